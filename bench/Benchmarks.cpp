@@ -0,0 +1,281 @@
+/*
+ * Benchmarks
+ * Timing of the GDP03 sampling and motion hot paths, in place of the test
+ * sequence of src/main.cpp:
+ *
+ *   pio run -e bench -t upload, then pio device monitor > bench.txt
+ *   pio run -e bench_native, then .pio/build/bench_native/program > bench.txt
+ *   python bench/compare.py bench/baseline_native.txt bench.txt
+ *
+ * The load cell operations run for every number of samples in use from 1
+ * up to SAMPLES (the bench envs build with SAMPLES = 128), getData() next
+ * to its fixed point counterpart getForce_mN(), and smoothedData() next to
+ * the smoothing it replaced (smoothedData.scan): the dataset summed and
+ * scanned for its highest and lowest sample on every read. The HX711 read-out is timed
+ * through HX711_ADC_Fast and through HX711_ADC on the same pins
+ * (conversion24bit.pins), for the gain of the direct port access; on the
+ * host both go through digitalWrite() and digitalRead(). The conversion of one raw
+ * sample to newtons is timed both ways too: the float formula main.cpp used
+ * (divide by calFactor, abs, / 1000, * g) and toForce_mN(). Telemetry.force()
+ * takes the place of the old printFloat3SF(): it sends a binary frame, or
+ * prints three significant figures with -D TELEMETRY_BINARY=0. The
+ * revolution is queued and waited for as stepMotor() does.
+ *
+ * Each filter policy of HX711_ADC_Filter.h is also timed on its own (a
+ * conversion added and the value read, on a noisy input) for a range of
+ * samples in use, and its step response is printed as a comment: the
+ * conversions until the output is 90% of the way to a step, and until it
+ * is within one count of it. The RAM of the average and median filters
+ * is printed for 4-byte and packed 3-byte samples at 16, 64 and 128
+ * samples (sizeof on the machine the report is from).
+ *
+ * On the Mega this needs the Forefoot HX711 on its pins (its read-out is
+ * skipped otherwise), and the Forefoot actuator turns one revolution each
+ * way, so run it with the foot clear of the load plate. On the host the
+ * virtual rig (lib/RigSim) stands in for both.
+ */
+
+#include <Arduino.h>
+#include <HX711_ADC.h>
+#include <HX711_ADC_Fast.h>
+#include <StepEngine.h>
+#include <Telemetry.h>
+#include <Bench.h>
+
+#ifdef HAL_NATIVE
+#include <RigSim.h>
+#endif
+
+// Pins as in src/main.cpp
+const int DIR_F = 35;
+const int PUL_F = 34;
+const int ENA_F = 28;
+const int HX711_dout_F = 4;
+const int HX711_sck_F = 5;
+
+const int stepsPerRevolution = 800; // 1/4 microstepping
+const int stepDelay_fast = 300;
+const float g = 9.81;
+const float calFactor = 419.87; // Raw counts per gram, about the rig's
+const unsigned long readyTimeout = 500; // Wait for a conversion before giving up on the HX711 (ms)
+const uint8_t conversionRuns = 100; // Runs of the operations that wait for the hardware
+const uint8_t revolutionRuns = 10;
+
+// The load cell with its protected steps opened up for timing
+class BenchLoadCell : public HX711_ADC_Fast<HX711_dout_F, HX711_sck_F> {
+  public:
+    using HX711_ADC_Base::conversion24bit;
+    using HX711_ADC_Base::smoothedData;
+};
+
+// The same HX711 through the runtime pin numbers of HX711_ADC
+class BenchPinLoadCell : public HX711_ADC {
+  public:
+    BenchPinLoadCell() : HX711_ADC(HX711_dout_F, HX711_sck_F) {}
+    using HX711_ADC_Base::conversion24bit;
+};
+
+// Print that drops everything, so the serial port's speed is not timed
+class NullPrint : public Print {
+  public:
+    size_t write(uint8_t) { return 1; }
+    size_t write(const uint8_t *, size_t size) { return size; }
+};
+
+BenchLoadCell LoadCell;
+BenchPinLoadCell PinLoadCell;
+long scanSampleSet[SAMPLES + IGN_HIGH_SAMPLE + IGN_LOW_SAMPLE]; // Dataset of smoothedData.scan
+uint8_t scanDivBit = 0;
+int scanSamplesInUse = 1;
+HX711_TrimmedAverage<SAMPLES> trimmedFilter;
+HX711_Median<15> medianFilter;
+HX711_IIR<4> iirFilter;
+HX711_Passthrough passthroughFilter;
+NullPrint nullPrint;
+TelemetryStream telemetry; // Not the global one, which the report would share a port with
+bool revolutionForward = false;
+
+// Untimed: wait for the HX711 to have a conversion ready
+bool conversionReady(void *) {
+  unsigned long start = millis();
+  while (digitalRead(HX711_dout_F) == HIGH) {
+    if (millis() - start > readyTimeout) return false;
+    yield();
+  }
+  return true;
+}
+
+void conversion24bit(void *) {
+  LoadCell.conversion24bit();
+}
+
+void conversion24bitPins(void *) {
+  PinLoadCell.conversion24bit();
+}
+
+void smoothedData(void *) {
+  volatile long data = LoadCell.smoothedData();
+  (void)data;
+}
+
+// HX711_ADC::smoothedData() before the running sum and min/max queues
+void smoothedDataScan(void *) {
+  long data = 0;
+  long L = 0xFFFFFF;
+  long H = 0x00;
+  for (uint8_t r = 0; r < (scanSamplesInUse + IGN_HIGH_SAMPLE + IGN_LOW_SAMPLE); r++) {
+    if (IGN_LOW_SAMPLE && L > scanSampleSet[r]) L = scanSampleSet[r]; // find lowest value
+    if (IGN_HIGH_SAMPLE && H < scanSampleSet[r]) H = scanSampleSet[r]; // find highest value
+    data += scanSampleSet[r];
+  }
+  if (IGN_LOW_SAMPLE) data -= L; // remove lowest value
+  if (IGN_HIGH_SAMPLE) data -= H; // remove highest value
+  volatile long result = data >> scanDivBit;
+  (void)result;
+}
+
+void getData(void *) {
+  volatile float data = LoadCell.getData();
+  (void)data;
+}
+
+// Raw values around mid-scale with +-2048 counts of noise
+long noisyRaw() {
+  static uint16_t lfsr = 0xACE1;
+  lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xB400);
+  return 0x800000L + (lfsr & 0x0FFF) - 0x0800;
+}
+
+template <class Filter>
+void filterAdd(void *context) {
+  Filter *filter = (Filter *)context;
+  filter->add(noisyRaw());
+  volatile long data = filter->value();
+  (void)data;
+}
+
+// Conversions until the output follows a step from 0x800000 to 0x810000, printed as a comment
+template <class Filter>
+void printStepResponse(const char *name, Filter &filter) {
+  const long from = 0x800000L;
+  const long to = 0x810000L;
+  int samples = filter.samples();
+  for (uint16_t n = 0; n < 2 * filter.settling + 2; n++) filter.add(from);
+  int ninety = -1;
+  int settled = -1;
+  for (int n = 1; n <= 1000 && settled < 0; n++) {
+    filter.add(to);
+    long value = filter.value();
+    if (ninety < 0 && value >= from + (to - from) * 9 / 10) ninety = n;
+    if (value >= to - 1 && value <= to + 1) settled = n;
+  }
+  Serial.print(F("# step response "));
+  Serial.print(name);
+  Serial.print(' ');
+  Serial.print(samples);
+  Serial.print(F(": 90% after "));
+  Serial.print(ninety);
+  Serial.print(F(", settled after "));
+  Serial.print(settled);
+  Serial.println(F(" conversions"));
+}
+
+template <class Filter>
+void benchFilter(const char *name, Filter &filter, int samples) {
+  filter.setSamples(samples, 0x800000L);
+  Bench.run(name, filter.samples(), filterAdd<Filter>, &filter);
+  printStepResponse(name, filter);
+}
+
+template <class Unpacked, class Packed>
+void printRam(const char *name, int samples) {
+  Serial.print(F("# ram "));
+  Serial.print(name);
+  Serial.print(' ');
+  Serial.print(samples);
+  Serial.print(F(": 4-byte samples "));
+  Serial.print(sizeof(Unpacked));
+  Serial.print(F(", packed "));
+  Serial.print(sizeof(Packed));
+  Serial.println(F(" bytes"));
+}
+
+void getForce_mN(void *) {
+  volatile long data = LoadCell.getForce_mN();
+  (void)data;
+}
+
+void rawToForceFloat(void *) {
+  float i = (noisyRaw() - LoadCell.getTareOffset()) / LoadCell.getCalFactor();
+  i = abs(i);
+  volatile float force = (i / 1000) * g;
+  (void)force;
+}
+
+void rawToForceFixed(void *) {
+  volatile float force = labs(LoadCell.toForce_mN(noisyRaw())) * 0.001;
+  (void)force;
+}
+
+void telemetryForce(void *) {
+  telemetry.force(0, FORCE_AFTER_FORWARD, 1.234);
+}
+
+// One revolution, alternating direction so the actuator ends where it started
+void stepMotorRevolution(void *) {
+  revolutionForward = !revolutionForward;
+  while (!Steppers.queueMove(0, revolutionForward, stepsPerRevolution, stepDelay_fast)) yield();
+  while (!Steppers.isMoveDone(0)) yield();
+}
+
+void setup() {
+#ifdef HAL_NATIVE
+  Rig.begin(rigDefaults);
+#endif
+  Serial.begin(57600);
+  Steppers.attach(0, DIR_F, PUL_F);
+  Steppers.begin();
+  pinMode(ENA_F, OUTPUT);
+  digitalWrite(ENA_F, LOW); // Enable the driver
+  LoadCell.begin();
+  LoadCell.setCalFactor(calFactor);
+  LoadCell.setForceScale(g);
+  LoadCell.setTareOffset(0x800000L);
+  PinLoadCell.begin();
+  telemetry.begin(nullPrint);
+
+  Serial.println(F("# GDP03 benchmarks"));
+  printRam<HX711_TrimmedAverage<16, 1, 1, HX711_Samples32>, HX711_TrimmedAverage<16> >("filter.trimmed", 16);
+  printRam<HX711_TrimmedAverage<64, 1, 1, HX711_Samples32>, HX711_TrimmedAverage<64> >("filter.trimmed", 64);
+  printRam<HX711_TrimmedAverage<128, 1, 1, HX711_Samples32>, HX711_TrimmedAverage<128> >("filter.trimmed", 128);
+  printRam<HX711_Median<15, HX711_Samples32>, HX711_Median<15> >("filter.median", 15);
+  Bench.begin(Serial);
+  for (unsigned int samples = 1; samples <= SAMPLES; samples *= 2) {
+    LoadCell.setSamplesInUse(samples);
+    Bench.run("conversion24bit", samples, conversion24bit, 0, conversionRuns, BENCH_VIRTUAL, conversionReady);
+    Bench.run("conversion24bit.pins", samples, conversion24bitPins, 0, conversionRuns, BENCH_VIRTUAL, conversionReady);
+    Bench.run("smoothedData", samples, smoothedData, 0);
+    scanSamplesInUse = samples;
+    for (scanDivBit = 0; (1 << scanDivBit) < samples; scanDivBit++);
+    for (uint8_t r = 0; r < samples + IGN_HIGH_SAMPLE + IGN_LOW_SAMPLE; r++) scanSampleSet[r] = noisyRaw();
+    Bench.run("smoothedData.scan", samples, smoothedDataScan, 0);
+    Bench.run("getData", samples, getData, 0);
+    Bench.run("getForce_mN", samples, getForce_mN, 0);
+  }
+  for (int samples = 1; samples <= SAMPLES; samples *= 2) benchFilter("filter.trimmed", trimmedFilter, samples);
+  for (int samples = 1; samples <= 15; samples = samples * 2 + 1) benchFilter("filter.median", medianFilter, samples);
+  for (int samples = 1; samples <= 16; samples *= 2) benchFilter("filter.iir", iirFilter, samples);
+  benchFilter("filter.passthrough", passthroughFilter, 1);
+  Bench.run("rawToForce.float", 0, rawToForceFloat, 0);
+  Bench.run("rawToForce.fixed", 0, rawToForceFixed, 0);
+  Bench.run("Telemetry.force", 0, telemetryForce, 0);
+  Bench.run("stepMotor.revolution", 0, stepMotorRevolution, 0, revolutionRuns, BENCH_VIRTUAL);
+  Serial.println(F("# done"));
+  Serial.flush();
+#ifdef HAL_NATIVE
+  exit(0); // The run ends with the report
+#endif
+}
+
+void loop() {
+}
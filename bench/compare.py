@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Compare a GDP03 benchmark report with a stored baseline.
+
+    python bench/compare.py bench/baseline_native.txt bench.txt
+    python bench/compare.py --update bench/baseline_native.txt bench.txt
+
+Reports are the lines printed by lib/Bench (operation, setting, runs, min,
+median, p99 and max in ns, '#' starts a comment). An operation has regressed
+when its median or p99 is more than the tolerance above the baseline, plus
+a floor for the clock's resolution on very short operations. The exit
+status is 1 if anything regressed. --update replaces the baseline with the
+report instead.
+"""
+
+import argparse
+import shutil
+import sys
+
+COLUMNS = ("min", "median", "p99", "max")
+CHECKED = ("median", "p99")
+
+
+def load(path):
+    results = {}
+    with open(path) as f:
+        for line in f:
+            line = line.split("#", 1)[0].split()
+            if len(line) != 7:
+                continue
+            name, setting = line[0], int(line[1])
+            results[(name, setting)] = dict(zip(COLUMNS, map(int, line[3:])))
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("report")
+    parser.add_argument("--tolerance", type=float, default=10, help="allowed slow-down in percent (default 10)")
+    parser.add_argument("--floor", type=int, default=20, help="allowed slow-down in ns on top of the tolerance (default 20)")
+    parser.add_argument("--update", action="store_true", help="store the report as the new baseline")
+    args = parser.parse_args()
+
+    if args.update:
+        shutil.copyfile(args.report, args.baseline)
+        print("baseline %s updated from %s" % (args.baseline, args.report))
+        return 0
+
+    baseline = load(args.baseline)
+    report = load(args.report)
+    regressions = 0
+    print("%-22s %7s %12s %12s %8s  %s" % ("operation", "setting", "base median", "median", "change", ""))
+    for key in sorted(set(baseline) | set(report)):
+        name, setting = key
+        if key not in report:
+            print("%-22s %7d %12d %12s %8s  missing" % (name, setting, baseline[key]["median"], "-", ""))
+            continue
+        new = report[key]
+        if key not in baseline:
+            print("%-22s %7d %12s %12d %8s  new" % (name, setting, "-", new["median"], ""))
+            continue
+        old = baseline[key]
+        slower = [c for c in CHECKED if new[c] > old[c] * (1 + args.tolerance / 100.0) + args.floor]
+        change = "%+.1f%%" % (100.0 * (new["median"] - old["median"]) / old["median"]) if old["median"] else "-"
+        flag = "REGRESSION (%s)" % ", ".join(slower) if slower else ""
+        regressions += bool(slower)
+        print("%-22s %7d %12d %12d %8s  %s" % (name, setting, old["median"], new["median"], change, flag))
+    print("%d regression%s" % (regressions, "" if regressions == 1 else "s"))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
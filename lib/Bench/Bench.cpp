@@ -0,0 +1,146 @@
+/*
+ * Bench
+ * Timing harness for the GDP03 benchmarks.
+ * See Bench.h for usage.
+ */
+
+#include "Bench.h"
+
+#ifdef __AVR__
+#include <avr/interrupt.h>
+#else
+#include <Hal.h>
+#include <time.h>
+#endif
+
+#define BENCH_OVERHEAD_RUNS 16 // Empty runs timed to find the cost of reading the clock
+
+BenchRunner Bench;
+
+static void benchNothing(void *) {
+}
+
+#ifdef __AVR__
+
+static volatile uint16_t benchOverflows = 0; // Upper half of the cycle count
+
+ISR(TIMER5_OVF_vect) {
+  benchOverflows++;
+}
+
+static void benchStartClock() {
+  TCCR5A = 0;
+  TCCR5B = _BV(CS50); // Normal mode, no prescaler: one count per CPU cycle
+  TCNT5 = 0;
+  benchOverflows = 0;
+  TIFR5 = _BV(TOV5);
+  TIMSK5 = _BV(TOIE5);
+}
+
+static uint32_t benchCycles() {
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t count = TCNT5;
+  uint16_t high = benchOverflows;
+  if ((TIFR5 & _BV(TOV5)) && count < 0x8000) high++; // Overflowed since interrupts went off, not counted yet
+  SREG = oldSREG;
+  return ((uint32_t)high << 16) | count;
+}
+
+#else
+
+static void benchStartClock() {
+}
+
+static uint64_t benchNanoseconds() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+#endif
+
+void BenchRunner::begin(Print &output) {
+  out = &output;
+  benchStartClock();
+  overhead = 0;
+  uint32_t fastest = 0xFFFFFFFFUL;
+  for (uint8_t i = 0; i < BENCH_OVERHEAD_RUNS; i++) {
+    uint32_t t = measure(benchNothing, 0, BENCH_CPU);
+    if (t < fastest) fastest = t;
+  }
+#ifdef __AVR__
+  overhead = ((uint64_t)fastest * (F_CPU / 1000000UL) + 500) / 1000; // Back to cycles
+  out->print(F("# clock: Timer5 cycles, overhead "));
+  out->print(overhead);
+  out->println(F(" cycles subtracted"));
+#else
+  overhead = fastest;
+  out->print(F("# clock: host monotonic in batches of "));
+  out->print(BENCH_HOST_BATCH);
+  out->print(F(" (overhead "));
+  out->print(overhead);
+  out->println(F(" ns subtracted), HAL virtual clock for pin timing"));
+#endif
+  out->println(F("# operation setting runs min_ns median_ns p99_ns max_ns"));
+}
+
+void BenchRunner::run(const char *name, unsigned int setting, Operation operation, void *context, uint8_t runs, BenchClock clock, Prepare prepare) {
+  if (runs > BENCH_RUNS) runs = BENCH_RUNS;
+  if (runs == 0) return;
+  for (uint8_t i = 0; i < runs; i++) {
+    if (prepare && !prepare(context)) {
+      out->print(F("# "));
+      out->print(name);
+      out->print(' ');
+      out->print(setting);
+      out->println(F(" skipped"));
+      return;
+    }
+    times[i] = measure(operation, context, clock);
+  }
+  sort(runs);
+  out->print(name);
+  out->print(' ');
+  out->print(setting);
+  out->print(' ');
+  out->print(runs);
+  out->print(' ');
+  out->print(times[0]);
+  out->print(' ');
+  out->print(times[(runs - 1) / 2]);
+  out->print(' ');
+  out->print(times[(runs * 99UL + 99) / 100 - 1]); // Nearest rank
+  out->print(' ');
+  out->println(times[runs - 1]);
+}
+
+uint32_t BenchRunner::measure(Operation operation, void *context, BenchClock clock) {
+#ifdef __AVR__
+  uint32_t start = benchCycles();
+  operation(context);
+  uint32_t cycles = benchCycles() - start;
+  cycles = (cycles > overhead) ? cycles - overhead : 0;
+  return (uint64_t)cycles * 1000 / (F_CPU / 1000000UL);
+#else
+  if (clock == BENCH_VIRTUAL) {
+    unsigned long start = Hal.now();
+    operation(context);
+    return (Hal.now() - start) * 1000UL;
+  }
+  uint64_t start = benchNanoseconds();
+  for (uint8_t i = 0; i < BENCH_HOST_BATCH; i++) operation(context);
+  uint32_t t = (benchNanoseconds() - start) / BENCH_HOST_BATCH;
+  return (t > overhead) ? t - overhead : 0;
+#endif
+}
+
+// Insertion sort, the runs are few and mostly close to sorted
+void BenchRunner::sort(uint8_t runs) {
+  for (uint8_t i = 1; i < runs; i++) {
+    uint32_t t = times[i];
+    uint8_t j = i;
+    for (; j > 0 && times[j - 1] > t; j--) times[j] = times[j - 1];
+    times[j] = t;
+  }
+}
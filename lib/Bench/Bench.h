@@ -0,0 +1,61 @@
+/*
+ * Bench
+ * Timing harness for the GDP03 benchmarks (bench/, [env:bench] on the Mega
+ * and [env:bench_native] on the host).
+ *
+ * run() times an operation a number of times and prints one line with the
+ * fastest, median, 99th percentile and slowest run in nanoseconds:
+ *
+ *   <operation> <setting> <runs> <min> <median> <p99> <max>
+ *
+ * The setting is the number of samples in use for the load cell operations
+ * and 0 where it does not apply. Lines starting with '#' are comments.
+ * bench/compare.py checks a report against a stored baseline.
+ *
+ * On the Mega the clock is Timer5 counting CPU cycles (62.5 ns), extended to
+ * 32 bits by its overflow interrupt, with the cost of reading it subtracted.
+ * Timer1 and Timer3 are the step timers and Timer4 polls the load cells, so
+ * Timer5 is the one that is free. Interrupts stay enabled while an
+ * operation runs, so the spread includes the ISRs that would hit it in the
+ * firmware.
+ *
+ * On the host an operation is timed on one of two clocks. BENCH_CPU is the
+ * monotonic clock, over batches of BENCH_HOST_BATCH calls since one call is
+ * shorter than its resolution. BENCH_VIRTUAL is the HAL's virtual clock, for
+ * operations whose time is pin timing and delays (an HX711 read-out, a
+ * stepper move): it gives the time the simulated board takes, the same on
+ * every run, where a host clock would only measure the simulator.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <Arduino.h>
+
+#define BENCH_RUNS 200 // Most runs kept per operation
+#define BENCH_HOST_BATCH 100 // Calls per timed run on the host's monotonic clock
+
+enum BenchClock {
+  BENCH_CPU, // Host: monotonic clock, in batches
+  BENCH_VIRTUAL // Host: HAL virtual clock, one call per run
+}; // The Mega always counts cycles
+
+class BenchRunner {
+  public:
+    typedef void (*Operation)(void *context);
+    typedef bool (*Prepare)(void *context); // Untimed set-up before each run, false abandons the operation
+
+    void begin(Print &out); // Start the clock and print the report header
+    void run(const char *name, unsigned int setting, Operation operation, void *context, uint8_t runs = BENCH_RUNS, BenchClock clock = BENCH_CPU, Prepare prepare = 0);
+
+  private:
+    uint32_t measure(Operation operation, void *context, BenchClock clock); // One run (ns)
+    void sort(uint8_t runs);
+    Print *out = 0;
+    uint32_t overhead = 0; // Cost of reading the clock (cycles)
+    uint32_t times[BENCH_RUNS];
+};
+
+extern BenchRunner Bench;
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * Commands
+ * Run-time command interface of the GDP03 firmware.
+ * See Commands.h for usage.
+ */
+
+#include "Commands.h"
+#include <Telemetry.h>
+#include <string.h>
+
+CommandParser Commands;
+
+static const char *const statusNames[] = {"ok", "unknown", "range", "busy", "syntax", "store"};
+
+uint8_t CommandParser::feed(uint8_t byte) {
+  if (byte == 0x00) {
+    if (!binary) { // Start of a frame, drops any partial text line
+      binary = true;
+      frameBytes = 0;
+      length = 0;
+      overflow = false;
+      return 0;
+    }
+    if (frameBytes == 0) return 0; // Back-to-back delimiters keep waiting for the frame
+    binary = false; // Back to text, whether or not the frame was valid
+    return decoder.feed(byte) ? runFrame() : 0;
+  }
+  if (binary) {
+    decoder.feed(byte);
+    if (frameBytes < 255) frameBytes++;
+    return 0;
+  }
+  if (byte == '\n' || byte == '\r') {
+    uint8_t request = (length > 0 || overflow) ? runLine() : 0;
+    length = 0;
+    overflow = false;
+    return request;
+  }
+  if (length == 0 && !overflow) {
+    if (byte == 'r') return COMMAND_RAW;
+    if (byte == 'd') return COMMAND_TRACE;
+  }
+  if (length < COMMAND_LINE_LENGTH) line[length++] = byte;
+  else overflow = true;
+  return 0;
+}
+
+uint8_t CommandParser::runLine() {
+  if (overflow) {
+    error(PARAMETER_SYNTAX);
+    return 0;
+  }
+  // Split in place into up to three words
+  line[length] = 0;
+  char *words[3] = {0, 0, 0};
+  uint8_t count = 0;
+  for (char *p = line; *p; p++) {
+    if (*p == ' ' || *p == '\t') {
+      *p = 0;
+    }
+    else if (p == line || p[-1] == 0) {
+      if (count == 3) {
+        error(PARAMETER_SYNTAX);
+        return 0;
+      }
+      words[count++] = p;
+    }
+  }
+  if (count == 0) return 0;
+  const char *command = words[0];
+
+  if (!strcmp(command, "list") && count == 1) {
+    for (uint8_t id = 0; id < Parameters.count(); id++) {
+      const Parameter *p = Parameters.describe(id);
+      char text[TELEMETRY_MAX_PAYLOAD + 1];
+      uint8_t n = 0;
+      for (const char *c = p->name; *c && n < sizeof(text) - 1; c++) text[n++] = *c;
+      char value[13 + PARAMETERS_MAX_DECIMALS];
+      const long values[3] = {Parameters.get(id), p->minimum, p->maximum};
+      for (uint8_t i = 0; i < 3; i++) {
+        uint8_t m = formatFixed(values[i], p->decimals, value);
+        if (n + 1 + m >= (uint8_t)sizeof(text)) break;
+        text[n++] = ' ';
+        memcpy(text + n, value, m);
+        n += m;
+      }
+      text[n] = 0;
+      Telemetry.text(text);
+    }
+    Telemetry.text("end");
+    return 0;
+  }
+  if (!strcmp(command, "save") && count == 1) {
+    uint8_t status = Parameters.save();
+    if (status == PARAMETER_OK) Telemetry.text("saved");
+    else error(status);
+    return 0;
+  }
+  if (!strcmp(command, "start") && count == 1) {
+    if (!Parameters.isTestRunning()) return COMMAND_START;
+    error(PARAMETER_BUSY);
+    return 0;
+  }
+  bool get = !strcmp(command, "get") && count == 2;
+  bool set = !strcmp(command, "set") && count == 3;
+  if (!get && !set) {
+    error(PARAMETER_SYNTAX);
+    return 0;
+  }
+  int8_t id = Parameters.find(words[1]);
+  if (id < 0) {
+    error(PARAMETER_UNKNOWN);
+    return 0;
+  }
+  if (set) {
+    long value;
+    if (!parseFixed(words[2], Parameters.describe(id)->decimals, value)) {
+      error(PARAMETER_SYNTAX);
+      return 0;
+    }
+    uint8_t status = Parameters.set(id, value);
+    if (status != PARAMETER_OK) {
+      error(status);
+      return 0;
+    }
+  }
+  answer(id);
+  return 0;
+}
+
+uint8_t CommandParser::runFrame() {
+  const uint8_t *p = decoder.payload();
+  uint8_t n = decoder.length();
+  uint8_t id = (n > 0) ? p[0] : COMMAND_ALL;
+  switch (decoder.type()) {
+    case COMMAND_GET:
+      if (n < 1) break;
+      Telemetry.parameter(id, id < Parameters.count() ? PARAMETER_OK : PARAMETER_UNKNOWN, Parameters.get(id));
+      return 0;
+
+    case COMMAND_SET: {
+      if (n < 5) break;
+      uint8_t status = Parameters.set(id, (long)telemetryGet32(p + 1)); // Before get(), the answer carries the new value
+      Telemetry.parameter(id, status, Parameters.get(id));
+      return 0;
+    }
+
+    case COMMAND_DESCRIBE: {
+      if (n < 1) break;
+      const Parameter *d = Parameters.describe(id);
+      if (d) Telemetry.parameterInfo(id, d->decimals, d->flags, d->minimum, d->maximum, d->name);
+      else Telemetry.parameter(id, PARAMETER_UNKNOWN, 0);
+      return 0;
+    }
+
+    case COMMAND_SAVE:
+      Telemetry.parameter(COMMAND_ALL, Parameters.save(), 0);
+      return 0;
+
+    case COMMAND_START:
+      if (!Parameters.isTestRunning()) return COMMAND_START;
+      Telemetry.parameter(COMMAND_ALL, PARAMETER_BUSY, 0);
+      return 0;
+
+    case COMMAND_RAW:
+    case COMMAND_TRACE:
+      return decoder.type();
+  }
+  Telemetry.parameter(COMMAND_ALL, PARAMETER_SYNTAX, decoder.type());
+  return 0;
+}
+
+void CommandParser::error(uint8_t status) {
+  char text[16] = "error ";
+  strcat(text, statusNames[status]);
+  Telemetry.text(text);
+}
+
+void CommandParser::answer(uint8_t id) {
+  const Parameter *p = Parameters.describe(id);
+  char text[COMMAND_NAME_LENGTH + 14 + PARAMETERS_MAX_DECIMALS];
+  uint8_t n = 0;
+  for (const char *c = p->name; *c && n < COMMAND_NAME_LENGTH; c++) text[n++] = *c;
+  text[n++] = ' ';
+  formatFixed(Parameters.get(id), p->decimals, text + n);
+  Telemetry.text(text);
+}
@@ -0,0 +1,63 @@
+/*
+ * Commands
+ * Run-time command interface of the GDP03 firmware, so test parameters
+ * (Parameters.h) can be read, changed and saved over serial without
+ * reflashing.
+ *
+ * The sketch passes every received byte to feed(). Text commands are lines
+ * ending in '\n' or '\r', answered with TEXT telemetry:
+ *   get <name>          -> "<name> <value>"
+ *   set <name> <value>  -> "<name> <value>" with the value now in use
+ *   list                -> "<name> <value> <minimum> <maximum>" for each
+ *                          parameter, then "end"
+ *   save                -> "saved"
+ *   start               -> starts the test at the start prompt, or another
+ *                          test once the last has completed
+ * Errors are answered with "error <unknown|range|busy|syntax|store>". Values
+ * are decimal, with up to the parameter's decimal places (further digits
+ * are rounded). The single characters 'r' (toggle raw sample streaming) and
+ * 'd' (dump the event trace) still act at once at the start of a line.
+ * The sketch takes commands from the start prompt on, where lines that do
+ * not begin with one of the prompt's answers (y, n, c) are commands.
+ *
+ * Binary commands are frames as in TelemetryFrame.h, with a CommandType
+ * and fixed point values, sent between two 0x00 delimiters (a 0x00 first
+ * marks the bytes that follow as a frame rather than text). They are
+ * answered with TELEMETRY_PARAMETER frames, and COMMAND_DESCRIBE lets host
+ * tools list the parameters with their ranges by asking for ids from 0 up
+ * until PARAMETER_UNKNOWN comes back.
+ *
+ * Nothing is allocated: a text line is collected in a fixed buffer and split
+ * in place, and frames are decoded by a TelemetryDecoder.
+ */
+
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <stdint.h>
+#include <TelemetryFrame.h>
+#include "Parameters.h"
+
+#define COMMAND_LINE_LENGTH 40 // Longest text command, longer lines are refused
+#define COMMAND_NAME_LENGTH 24 // Longest parameter name in answers
+
+class CommandParser {
+  public:
+    uint8_t feed(uint8_t byte); // One received byte, returns COMMAND_START, COMMAND_RAW or COMMAND_TRACE for the sketch to act on, else 0
+
+  private:
+    uint8_t runLine();
+    uint8_t runFrame();
+    void error(uint8_t status);
+    void answer(uint8_t id); // "<name> <value>"
+    char line[COMMAND_LINE_LENGTH + 1];
+    uint8_t length = 0;
+    bool overflow = false;
+    bool binary = false; // Bytes are a frame until the next 0x00
+    uint8_t frameBytes = 0; // Bytes of the frame so far
+    TelemetryDecoder decoder;
+};
+
+extern CommandParser Commands;
+
+#endif
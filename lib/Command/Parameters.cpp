@@ -0,0 +1,161 @@
+/*
+ * Parameters
+ * Test parameters of the GDP03 firmware that can be changed at run time.
+ * See Parameters.h for usage.
+ */
+
+#include "Parameters.h"
+#include <ConfigStore.h>
+#include <string.h>
+
+ParameterSet Parameters;
+
+static const long decimalScale[PARAMETERS_MAX_DECIMALS + 1] = {1, 10, 100, 1000, 10000};
+
+void ParameterSet::begin(const Parameter *table, uint8_t count) {
+  this->table = table;
+  entries = count;
+  changes = false;
+  recalibrate = false;
+}
+
+uint8_t ParameterSet::count() {
+  return entries;
+}
+
+const Parameter *ParameterSet::describe(uint8_t id) {
+  return (id < entries) ? &table[id] : 0;
+}
+
+int8_t ParameterSet::find(const char *name) {
+  for (uint8_t i = 0; i < entries; i++) {
+    if (!strcmp(table[i].name, name)) return i;
+  }
+  return -1;
+}
+
+long ParameterSet::get(uint8_t id) {
+  if (id >= entries) return 0;
+  const Parameter &p = table[id];
+  switch (p.type) {
+    case PARAMETER_BYTE: return *(uint8_t *)p.variable;
+    case PARAMETER_INT: return *(int *)p.variable;
+    case PARAMETER_LONG: return *(long *)p.variable;
+    case PARAMETER_FLOAT: {
+      float v = *(float *)p.variable * decimalScale[p.decimals];
+      return (long)(v + (v < 0 ? -0.5 : 0.5));
+    }
+  }
+  return 0;
+}
+
+uint8_t ParameterSet::set(uint8_t id, long value) {
+  if (id >= entries) return PARAMETER_UNKNOWN;
+  const Parameter &p = table[id];
+  if (value < p.minimum || value > p.maximum) return PARAMETER_RANGE;
+  if (value == get(id)) return PARAMETER_OK;
+  if (running && (p.flags & PARAMETER_IDLE)) return PARAMETER_BUSY;
+  switch (p.type) {
+    case PARAMETER_BYTE: *(uint8_t *)p.variable = value; break;
+    case PARAMETER_INT: *(int *)p.variable = value; break;
+    case PARAMETER_LONG: *(long *)p.variable = value; break;
+    case PARAMETER_FLOAT: *(float *)p.variable = (float)value / decimalScale[p.decimals]; break;
+  }
+  changes = true;
+  if (p.flags & PARAMETER_RECALIBRATE) recalibrate = true;
+  return PARAMETER_OK;
+}
+
+void ParameterSet::setTestRunning(bool running) {
+  this->running = running;
+}
+
+bool ParameterSet::isTestRunning() {
+  return running;
+}
+
+bool ParameterSet::changed() {
+  bool c = changes;
+  changes = false;
+  return c;
+}
+
+bool ParameterSet::needsRecalibration() {
+  bool r = recalibrate;
+  recalibrate = false;
+  return r;
+}
+
+// The fixed point values are kept in table order
+uint8_t ParameterSet::save() {
+  int32_t values[CONFIG_MAX_PARAMETERS];
+  if (entries > CONFIG_MAX_PARAMETERS) return PARAMETER_STORE;
+  for (uint8_t i = 0; i < entries; i++) values[i] = get(i);
+  Config.setParameters(values, entries);
+  return Config.save() ? PARAMETER_OK : PARAMETER_STORE;
+}
+
+bool ParameterSet::load() {
+  uint8_t saved = Config.getParameterCount();
+  if (saved == 0 || saved > entries) return false; // Parameters added to the end of the table since keep their defaults
+  bool wasRunning = running;
+  running = false;
+  for (uint8_t i = 0; i < saved; i++) set(i, Config.getParameter(i)); // Out of range: the default is kept
+  running = wasRunning;
+  return true;
+}
+
+bool parseFixed(const char *text, uint8_t decimals, long &value) {
+  bool negative = (*text == '-');
+  if (*text == '-' || *text == '+') text++;
+  long v = 0;
+  uint8_t digits = 0; // Digits after the first significant one, at most 8 so v stays within a long
+  int8_t places = -1; // Decimal places read, -1 before the point
+  bool any = false;
+  bool roundUp = false;
+  for (; *text; text++) {
+    char c = *text;
+    if (c == '.' && places < 0) {
+      places = 0;
+      continue;
+    }
+    if (c < '0' || c > '9') return false;
+    any = true;
+    if (places >= decimals) { // Past the fixed point precision: only the first extra digit rounds
+      if (places == decimals) {
+        roundUp = (c >= '5');
+        places++;
+      }
+      continue;
+    }
+    if (v != 0 && ++digits > 8) return false;
+    v = v * 10 + (c - '0');
+    if (places >= 0) places++;
+  }
+  if (!any) return false;
+  for (int8_t i = (places < 0) ? 0 : places; i < decimals; i++) {
+    if (v != 0 && ++digits > 8) return false;
+    v *= 10;
+  }
+  if (roundUp) v++;
+  value = negative ? -v : v;
+  return true;
+}
+
+uint8_t formatFixed(long value, uint8_t decimals, char *out) {
+  char digits[12];
+  uint8_t n = 0;
+  unsigned long v = (value < 0) ? -(unsigned long)value : value;
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v || n <= decimals);
+  uint8_t length = 0;
+  if (value < 0) out[length++] = '-';
+  while (n > 0) {
+    if (n == decimals) out[length++] = '.';
+    out[length++] = digits[--n];
+  }
+  out[length] = 0;
+  return length;
+}
@@ -0,0 +1,90 @@
+/*
+ * Parameters
+ * Test parameters of the GDP03 firmware that can be changed at run time.
+ *
+ * The sketch lists its tunable globals in a table of Parameter entries
+ * (name, variable, type, range) and hands it to begin(). Values cross the
+ * interface as fixed point integers, value * 10^decimals (a force with 3
+ * decimals is in mN), so they can be parsed, checked and sent without float
+ * formatting and mean the same in text and binary commands. set() checks the
+ * range before writing the variable, and parameters marked PARAMETER_IDLE
+ * are refused while a test is running. The sketch asks changed() to update
+ * the settings derived from the variables, and needsRecalibration() to
+ * search the step counts again after a change to the target.
+ *
+ * save() writes every value to EEPROM with the rest of the configuration
+ * (ConfigStore.h), load() takes them from the configuration read at boot (an
+ * entry out of range keeps the compiled default, and so do entries added to
+ * the end of the table after the save).
+ */
+
+#ifndef PARAMETERS_H
+#define PARAMETERS_H
+
+#include <stdint.h>
+
+#define PARAMETERS_MAX_DECIMALS 4 // Most decimal places of a fixed point value
+
+// C type of the variable behind a parameter
+enum ParameterType {
+  PARAMETER_BYTE = 0, // uint8_t
+  PARAMETER_INT = 1, // int
+  PARAMETER_LONG = 2, // long
+  PARAMETER_FLOAT = 3 // float
+};
+
+enum ParameterFlags {
+  PARAMETER_RECALIBRATE = 1, // A change needs a new step search (needsRecalibration())
+  PARAMETER_IDLE = 2 // Can only be changed while no test is running
+};
+
+// Result of a command, sent back to the host
+enum ParameterStatus {
+  PARAMETER_OK = 0,
+  PARAMETER_UNKNOWN = 1, // No parameter with this name or id
+  PARAMETER_RANGE = 2, // Value out of range, not changed
+  PARAMETER_BUSY = 3, // Not while a test is running
+  PARAMETER_SYNTAX = 4, // Malformed command or value
+  PARAMETER_STORE = 5 // EEPROM did not read back what was written
+};
+
+struct Parameter {
+  const char *name;
+  void *variable;
+  uint8_t type; // ParameterType
+  uint8_t decimals; // Fixed point decimal places, up to PARAMETERS_MAX_DECIMALS
+  uint8_t flags; // ParameterFlags
+  long minimum; // Range, fixed point
+  long maximum;
+};
+
+class ParameterSet {
+  public:
+    void begin(const Parameter *table, uint8_t count); // Up to CONFIG_MAX_PARAMETERS can be saved
+    uint8_t count();
+    const Parameter *describe(uint8_t id); // Entry of a parameter, 0 past the last
+    int8_t find(const char *name); // Id of a parameter, -1 if unknown
+    long get(uint8_t id); // Fixed point value
+    uint8_t set(uint8_t id, long value); // ParameterStatus
+    void setTestRunning(bool running); // PARAMETER_IDLE parameters are refused while set
+    bool isTestRunning();
+    bool changed(); // True once after any change
+    bool needsRecalibration(); // True once after a change to a PARAMETER_RECALIBRATE parameter
+    uint8_t save(); // ParameterStatus
+    bool load(); // False if nothing was saved for this table
+
+  private:
+    const Parameter *table = 0;
+    uint8_t entries = 0;
+    bool running = false;
+    bool changes = false;
+    bool recalibrate = false;
+};
+
+// Fixed point text conversions, without float formatting or allocation
+bool parseFixed(const char *text, uint8_t decimals, long &value); // False if 'text' is not a number (extra decimals are rounded)
+uint8_t formatFixed(long value, uint8_t decimals, char *out); // Writes a terminated string of up to 12 + decimals characters, returns its length
+
+extern ParameterSet Parameters;
+
+#endif
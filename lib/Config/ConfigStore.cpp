@@ -0,0 +1,182 @@
+/*
+ * ConfigStore
+ * Configuration of the GDP03 firmware kept in EEPROM across restarts.
+ * See ConfigStore.h for usage.
+ */
+
+#include "ConfigStore.h"
+#include <EEPROM.h>
+#include <TelemetryFrame.h>
+#include <math.h>
+#include <string.h>
+#include <stddef.h>
+
+// Earlier layout, migrated by begin()
+#define CONFIG_LEGACY_CAL_ADDRESS 0 // float per channel, 4 bytes apart
+#define CONFIG_LEGACY_PARAMETERS_ADDRESS 8 // Magic, count, then int32_t values
+#define CONFIG_LEGACY_PARAMETERS_MAGIC 0x50 // 'P'
+
+static_assert(CONFIG_LEGACY_PARAMETERS_ADDRESS + 2 + 4 * CONFIG_MAX_PARAMETERS <= CONFIG_ADDRESS, "ConfigStore: the earlier layout must end before slot A");
+static_assert(sizeof(ConfigRecord) <= CONFIG_SLOT_SIZE, "ConfigStore: ConfigRecord does not fit in a slot");
+
+ConfigStore Config;
+
+static int slotAddress(uint8_t slot) {
+  return CONFIG_ADDRESS + slot * CONFIG_SLOT_SIZE;
+}
+
+// CRC over the record with the crc field itself skipped
+static uint16_t recordCrc(const ConfigRecord &record) {
+  const uint8_t *bytes = (const uint8_t *)&record;
+  const size_t field = offsetof(ConfigRecord, crc);
+  uint16_t crc = telemetryCrc16(bytes, field);
+  return telemetryCrc16(bytes + field + sizeof(record.crc), sizeof(record) - field - sizeof(record.crc), crc);
+}
+
+uint8_t ConfigStore::begin() {
+  memset(&record, 0, sizeof(record));
+  slot = CONFIG_NO_SLOT;
+  badSlots = 0;
+  dirty = false;
+  ConfigRecord slotRecord;
+  for (uint8_t i = 0; i < 2; i++) {
+    if (!readSlot(i, slotRecord)) continue;
+    if (slot == CONFIG_NO_SLOT || (int16_t)(slotRecord.sequence - record.sequence) > 0) {
+      record = slotRecord;
+      slot = i;
+    }
+  }
+  if (slot != CONFIG_NO_SLOT) source = CONFIG_LOADED;
+  else source = migrate() ? CONFIG_MIGRATED : CONFIG_EMPTY;
+  return source;
+}
+
+uint8_t ConfigStore::getSource() {
+  return source;
+}
+
+uint8_t ConfigStore::getSlot() {
+  return slot;
+}
+
+uint8_t ConfigStore::getBadSlots() {
+  return badSlots;
+}
+
+uint16_t ConfigStore::getSequence() {
+  return record.sequence;
+}
+
+bool ConfigStore::save() {
+  if (!dirty) return true;
+  uint8_t target = (slot == 0) ? 1 : 0; // Never the slot holding the current record
+  record.magic = CONFIG_MAGIC;
+  record.version = CONFIG_VERSION;
+  record.sequence++;
+  record.crc = recordCrc(record);
+#if defined(ESP8266)|| defined(ESP32)
+  EEPROM.begin(512);
+#endif
+  EEPROM.put(slotAddress(target), record);
+#if defined(ESP8266)|| defined(ESP32)
+  EEPROM.commit();
+#endif
+  ConfigRecord stored;
+  if (!readSlot(target, stored) || memcmp(&stored, &record, sizeof(record)) != 0) return false;
+  badSlots &= ~(1 << target);
+  slot = target;
+  dirty = false;
+  return true;
+}
+
+bool ConfigStore::isCalibrated(uint8_t channel) {
+  return channel < CONFIG_CHANNELS && (record.flags & (CONFIG_CALIBRATED << channel));
+}
+
+float ConfigStore::getCalFactor(uint8_t channel) {
+  return isCalibrated(channel) ? record.calFactor[channel] : 0;
+}
+
+void ConfigStore::setCalFactor(uint8_t channel, float calFactor) {
+  if (channel < CONFIG_CHANNELS) change(&record.calFactor[channel], &calFactor, sizeof(calFactor), CONFIG_CALIBRATED << channel);
+}
+
+bool ConfigStore::isTared(uint8_t channel) {
+  return channel < CONFIG_CHANNELS && (record.flags & (CONFIG_TARED << channel));
+}
+
+long ConfigStore::getTareOffset(uint8_t channel) {
+  return isTared(channel) ? record.tareOffset[channel] : 0;
+}
+
+void ConfigStore::setTareOffset(uint8_t channel, long tareOffset) {
+  int32_t value = tareOffset;
+  if (channel < CONFIG_CHANNELS) change(&record.tareOffset[channel], &value, sizeof(value), CONFIG_TARED << channel);
+}
+
+bool ConfigStore::hasLimits() {
+  return record.flags & CONFIG_LIMITS;
+}
+
+const MotionLimits &ConfigStore::getLimits() {
+  return record.limits;
+}
+
+void ConfigStore::setLimits(const MotionLimits &limits) {
+  change(&record.limits, &limits, sizeof(limits), CONFIG_LIMITS);
+}
+
+bool ConfigStore::hasParameters() {
+  return record.flags & CONFIG_PARAMETERS;
+}
+
+uint8_t ConfigStore::getParameterCount() {
+  return hasParameters() ? record.parameterCount : 0;
+}
+
+long ConfigStore::getParameter(uint8_t id) {
+  return (id < getParameterCount()) ? record.parameters[id] : 0;
+}
+
+bool ConfigStore::setParameters(const int32_t *values, uint8_t count) {
+  if (count > CONFIG_MAX_PARAMETERS) return false;
+  if (record.parameterCount != count) {
+    record.parameterCount = count;
+    record.flags &= ~CONFIG_PARAMETERS; // Marks the record as changed below
+  }
+  change(record.parameters, values, count * sizeof(int32_t), CONFIG_PARAMETERS);
+  return true;
+}
+
+// One read of a slot, true if it holds a record of this version with a good CRC
+bool ConfigStore::readSlot(uint8_t slot, ConfigRecord &slotRecord) {
+  EEPROM.get(slotAddress(slot), slotRecord);
+  if (slotRecord.magic == 0xFFFF && slotRecord.version == 0xFF) return false; // Erased, never written
+  if (slotRecord.magic == CONFIG_MAGIC && slotRecord.version == CONFIG_VERSION && slotRecord.crc == recordCrc(slotRecord)) return true;
+  badSlots |= 1 << slot;
+  return false;
+}
+
+// Fill the record from the earlier layout, true if it held anything
+bool ConfigStore::migrate() {
+  for (uint8_t i = 0; i < CONFIG_CHANNELS; i++) {
+    float calFactor;
+    EEPROM.get(CONFIG_LEGACY_CAL_ADDRESS + 4 * i, calFactor);
+    if (isfinite(calFactor) && calFactor != 0) setCalFactor(i, calFactor); // Erased EEPROM reads as NaN
+  }
+  uint8_t count = EEPROM.read(CONFIG_LEGACY_PARAMETERS_ADDRESS + 1);
+  if (EEPROM.read(CONFIG_LEGACY_PARAMETERS_ADDRESS) == CONFIG_LEGACY_PARAMETERS_MAGIC && count <= CONFIG_MAX_PARAMETERS) {
+    int32_t values[CONFIG_MAX_PARAMETERS];
+    for (uint8_t i = 0; i < count; i++) EEPROM.get(CONFIG_LEGACY_PARAMETERS_ADDRESS + 2 + 4 * i, values[i]);
+    setParameters(values, count);
+  }
+  return dirty;
+}
+
+// Set a field of the record, marking it changed if the value or the flag is new
+void ConfigStore::change(void *field, const void *value, uint8_t size, uint8_t flag) {
+  if ((record.flags & flag) && memcmp(field, value, size) == 0) return;
+  memcpy(field, value, size);
+  record.flags |= flag;
+  dirty = true;
+}
@@ -0,0 +1,103 @@
+/*
+ * ConfigStore
+ * Configuration of the GDP03 firmware kept in EEPROM across restarts: the
+ * load cells' calibration factors and tare offsets, the test parameters
+ * saved with the 'save' command (Parameters.h) and the motion limits.
+ *
+ * The configuration is one ConfigRecord, stored twice (slots A and B) with a
+ * version, a save sequence number and a CRC-16/CCITT-FALSE (as the telemetry
+ * frames). save() always writes the slot that does not hold the current
+ * record, so a save cut short by a reset leaves the previous record intact,
+ * and begin() takes the newest slot that passes its checks. The record is
+ * read once at boot by begin() and kept in RAM: the getters never touch
+ * EEPROM, and save() only writes when a setter has changed something (and
+ * then, through EEPROM.update(), only the bytes that differ).
+ *
+ * If neither slot is valid, begin() migrates the earlier layout: raw float
+ * calibration factors at addresses 0 and 4, and the test parameters at 8
+ * ('P', count, int32_t values). The migrated record is written by the next
+ * save(), the earlier layout is left as it was.
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdint.h>
+#include <MotionPlanner.h>
+
+#define CONFIG_MAGIC 0x4743 // 'GC'
+#define CONFIG_VERSION 1 // Layout of ConfigRecord, a record of another version is not loaded
+#define CONFIG_CHANNELS 2 // Load cells, sampler channel order
+#define CONFIG_MAX_PARAMETERS 12 // Test parameters kept, in parameter table order
+#define CONFIG_ADDRESS 64 // EEPROM address of slot A, after the earlier layout
+#define CONFIG_SLOT_SIZE 128 // Slot B starts CONFIG_SLOT_SIZE after slot A
+#define CONFIG_NO_SLOT 0xFF
+
+// Parts of the record that hold a value
+enum ConfigFlags {
+  CONFIG_CALIBRATED = 0x01, // Calibration factor of channel n: CONFIG_CALIBRATED << n
+  CONFIG_TARED = 0x04, // Tare offset of channel n: CONFIG_TARED << n
+  CONFIG_PARAMETERS = 0x10,
+  CONFIG_LIMITS = 0x20
+};
+
+// Where the record in RAM came from at boot
+enum ConfigSource {
+  CONFIG_EMPTY = 0, // Nothing saved, defaults
+  CONFIG_LOADED = 1, // A valid slot
+  CONFIG_MIGRATED = 2 // The earlier layout, not written yet
+};
+
+// Fields are ordered so there is no padding on the Mega or the host
+struct ConfigRecord {
+  uint16_t magic; // CONFIG_MAGIC
+  uint8_t version; // CONFIG_VERSION
+  uint8_t flags; // ConfigFlags
+  uint16_t sequence; // Incremented by every save, the newer valid slot is loaded
+  uint16_t crc; // Over the whole record except this field
+  float calFactor[CONFIG_CHANNELS];
+  int32_t tareOffset[CONFIG_CHANNELS]; // Raw counts
+  MotionLimits limits; // Fast move limits at the sketch's reference microstep setting
+  uint8_t parameterCount;
+  uint8_t reserved[3];
+  int32_t parameters[CONFIG_MAX_PARAMETERS]; // Fixed point, as ParameterSet::get()
+};
+
+class ConfigStore {
+  public:
+    uint8_t begin(); // Reads both slots (or migrates the earlier layout), returns the ConfigSource
+    uint8_t getSource(); // ConfigSource
+    uint8_t getSlot(); // Slot of the record (0: A, 1: B), CONFIG_NO_SLOT if not loaded from one
+    uint8_t getBadSlots(); // Slots holding a record that failed its checks (bit 0: A, bit 1: B)
+    uint16_t getSequence();
+    bool save(); // Writes the record if changed, false if the slot did not read back (the previous record is kept)
+
+    bool isCalibrated(uint8_t channel);
+    float getCalFactor(uint8_t channel);
+    void setCalFactor(uint8_t channel, float calFactor);
+    bool isTared(uint8_t channel);
+    long getTareOffset(uint8_t channel);
+    void setTareOffset(uint8_t channel, long tareOffset);
+    bool hasLimits();
+    const MotionLimits &getLimits();
+    void setLimits(const MotionLimits &limits);
+    bool hasParameters();
+    uint8_t getParameterCount();
+    long getParameter(uint8_t id); // 0 past the count
+    bool setParameters(const int32_t *values, uint8_t count); // False if more than CONFIG_MAX_PARAMETERS
+
+  private:
+    bool readSlot(uint8_t slot, ConfigRecord &slotRecord);
+    bool migrate();
+    void change(void *field, const void *value, uint8_t size, uint8_t flag);
+
+    ConfigRecord record;
+    uint8_t source = CONFIG_EMPTY;
+    uint8_t slot = CONFIG_NO_SLOT;
+    uint8_t badSlots = 0;
+    bool dirty = false;
+};
+
+extern ConfigStore Config;
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * GaitPlayer
+ * Real-time playback of a GaitProfile on both axes of the GDP03 rig.
+ * See GaitPlayer.h for usage.
+ */
+
+#include "GaitPlayer.h"
+#include <math.h>
+
+void GaitPlayer::begin(GaitProfile &gaitProfile, const long axisStroke[GAIT_AXES], const MotionLimits &motionLimits) {
+  profile = &gaitProfile;
+  for (uint8_t i = 0; i < GAIT_AXES; i++) stroke[i] = axisStroke[i];
+  limits = motionLimits;
+  start(0);
+}
+
+void GaitPlayer::start(unsigned long timeMicroseconds) {
+  startTime = timeMicroseconds;
+  lastTime = timeMicroseconds;
+  updates = 0;
+  for (uint8_t i = 0; i < GAIT_AXES; i++) {
+    velocity[i] = 0;
+    maxError[i] = 0;
+    sumSquares[i] = 0;
+  }
+}
+
+bool GaitPlayer::update(unsigned long timeMicroseconds, const long position[GAIT_AXES]) {
+  if (!profile) return false;
+  float dt = (timeMicroseconds - lastTime) / 1000000.0;
+  lastTime = timeMicroseconds;
+  unsigned long elapsed = (timeMicroseconds - startTime) / 1000;
+  uint16_t period = profile->getPeriod();
+  bool playing = elapsed < period;
+  uint16_t now = playing ? elapsed : period;
+  uint16_t ahead = (now + GAIT_LOOKAHEAD_MS < period) ? now + GAIT_LOOKAHEAD_MS : period;
+  updates++;
+  for (uint8_t i = 0; i < GAIT_AXES; i++) {
+    float error = getTarget(i, now) - position[i];
+    if (fabs(error) > maxError[i]) maxError[i] = fabs(error);
+    sumSquares[i] += error * error;
+
+    // Speed that reaches the look-ahead point, no faster than the axis can still brake from
+    // (v = sqrt(2 a d)) and within the velocity and acceleration limits
+    float distance = getTarget(i, ahead) - position[i];
+    float wanted = distance * (1000.0 / GAIT_LOOKAHEAD_MS);
+    float braking = sqrt(2 * limits.acceleration * fabs(distance));
+    float fastest = (braking < limits.maxVelocity) ? braking : limits.maxVelocity;
+    if (wanted > fastest) wanted = fastest;
+    if (wanted < -fastest) wanted = -fastest;
+    float step = limits.acceleration * dt;
+    if (wanted > velocity[i] + step) wanted = velocity[i] + step;
+    if (wanted < velocity[i] - step) wanted = velocity[i] - step;
+    velocity[i] = wanted;
+  }
+  if (playing) return true;
+  for (uint8_t i = 0; i < GAIT_AXES; i++) {
+    if (getDirection(i) != 0) return true; // Still settling on the final keyframe
+  }
+  return false;
+}
+
+int8_t GaitPlayer::getDirection(uint8_t axis) {
+  if (axis >= GAIT_AXES || fabs(velocity[axis]) < GAIT_MIN_VELOCITY) return 0;
+  return (velocity[axis] > 0) ? 1 : -1;
+}
+
+float GaitPlayer::getVelocity(uint8_t axis) {
+  if (axis >= GAIT_AXES) return 0;
+  return fabs(velocity[axis]);
+}
+
+long GaitPlayer::getTarget(uint8_t axis, uint16_t time) {
+  if (!profile || axis >= GAIT_AXES) return 0;
+  return (long)((float)stroke[axis] * profile->valueAt(axis, time) / GAIT_FULL_STROKE + 0.5);
+}
+
+float GaitPlayer::getMaxError(uint8_t axis) {
+  if (axis >= GAIT_AXES) return 0;
+  return maxError[axis];
+}
+
+float GaitPlayer::getRmsError(uint8_t axis) {
+  if (axis >= GAIT_AXES || updates == 0) return 0;
+  return sqrt(sumSquares[axis] / updates);
+}
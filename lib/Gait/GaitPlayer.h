@@ -0,0 +1,50 @@
+/*
+ * GaitPlayer
+ * Real-time playback of a GaitProfile on both axes of the GDP03 rig.
+ *
+ * Call start() at the beginning of a cycle, then update() every few
+ * milliseconds with the axis positions (microsteps from the start position).
+ * update() looks GAIT_LOOKAHEAD_MS ahead on the interpolated trajectory and
+ * returns, per axis, the direction and speed that reach it, limited by the
+ * MotionLimits velocity and acceleration. The caller runs the axes at those
+ * speeds (StepEngine STEP_CONTINUOUS moves and setSpeed()), so a cycle plays
+ * at the profile's own cadence as far as the limits allow.
+ *
+ * The position error against the trajectory is accumulated per axis over
+ * the cycle (maximum and RMS, in microsteps) for tracking-error reports.
+ */
+
+#ifndef GAIT_PLAYER_H
+#define GAIT_PLAYER_H
+
+#include <stdint.h>
+#include "GaitProfile.h"
+#include "MotionPlanner.h"
+
+#define GAIT_LOOKAHEAD_MS 20 // Trajectory look-ahead for the speed command
+#define GAIT_MIN_VELOCITY 50 // Commands slower than this stop the axis (microsteps/s)
+
+class GaitPlayer {
+  public:
+    void begin(GaitProfile &profile, const long stroke[GAIT_AXES], const MotionLimits &limits); // stroke = calibrated microsteps per axis
+    void start(unsigned long timeMicroseconds); // Start a cycle and clear the tracking statistics
+    bool update(unsigned long timeMicroseconds, const long position[GAIT_AXES]); // Returns false once the cycle is over and all axes have stopped
+    int8_t getDirection(uint8_t axis); // +1 forward, -1 back, 0 stopped
+    float getVelocity(uint8_t axis); // Commanded speed (microsteps/s)
+    long getTarget(uint8_t axis, uint16_t time); // Trajectory position at a time in the cycle (microsteps)
+    float getMaxError(uint8_t axis); // Largest position error this cycle (microsteps)
+    float getRmsError(uint8_t axis); // RMS position error this cycle (microsteps)
+
+  private:
+    GaitProfile *profile = 0;
+    long stroke[GAIT_AXES];
+    MotionLimits limits;
+    unsigned long startTime;
+    unsigned long lastTime;
+    float velocity[GAIT_AXES]; // Signed commanded velocity
+    float maxError[GAIT_AXES];
+    float sumSquares[GAIT_AXES];
+    unsigned long updates;
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * GaitProfile
+ * Time-indexed loading trajectories for the GDP03 rig, stored in flash.
+ * See GaitProfile.h for usage.
+ */
+
+#include "GaitProfile.h"
+
+// Walking: heel strike and loading response on the heel, both loaded in
+// mid-stance, push-off on the forefoot, then swing with the foot unloaded.
+static const GaitKeyframe gaitWalkingFrames[] PROGMEM = {
+  {0, {0, 0}},
+  {60, {100, 700}}, // Heel strike
+  {150, {300, 1000}}, // Loading response
+  {300, {650, 650}}, // Mid-stance
+  {450, {1000, 300}}, // Terminal stance, heel off
+  {550, {700, 0}}, // Push-off
+  {620, {0, 0}}, // Toe-off
+  {1000, {0, 0}} // Swing
+};
+
+GaitProfile gaitWalking(gaitWalkingFrames, sizeof(gaitWalkingFrames) / sizeof(gaitWalkingFrames[0]));
+
+GaitProfile::GaitProfile(const GaitKeyframe *keyframes, uint8_t frameCount) {
+  frames = keyframes;
+  count = frameCount;
+}
+
+bool GaitProfile::isValid() {
+  if (count < 2 || getFrame(0).time != 0) return false;
+  for (uint8_t i = 1; i < count; i++) {
+    if (getFrame(i).time <= getFrame(i - 1).time) return false;
+  }
+  return true;
+}
+
+uint8_t GaitProfile::getCount() {
+  return count;
+}
+
+uint16_t GaitProfile::getPeriod() {
+  return count ? getFrame(count - 1).time : 0;
+}
+
+GaitKeyframe GaitProfile::getFrame(uint8_t index) {
+  GaitKeyframe frame;
+  const uint16_t *p = (const uint16_t *)&frames[index];
+  frame.time = pgm_read_word(p);
+  for (uint8_t i = 0; i < GAIT_AXES; i++) frame.position[i] = pgm_read_word(p + 1 + i);
+  return frame;
+}
+
+uint16_t GaitProfile::valueAt(uint8_t axis, uint16_t time) {
+  if (count == 0 || axis >= GAIT_AXES) return 0;
+  if (segment >= count - 1 || getFrame(segment).time > time) segment = 0; // Restart the scan when time goes back
+  while (segment < count - 1 && getFrame(segment + 1).time <= time) segment++;
+  GaitKeyframe a = getFrame(segment);
+  if (segment >= count - 1) return a.position[axis];
+  GaitKeyframe b = getFrame(segment + 1);
+  long span = b.time - a.time;
+  long delta = (long)b.position[axis] - a.position[axis];
+  return a.position[axis] + (delta * (time - a.time) + (delta < 0 ? -span / 2 : span / 2)) / span;
+}
@@ -0,0 +1,57 @@
+/*
+ * GaitProfile
+ * Time-indexed loading trajectories for the GDP03 rig, stored in flash.
+ *
+ * A profile is a list of keyframes {time in ms, forefoot, heel} kept in
+ * PROGMEM. The axis values are in permille of the calibrated stroke of each
+ * axis (0 = start position, 1000 = the position that gives targetForce), so
+ * one profile works for any specimen once the step counts are calibrated.
+ * Times must increase, the first keyframe is at 0 and the last one sets the
+ * cycle period (it should repeat the first values so cycles join up).
+ * valueAt() interpolates linearly between keyframes at run time.
+ *
+ * On the host (not __AVR__) PROGMEM is ordinary memory.
+ */
+
+#ifndef GAIT_PROFILE_H
+#define GAIT_PROFILE_H
+
+#include <stdint.h>
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef pgm_read_word
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#endif
+#endif
+
+#define GAIT_AXES 2 // Axes in a keyframe (0 = Forefoot, 1 = Heel)
+#define GAIT_FULL_STROKE 1000 // Keyframe value for the calibrated stroke
+
+struct GaitKeyframe {
+  uint16_t time; // Time from the start of the cycle (ms)
+  uint16_t position[GAIT_AXES]; // Permille of the calibrated stroke for each axis
+};
+
+class GaitProfile {
+  public:
+    GaitProfile(const GaitKeyframe *frames, uint8_t count); // frames must be in PROGMEM
+    bool isValid(); // At least two keyframes, starting at 0 with increasing times
+    uint8_t getCount(); // Number of keyframes
+    uint16_t getPeriod(); // Cycle length (ms), the time of the last keyframe
+    GaitKeyframe getFrame(uint8_t index); // Keyframe copied out of flash
+    uint16_t valueAt(uint8_t axis, uint16_t time); // Interpolated value at a time in the cycle (ms), clamped to the last keyframe
+
+  private:
+    const GaitKeyframe *frames;
+    uint8_t count;
+    uint8_t segment = 0; // Keyframe the last lookup started at (playback moves forwards)
+};
+
+extern GaitProfile gaitWalking; // Heel strike, mid-stance and toe-off at a 1 s walking cadence
+
+#endif
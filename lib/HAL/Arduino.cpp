@@ -0,0 +1,318 @@
+/*
+ * Arduino
+ * Host implementation of the Arduino API used by the GDP03 firmware.
+ * See Arduino.h for usage.
+ */
+
+#include "Arduino.h"
+#include "Hal.h"
+#include <stdio.h>
+
+HardwareSerial Serial;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  Hal.setPinMode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  Hal.writePin(pin, level);
+}
+
+int digitalRead(uint8_t pin) {
+  return Hal.readPin(pin);
+}
+
+unsigned long millis() {
+  Hal.advance(HAL_CALL_US);
+  return Hal.now() / 1000;
+}
+
+unsigned long micros() {
+  Hal.advance(HAL_CALL_US);
+  return Hal.now();
+}
+
+void delay(unsigned long ms) {
+  Hal.advance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  Hal.advance(us);
+}
+
+void yield() {
+  Hal.idle();
+}
+
+void noInterrupts() {
+  Hal.disableInterrupts();
+}
+
+void interrupts() {
+  Hal.enableInterrupts();
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) {
+  Hal.attachInterrupt(interrupt, isr, mode);
+}
+
+void detachInterrupt(uint8_t interrupt) {
+  Hal.detachInterrupt(interrupt);
+}
+
+// Print, with the number formatting of the Arduino core
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (!write(*buffer++)) break;
+    n++;
+  }
+  return n;
+}
+
+size_t Print::print(const __FlashStringHelper *str) {
+  return write(reinterpret_cast<const char *>(str));
+}
+
+size_t Print::print(const char str[]) {
+  return write(str);
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char n, int base) {
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(int n, int base) {
+  return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base) {
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base) {
+  if (base == 0) return write((uint8_t)n);
+  if (base == 10 && n < 0) return print('-') + printNumber(-(unsigned long)n, 10);
+  return printNumber(n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  if (base == 0) return write((uint8_t)n);
+  return printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits) {
+  return printFloat(n, digits);
+}
+
+size_t Print::println(const __FlashStringHelper *str) { return print(str) + println(); }
+size_t Print::println(const char str[]) { return print(str) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char n, int base) { return print(n, base) + println(); }
+size_t Print::println(int n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned int n, int base) { return print(n, base) + println(); }
+size_t Print::println(long n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned long n, int base) { return print(n, base) + println(); }
+size_t Print::println(double n, int digits) { return print(n, digits) + println(); }
+
+size_t Print::println() {
+  return write("\r\n");
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+  char buffer[8 * sizeof(long) + 1];
+  char *p = &buffer[sizeof(buffer) - 1];
+  *p = 0;
+  if (base < 2) base = 10;
+  do {
+    char c = n % base;
+    n /= base;
+    *--p = (c < 10) ? c + '0' : c + 'A' - 10;
+  } while (n);
+  return write(p);
+}
+
+size_t Print::printFloat(double number, uint8_t digits) {
+  if (isnan(number)) return print("nan");
+  if (isinf(number)) return print("inf");
+  if (number > 4294967040.0 || number < -4294967040.0) return print("ovf");
+  size_t n = 0;
+  if (number < 0.0) {
+    n += print('-');
+    number = -number;
+  }
+  double rounding = 0.5;
+  for (uint8_t i = 0; i < digits; i++) rounding /= 10.0;
+  number += rounding;
+  unsigned long whole = (unsigned long)number;
+  double remainder = number - (double)whole;
+  n += print(whole);
+  if (digits > 0) n += print('.');
+  while (digits-- > 0) {
+    remainder *= 10.0;
+    unsigned int digit = (unsigned int)remainder;
+    n += print(digit);
+    remainder -= digit;
+  }
+  return n;
+}
+
+// Stream parsing, with the timeout running on the virtual clock
+
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) return c;
+  } while (millis() - start < timeoutMs);
+  return -1;
+}
+
+int Stream::timedPeek() {
+  unsigned long start = millis();
+  do {
+    int c = peek();
+    if (c >= 0) return c;
+  } while (millis() - start < timeoutMs);
+  return -1;
+}
+
+int Stream::peekNumber() {
+  while (true) {
+    int c = timedPeek();
+    if (c < 0 || c == '-' || c == '.' || (c >= '0' && c <= '9')) return c;
+    read();
+  }
+}
+
+long Stream::parseInt() {
+  int c = peekNumber();
+  if (c < 0) return 0;
+  bool negative = false;
+  long value = 0;
+  while (c == '-' || (c >= '0' && c <= '9')) {
+    if (c == '-') negative = true;
+    else value = value * 10 + c - '0';
+    read();
+    c = timedPeek();
+  }
+  return negative ? -value : value;
+}
+
+float Stream::parseFloat() {
+  int c = peekNumber();
+  if (c < 0) return 0;
+  bool negative = false;
+  bool fraction = false;
+  double value = 0;
+  double scale = 1;
+  while (c == '-' || c == '.' || (c >= '0' && c <= '9')) {
+    if (c == '-') negative = true;
+    else if (c == '.') fraction = true;
+    else {
+      value = value * 10 + c - '0';
+      if (fraction) scale *= 0.1;
+    }
+    read();
+    c = timedPeek();
+  }
+  value *= scale;
+  return negative ? -value : value;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0) break;
+    *buffer++ = (char)c;
+    count++;
+  }
+  return count;
+}
+
+// Serial
+
+void HardwareSerial::begin(unsigned long baud) {
+  byteMicros = baud ? (10000000UL + baud / 2) / baud : 0; // 10 bits per byte with start and stop bits
+  txDone = Hal.now();
+}
+
+void HardwareSerial::end() {
+  flush();
+  byteMicros = 0;
+}
+
+int HardwareSerial::available() {
+  size_t count = (rxHead + SERIAL_RX_BUFFER_SIZE - rxTail) % SERIAL_RX_BUFFER_SIZE;
+  if (count == 0) Hal.idle(); // Nothing to do until the next interrupt
+  return count;
+}
+
+int HardwareSerial::peek() {
+  if (rxHead == rxTail) return -1;
+  return rx[rxTail];
+}
+
+int HardwareSerial::read() {
+  if (rxHead == rxTail) return -1;
+  uint8_t c = rx[rxTail];
+  rxTail = (rxTail + 1) % SERIAL_RX_BUFFER_SIZE;
+  Hal.activity();
+  return c;
+}
+
+int HardwareSerial::availableForWrite() {
+  if (!byteMicros) return SERIAL_TX_BUFFER_SIZE - 1;
+  unsigned long now = Hal.now();
+  unsigned long queued = ((long)(txDone - now) > 0) ? (txDone - now + byteMicros - 1) / byteMicros : 0;
+  return (queued >= SERIAL_TX_BUFFER_SIZE - 1) ? 0 : SERIAL_TX_BUFFER_SIZE - 1 - queued;
+}
+
+void HardwareSerial::flush() {
+  if (byteMicros && (long)(txDone - Hal.now()) > 0) Hal.advance(txDone - Hal.now());
+  fflush(stdout);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    if (byteMicros) {
+      // Wait for room in the transmit buffer, then queue the byte behind the ones already in it
+      if (availableForWrite() == 0) Hal.advance(txDone - Hal.now() - (SERIAL_TX_BUFFER_SIZE - 2) * byteMicros);
+      unsigned long now = Hal.now();
+      if ((long)(txDone - now) < 0) txDone = now;
+      txDone += byteMicros;
+    }
+    if (sink) sink(&buffer[i], 1, sinkContext);
+    else fputc(buffer[i], stdout);
+  }
+  Hal.activity();
+  return size;
+}
+
+void HardwareSerial::inject(const uint8_t *data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    size_t next = (rxHead + 1) % SERIAL_RX_BUFFER_SIZE;
+    if (next == rxTail) break; // Full, the rest is lost as on the target
+    rx[rxHead] = data[i];
+    rxHead = next;
+  }
+}
+
+void HardwareSerial::inject(const char *text) {
+  inject((const uint8_t *)text, strlen(text));
+}
+
+void HardwareSerial::setSink(Sink sink, void *context) {
+  this->sink = sink;
+  sinkContext = context;
+}
@@ -0,0 +1,175 @@
+/*
+ * Arduino
+ * Host implementation of the Arduino API used by the GDP03 firmware.
+ *
+ * Declares the subset of the Arduino core that the sketch and its libraries
+ * use (pins, time, interrupts, Print/Stream and Serial, PROGMEM access), with
+ * the Mega's values for the constants and pin to interrupt mapping, so code
+ * written for the Mega builds unchanged in [env:native]. The functions run
+ * against the simulated board in Hal.h. HAL_NATIVE is defined for the few
+ * places that need to know.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define HAL_NATIVE 1
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef unsigned int word;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : ((p) >= 18 && (p) <= 21 ? 23 - (p) : NOT_AN_INTERRUPT)))
+
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define bit(b) (1UL << (b))
+#define bitRead(value, b) (((value) >> (b)) & 0x01)
+#define bitSet(value, b) ((value) |= (1UL << (b)))
+#define bitClear(value, b) ((value) &= ~(1UL << (b)))
+#define bitWrite(value, b, bitvalue) ((bitvalue) ? bitSet(value, b) : bitClear(value, b))
+
+// Flash is ordinary memory on the host
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define pgm_read_float(address) (*(const float *)(address))
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void noInterrupts();
+void interrupts();
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+void setup();
+void loop();
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t print(const __FlashStringHelper *str);
+    size_t print(const char str[]);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println(const __FlashStringHelper *str);
+    size_t println(const char str[]);
+    size_t println(char c);
+    size_t println(unsigned char n, int base = DEC);
+    size_t println(int n, int base = DEC);
+    size_t println(unsigned int n, int base = DEC);
+    size_t println(long n, int base = DEC);
+    size_t println(unsigned long n, int base = DEC);
+    size_t println(double n, int digits = 2);
+    size_t println();
+
+  private:
+    size_t printNumber(unsigned long n, uint8_t base);
+    size_t printFloat(double number, uint8_t digits);
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout(unsigned long timeout) { timeoutMs = timeout; }
+    long parseInt();
+    float parseFloat();
+    size_t readBytes(char *buffer, size_t length);
+
+  protected:
+    int timedRead();
+    int timedPeek();
+    int peekNumber(); // Skip to the next character that can start a number
+    unsigned long timeoutMs = 1000;
+};
+
+#define SERIAL_TX_BUFFER_SIZE 64
+#define SERIAL_RX_BUFFER_SIZE 1024 // Larger than on the Mega so scripted input can be queued up front
+
+// Serial on the host: input is queued with inject(), output goes to stdout (or a sink) and takes
+// the time it would take at the configured baud rate once the Mega's transmit buffer is full
+class HardwareSerial : public Stream {
+  public:
+    typedef void (*Sink)(const uint8_t *data, size_t length, void *context);
+
+    void begin(unsigned long baud);
+    void end();
+    int available();
+    int peek();
+    int read();
+    int availableForWrite();
+    void flush();
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    operator bool() { return true; }
+
+    void inject(const uint8_t *data, size_t length); // Bytes received from the host side
+    void inject(const char *text);
+    void setSink(Sink sink, void *context); // Send output here instead of stdout (0 = stdout)
+
+  private:
+    unsigned long byteMicros = 0; // Time to send one byte (0 = not started)
+    unsigned long txDone = 0; // Time the transmit buffer will be empty
+    uint8_t rx[SERIAL_RX_BUFFER_SIZE];
+    size_t rxHead = 0;
+    size_t rxTail = 0;
+    Sink sink = 0;
+    void *sinkContext = 0;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * EEPROM
+ * Host version of the Arduino EEPROM library for [env:native].
+ * See EEPROM.h for usage.
+ */
+
+#include "EEPROM.h"
+#include "Hal.h"
+#include <string.h>
+
+EEPROMClass EEPROM;
+
+EEPROMClass::EEPROMClass() {
+  memset(cells, 0xFF, sizeof(cells));
+}
+
+uint8_t EEPROMClass::read(int address) {
+  if (address < 0 || address >= HAL_EEPROM_SIZE) return 0xFF;
+  return cells[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+  if (address < 0 || address >= HAL_EEPROM_SIZE) return;
+  cells[address] = value;
+  Hal.advance(HAL_EEPROM_WRITE_US);
+}
+
+void EEPROMClass::update(int address, uint8_t value) {
+  if (read(address) != value) write(address, value);
+}
@@ -0,0 +1,49 @@
+/*
+ * EEPROM
+ * Host version of the Arduino EEPROM library for [env:native].
+ *
+ * The Mega's 4 KB EEPROM is an array that starts erased (0xFF) and lasts for
+ * the run. Each byte written costs the 3.3 ms an EEPROM write takes on the
+ * ATmega2560, on the virtual clock. begin() and commit() are the ESP
+ * variants' calls and do nothing here.
+ */
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HAL_EEPROM_SIZE 4096 // ATmega2560
+#define HAL_EEPROM_WRITE_US 3300 // Time to write one byte
+
+class EEPROMClass {
+  public:
+    EEPROMClass();
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    void update(int address, uint8_t value); // Write only if different
+    uint16_t length() { return HAL_EEPROM_SIZE; }
+    void begin(size_t) {}
+    bool commit() { return true; }
+    uint8_t *data() { return cells; } // Contents, for a simulation to preload or inspect
+
+    template <typename T> T &get(int address, T &value) {
+      uint8_t *p = (uint8_t *)&value;
+      for (size_t i = 0; i < sizeof(T); i++) p[i] = read(address + i);
+      return value;
+    }
+
+    template <typename T> const T &put(int address, const T &value) {
+      const uint8_t *p = (const uint8_t *)&value;
+      for (size_t i = 0; i < sizeof(T); i++) update(address + i, p[i]);
+      return value;
+    }
+
+  private:
+    uint8_t cells[HAL_EEPROM_SIZE];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
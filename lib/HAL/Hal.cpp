@@ -0,0 +1,220 @@
+/*
+ * Hal
+ * Host side of the GDP03 hardware abstraction layer ([env:native]).
+ * See Hal.h for usage.
+ */
+
+#include "Hal.h"
+#include "Arduino.h"
+#include <stdio.h>
+
+NativeHal Hal;
+
+void NativeHal::reset() {
+  clock = 0;
+  enabled = true;
+  timeLimit = 0;
+  silenceLimit = 0;
+  lastActivity = 0;
+  for (uint8_t i = 0; i < HAL_TIMERS + HAL_DEVICE_TIMERS; i++) {
+    timers[i].handler = 0;
+    timers[i].active = false;
+    timers[i].generation = 0;
+  }
+  deviceTimers = 0;
+  for (uint8_t i = 0; i < HAL_EXT_INTERRUPTS; i++) {
+    interrupts[i].isr = 0;
+    interrupts[i].pending = false;
+  }
+  for (uint8_t i = 0; i < HAL_PINS; i++) {
+    levels[i] = LOW;
+    modes[i] = INPUT;
+  }
+  hookCount = 0;
+}
+
+unsigned long NativeHal::now() {
+  return clock;
+}
+
+void NativeHal::advance(unsigned long microseconds) {
+  unsigned long end = clock + microseconds;
+  while (runNext(end)) {}
+  if ((long)(end - clock) > 0) clock = end; // An ISR may have run past the end
+  checkLimits();
+}
+
+void NativeHal::idle() {
+  unsigned long step = HAL_YIELD_MAX_US;
+  for (uint8_t i = 0; i < HAL_TIMERS + deviceTimers; i++) {
+    Timer &t = timers[i];
+    if (!t.handler || t.active) continue;
+    long due = (long)(t.next - clock);
+    if (due < (long)step) step = (due > 0) ? due : 0;
+  }
+  advance(step ? step : 1);
+}
+
+void NativeHal::setTimeLimit(unsigned long microseconds) {
+  timeLimit = microseconds;
+}
+
+void NativeHal::setSilenceLimit(unsigned long microseconds) {
+  silenceLimit = microseconds;
+  lastActivity = clock;
+}
+
+void NativeHal::activity() {
+  lastActivity = clock;
+}
+
+void NativeHal::checkLimits() {
+  if (timeLimit && (long)(clock - timeLimit) >= 0) end("time limit reached");
+  if (silenceLimit && clock - lastActivity >= silenceLimit) end("no serial traffic");
+}
+
+void NativeHal::end(const char *reason) {
+  fflush(stdout);
+  fprintf(stderr, "hal: %s at %lu.%06lu s\n", reason, clock / 1000000UL, clock % 1000000UL);
+  exit(0);
+}
+
+void NativeHal::enableInterrupts() {
+  enabled = true;
+  while (runNext(clock)) {} // Anything that fell due while they were off
+}
+
+void NativeHal::disableInterrupts() {
+  enabled = false;
+}
+
+bool NativeHal::interruptsEnabled() {
+  return enabled;
+}
+
+// Run the pending pin interrupt or the earliest timer due by 'end', returns false if nothing could run.
+// With interrupts disabled only device timers run.
+bool NativeHal::runNext(unsigned long end) {
+  for (uint8_t i = 0; enabled && i < HAL_EXT_INTERRUPTS; i++) {
+    Interrupt &irq = interrupts[i];
+    if (!irq.pending) continue;
+    irq.pending = false;
+    if (!irq.isr) continue;
+    enabled = false; // As on the AVR, an ISR runs with interrupts disabled
+    irq.isr();
+    enabled = true;
+    return true;
+  }
+  int8_t due = -1;
+  for (uint8_t i = 0; i < HAL_TIMERS + deviceTimers; i++) {
+    Timer &t = timers[i];
+    if (!t.handler || t.active || (long)(t.next - end) > 0) continue;
+    if (i < HAL_TIMERS && !enabled) continue;
+    if (due < 0 || (long)(t.next - timers[due].next) < 0) due = i;
+  }
+  if (due < 0) return false;
+  Timer &t = timers[due];
+  bool device = (due >= HAL_TIMERS);
+  unsigned long at = t.next;
+  if ((long)(at - clock) > 0) clock = at;
+  uint8_t generation = t.generation;
+  t.active = true;
+  if (!device) enabled = t.nested;
+  unsigned long next = t.handler(t.context);
+  if (!device) enabled = true;
+  t.active = false;
+  if (t.generation == generation) {
+    if (next) t.next = at + next; // Compare times stay on the timer's own schedule, as in CTC mode
+    else t.handler = 0;
+  }
+  return true;
+}
+
+void NativeHal::startTimer(uint8_t timer, unsigned long microseconds, TimerHandler handler, void *context, bool nested) {
+  if (timer >= HAL_TIMERS + deviceTimers) return;
+  Timer &t = timers[timer];
+  t.handler = handler;
+  t.context = context;
+  t.next = clock + microseconds;
+  t.nested = nested;
+  t.generation++;
+}
+
+void NativeHal::stopTimer(uint8_t timer) {
+  if (timer >= HAL_TIMERS + deviceTimers) return;
+  timers[timer].handler = 0;
+  timers[timer].generation++;
+}
+
+bool NativeHal::timerRunning(uint8_t timer) {
+  return timer < HAL_TIMERS + deviceTimers && timers[timer].handler;
+}
+
+uint8_t NativeHal::addDeviceTimer() {
+  if (deviceTimers >= HAL_DEVICE_TIMERS) return 0xFF;
+  return HAL_TIMERS + deviceTimers++;
+}
+
+void NativeHal::attachInterrupt(uint8_t interrupt, Isr isr, int mode) {
+  if (interrupt >= HAL_EXT_INTERRUPTS) return;
+  interrupts[interrupt].isr = isr;
+  interrupts[interrupt].mode = mode;
+  interrupts[interrupt].pending = false;
+}
+
+void NativeHal::detachInterrupt(uint8_t interrupt) {
+  if (interrupt >= HAL_EXT_INTERRUPTS) return;
+  interrupts[interrupt].isr = 0;
+  interrupts[interrupt].pending = false;
+}
+
+void NativeHal::setPinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= HAL_PINS) return;
+  modes[pin] = mode;
+  if (mode == INPUT_PULLUP) levels[pin] = HIGH;
+}
+
+void NativeHal::writePin(uint8_t pin, uint8_t level) {
+  advance(HAL_CALL_US);
+  if (pin >= HAL_PINS) return;
+  level = level ? HIGH : LOW;
+  if (levels[pin] == level) return;
+  levels[pin] = level;
+  for (uint8_t i = 0; i < hookCount; i++) hooks[i].hook(pin, level, hooks[i].context);
+}
+
+uint8_t NativeHal::readPin(uint8_t pin) {
+  advance(HAL_CALL_US);
+  return (pin < HAL_PINS) ? levels[pin] : LOW;
+}
+
+uint8_t NativeHal::getLevel(uint8_t pin) {
+  return (pin < HAL_PINS) ? levels[pin] : LOW;
+}
+
+void NativeHal::drivePin(uint8_t pin, uint8_t level) {
+  if (pin >= HAL_PINS) return;
+  level = level ? HIGH : LOW;
+  uint8_t previous = levels[pin];
+  levels[pin] = level;
+  int interrupt = digitalPinToInterrupt(pin);
+  if (interrupt == NOT_AN_INTERRUPT) return;
+  Interrupt &irq = interrupts[interrupt];
+  if (!irq.isr) return;
+  bool fire = false;
+  if (irq.mode == LOW) fire = (level == LOW);
+  else if (irq.mode == CHANGE) fire = (level != previous);
+  else if (irq.mode == FALLING) fire = (previous == HIGH && level == LOW);
+  else if (irq.mode == RISING) fire = (previous == LOW && level == HIGH);
+  if (!fire) return;
+  irq.pending = true;
+  while (runNext(clock)) {}
+}
+
+bool NativeHal::addPinHook(PinHook hook, void *context) {
+  if (hookCount >= HAL_PIN_HOOKS) return false;
+  hooks[hookCount].hook = hook;
+  hooks[hookCount].context = context;
+  hookCount++;
+  return true;
+}
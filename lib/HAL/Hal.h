@@ -0,0 +1,113 @@
+/*
+ * Hal
+ * Host side of the GDP03 hardware abstraction layer ([env:native]).
+ *
+ * The firmware talks to the hardware through the Arduino API (pins, time,
+ * Serial, EEPROM, attachInterrupt). On the Mega that is the Arduino core;
+ * on the host it is this library: Arduino.h, EEPROM.h and util/atomic.h
+ * here implement the same calls against a simulated Mega, so the sketch,
+ * the libraries and the unmodified HX711_ADC decode path build and run
+ * natively. Register level code stays behind #ifdef __AVR__, and the few
+ * places that program a hardware timer use Hal.startTimer() instead.
+ *
+ * Time is virtual. It only moves when the firmware spends it: delay() and
+ * delayMicroseconds() advance it by the amount asked for, micros(),
+ * millis(), digitalRead() and digitalWrite() by HAL_CALL_US each, and
+ * yield() (or polling an empty Serial) skips ahead to the next timer event,
+ * at most HAL_YIELD_MAX_US. Emulated timer and pin interrupts run in time
+ * order as the clock passes them, and only while interrupts are enabled, so
+ * noInterrupts() sections hold them off as on the target. A run therefore
+ * goes as fast as the host can execute it and is exactly repeatable.
+ *
+ * Simulations of the rig attach to the pins: addPinHook() sees every output
+ * level change (step pulses, HX711 SCK) and drivePin() sets an input level
+ * (HX711 DOUT), firing any interrupt attached to it. A simulated device that
+ * does things on its own time (an HX711 finishing a conversion) takes a
+ * device timer, which runs whether or not interrupts are enabled.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HAL_PINS 70 // Digital pins of the Mega
+#define HAL_TIMERS 6 // Timer0 to Timer5, numbered as on the Mega
+#define HAL_DEVICE_TIMERS 8 // Timers for simulated devices, numbered from HAL_TIMERS
+#define HAL_EXT_INTERRUPTS 6 // INT0 to INT5
+#define HAL_PIN_HOOKS 8 // Pin hooks that can be added
+#define HAL_CALL_US 1 // Virtual time taken by micros(), millis(), digitalRead() and digitalWrite()
+#define HAL_YIELD_MAX_US 100 // Longest skip made by yield() when no timer is due sooner
+
+class NativeHal {
+  public:
+    typedef unsigned long (*TimerHandler)(void *context); // Timer ISR body, returns microseconds to the next call (0 = stop)
+    typedef void (*PinHook)(uint8_t pin, uint8_t level, void *context); // Output pin level change
+    typedef void (*Isr)();
+
+    void reset(); // Clock to 0, pins low, timers stopped, interrupts and hooks cleared
+    unsigned long now(); // Virtual time in microseconds (does not advance the clock)
+    void advance(unsigned long microseconds); // Move the clock on, running the interrupts that fall due
+    void idle(); // Skip to the next timer event (yield())
+    void setTimeLimit(unsigned long microseconds); // End the run when the clock passes this (0 = no limit)
+    void setSilenceLimit(unsigned long microseconds); // End the run after this long without Serial traffic (0 = no limit)
+    void activity(); // Serial traffic seen, restarts the silence limit
+
+    // Interrupts
+    void enableInterrupts(); // interrupts(): runs anything held off
+    void disableInterrupts(); // noInterrupts()
+    bool interruptsEnabled();
+    void startTimer(uint8_t timer, unsigned long microseconds, TimerHandler handler, void *context, bool nested = false); // First call after 'microseconds', nested = run with interrupts enabled (ISR_NOBLOCK)
+    void stopTimer(uint8_t timer);
+    bool timerRunning(uint8_t timer);
+    uint8_t addDeviceTimer(); // Number of a free device timer for startTimer(), or 0xFF
+    void attachInterrupt(uint8_t interrupt, Isr isr, int mode);
+    void detachInterrupt(uint8_t interrupt);
+
+    // Pins
+    void setPinMode(uint8_t pin, uint8_t mode);
+    void writePin(uint8_t pin, uint8_t level); // digitalWrite()
+    uint8_t readPin(uint8_t pin); // digitalRead()
+    void drivePin(uint8_t pin, uint8_t level); // Level driven onto the pin from outside (a simulated device)
+    uint8_t getLevel(uint8_t pin); // Pin level for a simulated device (takes no time, unlike readPin())
+    bool addPinHook(PinHook hook, void *context); // Called on every output level change, returns false if there is no room
+
+  private:
+    struct Timer {
+      TimerHandler handler; // 0 = stopped
+      void *context;
+      unsigned long next; // Time of the next compare
+      bool nested;
+      bool active; // Handler is running
+      uint8_t generation; // Bumped by start/stop, so a handler that restarts its own timer wins
+    };
+    struct Interrupt {
+      Isr isr;
+      int mode;
+      bool pending;
+    };
+    struct Hook {
+      PinHook hook;
+      void *context;
+    };
+    bool runNext(unsigned long end);
+    void checkLimits();
+    void end(const char *reason);
+    unsigned long clock = 0;
+    bool enabled = true;
+    unsigned long timeLimit = 0;
+    unsigned long silenceLimit = 0;
+    unsigned long lastActivity = 0;
+    Timer timers[HAL_TIMERS + HAL_DEVICE_TIMERS];
+    uint8_t deviceTimers = 0; // Device timers handed out
+    Interrupt interrupts[HAL_EXT_INTERRUPTS];
+    uint8_t levels[HAL_PINS];
+    uint8_t modes[HAL_PINS];
+    Hook hooks[HAL_PIN_HOOKS];
+    uint8_t hookCount = 0;
+};
+
+extern NativeHal Hal;
+
+#endif
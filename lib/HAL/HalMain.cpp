@@ -0,0 +1,52 @@
+/*
+ * HalMain
+ * Entry point of the sketch in [env:native].
+ *
+ * Runs setup() and then loop() for ever on the simulated board, as the
+ * Arduino core's main() does. Standard input, when it is not a terminal, is
+ * queued as Serial input first so a run can be scripted:
+ *
+ *   printf 'y' | .pio/build/native/program -t 3600
+ *
+ * -t <s> ends the run after s seconds of virtual time, -s <s> after s
+ * seconds without Serial traffic (default 600, 0 = never), which is how a
+ * sketch that halts or waits for input that never comes finishes.
+ *
+ * Builds that bring their own main() (the rig simulator) define
+ * HAL_CUSTOM_MAIN. The unit tests (test/test_native) also have their own,
+ * PlatformIO defines PIO_UNIT_TESTING when it builds them.
+ */
+
+#if !defined(HAL_CUSTOM_MAIN) && !defined(PIO_UNIT_TESTING)
+
+#include "Arduino.h"
+#include "Hal.h"
+#include <stdio.h>
+#include <unistd.h>
+
+#define HAL_DEFAULT_SILENCE_S 600
+
+int main(int argc, char **argv) {
+  unsigned long timeLimit = 0;
+  unsigned long silenceLimit = HAL_DEFAULT_SILENCE_S;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "-t")) timeLimit = strtoul(argv[i + 1], 0, 10);
+    else if (!strcmp(argv[i], "-s")) silenceLimit = strtoul(argv[i + 1], 0, 10);
+    else {
+      fprintf(stderr, "usage: %s [-t seconds] [-s seconds]\n", argv[0]);
+      return 2;
+    }
+  }
+  Hal.reset();
+  Hal.setTimeLimit(timeLimit * 1000000UL);
+  Hal.setSilenceLimit(silenceLimit * 1000000UL);
+  if (!isatty(0)) {
+    uint8_t buffer[SERIAL_RX_BUFFER_SIZE];
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, stdin);
+    Serial.inject(buffer, length);
+  }
+  setup();
+  while (true) loop();
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * HalPorts
+ * Host version of the ATmega2560's I/O port registers and status register.
+ * See HalPorts.h for usage.
+ */
+
+#include "HalPorts.h"
+#include "Hal.h"
+#include <Arduino.h>
+
+#define X HAL_NO_PIN
+
+// pins_arduino.h of the Mega, inverted: pin number of bits 0 to 7 of each port
+const uint8_t halPortPins[HAL_PORTS][8] = {
+  {22, 23, 24, 25, 26, 27, 28, 29}, // A
+  {53, 52, 51, 50, 10, 11, 12, 13}, // B
+  {37, 36, 35, 34, 33, 32, 31, 30}, // C
+  {21, 20, 19, 18, X, X, X, 38}, // D
+  {0, 1, X, 5, 2, 3, X, X}, // E
+  {54, 55, 56, 57, 58, 59, 60, 61}, // F (A0 to A7)
+  {41, 40, 39, X, X, 4, X, X}, // G
+  {17, 16, X, 6, 7, 8, 9, X}, // H
+  {15, 14, X, X, X, X, X, X}, // J
+  {62, 63, 64, 65, 66, 67, 68, 69}, // K (A8 to A15)
+  {49, 48, 47, 46, 45, 44, 43, 42} // L
+};
+
+#undef X
+
+HalPortRegister halPortOutputs[HAL_PORTS] = {
+  HalPortRegister(0, true), HalPortRegister(1, true), HalPortRegister(2, true), HalPortRegister(3, true),
+  HalPortRegister(4, true), HalPortRegister(5, true), HalPortRegister(6, true), HalPortRegister(7, true),
+  HalPortRegister(8, true), HalPortRegister(9, true), HalPortRegister(10, true)
+};
+HalPortRegister halPortInputs[HAL_PORTS] = {
+  HalPortRegister(0, false), HalPortRegister(1, false), HalPortRegister(2, false), HalPortRegister(3, false),
+  HalPortRegister(4, false), HalPortRegister(5, false), HalPortRegister(6, false), HalPortRegister(7, false),
+  HalPortRegister(8, false), HalPortRegister(9, false), HalPortRegister(10, false)
+};
+HalStatusRegister halStatus;
+
+HalPortRegister::operator uint8_t() const {
+  uint8_t value = 0;
+  for (uint8_t bit = 0; bit < 8; bit++) {
+    uint8_t pin = halPortPins[port][bit];
+    if (pin != HAL_NO_PIN && Hal.getLevel(pin)) value |= 1 << bit;
+  }
+  Hal.advance(HAL_CALL_US);
+  return value;
+}
+
+HalPortRegister &HalPortRegister::operator=(uint8_t value) {
+  if (!output) return *this;
+  for (uint8_t bit = 0; bit < 8; bit++) {
+    uint8_t pin = halPortPins[port][bit];
+    uint8_t level = (value >> bit) & 1;
+    if (pin != HAL_NO_PIN && Hal.getLevel(pin) != level) Hal.writePin(pin, level);
+  }
+  return *this;
+}
+
+HalStatusRegister::operator uint8_t() const {
+  return Hal.interruptsEnabled() ? 0x80 : 0;
+}
+
+HalStatusRegister &HalStatusRegister::operator=(uint8_t value) {
+  if (value & 0x80) Hal.enableInterrupts();
+  else Hal.disableInterrupts();
+  return *this;
+}
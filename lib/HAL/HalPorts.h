@@ -0,0 +1,77 @@
+/*
+ * HalPorts
+ * Host version of the ATmega2560's I/O port registers and status register,
+ * for code that drives pins directly instead of through digitalWrite() and
+ * digitalRead() (HX711_ADC_Fast and HX711_ADC_Group when HX711_FAST_PORTS
+ * is set to 1 on the host).
+ *
+ * PORTA to PORTL and PINA to PINL are HalPortRegisters on the simulated
+ * board's pins. Reading either gives the levels of the port's pins; an
+ * assignment, |= or &= on PORTx sets the pins whose bits change through
+ * Hal.writePin(), so pin hooks see the edges as they do from
+ * digitalWrite() (writes to PINx are ignored). A read takes HAL_CALL_US and
+ * a write HAL_CALL_US per pin it changes, as the Arduino calls do. The port and
+ * bit of each pin number are the Mega's (pins_arduino.h of the Arduino
+ * core), kept here as a port to pin table independent of the pin tables of
+ * the code under test. SREG reads and restores the emulated interrupt flag
+ * (bit 7), so the save, noInterrupts(), restore pattern works unchanged.
+ */
+
+#ifndef HAL_PORTS_H
+#define HAL_PORTS_H
+
+#include <stdint.h>
+
+#define HAL_PORTS 11 // A to L, without I
+#define HAL_NO_PIN 0xFF
+
+extern const uint8_t halPortPins[HAL_PORTS][8]; // Pin number of each bit of ports A to L, HAL_NO_PIN where not bonded out
+
+class HalPortRegister {
+  public:
+    HalPortRegister(uint8_t port, bool output) : port(port), output(output) {}
+    operator uint8_t() const; // Levels of the port's pins
+    HalPortRegister &operator=(uint8_t value);
+    HalPortRegister &operator|=(uint8_t bits) { return *this = *this | bits; }
+    HalPortRegister &operator&=(uint8_t bits) { return *this = *this & bits; }
+
+  private:
+    uint8_t port;
+    bool output; // PORTx, otherwise PINx
+};
+
+class HalStatusRegister {
+  public:
+    operator uint8_t() const; // Bit 7: interrupts enabled
+    HalStatusRegister &operator=(uint8_t value);
+};
+
+extern HalPortRegister halPortOutputs[HAL_PORTS];
+extern HalPortRegister halPortInputs[HAL_PORTS];
+extern HalStatusRegister halStatus;
+
+#define PORTA halPortOutputs[0]
+#define PORTB halPortOutputs[1]
+#define PORTC halPortOutputs[2]
+#define PORTD halPortOutputs[3]
+#define PORTE halPortOutputs[4]
+#define PORTF halPortOutputs[5]
+#define PORTG halPortOutputs[6]
+#define PORTH halPortOutputs[7]
+#define PORTJ halPortOutputs[8]
+#define PORTK halPortOutputs[9]
+#define PORTL halPortOutputs[10]
+#define PINA halPortInputs[0]
+#define PINB halPortInputs[1]
+#define PINC halPortInputs[2]
+#define PIND halPortInputs[3]
+#define PINE halPortInputs[4]
+#define PINF halPortInputs[5]
+#define PING halPortInputs[6]
+#define PINH halPortInputs[7]
+#define PINJ halPortInputs[8]
+#define PINK halPortInputs[9]
+#define PINL halPortInputs[10]
+#define SREG halStatus
+
+#endif
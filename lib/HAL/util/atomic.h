@@ -0,0 +1,30 @@
+/*
+ * util/atomic.h
+ * Host version of the avr-libc ATOMIC_BLOCK macros for [env:native].
+ *
+ * The block runs with the emulated interrupts disabled (Hal.h), and on the
+ * way out (also by break or return) they are restored to their previous
+ * state (ATOMIC_RESTORESTATE) or enabled (ATOMIC_FORCEON).
+ */
+
+#ifndef HAL_UTIL_ATOMIC_H
+#define HAL_UTIL_ATOMIC_H
+
+#include "../Hal.h"
+
+class HalAtomicGuard {
+  public:
+    HalAtomicGuard(bool restore) : enableOnExit(!restore || Hal.interruptsEnabled()) { Hal.disableInterrupts(); }
+    ~HalAtomicGuard() { if (enableOnExit) Hal.enableInterrupts(); }
+    bool pass() { return first ? !(first = false) : false; } // True once, for the single pass of the block
+
+  private:
+    bool enableOnExit;
+    bool first = true;
+};
+
+#define ATOMIC_RESTORESTATE true
+#define ATOMIC_FORCEON false
+#define ATOMIC_BLOCK(type) for (HalAtomicGuard halAtomicGuard(type); halAtomicGuard.pass(); )
+
+#endif
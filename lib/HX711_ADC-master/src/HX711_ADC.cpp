@@ -10,13 +10,15 @@
 #include <HX711_ADC.h>
 
 
-HX711_ADC::HX711_ADC(uint8_t dout, uint8_t sck) //constructor
+HX711_ADC_Base::HX711_ADC_Base(uint8_t dout, uint8_t sck, uint8_t settling, uint8_t maxSamples) //constructor
+	: filterSettling(settling), filterMaxSamples(maxSamples)
 { 	
 	doutPin = dout;
 	sckPin = sck;
+	updateForceScale();
 } 
 
-void HX711_ADC::setGain(uint8_t gain)  //value should be 32, 64 or 128*
+void HX711_ADC_Base::setGain(uint8_t gain)  //value should be 32, 64 or 128*
 {
 	if(gain < 64) GAIN = 2; //32, channel B
 	else if(gain < 128) GAIN = 3; //64, channel A
@@ -24,7 +26,7 @@ void HX711_ADC::setGain(uint8_t gain)  //value should be 32, 64 or 128*
 }
 
 //set pinMode, HX711 gain and power up the HX711
-void HX711_ADC::begin()
+void HX711_ADC_Base::begin()
 {
 	pinMode(sckPin, OUTPUT);
 	pinMode(doutPin, INPUT);
@@ -33,7 +35,7 @@ void HX711_ADC::begin()
 }
 
 //set pinMode, HX711 selected gain and power up the HX711
-void HX711_ADC::begin(uint8_t gain)
+void HX711_ADC_Base::begin(uint8_t gain)
 {
 	pinMode(sckPin, OUTPUT);
 	pinMode(doutPin, INPUT);
@@ -42,13 +44,13 @@ void HX711_ADC::begin(uint8_t gain)
 }
 
 /*  start(t): 
-*	will do conversions continuously for 't' +400 milliseconds (400ms is min. settling time at 10SPS). 
+*	will do conversions continuously for 't' + the settling time (400ms at 10SPS, 50ms at 80SPS, see getStartSettlingTime()). 
 *   Running this for 1-5s in setup() - before tare() seems to improve the tare accuracy */
-void HX711_ADC::start(unsigned long t)
+void HX711_ADC_Base::start(unsigned long t)
 {
-	t += 400;
-	lastDoutLowTime = millis();
-	while(millis() < t) 
+	unsigned long startTime = millis();
+	lastDoutLowTime = startTime;
+	while(millis() - startTime < t + getStartSettlingTime()) //shortens once an 80SPS rate has been detected
 	{
 		update();
 		yield();
@@ -58,13 +60,13 @@ void HX711_ADC::start(unsigned long t)
 }	
 
 /*  start(t, dotare) with selectable tare:
-*	will do conversions continuously for 't' +400 milliseconds (400ms is min. settling time at 10SPS). 
+*	will do conversions continuously for 't' + the settling time (400ms at 10SPS, 50ms at 80SPS, see getStartSettlingTime()). 
 *   Running this for 1-5s in setup() - before tare() seems to improve the tare accuracy. */
-void HX711_ADC::start(unsigned long t, bool dotare)
+void HX711_ADC_Base::start(unsigned long t, bool dotare)
 {
-	t += 400;
-	lastDoutLowTime = millis();
-	while(millis() < t) 
+	unsigned long startTime = millis();
+	lastDoutLowTime = startTime;
+	while(millis() - startTime < t + getStartSettlingTime()) //shortens once an 80SPS rate has been detected
 	{
 		update();
 		yield();
@@ -77,33 +79,32 @@ void HX711_ADC::start(unsigned long t, bool dotare)
 }	
 
 /*  startMultiple(t): use this if you have more than one load cell and you want to do tare and stabilization simultaneously.
-*	Will do conversions continuously for 't' +400 milliseconds (400ms is min. settling time at 10SPS). 
+*	Will do conversions continuously for 't', at least the settling time (400ms at 10SPS, 50ms at 80SPS) longer if 't' is shorter than that. 
 *   Running this for 1-5s in setup() - before tare() seems to improve the tare accuracy */
-int HX711_ADC::startMultiple(unsigned long t)
+int HX711_ADC_Base::startMultiple(unsigned long t)
 {
 	tareTimeoutFlag = 0;
 	lastDoutLowTime = millis();
 	if(startStatus == 0) {
 		if(isFirst) {
 			startMultipleTimeStamp = millis();
-			if (t < 400) 
-			{
-				startMultipleWaitTime = t + 400; //min time for HX711 to be stable
-			} 
-			else 
-			{
-				startMultipleWaitTime = t;
-			}
+			startMultipleWaitTime = t;
 			isFirst = 0;
 		}	
-		if((millis() - startMultipleTimeStamp) < startMultipleWaitTime) {
+		unsigned long settle = getStartSettlingTime(); //min time for HX711 to be stable, follows the detected rate
+		unsigned long wait = (startMultipleWaitTime < settle) ? startMultipleWaitTime + settle : startMultipleWaitTime;
+		if((millis() - startMultipleTimeStamp) < wait) {
 			update(); //do conversions during stabilization time
 			yield();
 			return 0;
 		}
 		else { //do tare after stabilization time is up
-			static unsigned long timeout = millis() + tareTimeOut;
-			doTare = 1;
+			if (!doTare) //first call after the stabilization time, the timeout is per instance
+			{
+				startMultipleTareTime = millis();
+				tareTimes = 0;
+				doTare = 1;
+			}
 			update();
 			if(convRslt == 2) 
 			{	
@@ -111,9 +112,9 @@ int HX711_ADC::startMultiple(unsigned long t)
 				convRslt = 0;
 				startStatus = 1;
 			}
-			if (!tareTimeoutDisable) 
+			else if (!tareTimeoutDisable) 
 			{
-				if (millis() > timeout) 
+				if (millis() - startMultipleTareTime > getTareTimeout()) 
 				{ 
 				tareTimeoutFlag = 1;
 				return 1; // Prevent endless loop if no HX711 is connected
@@ -126,26 +127,21 @@ int HX711_ADC::startMultiple(unsigned long t)
 
 /*  startMultiple(t, dotare) with selectable tare: 
 *	use this if you have more than one load cell and you want to (do tare and) stabilization simultaneously.
-*	Will do conversions continuously for 't' +400 milliseconds (400ms is min. settling time at 10SPS). 
+*	Will do conversions continuously for 't', at least the settling time (400ms at 10SPS, 50ms at 80SPS) longer if 't' is shorter than that. 
 *   Running this for 1-5s in setup() - before tare() seems to improve the tare accuracy */
-int HX711_ADC::startMultiple(unsigned long t, bool dotare)
+int HX711_ADC_Base::startMultiple(unsigned long t, bool dotare)
 {
 	tareTimeoutFlag = 0;
 	lastDoutLowTime = millis();
 	if(startStatus == 0) {
 		if(isFirst) {
 			startMultipleTimeStamp = millis();
-			if (t < 400) 
-			{
-				startMultipleWaitTime = t + 400; //min time for HX711 to be stable
-			} 
-			else 
-			{
-				startMultipleWaitTime = t;
-			}
+			startMultipleWaitTime = t;
 			isFirst = 0;
 		}	
-		if((millis() - startMultipleTimeStamp) < startMultipleWaitTime) {
+		unsigned long settle = getStartSettlingTime(); //min time for HX711 to be stable, follows the detected rate
+		unsigned long wait = (startMultipleWaitTime < settle) ? startMultipleWaitTime + settle : startMultipleWaitTime;
+		if((millis() - startMultipleTimeStamp) < wait) {
 			update(); //do conversions during stabilization time
 			yield();
 			return 0;
@@ -153,8 +149,12 @@ int HX711_ADC::startMultiple(unsigned long t, bool dotare)
 		else { //do tare after stabilization time is up
 			if (dotare) 
 			{
-				static unsigned long timeout = millis() + tareTimeOut;
-				doTare = 1;
+				if (!doTare) //first call after the stabilization time, the timeout is per instance
+				{
+					startMultipleTareTime = millis();
+					tareTimes = 0;
+					doTare = 1;
+				}
 				update();
 				if(convRslt == 2) 
 				{	
@@ -162,9 +162,9 @@ int HX711_ADC::startMultiple(unsigned long t, bool dotare)
 					convRslt = 0;
 					startStatus = 1;
 				}
-				if (!tareTimeoutDisable) 
+				else if (!tareTimeoutDisable) 
 				{
-					if (millis() > timeout) 
+					if (millis() - startMultipleTareTime > getTareTimeout()) 
 					{ 
 					tareTimeoutFlag = 1;
 					return 1; // Prevent endless loop if no HX711 is connected
@@ -178,19 +178,19 @@ int HX711_ADC::startMultiple(unsigned long t, bool dotare)
 }
 
 //zero the scale, wait for tare to finnish (blocking)
-void HX711_ADC::tare() 
+void HX711_ADC_Base::tare() 
 {
 	uint8_t rdy = 0;
 	doTare = 1;
 	tareTimes = 0;
 	tareTimeoutFlag = 0;
-	unsigned long timeout = millis() + tareTimeOut;
+	unsigned long tareStart = millis();
 	while(rdy != 2) 
 	{
 		rdy = update();
 		if (!tareTimeoutDisable) 
 		{
-			if (millis() > timeout) 
+			if (millis() - tareStart > getTareTimeout()) 
 			{ 
 				tareTimeoutFlag = 1;
 				break; // Prevent endless loop if no HX711 is connected
@@ -201,7 +201,7 @@ void HX711_ADC::tare()
 }
 
 //zero the scale, initiate the tare operation to run in the background (non-blocking)
-void HX711_ADC::tareNoDelay() 
+void HX711_ADC_Base::tareNoDelay() 
 {
 	doTare = 1;
 	tareTimes = 0;
@@ -209,14 +209,15 @@ void HX711_ADC::tareNoDelay()
 }
 
 //set new calibration factor, raw data is divided by this value to convert to readable data
-void HX711_ADC::setCalFactor(float cal) 
+void HX711_ADC_Base::setCalFactor(float cal) 
 {
 	calFactor = cal;
 	calFactorRecip = 1/calFactor;
+	updateForceScale();
 }
 
 //returns 'true' if tareNoDelay() operation is complete
-bool HX711_ADC::getTareStatus() 
+bool HX711_ADC_Base::getTareStatus() 
 {
 	bool t = tareStatus;
 	tareStatus = 0;
@@ -224,7 +225,7 @@ bool HX711_ADC::getTareStatus()
 }
 
 //returns the current calibration factor
-float HX711_ADC::getCalFactor() 
+float HX711_ADC_Base::getCalFactor() 
 {
 	return calFactor;
 }
@@ -233,9 +234,9 @@ float HX711_ADC::getCalFactor()
 //if conversion is ready; read out 24 bit data and add to dataset, returns 1
 //if tare operation is complete, returns 2
 //else returns 0
-uint8_t HX711_ADC::update() 
+uint8_t HX711_ADC_Base::update() 
 {
-	byte dout = digitalRead(doutPin); //check if conversion is ready
+	byte dout = readDout(); //check if conversion is ready
 	if (!dout) 
 	{
 		conversion24bit();
@@ -257,10 +258,10 @@ uint8_t HX711_ADC::update()
 // call the function dataWaitingAsync() in loop or from ISR to check if new data is available to read
 // if conversion is ready, just call updateAsync() to read out 24 bit data and add to dataset
 // returns 1 if data available , else 0
-bool HX711_ADC::dataWaitingAsync() 
+bool HX711_ADC_Base::dataWaitingAsync() 
 {
 	if (dataWaiting) { lastDoutLowTime = millis(); return 1; }
-	byte dout = digitalRead(doutPin); //check if conversion is ready
+	byte dout = readDout(); //check if conversion is ready
 	if (!dout) 
 	{
 		dataWaiting = true;
@@ -282,7 +283,7 @@ bool HX711_ADC::dataWaitingAsync()
 
 // if data is available call updateAsync() to convert it and add it to the dataset.
 // call getData() to get latest value
-bool HX711_ADC::updateAsync() 
+bool HX711_ADC_Base::updateAsync() 
 {
 	if (dataWaiting) { 
 		conversion24bit();
@@ -293,7 +294,7 @@ bool HX711_ADC::updateAsync()
 
 }
 
-float HX711_ADC::getData() // return fresh data from the moving average dataset
+float HX711_ADC_Base::getData() // return fresh data from the moving average dataset
 {
 	long data = 0;
 	lastSmoothedData = smoothedData();
@@ -302,55 +303,77 @@ float HX711_ADC::getData() // return fresh data from the moving average dataset
 	return x;
 }
 
-long HX711_ADC::smoothedData() 
+//returns the smoothed raw value minus the tare offset, without float math
+long HX711_ADC_Base::getRawTared()
 {
-	long data = 0;
-	long L = 0xFFFFFF;
-	long H = 0x00;
-	for (uint8_t r = 0; r < (samplesInUse + IGN_HIGH_SAMPLE + IGN_LOW_SAMPLE); r++) 
+	lastSmoothedData = smoothedData();
+	return lastSmoothedData - tareOffset;
+}
+
+//returns the smoothed value as force in mN, getData() * the force unit rounded to an integer without float math
+long HX711_ADC_Base::getForce_mN()
+{
+	lastSmoothedData = smoothedData();
+	return toForce_mN(lastSmoothedData);
+}
+
+//converts a raw conversion to force in mN: (raw - tare offset) * forceScale / 2^forceShift, rounded.
+//the 24 bit value is multiplied a byte at a time so every product fits 32 bits, no 64 bit or float math.
+//the partial products are summed with their low bits kept, so the result is the exact product rounded once
+long HX711_ADC_Base::toForce_mN(long raw)
+{
+	long tared = raw - tareOffset;
+	bool negative = forceNegative;
+	unsigned long u = tared;
+	if (tared < 0) 
 	{
-		#if IGN_LOW_SAMPLE
-		if (L > dataSampleSet[r]) L = dataSampleSet[r]; // find lowest value
-		#endif
-		#if IGN_HIGH_SAMPLE
-		if (H < dataSampleSet[r]) H = dataSampleSet[r]; // find highest value
-		#endif
-		data += dataSampleSet[r];
+		u = -tared;
+		negative = !negative;
 	}
-	#if IGN_LOW_SAMPLE 
-	data -= L; //remove lowest value
-	#endif
-	#if IGN_HIGH_SAMPLE 
-	data -= H; //remove highest value
-	#endif
-	//return data;
-	return (data >> divBit);
-
+	if (u > 0xFFFFFF) u = 0xFFFFFF;
+	unsigned long a = (u >> 16) * forceScale; //product = a * 2^16 + b * 2^8 + c, each below 2^31
+	unsigned long b = ((u >> 8) & 0xFF) * forceScale;
+	unsigned long c = (u & 0xFF) * forceScale;
+	unsigned long low = c + ((b & 0xFF) << 8); //product mod 2^16, plus a carry above
+	unsigned long v = a + (b >> 8) + (low >> 16); //product / 2^16, below 2^31
+	uint8_t s = forceShift - 16;
+	if (s) v = (v + (1UL << (s - 1))) >> s; //the low 16 bits cannot carry into bit s of v
+	else if ((low & 0xFFFF) >= 0x8000) v++;
+	return negative ? -(long)v : (long)v;
+}
+
+//set the force in mN of one calibrated unit, i.e. 9.81 when calFactor is in raw counts per gram
+void HX711_ADC_Base::setForceScale(float mNPerUnit)
+{
+	forceUnit = mNPerUnit;
+	updateForceScale();
+}
+
+//mN per raw count as a 23 bit scale and a shift, the shift as large as the scale allows for the best precision.
+//scales of 128 mN per count and above are clamped (calFactor must be above 1/128 count per mN)
+void HX711_ADC_Base::updateForceScale()
+{
+	float scale = forceUnit / calFactor;
+	forceNegative = scale < 0;
+	if (forceNegative) scale = -scale;
+	float m = scale * 65536.0;
+	uint8_t shift = 16;
+	while (m < 4194304.0 && shift < 47) 
+	{
+		m *= 2;
+		shift++;
+	}
+	forceScale = (m < 8388607.0) ? (unsigned long)(m + 0.5) : 8388607UL;
+	forceShift = shift;
 }
 
-void HX711_ADC::conversion24bit()  //read 24 bit data, store in dataset and start the next conversion
+void HX711_ADC_Base::conversion24bit()  //read 24 bit data, store in dataset and start the next conversion
 {
 	conversionTime = micros() - conversionStartTime;
 	conversionStartTime = micros();
-	unsigned long data = 0;
-	uint8_t dout;
+	detectSampleRate();
 	convRslt = 0;
-	if(SCK_DISABLE_INTERRUPTS) noInterrupts();
-
-	for (uint8_t i = 0; i < (24 + GAIN); i++) 
-	{ 	//read 24 bit data + set gain and start next conversion
-		digitalWrite(sckPin, 1);
-		if(SCK_DELAY) delayMicroseconds(1); // could be required for faster mcu's, set value in config.h
-		digitalWrite(sckPin, 0);
-		if (i < (24)) 
-		{
-			dout = digitalRead(doutPin);
-			data = (data << 1) | dout;
-		} else {
-			if(SCK_DELAY) delayMicroseconds(1); // could be required for faster mcu's, set value in config.h
-		}
-	}
-	if(SCK_DISABLE_INTERRUPTS) interrupts();
+	unsigned long data = shiftInData();
 	
 	/*
 	The HX711 output range is min. 0x800000 and max. 0x7FFFFF (the value rolls over).
@@ -367,21 +390,19 @@ void HX711_ADC::conversion24bit()  //read 24 bit data, store in dataset and star
 	if (reverseVal) {
 		data = 0xFFFFFF - data;
 	}
-	if (readIndex == samplesInUse + IGN_HIGH_SAMPLE + IGN_LOW_SAMPLE - 1) 
+	lastConversion = (long)data;
+	filterAdd((long)data);
+	if (refreshTimes)
 	{
-		readIndex = 0;
-	}
-	else 
-	{
-		readIndex++;
+		refreshTimes--;
+		if (!refreshTimes) refreshStatus = 1;
 	}
 	if(data > 0)  
 	{
 		convRslt++;
-		dataSampleSet[readIndex] = (long)data;
 		if(doTare) 
 		{
-			if (tareTimes < DATA_SET) 
+			if (tareTimes < filterSettling) 
 			{
 				tareTimes++;
 			}
@@ -397,41 +418,64 @@ void HX711_ADC::conversion24bit()  //read 24 bit data, store in dataset and star
 	}
 }
 
+//returns the dout pin level, the HX711 pulls dout low when a conversion is ready
+uint8_t HX711_ADC_Base::readDout()
+{
+	return digitalRead(doutPin);
+}
+
+//clock out 24 bit data + set gain and start next conversion
+unsigned long HX711_ADC_Base::shiftInData()
+{
+	unsigned long data = 0;
+	uint8_t dout;
+	if(SCK_DISABLE_INTERRUPTS) noInterrupts();
+
+	for (uint8_t i = 0; i < (24 + GAIN); i++) 
+	{ 	//read 24 bit data + set gain and start next conversion
+		digitalWrite(sckPin, 1);
+		if(SCK_DELAY) delayMicroseconds(1); // could be required for faster mcu's, set value in config.h
+		digitalWrite(sckPin, 0);
+		if (i < (24)) 
+		{
+			dout = digitalRead(doutPin);
+			data = (data << 1) | dout;
+		} else {
+			if(SCK_DELAY) delayMicroseconds(1); // could be required for faster mcu's, set value in config.h
+		}
+	}
+	if(SCK_DISABLE_INTERRUPTS) interrupts();
+	return data;
+}
+
 //power down the HX711
-void HX711_ADC::powerDown() 
+void HX711_ADC_Base::powerDown() 
 {
 	digitalWrite(sckPin, LOW);
 	digitalWrite(sckPin, HIGH);
 }
 
 //power up the HX711
-void HX711_ADC::powerUp() 
+void HX711_ADC_Base::powerUp() 
 {
 	digitalWrite(sckPin, LOW);
 }
 
 //get the tare offset (raw data value output without the scale "calFactor")
-long HX711_ADC::getTareOffset() 
+long HX711_ADC_Base::getTareOffset() 
 {
 	return tareOffset;
 }
 
 //set new tare offset (raw data value input without the scale "calFactor")
-void HX711_ADC::setTareOffset(long newoffset)
+void HX711_ADC_Base::setTareOffset(long newoffset)
 {
 	tareOffset = newoffset;
 }
 
-//for testing and debugging:
-//returns current value of dataset readIndex
-int HX711_ADC::getReadIndex()
-{
-	return readIndex;
-}
-
 //for testing and debugging:
 //returns latest conversion time in millis
-float HX711_ADC::getConversionTime()
+float HX711_ADC_Base::getConversionTime()
 {
 	return conversionTime/1000.0;
 }
@@ -439,7 +483,7 @@ float HX711_ADC::getConversionTime()
 //for testing and debugging:
 //returns the HX711 conversions ea seconds based on the latest conversion time. 
 //The HX711 can be set to 10SPS or 80SPS. For general use the recommended setting is 10SPS.
-float HX711_ADC::getSPS()
+float HX711_ADC_Base::getSPS()
 {
 	float sps = 1000000.0/conversionTime;
 	return sps;
@@ -448,74 +492,31 @@ float HX711_ADC::getSPS()
 //for testing and debugging:
 //returns the tare timeout flag from the last tare operation. 
 //0 = no timeout, 1 = timeout
-bool HX711_ADC::getTareTimeoutFlag() 
+bool HX711_ADC_Base::getTareTimeoutFlag() 
 {
 	return tareTimeoutFlag;
 }
 
-void HX711_ADC::disableTareTimeout()
+void HX711_ADC_Base::disableTareTimeout()
 {
 	tareTimeoutDisable = 1;
 }
 
-long HX711_ADC::getSettlingTime() 
+long HX711_ADC_Base::getSettlingTime() 
 {
-	long st = getConversionTime() * DATA_SET;
+	long st = getConversionTime() * filterSettling;
 	return st;
 }
 
-//overide the number of samples in use
-//value is rounded down to the nearest valid value
-void HX711_ADC::setSamplesInUse(int samples)
-{
-	int old_value = samplesInUse;
-	
-	if(samples <= SAMPLES)
-	{
-		if(samples == 0) //reset to the original value
-		{
-			divBit = divBitCompiled;
-		} 
-		else
-		{
-			samples >>= 1;
-			for(divBit = 0; samples != 0; samples >>= 1, divBit++);
-		}
-		samplesInUse = 1 << divBit;
-		
-		//replace the value of all samples in use with the last conversion value
-		if(samplesInUse != old_value) 
-		{
-			for (uint8_t r = 0; r < samplesInUse + IGN_HIGH_SAMPLE + IGN_LOW_SAMPLE; r++) 
-			{
-				dataSampleSet[r] = lastSmoothedData;
-			}
-			readIndex = 0;
-		}
-	}
-}
-
-//returns the current number of samples in use.
-int HX711_ADC::getSamplesInUse()
-{
-	return samplesInUse;
-}
-
-//resets index for dataset
-void HX711_ADC::resetSamplesIndex()
-{
-	readIndex = 0;
-}
-
 //Fill the whole dataset up with new conversions, i.e. after a reset/restart (this function is blocking once started)
-bool HX711_ADC::refreshDataSet()
+bool HX711_ADC_Base::refreshDataSet()
 {
-	int s = getSamplesInUse() + IGN_HIGH_SAMPLE + IGN_LOW_SAMPLE; // get number of samples in dataset
+	int s = filterSlots(); // get number of samples in dataset
 	resetSamplesIndex();
 	while ( s > 0 ) {
 		update();
 		yield();
-		if (digitalRead(doutPin) == LOW) { // HX711 dout pin is pulled low when a new conversion is ready
+		if (readDout() == LOW) { // HX711 dout pin is pulled low when a new conversion is ready
 			getData(); // add data to the set and start next conversion
 			s--;
 		}
@@ -523,19 +524,24 @@ bool HX711_ADC::refreshDataSet()
 	return true;
 }
 
-//returns 'true' when the whole dataset has been filled up with conversions, i.e. after a reset/restart.
-bool HX711_ADC::getDataSetStatus()
+//Fill the whole dataset up with new conversions, initiate the operation to run in the background as update() reads them (non-blocking)
+void HX711_ADC_Base::refreshDataSetNoDelay()
 {
-	bool i = false;
-	if (readIndex == samplesInUse + IGN_HIGH_SAMPLE + IGN_LOW_SAMPLE - 1) 
-	{
-		i = true;
-	}
-	return i;
+	resetSamplesIndex();
+	refreshStatus = 0;
+	refreshTimes = filterSlots();
+}
+
+//returns 'true' once the dataset has been refilled after refreshDataSetNoDelay(), the status is cleared when read
+bool HX711_ADC_Base::getRefreshStatus()
+{
+	bool r = refreshStatus;
+	refreshStatus = 0;
+	return r;
 }
 
 //returns and sets a new calibration value (calFactor) based on a known mass input
-float HX711_ADC::getNewCalibration(float known_mass)
+float HX711_ADC_Base::getNewCalibration(float known_mass)
 {
 	float readValue = getData();
 	float exist_calFactor = getCalFactor();
@@ -546,13 +552,92 @@ float HX711_ADC::getNewCalibration(float known_mass)
 }
 
 //returns 'true' if it takes longer time then 'SIGNAL_TIMEOUT' for the dout pin to go low after a new conversion is started
-bool HX711_ADC::getSignalTimeoutFlag()
+bool HX711_ADC_Base::getSignalTimeoutFlag()
 {
 	return signalTimeoutFlag;
 }
 
 //reverse the output value (flip positive/negative value)
 //tare/zero-offset must be re-set after calling this.
-void HX711_ADC::setReverseOutput() {
+void HX711_ADC_Base::setReverseOutput() {
 	reverseVal = true;
 }
+
+//returns the latest raw 24 bit conversion (before tare and calibration), i.e. for logging each sample from an ISR
+long HX711_ADC_Base::getLastConversionRaw()
+{
+	return lastConversion;
+}
+
+//set the sample rate, 10 or 80 (SPS) as wired on the HX711 RATE pin, or HX711_RATE_AUTO to detect it from the conversion times.
+//the tare timeout, start-up settling time and smoothing time (if set) follow the rate in use.
+void HX711_ADC_Base::setSampleRate(uint8_t sps)
+{
+	sampleRate = (sps == 10 || sps == 80) ? sps : HX711_RATE_AUTO;
+	applySmoothingTime();
+}
+
+//returns the rate in use, the rate set or the detected rate (10 until a rate has been detected)
+uint8_t HX711_ADC_Base::getSampleRate()
+{
+	return sampleRate ? sampleRate : detectedRate;
+}
+
+//set the samples in use for a smoothing window of about 'ms' (rounded down to a valid number of samples),
+//recalculated when the rate in use changes. 0 leaves the samples in use as they are.
+void HX711_ADC_Base::setSmoothingTime(unsigned int ms)
+{
+	smoothingTime = ms;
+	applySmoothingTime();
+}
+
+//returns the tare timeout in ms: the filter's settling conversions at the rate in use + 50% margin (2.7s at 10SPS, 0.34s at 80SPS with 16 samples)
+unsigned int HX711_ADC_Base::getTareTimeout()
+{
+	return filterSettling * conversionPeriod() * 3 / 2000;
+}
+
+//returns the time in ms the HX711 output needs to settle after power up at the rate in use
+unsigned int HX711_ADC_Base::getStartSettlingTime()
+{
+	return HX711_SETTLE_CONVERSIONS * conversionPeriod() / 1000;
+}
+
+unsigned long HX711_ADC_Base::conversionPeriod()
+{
+	return (getSampleRate() == 80) ? 12500 : 100000;
+}
+
+//a rate is detected after HX711_RATE_DETECT conversion times in a row that fit it, so one late read does not change it.
+//times between the two ranges, or longer (the conversions were not read for a while), are ignored.
+void HX711_ADC_Base::detectSampleRate()
+{
+	if (conversionTime < HX711_FAST_MAX_US) 
+	{
+		if (fastConversions < HX711_RATE_DETECT) fastConversions++;
+		slowConversions = 0;
+	}
+	else if (conversionTime >= HX711_SLOW_MIN_US && conversionTime <= HX711_SLOW_MAX_US) 
+	{
+		if (slowConversions < HX711_RATE_DETECT) slowConversions++;
+		fastConversions = 0;
+	}
+	else return;
+	uint8_t rate = detectedRate;
+	if (fastConversions >= HX711_RATE_DETECT) rate = 80;
+	if (slowConversions >= HX711_RATE_DETECT) rate = 10;
+	if (rate != detectedRate) 
+	{
+		detectedRate = rate;
+		if (sampleRate == HX711_RATE_AUTO) applySmoothingTime();
+	}
+}
+
+void HX711_ADC_Base::applySmoothingTime()
+{
+	if (!smoothingTime) return;
+	unsigned long samples = (unsigned long)smoothingTime * getSampleRate() / 1000;
+	if (samples < 1) samples = 1;
+	if (samples > filterMaxSamples) samples = filterMaxSamples;
+	setSamplesInUse(samples);
+}
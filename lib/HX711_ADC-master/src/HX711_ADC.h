@@ -11,46 +11,28 @@
 
 #include <Arduino.h>
 #include "config.h"
+#include "HX711_ADC_Filter.h"
 
 /*
 Note: HX711_ADC configuration values has been moved to file config.h
 */
 
-#define DATA_SET 	SAMPLES + IGN_HIGH_SAMPLE + IGN_LOW_SAMPLE // total samples in memory
-
-#if (SAMPLES  != 1) & (SAMPLES  != 2) & (SAMPLES  != 4) & (SAMPLES  != 8) & (SAMPLES  != 16) & (SAMPLES  != 32) & (SAMPLES  != 64) & (SAMPLES  != 128)
-	#error "number of SAMPLES not valid!"
-#endif
-
-#if (SAMPLES  == 1) & ((IGN_HIGH_SAMPLE  != 0) | (IGN_LOW_SAMPLE  != 0))
-	#error "number of SAMPLES not valid!"
-#endif
+#define SIGNAL_TIMEOUT	100
 
-#if 		(SAMPLES == 1)
-#define 	DIVB 0
-#elif 		(SAMPLES == 2)
-#define 	DIVB 1
-#elif 		(SAMPLES == 4)
-#define 	DIVB 2
-#elif  		(SAMPLES == 8)
-#define 	DIVB 3
-#elif  		(SAMPLES == 16)
-#define 	DIVB 4
-#elif  		(SAMPLES == 32)
-#define 	DIVB 5
-#elif  		(SAMPLES == 64)
-#define 	DIVB 6
-#elif  		(SAMPLES == 128)
-#define 	DIVB 7
-#endif
+#define HX711_RATE_AUTO				0		//setSampleRate(): detect the rate from the conversion time
+#define HX711_SETTLE_CONVERSIONS	4		//conversion periods before the output has settled after power up (400ms at 10SPS, 50ms at 80SPS)
+#define HX711_RATE_DETECT			4		//consecutive conversion times needed to detect a rate
+#define HX711_FAST_MAX_US			40000	//conversion time below this: 80SPS (12.5ms)
+#define HX711_SLOW_MIN_US			80000	//conversion time in this range: 10SPS (100ms), longer gaps are ignored
+#define HX711_SLOW_MAX_US			150000
 
-#define SIGNAL_TIMEOUT	100
+typedef HX711_TrimmedAverage<SAMPLES, IGN_HIGH_SAMPLE, IGN_LOW_SAMPLE> HX711_DefaultFilter; //filter of HX711_ADC, set in config.h
 
-class HX711_ADC
+//everything but the filter, load cells with different filters can all be used as an HX711_ADC_Base
+class HX711_ADC_Base
 {	
 		
 	public:
-		HX711_ADC(uint8_t dout, uint8_t sck); 		//constructor
 		void setGain(uint8_t gain = 128); 			//value must be 32, 64 or 128*
 		void begin();								//set pinMode, HX711 gain and power up the HX711
 		void begin(uint8_t gain);					//set pinMode, HX711 selected gain and power up the HX711
@@ -64,8 +46,12 @@ class HX711_ADC
 		void setCalFactor(float cal); 				//set new calibration factor, raw data is divided by this value to convert to readable data
 		float getCalFactor(); 						//returns the current calibration factor
 		float getData(); 							//returns data from the moving average dataset 
+		long getRawTared();							//returns the smoothed raw value minus the tare offset (integer only)
+		long getForce_mN();							//returns the smoothed value as force in mN with the scale of setForceScale() (integer only)
+		long toForce_mN(long raw);					//converts a raw conversion, i.e. getLastConversionRaw(), to force in mN (integer only)
+		void setForceScale(float mNPerUnit);		//force in mN of one calibrated unit (9.81 for grams), folded with calFactor into a fixed point scale (default 1)
 
-		int getReadIndex(); 						//for testing and debugging
+		virtual int getReadIndex() = 0; 			//for testing and debugging
 		float getConversionTime(); 					//for testing and debugging
 		float getSPS();								//for testing and debugging
 		bool getTareTimeoutFlag();					//for testing and debugging
@@ -78,49 +64,101 @@ class HX711_ADC
 		uint8_t update(); 							//if conversion is ready; read out 24 bit data and add to dataset
 		bool dataWaitingAsync(); 					//checks if data is available to read (no conversion yet)
 		bool updateAsync(); 						//read available data and add to dataset 
-		void setSamplesInUse(int samples);			//overide number of samples in use
-		int getSamplesInUse();						//returns current number of samples in use
-		void resetSamplesIndex();					//resets index for dataset
+		virtual void setSamplesInUse(int samples) = 0;	//overide number of samples in use
+		virtual int getSamplesInUse() = 0;			//returns current number of samples in use
+		virtual void resetSamplesIndex() = 0;		//resets index for dataset
 		bool refreshDataSet();						//Fill the whole dataset up with new conversions, i.e. after a reset/restart (this function is blocking once started)
-		bool getDataSetStatus();					//returns 'true' when the whole dataset has been filled up with conversions, i.e. after a reset/restart
+		void refreshDataSetNoDelay();				//Fill the whole dataset up with new conversions in the background as update() reads them (non-blocking)
+		bool getRefreshStatus();					//returns 'true' if refreshDataSetNoDelay() operation is complete
+		virtual bool getDataSetStatus() = 0;		//returns 'true' when the whole dataset has been filled up with conversions, i.e. after a reset/restart
 		float getNewCalibration(float known_mass);	//returns and sets a new calibration value (calFactor) based on a known mass input
 		bool getSignalTimeoutFlag();				//returns 'true' if it takes longer time then 'SIGNAL_TIMEOUT' for the dout pin to go low after a new conversion is started
 		void setReverseOutput();					//reverse the output value
+		long getLastConversionRaw();				//returns the latest raw 24 bit conversion (before tare and calibration)
+		void setSampleRate(uint8_t sps);			//10 or 80 as set by the HX711 RATE pin, HX711_RATE_AUTO (default) detects it from the conversion time
+		uint8_t getSampleRate();					//returns the rate in use: the rate set, or the detected rate (10 until detected)
+		void setSmoothingTime(unsigned int ms);		//use the samples for a smoothing window of about 'ms' at the rate in use, kept when the rate changes (0 = off)
+		unsigned int getTareTimeout();				//returns the tare timeout in ms at the rate in use
+		unsigned int getStartSettlingTime();		//returns the minimum start() settling time in ms at the rate in use
 
 	protected:
+		HX711_ADC_Base(uint8_t dout, uint8_t sck, uint8_t settling, uint8_t maxSamples);	//constructor, the filter's settling conversions and most samples in use
+		virtual uint8_t readDout();					//returns the dout pin level (low = conversion ready)
+		virtual unsigned long shiftInData();		//clock out the 24 bit data + gain pulses (starts the next conversion)
 		void conversion24bit(); 					//if conversion is ready: returns 24 bit data and starts the next conversion
-		long smoothedData();						//returns the smoothed data value calculated from the dataset
+		virtual long smoothedData() = 0;			//returns the smoothed data value calculated from the dataset
+		virtual void filterAdd(long value) = 0;		//add a conversion to the dataset, 0 = out of range
+		virtual uint8_t filterSlots() = 0;			//returns the conversions held in the dataset
+		void detectSampleRate();					//update the detected rate from the latest conversion time
+		void applySmoothingTime();					//set the samples in use from smoothingTime at the rate in use
+		unsigned long conversionPeriod();			//conversion period in us at the rate in use
+		void updateForceScale();					//recalculate the fixed point force scale from calFactor and forceUnit
 		uint8_t sckPin; 							//HX711 pd_sck pin
 		uint8_t doutPin; 							//HX711 dout pin
 		uint8_t GAIN;								//HX711 GAIN
 		float calFactor = 1.0;						//calibration factor as given in function setCalFactor(float cal)
 		float calFactorRecip = 1.0;					//reciprocal calibration factor (1/calFactor), the HX711 raw data is multiplied by this value
-		volatile long dataSampleSet[DATA_SET + 1];	// dataset, make voltile if interrupt is used 
+		float forceUnit = 1.0;						//mN per calibrated unit, as given in function setForceScale(float mNPerUnit)
+		unsigned long forceScale = 0;				//mN per raw count = forceScale / 2^forceShift, forceScale below 2^23
+		uint8_t forceShift = 16;
+		bool forceNegative = 0;						//sign of the scale
+		const uint8_t filterSettling;				//conversions before the filter output has followed a step, the tare waits for these
+		const uint8_t filterMaxSamples;				//most samples in use of the filter
 		long tareOffset = 0;
-		int readIndex = 0;
 		unsigned long conversionStartTime = 0;
 		unsigned long conversionTime = 0;
 		uint8_t isFirst = 1;
 		uint8_t tareTimes = 0;
-		uint8_t divBit = DIVB;
-		const uint8_t divBitCompiled = DIVB;
 		bool doTare = 0;
 		bool startStatus = 0;
 		unsigned long startMultipleTimeStamp = 0;
 		unsigned long startMultipleWaitTime = 0;
+		unsigned long startMultipleTareTime = 0;	//time the startMultiple() tare began
 		uint8_t convRslt = 0;
 		bool tareStatus = 0;
-		unsigned int tareTimeOut = (SAMPLES + IGN_HIGH_SAMPLE + IGN_HIGH_SAMPLE) * 150; // tare timeout time in ms, no of samples * 150ms (10SPS + 50% margin)
+		uint8_t refreshTimes = 0;					//conversions still to read for refreshDataSetNoDelay()
+		bool refreshStatus = 0;
+		uint8_t sampleRate = HX711_RATE_AUTO;		//rate set with setSampleRate()
+		uint8_t detectedRate = 10;					//rate found from the conversion times
+		uint8_t fastConversions = 0;				//consecutive conversion times that look like 80SPS
+		uint8_t slowConversions = 0;				//consecutive conversion times that look like 10SPS
+		unsigned int smoothingTime = 0;				//smoothing window set with setSmoothingTime() (ms)
 		bool tareTimeoutFlag = 0;
 		bool tareTimeoutDisable = 0;
-		int samplesInUse = SAMPLES;
 		long lastSmoothedData = 0;
 		bool dataOutOfRange = 0;
 		unsigned long lastDoutLowTime = 0;
 		bool signalTimeoutFlag = 0;
 		bool reverseVal = 0;
 		bool dataWaiting = 0;
+		volatile long lastConversion = 0;
 };	
 
+//HX711_ADC with a filter policy from HX711_ADC_Filter.h, i.e. HX711_ADC_Filtered<HX711_Median<5> > LoadCell(dout, sck)
+template <class Filter>
+class HX711_ADC_Filtered : public HX711_ADC_Base
+{
+	public:
+		HX711_ADC_Filtered(uint8_t dout, uint8_t sck) : HX711_ADC_Base(dout, sck, Filter::settling, Filter::maxSamples) {}	//constructor
+		int getReadIndex() { return filter.index(); }
+		void setSamplesInUse(int samples) { filter.setSamples(samples, lastSmoothedData); }	//the samples in use are refilled with the last value when it changes
+		int getSamplesInUse() { return filter.samples(); }
+		void resetSamplesIndex() { filter.resetIndex(); }
+		bool getDataSetStatus() { return filter.index() == filter.slots() - 1; }
+
+	protected:
+		long smoothedData() { return filter.value(); }
+		void filterAdd(long value) { filter.add(value); }
+		uint8_t filterSlots() { return filter.slots(); }
+		Filter filter;
+};
+
+//HX711_ADC with the filter set in config.h
+class HX711_ADC : public HX711_ADC_Filtered<HX711_DefaultFilter>
+{
+	public:
+		HX711_ADC(uint8_t dout, uint8_t sck) : HX711_ADC_Filtered<HX711_DefaultFilter>(dout, sck) {}	//constructor
+};
+
 #endif
    
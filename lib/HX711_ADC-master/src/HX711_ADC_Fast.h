@@ -0,0 +1,147 @@
+/*
+   -------------------------------------------------------------------------------------
+   HX711_ADC_Fast
+   Compile-time pin variant of HX711_ADC for AVR (ATmega2560 / ATmega328P)
+   -------------------------------------------------------------------------------------
+*/
+
+/*
+HX711_ADC_Fast<DOUT, SCK> behaves exactly like HX711_ADC(DOUT, SCK), but the port registers
+and bit masks of the two pins are resolved at compile time, so the 24 data bits + gain pulses
+are clocked with direct register access instead of digitalWrite()/digitalRead() pin table lookups.
+
+Usage:
+	HX711_ADC_Fast<4, 5> LoadCell; //dout pin 4, sck pin 5
+	HX711_ADC_Fast<4, 5, HX711_Median<5> > LoadCell; //with a filter policy from HX711_ADC_Filter.h instead of the one in config.h
+
+On boards without a pin map below the class falls back to the HX711_ADC implementation.
+On the host ([env:native]) the fallback is the default too; a test defines HX711_FAST_PORTS
+as 1 before including this file to run the register path against the Mega's pin map on the
+port registers emulated by the HAL (HalPorts.h).
+*/
+
+#ifndef HX711_ADC_Fast_h
+#define HX711_ADC_Fast_h
+
+#include <Arduino.h>
+#include "HX711_ADC.h"
+
+#ifndef HX711_FAST_PORTS
+#if defined(__AVR_ATmega2560__) || defined(__AVR_ATmega328P__)
+#define HX711_FAST_PORTS 1
+#else
+#define HX711_FAST_PORTS 0
+#endif
+#endif
+
+#if HX711_FAST_PORTS
+
+#ifdef HAL_NATIVE
+#include <HalPorts.h>
+typedef HalPortRegister HX711_Register;
+#else
+typedef volatile uint8_t HX711_Register;
+#endif
+
+//pin code = (port << 3) | bit, port: 1 = A, 2 = B, 3 = C, 4 = D, 5 = E, 6 = F, 7 = G, 8 = H, 9 = J, 10 = K, 11 = L
+#define HX711_PIN(port, bit) (((port) << 3) | (bit))
+
+#if defined(__AVR_ATmega2560__) || defined(HAL_NATIVE)
+static constexpr uint8_t HX711_pinCodes[] = {
+	HX711_PIN(5,0), HX711_PIN(5,1), HX711_PIN(5,4), HX711_PIN(5,5), HX711_PIN(7,5), HX711_PIN(5,3), HX711_PIN(8,3), HX711_PIN(8,4), 	//D0-D7
+	HX711_PIN(8,5), HX711_PIN(8,6), HX711_PIN(2,4), HX711_PIN(2,5), HX711_PIN(2,6), HX711_PIN(2,7), HX711_PIN(9,1), HX711_PIN(9,0), 	//D8-D15
+	HX711_PIN(8,1), HX711_PIN(8,0), HX711_PIN(4,3), HX711_PIN(4,2), HX711_PIN(4,1), HX711_PIN(4,0), HX711_PIN(1,0), HX711_PIN(1,1), 	//D16-D23
+	HX711_PIN(1,2), HX711_PIN(1,3), HX711_PIN(1,4), HX711_PIN(1,5), HX711_PIN(1,6), HX711_PIN(1,7), HX711_PIN(3,7), HX711_PIN(3,6), 	//D24-D31
+	HX711_PIN(3,5), HX711_PIN(3,4), HX711_PIN(3,3), HX711_PIN(3,2), HX711_PIN(3,1), HX711_PIN(3,0), HX711_PIN(4,7), HX711_PIN(7,2), 	//D32-D39
+	HX711_PIN(7,1), HX711_PIN(7,0), HX711_PIN(11,7), HX711_PIN(11,6), HX711_PIN(11,5), HX711_PIN(11,4), HX711_PIN(11,3), HX711_PIN(11,2), //D40-D47
+	HX711_PIN(11,1), HX711_PIN(11,0), HX711_PIN(2,3), HX711_PIN(2,2), HX711_PIN(2,1), HX711_PIN(2,0), 								//D48-D53
+	HX711_PIN(6,0), HX711_PIN(6,1), HX711_PIN(6,2), HX711_PIN(6,3), HX711_PIN(6,4), HX711_PIN(6,5), HX711_PIN(6,6), HX711_PIN(6,7), 	//A0-A7
+	HX711_PIN(10,0), HX711_PIN(10,1), HX711_PIN(10,2), HX711_PIN(10,3), HX711_PIN(10,4), HX711_PIN(10,5), HX711_PIN(10,6), HX711_PIN(10,7) //A8-A15
+};
+#else
+static constexpr uint8_t HX711_pinCodes[] = {
+	HX711_PIN(4,0), HX711_PIN(4,1), HX711_PIN(4,2), HX711_PIN(4,3), HX711_PIN(4,4), HX711_PIN(4,5), HX711_PIN(4,6), HX711_PIN(4,7), 	//D0-D7
+	HX711_PIN(2,0), HX711_PIN(2,1), HX711_PIN(2,2), HX711_PIN(2,3), HX711_PIN(2,4), HX711_PIN(2,5), 								//D8-D13
+	HX711_PIN(3,0), HX711_PIN(3,1), HX711_PIN(3,2), HX711_PIN(3,3), HX711_PIN(3,4), HX711_PIN(3,5) 									//A0-A5
+};
+#endif
+
+//PINx (input) and PORTx (output) registers by port number, folds to a single register access for a constant port
+#define HX711_PORT_CASE(n, x) case n: return output ? PORT##x : PIN##x;
+static inline HX711_Register &HX711_portRegister(uint8_t port, bool output)
+{
+	switch (port)
+	{
+#ifdef PORTA
+		HX711_PORT_CASE(1, A)
+#endif
+		HX711_PORT_CASE(2, B)
+		HX711_PORT_CASE(3, C)
+		HX711_PORT_CASE(4, D)
+#ifdef PORTE
+		HX711_PORT_CASE(5, E)
+		HX711_PORT_CASE(6, F)
+		HX711_PORT_CASE(7, G)
+		HX711_PORT_CASE(8, H)
+		HX711_PORT_CASE(9, J)
+		HX711_PORT_CASE(10, K)
+		HX711_PORT_CASE(11, L)
+#endif
+		default: return PORTB;
+	}
+}
+#undef HX711_PORT_CASE
+
+#endif
+
+template <uint8_t DOUT, uint8_t SCK, class Filter = HX711_DefaultFilter>
+class HX711_ADC_Fast : public HX711_ADC_Filtered<Filter>
+{
+	public:
+		HX711_ADC_Fast() : HX711_ADC_Filtered<Filter>(DOUT, SCK) {}	//constructor, pins are given as template parameters
+
+#if HX711_FAST_PORTS
+	protected:
+		static_assert(DOUT < sizeof(HX711_pinCodes) && SCK < sizeof(HX711_pinCodes), "HX711_ADC_Fast: pin number not valid for this board");
+		static constexpr uint8_t doutPort = HX711_pinCodes[DOUT] >> 3;
+		static constexpr uint8_t doutMask = 1 << (HX711_pinCodes[DOUT] & 7);
+		static constexpr uint8_t sckPort = HX711_pinCodes[SCK] >> 3;
+		static constexpr uint8_t sckMask = 1 << (HX711_pinCodes[SCK] & 7);
+
+		uint8_t readDout()
+		{
+			return (HX711_portRegister(doutPort, false) & doutMask) ? HIGH : LOW;
+		}
+
+		//same sequence and timing rules as HX711_ADC::shiftInData(), with direct register access
+		unsigned long shiftInData()
+		{
+			HX711_Register &sck = HX711_portRegister(sckPort, true);
+			HX711_Register &dout = HX711_portRegister(doutPort, false);
+			unsigned long data = 0;
+			uint8_t oldSREG = SREG;
+			if(SCK_DISABLE_INTERRUPTS) noInterrupts();
+			for (uint8_t i = 0; i < (24 + this->GAIN); i++)
+			{
+				//sck port may be shared with pins written from ISRs, so the read-modify-write is done with interrupts off
+				uint8_t pulseSREG = SREG;
+				noInterrupts();
+				sck |= sckMask;
+				if(SCK_DELAY) delayMicroseconds(1); // could be required for faster mcu's, set value in config.h
+				else __asm__ __volatile__ ("nop\n\tnop\n\tnop\n\tnop\n\t"); // min. 0.2us sck high time
+				sck &= ~sckMask;
+				SREG = pulseSREG;
+				if (i < 24)
+				{
+					data = (data << 1) | ((dout & doutMask) ? 1 : 0);
+				} else {
+					if(SCK_DELAY) delayMicroseconds(1); // could be required for faster mcu's, set value in config.h
+				}
+			}
+			if(SCK_DISABLE_INTERRUPTS) SREG = oldSREG;
+			return data;
+		}
+#endif
+};
+
+#endif
@@ -0,0 +1,371 @@
+/*
+   -------------------------------------------------------------------------------------
+   HX711_ADC_Filter
+   Filter policies for HX711_ADC
+   -------------------------------------------------------------------------------------
+*/
+
+/*
+A filter policy turns the conversions of one HX711 into the raw value returned by getData(). The
+policy is a template parameter of the load cell, and its sample storage is sized at compile time,
+so each load cell only holds the filter it uses:
+
+	HX711_ADC LoadCell(4, 5);										//filter set in config.h
+	HX711_ADC_Filtered<HX711_Median<5> > LoadCell(4, 5);			//any policy below
+	HX711_ADC_Fast<4, 5, HX711_TrimmedAverage<8> > LoadCell;		//with HX711_ADC_Fast
+
+Policies:
+	HX711_TrimmedAverage<SAMPLES, IGN_HIGH, IGN_LOW>	moving average of SAMPLES (1 to 128, a power of 2), the highest
+														and/or lowest sample of the window ignored (the HX711_ADC default)
+	HX711_Median<N>										median of the last N samples (N odd, 1 to 63)
+The average and median keep their samples in HX711_Samples24 (3 bytes each) unless a last template
+parameter of HX711_Samples32 asks for 4 bytes per sample.
+	HX711_IIR<SHIFT>									single pole low-pass in fixed point, y += (x - y) / 2^SHIFT (SHIFT 0 to 5),
+														about as smooth as a moving average of 2^SHIFT samples
+	HX711_Passthrough									the latest sample
+
+setSamplesInUse() works on every policy: the window of the average or median, or the time constant
+of the IIR (2^SHIFT in samples), up to the compiled size. A policy provides:
+	static const uint8_t maxSamples;		//most samples in use
+	static const uint8_t settling;			//conversions before the output has followed a step with the most samples in use (tare waits for these)
+	void add(long value);					//add a conversion, 0 = out of range (not stored)
+	long value();							//returns the filtered value
+	void setSamples(int samples, long fill);	//set the samples in use (rounded down, 0 = compiled size), a change refills the filter with 'fill'
+	int samples();							//returns the samples in use
+	uint8_t slots();						//returns the conversions held
+	uint8_t index();						//returns the slot of the latest conversion
+	void resetIndex();						//restart the window at slot 0
+*/
+
+#ifndef HX711_ADC_Filter_h
+#define HX711_ADC_Filter_h
+
+#include <Arduino.h>
+
+static constexpr uint8_t HX711_log2(uint8_t n) { return n > 1 ? 1 + HX711_log2(n >> 1) : 0; }
+
+//sample storage of the average and median filters, N samples of 0 to 0xFFFFFF (the range of conversion24bit())
+//packed in 3 bytes each, the top byte of a long is never used
+template <uint8_t N>
+class HX711_Samples24
+{
+	public:
+		long get(uint8_t i)
+		{
+			const uint8_t *b = bytes + 3 * i;
+			return (long)b[0] | ((long)b[1] << 8) | ((long)b[2] << 16);
+		}
+
+		void set(uint8_t i, long value)
+		{
+			uint8_t *b = bytes + 3 * i;
+			b[0] = value;
+			b[1] = value >> 8;
+			b[2] = value >> 16;
+		}
+
+	private:
+		uint8_t bytes[3 * N] = {};
+};
+
+//4 bytes per sample, the layout before HX711_Samples24 (for comparison, or for values outside 24 bits)
+template <uint8_t N>
+class HX711_Samples32
+{
+	public:
+		long get(uint8_t i) { return values[i]; }
+		void set(uint8_t i, long value) { values[i] = value; }
+
+	private:
+		int32_t values[N] = {};
+};
+
+template <uint8_t SAMPLES_, uint8_t IGN_HIGH = 1, uint8_t IGN_LOW = 1, template <uint8_t> class Storage = HX711_Samples24>
+class HX711_TrimmedAverage
+{
+	static_assert(SAMPLES_ >= 1 && SAMPLES_ <= 128 && !(SAMPLES_ & (SAMPLES_ - 1)), "HX711_TrimmedAverage: number of samples not valid!");
+	static_assert(IGN_HIGH <= 1 && IGN_LOW <= 1, "HX711_TrimmedAverage: ignored samples must be 0 or 1");
+	static_assert(SAMPLES_ > 1 || (IGN_HIGH == 0 && IGN_LOW == 0), "HX711_TrimmedAverage: number of samples not valid!");
+
+	public:
+		static const uint8_t maxSamples = SAMPLES_;
+		static const uint8_t settling = SAMPLES_ + IGN_HIGH + IGN_LOW;
+
+		HX711_TrimmedAverage()
+		{
+			rebuild();
+		}
+
+		void add(long value)
+		{
+			if (readIndex == slots() - 1) readIndex = 0;
+			else readIndex++;
+			//a conversion out of range is not stored, the slot keeps its value but is now the newest
+			replace(readIndex, value ? value : dataSampleSet.get(readIndex));
+		}
+
+		//the sum and the peak high/low samples are kept up to date by replace()
+		long value()
+		{
+			long data = runningSum;
+			if (IGN_LOW)
+			{
+				long L = dataSampleSet.get(minQueue[minHead]);
+				if (L > 0xFFFFFF) L = 0xFFFFFF;
+				data -= L; //remove lowest value
+			}
+			if (IGN_HIGH)
+			{
+				long H = dataSampleSet.get(maxQueue[maxHead]);
+				if (H < 0x00) H = 0x00;
+				data -= H; //remove highest value
+			}
+			return (data >> divBit);
+		}
+
+		void setSamples(int samples, long fill)
+		{
+			int old_value = samplesInUse;
+			if (samples > SAMPLES_) return;
+			if (samples == 0) //reset to the original value
+			{
+				divBit = divBitCompiled;
+			}
+			else
+			{
+				samples >>= 1;
+				for (divBit = 0; samples != 0; samples >>= 1, divBit++);
+			}
+			samplesInUse = 1 << divBit;
+			//replace the value of all samples in use with the fill value
+			if (samplesInUse != old_value)
+			{
+				for (uint8_t r = 0; r < slots(); r++)
+				{
+					dataSampleSet.set(r, fill);
+				}
+				readIndex = 0;
+				rebuild();
+			}
+		}
+
+		int samples() { return samplesInUse; }
+		uint8_t slots() { return samplesInUse + IGN_HIGH + IGN_LOW; }
+		uint8_t index() { return readIndex; }
+
+		void resetIndex()
+		{
+			readIndex = 0;
+			rebuild();
+		}
+
+	private:
+		//write a new sample to the oldest dataset slot
+		//the min/max queues hold slot numbers in age order, a slot that can never be the peak again is dropped from the back
+		void replace(uint8_t slot, long value)
+		{
+			uint8_t n = slots();
+			runningSum += value - dataSampleSet.get(slot);
+			dataSampleSet.set(slot, value);
+			if (IGN_HIGH)
+			{
+				if (maxCount && maxQueue[maxHead] == slot) //oldest sample leaves the window
+				{
+					if (++maxHead == n) maxHead = 0;
+					maxCount--;
+				}
+				while (maxCount)
+				{
+					uint8_t back = maxHead + maxCount - 1;
+					if (back >= n) back -= n;
+					if (dataSampleSet.get(maxQueue[back]) > value) break;
+					maxCount--;
+				}
+				uint8_t back = maxHead + maxCount;
+				if (back >= n) back -= n;
+				maxQueue[back] = slot;
+				maxCount++;
+			}
+			if (IGN_LOW)
+			{
+				if (minCount && minQueue[minHead] == slot) //oldest sample leaves the window
+				{
+					if (++minHead == n) minHead = 0;
+					minCount--;
+				}
+				while (minCount)
+				{
+					uint8_t back = minHead + minCount - 1;
+					if (back >= n) back -= n;
+					if (dataSampleSet.get(minQueue[back]) < value) break;
+					minCount--;
+				}
+				uint8_t back = minHead + minCount;
+				if (back >= n) back -= n;
+				minQueue[back] = slot;
+				minCount++;
+			}
+		}
+
+		//recalculate the running sum and min/max queues, after the dataset or readIndex has been changed directly
+		void rebuild()
+		{
+			uint8_t n = slots();
+			runningSum = 0;
+			maxHead = 0;
+			maxCount = 0;
+			minHead = 0;
+			minCount = 0;
+			//add the samples oldest first, the next conversion overwrites the slot after readIndex
+			uint8_t slot = readIndex;
+			for (uint8_t r = 0; r < n; r++)
+			{
+				if (++slot >= n) slot = 0;
+				long value = dataSampleSet.get(slot);
+				dataSampleSet.set(slot, 0);
+				replace(slot, value);
+			}
+		}
+
+		static const uint8_t divBitCompiled = HX711_log2(SAMPLES_);
+		Storage<settling> dataSampleSet;			//dataset
+		long runningSum = 0;						//sum of the samples in use, kept up to date as samples are added
+		uint8_t maxQueue[IGN_HIGH ? settling : 1];	//dataset slots in age order with decreasing values, front is the highest sample
+		uint8_t minQueue[IGN_LOW ? settling : 1];	//dataset slots in age order with increasing values, front is the lowest sample
+		uint8_t maxHead = 0;
+		uint8_t maxCount = 0;
+		uint8_t minHead = 0;
+		uint8_t minCount = 0;
+		uint8_t readIndex = 0;
+		uint8_t divBit = divBitCompiled;
+		uint8_t samplesInUse = SAMPLES_;
+};
+
+template <uint8_t N, template <uint8_t> class Storage = HX711_Samples24>
+class HX711_Median
+{
+	static_assert(N >= 1 && N <= 63 && (N & 1), "HX711_Median: number of samples must be odd, 1 to 63");
+
+	public:
+		static const uint8_t maxSamples = N;
+		static const uint8_t settling = N;
+
+		void add(long value)
+		{
+			if (!value) return; //out of range, not stored
+			if (++readIndex >= samplesInUse) readIndex = 0;
+			long old = window.get(readIndex);
+			window.set(readIndex, value);
+			//move the old sample's place in the sorted copy to where the new one belongs
+			uint8_t i = 0;
+			while (sorted.get(i) != old) i++;
+			while (i > 0 && sorted.get(i - 1) > value)
+			{
+				sorted.set(i, sorted.get(i - 1));
+				i--;
+			}
+			while (i < samplesInUse - 1 && sorted.get(i + 1) < value)
+			{
+				sorted.set(i, sorted.get(i + 1));
+				i++;
+			}
+			sorted.set(i, value);
+		}
+
+		long value() { return sorted.get(samplesInUse >> 1); }
+
+		void setSamples(int samples, long fill)
+		{
+			if (samples > N) return;
+			if (samples == 0) samples = N; //reset to the original value
+			else if (!(samples & 1)) samples--;
+			if (samples == samplesInUse) return;
+			samplesInUse = samples;
+			for (uint8_t r = 0; r < samplesInUse; r++)
+			{
+				window.set(r, fill);
+				sorted.set(r, fill);
+			}
+			readIndex = 0;
+		}
+
+		int samples() { return samplesInUse; }
+		uint8_t slots() { return samplesInUse; }
+		uint8_t index() { return readIndex; }
+		void resetIndex() { readIndex = 0; }
+
+	private:
+		Storage<N> window;			//samples in age order from readIndex
+		Storage<N> sorted;			//the same samples in increasing order
+		uint8_t readIndex = 0;
+		uint8_t samplesInUse = N;
+};
+
+template <uint8_t SHIFT>
+class HX711_IIR
+{
+	static_assert(SHIFT <= 5, "HX711_IIR: SHIFT must be 0 to 5");
+	static const uint8_t FRAC = 7;				//fraction bits of the state, a 24 bit sample << 7 still fits a long
+
+	public:
+		static const uint8_t maxSamples = 1 << SHIFT;
+		static const uint8_t settling = SHIFT ? ((8 << SHIFT) > 255 ? 255 : (8 << SHIFT)) : 1;	//e^-8 of a step is left
+
+		void add(long value)
+		{
+			if (!value) return; //out of range, not stored
+			if (!primed) //start at the first sample instead of climbing from 0
+			{
+				state = value << FRAC;
+				primed = true;
+				return;
+			}
+			state += ((value << FRAC) - state) >> shift;
+		}
+
+		long value() { return (state + (1L << (FRAC - 1))) >> FRAC; }
+
+		void setSamples(int samples, long fill)
+		{
+			if (samples > maxSamples) return;
+			uint8_t s = SHIFT;
+			if (samples != 0)
+			{
+				samples >>= 1;
+				for (s = 0; samples != 0; samples >>= 1, s++);
+			}
+			if (s == shift) return;
+			shift = s;
+			state = fill << FRAC;
+		}
+
+		int samples() { return 1 << shift; }
+		uint8_t slots() { return 1; }
+		uint8_t index() { return 0; }
+		void resetIndex() {}
+
+	private:
+		long state = 0;					//output << FRAC
+		uint8_t shift = SHIFT;
+		bool primed = false;
+};
+
+class HX711_Passthrough
+{
+	public:
+		static const uint8_t maxSamples = 1;
+		static const uint8_t settling = 1;
+
+		void add(long value) { if (value) last = value; }
+		long value() { return last; }
+		void setSamples(int, long) {}
+		int samples() { return 1; }
+		uint8_t slots() { return 1; }
+		uint8_t index() { return 0; }
+		void resetIndex() {}
+
+	private:
+		long last = 0;
+};
+
+#endif
@@ -0,0 +1,177 @@
+/*
+   -------------------------------------------------------------------------------------
+   HX711_ADC_Group
+   Shared clock read-out of several HX711 chips
+   -------------------------------------------------------------------------------------
+*/
+
+/*
+HX711_ADC_Group<SCK, DOUT...> drives several HX711 chips wired to one SCK pin, each with its own
+DOUT pin. Once every chip has a conversion ready, one run of 24 + gain clock pulses reads them all:
+after each falling edge all DOUT pins are sampled together (a single port read when they share a
+port) and the bits are sorted into one value per chip. Reading N chips then takes about as long as
+reading one, and all of them are read at the same instant. The conversions themselves are still
+timed by each chip's own oscillator.
+
+Each chip is an HX711_ADC (group[i]) with the filter set in config.h, and its own tare, calibration factor and samples in use,
+so it can be used wherever a single load cell is, e.g. with begin(), startMultiple(), update(),
+getData() or LoadCellSampler::attach(). A member's update() starts the shared read when every chip
+is ready, and the values read for the other members wait until their own update() collects them.
+
+Usage:
+	HX711_ADC_Group<5, 4, 6> LoadCells; //sck pin 5, dout pins 4 and 6
+	HX711_ADC &LoadCell_F = LoadCells[0];
+	HX711_ADC &LoadCell_H = LoadCells[1];
+
+The gain pulses are shared, so every chip runs at the gain of member 0. powerDown() on any member
+powers down the whole group. All members must be updated from the same context (all from the
+sampler ISR, or all from the main loop). With LoadCellSampler, members on polled DOUT pins are all
+collected in the same poll; a member on a pin interrupt is collected at its next DOUT edge.
+*/
+
+#ifndef HX711_ADC_Group_h
+#define HX711_ADC_Group_h
+
+#include <Arduino.h>
+#include "HX711_ADC.h"
+#include "HX711_ADC_Fast.h"
+
+template <uint8_t SCK, uint8_t... DOUT>
+class HX711_ADC_Group
+{
+	public:
+		static constexpr uint8_t channels = sizeof...(DOUT);
+		static_assert(channels >= 1 && channels <= 8, "HX711_ADC_Group: 1 to 8 dout pins");
+
+		HX711_ADC_Group() : members{Member(DOUT)...}
+		{
+			for (uint8_t c = 0; c < channels; c++)
+			{
+				members[c].group = this;
+				members[c].channel = c;
+				#if HX711_FAST_PORTS
+				doutRegister[c] = &HX711_portRegister(HX711_pinCodes[doutPins[c]] >> 3, false);
+				doutMask[c] = 1 << (HX711_pinCodes[doutPins[c]] & 7);
+				#endif
+			}
+		}
+
+		HX711_ADC &operator[](uint8_t channel)		//the load cell on dout pin number 'channel' of the list
+		{
+			return members[channel < channels ? channel : 0];
+		}
+
+	private:
+		class Member : public HX711_ADC
+		{
+			public:
+				Member(uint8_t dout) : HX711_ADC(dout, SCK) {}
+				HX711_ADC_Group *group = 0;
+				uint8_t channel = 0;
+				uint8_t gainPulses() { return GAIN; }
+
+			protected:
+				//ready when this member's last read value has not been collected yet, or when every chip is ready
+				uint8_t readDout()
+				{
+					if (group->waiting & (1 << channel)) return LOW;
+					return group->allReady() ? LOW : HIGH;
+				}
+
+				unsigned long shiftInData()
+				{
+					if (!(group->waiting & (1 << channel))) group->readAll();
+					group->waiting &= ~(1 << channel);
+					return group->data[channel];
+				}
+		};
+
+		static constexpr uint8_t doutPins[channels] = {DOUT...};
+
+		static constexpr bool samePort(uint8_t c = 1)
+		{
+		#if HX711_FAST_PORTS
+			return c >= channels || ((HX711_pinCodes[doutPins[c]] >> 3) == (HX711_pinCodes[doutPins[0]] >> 3) && samePort(c + 1));
+		#else
+			return false;
+		#endif
+		}
+
+		bool allReady()
+		{
+			for (uint8_t c = 0; c < channels; c++)
+			{
+				#if HX711_FAST_PORTS
+				if (*doutRegister[c] & doutMask[c]) return false;
+				#else
+				if (digitalRead(doutPins[c])) return false;
+				#endif
+			}
+			return true;
+		}
+
+		//one run of 24 + gain pulses on the shared sck pin, same sequence and timing rules as HX711_ADC::shiftInData()
+		void readAll()
+		{
+			uint8_t pulses = 24 + members[0].gainPulses();
+			for (uint8_t c = 0; c < channels; c++) data[c] = 0;
+			#if HX711_FAST_PORTS
+			static_assert(SCK < sizeof(HX711_pinCodes), "HX711_ADC_Group: sck pin number not valid for this board");
+			HX711_Register &sck = HX711_portRegister(HX711_pinCodes[SCK] >> 3, true);
+			const uint8_t sckMask = 1 << (HX711_pinCodes[SCK] & 7);
+			uint8_t oldSREG = SREG;
+			#endif
+			if(SCK_DISABLE_INTERRUPTS) noInterrupts();
+			for (uint8_t i = 0; i < pulses; i++)
+			{
+				#if HX711_FAST_PORTS
+				//sck port may be shared with pins written from ISRs, so the read-modify-write is done with interrupts off
+				uint8_t pulseSREG = SREG;
+				noInterrupts();
+				sck |= sckMask;
+				if(SCK_DELAY) delayMicroseconds(1); // could be required for faster mcu's, set value in config.h
+				else __asm__ __volatile__ ("nop\n\tnop\n\tnop\n\tnop\n\t"); // min. 0.2us sck high time
+				sck &= ~sckMask;
+				SREG = pulseSREG;
+				#else
+				digitalWrite(SCK, 1);
+				if(SCK_DELAY) delayMicroseconds(1); // could be required for faster mcu's, set value in config.h
+				digitalWrite(SCK, 0);
+				#endif
+				if (i < 24)
+				{
+					#if HX711_FAST_PORTS
+					uint8_t port = *doutRegister[0]; //all dout pins at once when they share a port
+					for (uint8_t c = 0; c < channels; c++)
+					{
+						uint8_t bits = (samePort() || c == 0) ? port : *doutRegister[c];
+						data[c] = (data[c] << 1) | ((bits & doutMask[c]) ? 1 : 0);
+					}
+					#else
+					for (uint8_t c = 0; c < channels; c++) data[c] = (data[c] << 1) | digitalRead(doutPins[c]);
+					#endif
+				} else {
+					if(SCK_DELAY) delayMicroseconds(1); // could be required for faster mcu's, set value in config.h
+				}
+			}
+			#if HX711_FAST_PORTS
+			if(SCK_DISABLE_INTERRUPTS) SREG = oldSREG;
+			#else
+			if(SCK_DISABLE_INTERRUPTS) interrupts();
+			#endif
+			waiting = (1 << channels) - 1;
+		}
+
+		Member members[channels];
+		unsigned long data[channels];				//last values read, one per chip
+		volatile uint8_t waiting = 0;				//bit per member whose read value has not been collected
+		#if HX711_FAST_PORTS
+		HX711_Register *doutRegister[channels];	//PINx register and bit of each dout pin
+		uint8_t doutMask[channels];
+		#endif
+};
+
+template <uint8_t SCK, uint8_t... DOUT>
+constexpr uint8_t HX711_ADC_Group<SCK, DOUT...>::doutPins[HX711_ADC_Group<SCK, DOUT...>::channels];
+
+#endif
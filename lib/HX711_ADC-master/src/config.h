@@ -21,13 +21,19 @@ Example on calculating settling time using the values SAMPLES = 16, IGN_HIGH_SAM
 
 Note that you can also overide (reducing) the number of samples in use at any time with the function: setSamplesInUse(samples).
 
+These values set the filter of HX711_ADC. Load cells declared with a filter policy (HX711_ADC_Filtered<filter>,
+HX711_ADC_Fast<dout, sck, filter>, see HX711_ADC_Filter.h) have their own window and do not use them.
+
 */
 
 #ifndef HX711_ADC_config_h
 #define HX711_ADC_config_h
 
 //number of samples in moving average dataset, value must be 1, 2, 4, 8, 16, 32, 64 or 128.
+//can be set from the build flags instead, e.g. -D SAMPLES=128
+#ifndef SAMPLES
 #define SAMPLES 					16		//default value: 16
+#endif
 
 //adds extra sample(s) to the dataset and ignore peak high/low sample, value must be 0 or 1.
 #define IGN_HIGH_SAMPLE 			1		//default value: 1
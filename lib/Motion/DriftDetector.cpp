@@ -0,0 +1,79 @@
+/*
+ * DriftDetector
+ * Watches the per-cycle peak force of one axis and corrects its step count
+ * when the specimen creeps.
+ * See DriftDetector.h for usage.
+ */
+
+#include "DriftDetector.h"
+
+void DriftDetector::begin(const DriftSettings &driftSettings, float calibratedStiffness) {
+  settings = driftSettings;
+  recalibrated(calibratedStiffness);
+}
+
+void DriftDetector::recalibrated(float calibratedStiffness) {
+  stiffness = calibratedStiffness;
+  calibrated = calibratedStiffness;
+  haveSmoothed = false;
+  havePair = false;
+  state = DRIFT_IN_BAND;
+  stateChanged = false;
+  corrections = 0;
+}
+
+uint8_t DriftDetector::update(float peak) {
+  lastPeak = peak;
+  smoothed = haveSmoothed ? smoothed + settings.smoothing * (peak - smoothed) : peak;
+  haveSmoothed = true;
+  float error = smoothed - settings.targetForce;
+  float magnitude = (error < 0) ? -error : error;
+  uint8_t previous = state;
+  if (state == DRIFT_IN_BAND) {
+    if (magnitude > settings.tolerance) state = (error > 0) ? DRIFT_HIGH : DRIFT_LOW;
+  }
+  else if (magnitude < settings.tolerance - settings.hysteresis) {
+    state = DRIFT_IN_BAND;
+    corrections = 0;
+  }
+  stateChanged = (state != previous);
+  return state;
+}
+
+bool DriftDetector::changed() {
+  return stateChanged;
+}
+
+long DriftDetector::correct(long steps) {
+  if (state == DRIFT_IN_BAND || !haveSmoothed) return steps;
+  // Secant through the peaks before and after the last correction, if the force moved by more than the
+  // noise, kept within a factor of 2 of the calibrated stiffness
+  float slope = stiffness;
+  float deltaPeak = lastPeak - pairPeak;
+  if (havePair && steps != pairSteps && (deltaPeak > settings.tolerance || deltaPeak < -settings.tolerance)) {
+    slope = deltaPeak / (steps - pairSteps);
+    if (slope < calibrated / 2) slope = calibrated / 2;
+    if (slope > calibrated * 2) slope = calibrated * 2;
+  }
+  if (slope <= 0) return steps;
+  stiffness = slope;
+  float step = (settings.targetForce - lastPeak) / slope;
+  pairSteps = steps;
+  pairPeak = lastPeak;
+  havePair = true;
+  haveSmoothed = false; // The next peaks are for the new step count
+  if (corrections < 255) corrections++;
+  return steps + (long)(step + (step < 0 ? -0.5 : 0.5));
+}
+
+bool DriftDetector::needsSearch() {
+  return state != DRIFT_IN_BAND && corrections >= settings.maxCorrections;
+}
+
+float DriftDetector::getSmoothedPeak() {
+  return smoothed;
+}
+
+uint8_t DriftDetector::getState() {
+  return state;
+}
@@ -0,0 +1,65 @@
+/*
+ * DriftDetector
+ * Watches the per-cycle peak force of one axis and corrects its step count
+ * when the specimen creeps.
+ *
+ * update() is given each cycle's peak force. A smoothed peak (exponential
+ * average over cycles, so single noisy cycles do not trigger) is compared
+ * with the target: once it leaves target +/- tolerance the axis is drifting
+ * high or low, and it only counts as back in band when it is within
+ * tolerance - hysteresis, so a peak sitting on the edge does not flip the
+ * state every cycle.
+ *
+ * While drifting, correct() returns an adjusted step count: a secant step
+ * from the last two (steps, peak) pairs, or from the calibrated stiffness
+ * for the first one. Each correction restarts the smoothing so the next
+ * peaks reflect the new step count. If the axis is still drifting after
+ * maxCorrections, needsSearch() asks for a full step search instead.
+ */
+
+#ifndef DRIFT_DETECTOR_H
+#define DRIFT_DETECTOR_H
+
+#include <stdint.h>
+
+enum DriftState {
+  DRIFT_IN_BAND = 0,
+  DRIFT_HIGH = 1, // Peak above target + tolerance
+  DRIFT_LOW = 2 // Peak below target - tolerance
+};
+
+struct DriftSettings {
+  float targetForce; // Wanted peak force (N)
+  float tolerance; // Drifting once the smoothed peak is further than this from the target (N)
+  float hysteresis; // Back in band only within tolerance - hysteresis (N)
+  float smoothing; // Weight of each new peak in the smoothed peak (0..1, 1 = no smoothing)
+  uint8_t maxCorrections; // Corrections tried before asking for a full search
+};
+
+class DriftDetector {
+  public:
+    void begin(const DriftSettings &settings, float stiffness); // stiffness from calibration (N per microstep)
+    void recalibrated(float stiffness); // After a full search: back in band, forget the history
+    uint8_t update(float peak); // Cycle peak force, returns the DriftState
+    bool changed(); // True if the last update() changed the state (log the reason)
+    long correct(long steps); // While drifting: the step count to use for the next cycle
+    bool needsSearch(); // Corrections have not brought the peak back in band
+    float getSmoothedPeak(); // Smoothed peak force (N)
+    uint8_t getState();
+
+  private:
+    DriftSettings settings;
+    float stiffness; // N per microstep, updated by the secant
+    float calibrated; // Stiffness from the last full search
+    float smoothed = 0;
+    bool haveSmoothed = false;
+    float lastPeak = 0; // Peak of the last cycle
+    bool havePair = false; // A previous (steps, peak) pair from before the last correction
+    long pairSteps = 0;
+    float pairPeak = 0;
+    uint8_t state = DRIFT_IN_BAND;
+    bool stateChanged = false;
+    uint8_t corrections = 0;
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * ForceController
+ * Closed-loop force control for one GDP03 axis.
+ * See ForceController.h for usage.
+ */
+
+#include "ForceController.h"
+
+void ForceController::begin(const ForceControlSettings &controlSettings) {
+  settings = controlSettings;
+  integral = 0;
+  error = 0;
+  velocity = 0;
+  peakForce = 0;
+  stiffness = 0;
+  haveTime = false;
+  inBand = 0;
+}
+
+void ForceController::setTarget(float targetForce) {
+  settings.targetForce = targetForce;
+  inBand = 0;
+}
+
+int8_t ForceController::update(float force, long position, unsigned long timeMicroseconds) {
+  float dt = haveTime ? (timeMicroseconds - lastTime) / 1000000.0 : 0;
+  if (!haveTime || force < settings.band) { // Not yet in contact, measure from the last free position
+    anchorForce = force;
+    anchorPosition = position;
+  }
+  lastTime = timeMicroseconds;
+  haveTime = true;
+  if (force > peakForce) peakForce = force;
+
+  // Update the stiffness estimate each time the force has moved by more than the band
+  float deltaForce = force - anchorForce;
+  long deltaPosition = position - anchorPosition;
+  if ((deltaForce > settings.band || deltaForce < -settings.band) && deltaPosition != 0) {
+    float slope = deltaForce / deltaPosition;
+    if (slope > 0) stiffness = (stiffness > 0) ? (stiffness + slope) / 2 : slope;
+    anchorForce = force;
+    anchorPosition = position;
+  }
+
+  error = settings.targetForce - force;
+  float magnitude = (error < 0) ? -error : error;
+  if (magnitude <= settings.band) {
+    if (inBand < 255) inBand++;
+    velocity = 0;
+    return 0;
+  }
+  inBand = 0;
+
+  float command = settings.kp * error + settings.ki * (integral + error * dt);
+  command += (error > 0) ? settings.feedforward : -settings.feedforward;
+  float speed = (command < 0) ? -command : command;
+  float limit = settings.maxVelocity;
+  if (stiffness > 0 && magnitude / stiffness / settings.horizon < limit) {
+    limit = magnitude / stiffness / settings.horizon; // Remaining microsteps over the horizon
+  }
+  if (speed < limit) {
+    integral += error * dt; // Only integrate while not limited (anti-windup)
+  }
+  else {
+    speed = limit;
+  }
+  if (speed < settings.minVelocity && limit >= settings.minVelocity) speed = settings.minVelocity;
+  velocity = speed;
+  // The error sign decides the direction if the integral has not yet caught up
+  int8_t direction = (command > 0) ? 1 : (command < 0 ? -1 : (error > 0 ? 1 : -1));
+  return direction;
+}
+
+float ForceController::getVelocity() {
+  return velocity;
+}
+
+float ForceController::getError() {
+  return error;
+}
+
+bool ForceController::isSettled() {
+  return inBand >= settings.settleSamples;
+}
+
+float ForceController::getPeakForce() {
+  return peakForce;
+}
+
+float ForceController::getStiffness() {
+  return stiffness;
+}
@@ -0,0 +1,66 @@
+/*
+ * ForceController
+ * Closed-loop force control for one GDP03 axis.
+ *
+ * update() is called with every new live load cell sample while the axis is
+ * moving. It returns the direction and speed the axis should run at: a
+ * feedforward approach speed plus a PI term on the force error, clamped
+ * between minVelocity and maxVelocity, so the axis runs fast while far
+ * from the target and slows down as the error shrinks. Inside the band
+ * around the target the axis is stopped, and the controller reports
+ * settled once settleSamples consecutive samples are in band.
+ *
+ * The load cells only convert at 10 or 80 SPS, so a stiff foot would make a
+ * fixed gain overshoot and hunt around the target. update() is therefore
+ * also given the axis position: the controller estimates the stiffness of
+ * the foot (secant over every band-sized change in force) and caps the speed
+ * so the remaining force error, converted to microsteps, is closed over
+ * 'horizon' seconds rather than within one sample period.
+ *
+ * The controller is plain arithmetic with no hardware access, so it can be
+ * run against a simulated foot on the host.
+ */
+
+#ifndef FORCE_CONTROLLER_H
+#define FORCE_CONTROLLER_H
+
+#include <stdint.h>
+
+struct ForceControlSettings {
+  float targetForce; // Force to reach (N)
+  float band; // Stop when the force is within +/- band of the target (N)
+  float kp; // Proportional gain (microsteps/s per N)
+  float ki; // Integral gain (microsteps/s per N.s)
+  float feedforward; // Speed added in the direction of the error (microsteps/s)
+  float minVelocity; // Slowest speed the axis is driven at outside the band (microsteps/s)
+  float maxVelocity; // Fastest speed (microsteps/s)
+  float horizon; // Time to close the remaining error once the stiffness is known (s), a few sample periods
+  uint8_t settleSamples; // Consecutive in-band samples needed to report settled
+};
+
+class ForceController {
+  public:
+    void begin(const ForceControlSettings &settings); // Reset the controller for a new approach
+    void setTarget(float targetForce); // Change the target without resetting the integral
+    int8_t update(float force, long position, unsigned long timeMicroseconds); // Returns +1 (forward, more force), -1 (back) or 0 (hold)
+    float getVelocity(); // Speed commanded by the last update (microsteps/s)
+    float getError(); // Target minus the last force (N)
+    bool isSettled(); // True once settleSamples consecutive samples were in band
+    float getPeakForce(); // Highest force seen since begin() (for overshoot)
+    float getStiffness(); // Estimated stiffness (N per microstep), 0 until known
+
+  private:
+    ForceControlSettings settings;
+    float integral = 0;
+    float error = 0;
+    float velocity = 0;
+    float peakForce = 0;
+    float stiffness = 0;
+    float anchorForce = 0; // Force and position the stiffness secant is measured from
+    long anchorPosition = 0;
+    unsigned long lastTime = 0;
+    bool haveTime = false;
+    uint8_t inBand = 0;
+};
+
+#endif
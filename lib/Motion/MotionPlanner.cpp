@@ -0,0 +1,170 @@
+/*
+ * MotionPlanner
+ * Accelerate / cruise / decelerate step profiles for the GDP03 axes.
+ * See MotionPlanner.h for usage.
+ */
+
+#include "MotionPlanner.h"
+#include <math.h>
+
+#if (MOTION_RAMP_POINTS % 4) != 0
+#error "MOTION_RAMP_POINTS must be a multiple of 4"
+#endif
+
+// Convert a velocity in microsteps/s to the edge time used by the step engine (half the step period)
+static uint16_t velocityToInterval(float velocity) {
+  if (velocity <= 0) return 0xFFFF;
+  float us = 500000.0 / velocity;
+  if (us > 65535.0) return 0xFFFF;
+  if (us < MOTION_MIN_INTERVAL) return MOTION_MIN_INTERVAL;
+  return (uint16_t)(us + 0.5);
+}
+
+void MotionProfile::plan(unsigned long moveSteps, const MotionLimits &moveLimits) {
+  limits = moveLimits;
+  steps = moveSteps;
+  if (limits.startVelocity < 1) limits.startVelocity = 1;
+  if (limits.maxVelocity < limits.startVelocity) limits.maxVelocity = limits.startVelocity;
+
+  // Split the ramp into its jerk-limited and constant acceleration phases
+  float dv = limits.maxVelocity - limits.startVelocity;
+  if (limits.acceleration <= 0) {
+    dv = 0;
+    limits.maxVelocity = limits.startVelocity;
+  }
+  if (dv <= 0) {
+    t1 = 0;
+    t2 = 0;
+    aPeak = 0;
+  }
+  else if (limits.jerk > 0) {
+    if (dv >= limits.acceleration * limits.acceleration / limits.jerk) {
+      t1 = limits.acceleration / limits.jerk;
+      aPeak = limits.acceleration;
+      t2 = dv / aPeak - t1;
+    }
+    else {
+      t1 = sqrt(dv / limits.jerk); // Acceleration never reaches its limit
+      aPeak = limits.jerk * t1;
+      t2 = 0;
+    }
+  }
+  else {
+    t1 = 0;
+    aPeak = limits.acceleration;
+    t2 = dv / aPeak;
+  }
+
+  // Trapezoid if both full ramps fit in the move, otherwise meet in the middle
+  float rampLength = rampPosition(2 * t1 + t2);
+  if (2 * rampLength <= steps) {
+    rampSteps = (unsigned long)rampLength;
+    vPeak = limits.maxVelocity;
+    cruiseTime = (steps - 2 * rampLength) / vPeak;
+  }
+  else {
+    rampSteps = steps / 2;
+    vPeak = rampVelocity(steps / 2.0);
+    cruiseTime = 0;
+  }
+  cruiseInterval = velocityToInterval(vPeak);
+
+  for (uint8_t i = 0; i <= MOTION_RAMP_POINTS; i++) {
+    float position = rampPointPosition(i) + 0.5; // Middle of the microstep
+    if (position > rampSteps) ramp[i] = cruiseInterval;
+    else ramp[i] = velocityToInterval(rampVelocity(position));
+  }
+}
+
+// Called from the step ISR: interpolate the ramp table, integer maths only
+unsigned int MotionProfile::intervalAt(unsigned long step) {
+  if (step >= steps) return cruiseInterval;
+  unsigned long d = steps - 1 - step; // Distance from the end of the move (deceleration ramp)
+  if (step < d) d = step;
+  if (d >= rampSteps) return cruiseInterval;
+  if (d < 4) return ramp[d];
+  // Points are 2^(m-2) microsteps apart in the octave [2^m, 2^(m+1))
+  uint8_t m = 2;
+  while ((d >> (m + 1)) != 0) m++;
+  uint8_t shift = m - 2;
+  uint8_t index = 4 + shift * 4 + ((d >> shift) & 3);
+  if (index >= MOTION_RAMP_POINTS) return ramp[MOTION_RAMP_POINTS];
+  uint16_t r0 = ramp[index];
+  uint16_t r1 = ramp[index + 1];
+  if (r1 >= r0) return r0;
+  unsigned long frac = d & ((1UL << shift) - 1);
+  return r0 - (uint16_t)(((unsigned long)(r0 - r1) * frac) >> shift);
+}
+
+// Inverse of the index calculation in intervalAt()
+unsigned long MotionProfile::rampPointPosition(uint8_t index) {
+  if (index < 4) return index;
+  uint8_t shift = (index - 4) / 4;
+  return (unsigned long)(4 + (index - 4) % 4) << shift;
+}
+
+unsigned long MotionProfile::getSteps() {
+  return steps;
+}
+
+unsigned long MotionProfile::getRampSteps() {
+  return rampSteps;
+}
+
+float MotionProfile::getDuration() {
+  float rampLength = (2 * rampSteps < steps) ? rampPosition(2 * t1 + t2) : steps / 2.0;
+  return 2 * rampTime(rampLength) + cruiseTime;
+}
+
+float MotionProfile::velocityAt(float position) {
+  float d = steps - position;
+  if (position < d) d = position;
+  if (d < 0) d = 0;
+  if (d >= rampSteps && 2 * rampSteps < steps) return vPeak;
+  return rampVelocity(d);
+}
+
+float MotionProfile::rampVelocityAtTime(float time) {
+  float v0 = limits.startVelocity;
+  float v1 = v0 + limits.jerk * t1 * t1 / 2;
+  if (time <= t1) return v0 + limits.jerk * time * time / 2;
+  if (time <= t1 + t2) return v1 + aPeak * (time - t1);
+  float tau = time - t1 - t2;
+  if (tau > t1) tau = t1;
+  return v1 + aPeak * t2 + aPeak * tau - limits.jerk * tau * tau / 2;
+}
+
+float MotionProfile::rampPosition(float time) {
+  float v0 = limits.startVelocity;
+  float j = limits.jerk;
+  if (time <= t1) return v0 * time + j * time * time * time / 6;
+  float v1 = v0 + j * t1 * t1 / 2;
+  float s1 = v0 * t1 + j * t1 * t1 * t1 / 6;
+  if (time <= t1 + t2) {
+    float tau = time - t1;
+    return s1 + v1 * tau + aPeak * tau * tau / 2;
+  }
+  float v2 = v1 + aPeak * t2;
+  float s2 = s1 + v1 * t2 + aPeak * t2 * t2 / 2;
+  float tau = time - t1 - t2;
+  if (tau > t1) tau = t1;
+  return s2 + v2 * tau + aPeak * tau * tau / 2 - j * tau * tau * tau / 6;
+}
+
+// Position is monotonic in time along the ramp, so bisect for the inverse
+float MotionProfile::rampTime(float position) {
+  float lo = 0;
+  float hi = 2 * t1 + t2;
+  if (position <= 0) return 0;
+  if (position >= rampPosition(hi)) return hi;
+  for (uint8_t i = 0; i < 32; i++) {
+    float mid = (lo + hi) / 2;
+    if (rampPosition(mid) < position) lo = mid;
+    else hi = mid;
+  }
+  return (lo + hi) / 2;
+}
+
+float MotionProfile::rampVelocity(float position) {
+  return rampVelocityAtTime(rampTime(position));
+}
@@ -0,0 +1,58 @@
+/*
+ * MotionPlanner
+ * Accelerate / cruise / decelerate step profiles for the GDP03 axes.
+ *
+ * plan() builds a trapezoidal profile (jerk = 0) or an S-curve profile
+ * (jerk > 0) from the motion limits, using float maths in the foreground.
+ * The acceleration ramp is stored as a small table of step intervals, four
+ * points per doubling of distance so the steep start of the ramp is tracked
+ * closely, and the step ISR reads the interval for each microstep with
+ * intervalAt(), which only uses integer maths. The deceleration ramp is the
+ * acceleration ramp played backwards, and short moves that cannot reach
+ * maxVelocity are cut into a symmetric triangle (or truncated S-curve).
+ */
+
+#ifndef MOTION_PLANNER_H
+#define MOTION_PLANNER_H
+
+#include <stdint.h>
+
+#define MOTION_RAMP_POINTS 64 // Intervals stored along the ramp, covers ramps up to 2^17 microsteps
+#define MOTION_MIN_INTERVAL 20 // Shortest edge time the step ISR can keep up with (us)
+
+struct MotionLimits {
+  float maxVelocity; // Cruise speed (microsteps/s)
+  float acceleration; // Peak acceleration (microsteps/s^2)
+  float jerk; // Rate of change of acceleration (microsteps/s^3), 0 for a trapezoidal profile
+  float startVelocity; // Speed the motor can start and stop at without ramping (microsteps/s)
+};
+
+class MotionProfile {
+  public:
+    void plan(unsigned long steps, const MotionLimits &limits); // Build the profile for a move of 'steps' microsteps
+    unsigned int intervalAt(unsigned long step); // Edge time (us, high and low like stepMotor's speedMicroseconds) for a microstep, ISR safe
+    unsigned long getSteps(); // Length of the planned move
+    unsigned long getRampSteps(); // Microsteps spent accelerating (and again decelerating)
+    float getDuration(); // Analytic move time in seconds
+    float velocityAt(float position); // Analytic velocity (microsteps/s) at a position along the move
+
+  private:
+    float rampVelocity(float position); // Velocity at a distance into the acceleration ramp
+    float rampPosition(float time); // Distance covered after 'time' seconds of acceleration
+    float rampTime(float position); // Inverse of rampPosition()
+    float rampVelocityAtTime(float time);
+    static unsigned long rampPointPosition(uint8_t index); // Microstep at which a table point sits
+
+    MotionLimits limits;
+    float t1 = 0; // S-curve: time spent raising (and lowering) acceleration
+    float t2 = 0; // S-curve: time at constant acceleration
+    float aPeak = 0; // Acceleration actually reached
+    float vPeak = 0; // Velocity at the end of the ramp
+    float cruiseTime = 0;
+    unsigned long steps = 0;
+    unsigned long rampSteps = 0; // Microsteps in each ramp
+    uint16_t cruiseInterval = 0;
+    uint16_t ramp[MOTION_RAMP_POINTS + 1];
+};
+
+#endif
@@ -0,0 +1,355 @@
+/*
+ * StepEngine
+ * Background step pulse generator for the GDP03 stepper drivers.
+ * See StepEngine.h for usage.
+ */
+
+#include "StepEngine.h"
+
+#include <Arduino.h>
+#include <util/atomic.h>
+#include <Trace.h>
+#ifndef __AVR__
+#include <Hal.h>
+static unsigned long stepTimer(void *axis); // Emulated Timer1/Timer3 compare, at the end
+#endif
+
+#define STEP_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+
+#define STEP_DIR_SETUP_US 10 // Delay between a DIR change and the first pulse of a move
+#define STEP_QUEUE_MASK (STEP_QUEUE_LENGTH - 1)
+
+#if (STEP_QUEUE_LENGTH & STEP_QUEUE_MASK) != 0
+#error "STEP_QUEUE_LENGTH must be a power of 2"
+#endif
+
+StepEngine Steppers;
+
+void StepEngine::attach(uint8_t axis, uint8_t dirPin, uint8_t pulPin) {
+  if (axis >= STEP_AXES) return;
+  Axis &a = axes[axis];
+  a.dirPin = dirPin;
+  a.pulPin = pulPin;
+  a.head = 0;
+  a.tail = 0;
+  a.running = false;
+  a.pulseHigh = false;
+  a.remaining = 0;
+  a.position = 0;
+  a.stepDir = 1;
+  a.speedMicroseconds = 0;
+  a.profile = 0;
+  a.stepIndex = 0;
+}
+
+void StepEngine::begin() {
+  for (uint8_t i = 0; i < STEP_AXES; i++) {
+    Axis &a = axes[i];
+    pinMode(a.dirPin, OUTPUT);
+    pinMode(a.pulPin, OUTPUT);
+    digitalWrite(a.pulPin, LOW);
+#ifdef __AVR__
+    a.dirPort = portOutputRegister(digitalPinToPort(a.dirPin));
+    a.dirMask = digitalPinToBitMask(a.dirPin);
+    a.pulPort = portOutputRegister(digitalPinToPort(a.pulPin));
+    a.pulMask = digitalPinToBitMask(a.pulPin);
+#endif
+  }
+#ifdef __AVR__
+  // Timer1 (axis 0) and Timer3 (axis 1): CTC mode, prescaler 8 -> 0.5 us per tick at 16 MHz
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11);
+  TIMSK1 &= ~_BV(OCIE1A);
+  TCCR3A = 0;
+  TCCR3B = _BV(WGM32) | _BV(CS31);
+  TIMSK3 &= ~_BV(OCIE3A);
+#endif
+}
+
+bool StepEngine::queueMove(uint8_t axis, bool direction, unsigned long steps, unsigned int speedMicroseconds) {
+  return pushMove(axis, direction, steps, speedMicroseconds, 0);
+}
+
+bool StepEngine::queueMove(uint8_t axis, bool direction, MotionProfile &profile) {
+  return pushMove(axis, direction, profile.getSteps(), profile.intervalAt(0), &profile);
+}
+
+bool StepEngine::pushMove(uint8_t axis, bool direction, unsigned long steps, unsigned int speedMicroseconds, MotionProfile *profile) {
+  if (axis >= STEP_AXES) return false;
+  if (linkedActive) return false; // Both axes belong to the linked move until it is done
+  Axis &a = axes[axis];
+  uint8_t next = (a.tail + 1) & STEP_QUEUE_MASK;
+  if (next == a.head) return false; // Queue full
+  StepMove &m = a.queue[a.tail];
+  m.direction = direction ? HIGH : LOW;
+  m.steps = steps;
+  m.speedMicroseconds = speedMicroseconds;
+  m.profile = profile;
+  a.tail = next; // Publish the move to the ISR
+  startTimer(axis);
+  return true;
+}
+
+bool StepEngine::linkedMove(bool direction0, unsigned long steps0, bool direction1, unsigned long steps1, long phase, unsigned int speedMicroseconds) {
+  return startLinked(direction0, steps0, direction1, steps1, phase, speedMicroseconds, 0);
+}
+
+bool StepEngine::linkedMove(bool direction0, unsigned long steps0, bool direction1, unsigned long steps1, long phase, MotionProfile &profile) {
+  return startLinked(direction0, steps0, direction1, steps1, phase, profile.intervalAt(0), &profile);
+}
+
+unsigned long StepEngine::linkedTicks(unsigned long steps0, unsigned long steps1, long phase) {
+  return ((steps0 > steps1) ? steps0 : steps1) + (unsigned long)((phase < 0) ? -phase : phase);
+}
+
+unsigned int StepEngine::velocityInterval(float velocity) {
+  if (!(velocity > 500000.0 / STEP_MAX_INTERVAL)) return STEP_MAX_INTERVAL; // Too slow, zero or not a number
+  float us = 500000.0 / velocity;
+  if (us < MOTION_MIN_INTERVAL) return MOTION_MIN_INTERVAL;
+  return (unsigned int)us;
+}
+
+bool StepEngine::startLinked(bool direction0, unsigned long steps0, bool direction1, unsigned long steps1, long phase, unsigned int speedMicroseconds, MotionProfile *profile) {
+  for (uint8_t i = 0; i < STEP_AXES; i++) {
+    if (axes[i].running || axes[i].head != axes[i].tail) return false; // Both axes must be idle
+  }
+  Linked &l = linked;
+  l.ticks = linkedTicks(steps0, steps1, phase);
+  l.tick = 0;
+  l.window = (steps0 > steps1) ? steps0 : steps1;
+  l.steps[0] = steps0;
+  l.steps[1] = steps1;
+  l.start[0] = (phase > 0) ? phase : 0;
+  l.start[1] = (phase < 0) ? -phase : 0;
+  l.direction[0] = direction0 ? HIGH : LOW;
+  l.direction[1] = direction1 ? HIGH : LOW;
+  l.stepped = 0;
+  for (uint8_t i = 0; i < STEP_AXES; i++) {
+    Axis &a = axes[i];
+    l.error[i] = l.window / 2; // Centre the steps in the window
+    a.remaining = l.steps[i];
+    a.stepDir = l.direction[i] ? 1 : -1;
+    a.pulseHigh = false;
+    a.running = true; // Reported busy, but only axis 0's timer runs
+  }
+  Axis &timing = axes[0];
+  timing.speedMicroseconds = speedMicroseconds;
+  timing.profile = profile;
+  timing.stepIndex = 0;
+  timing.running = false; // Let startTimer() arm the timer
+  linkedActive = true;
+  startTimer(0);
+  return true;
+}
+
+bool StepEngine::isMoveDone(uint8_t axis) {
+  if (axis >= STEP_AXES) return true;
+  return !axes[axis].running;
+}
+
+uint8_t StepEngine::queueSpace(uint8_t axis) {
+  if (axis >= STEP_AXES) return 0;
+  Axis &a = axes[axis];
+  return (a.head - a.tail - 1) & STEP_QUEUE_MASK;
+}
+
+long StepEngine::getPosition(uint8_t axis) {
+  long position = 0;
+  if (axis >= STEP_AXES) return position;
+  STEP_ATOMIC {
+    position = axes[axis].position;
+  }
+  return position;
+}
+
+void StepEngine::setPosition(uint8_t axis, long position) {
+  if (axis >= STEP_AXES) return;
+  STEP_ATOMIC {
+    axes[axis].position = position;
+  }
+}
+
+unsigned long StepEngine::getStepsRemaining(uint8_t axis) {
+  unsigned long remaining = 0;
+  if (axis >= STEP_AXES) return remaining;
+  STEP_ATOMIC {
+    remaining = axes[axis].remaining;
+  }
+  return remaining;
+}
+
+void StepEngine::stop(uint8_t axis) {
+  if (axis >= STEP_AXES) return;
+  Axis &a = axes[axis];
+  STEP_ATOMIC {
+    a.head = a.tail; // Drop queued moves
+    a.remaining = 0; // Finish after the current pulse (if high) goes low
+    if (linkedActive) linked.ticks = linked.tick; // End the linked move after the current tick
+  }
+}
+
+void StepEngine::setSpeed(uint8_t axis, unsigned int speedMicroseconds) {
+  if (axis >= STEP_AXES) return;
+  Axis &a = axes[axis];
+  STEP_ATOMIC {
+    if (!a.profile) a.speedMicroseconds = speedMicroseconds; // Planned moves keep their profile
+  }
+}
+
+// Called from the timer compare ISR. Each call emits one edge on the PUL pin:
+// a rising edge starts a microstep, the falling edge completes it and updates the position.
+unsigned int StepEngine::onTimer(uint8_t axis) {
+  if (linkedActive) return onLinkedTimer();
+  Axis &a = axes[axis];
+  if (a.pulseHigh) {
+    writePin(a, true, LOW);
+    a.pulseHigh = false;
+    a.position += a.stepDir;
+    if (a.remaining > 0 && a.remaining != STEP_CONTINUOUS) a.remaining--;
+    return a.speedMicroseconds;
+  }
+  if (a.remaining == 0) {
+    // Load the next queued move, skipping any with zero steps
+    while (a.remaining == 0) {
+      if (a.head == a.tail) {
+        a.running = false;
+        TRACE(TRACE_STEP_END, axis);
+        return 0;
+      }
+      StepMove &m = a.queue[a.head];
+      a.remaining = m.steps;
+      a.speedMicroseconds = m.speedMicroseconds;
+      a.profile = m.profile;
+      a.stepIndex = 0;
+      a.stepDir = m.direction ? 1 : -1;
+      a.head = (a.head + 1) & STEP_QUEUE_MASK;
+      writePin(a, false, m.direction);
+      TRACE(TRACE_STEP_START, axis);
+    }
+    return STEP_DIR_SETUP_US;
+  }
+  if (a.profile) a.speedMicroseconds = a.profile->intervalAt(a.stepIndex);
+  a.stepIndex++;
+  writePin(a, true, HIGH);
+  a.pulseHigh = true;
+  return a.speedMicroseconds;
+}
+
+// Linked move tick, called from axis 0's timer. The rising edge raises PUL on every axis the DDA
+// says is due on this tick, the falling edge lowers them together and updates the positions.
+unsigned int StepEngine::onLinkedTimer() {
+  Linked &l = linked;
+  Axis &timing = axes[0];
+  if (timing.pulseHigh) {
+    for (uint8_t i = 0; i < STEP_AXES; i++) {
+      if (!(l.stepped & (1 << i))) continue;
+      Axis &a = axes[i];
+      writePin(a, true, LOW);
+      a.position += a.stepDir;
+      if (a.remaining > 0) a.remaining--;
+    }
+    l.stepped = 0;
+    timing.pulseHigh = false;
+    return timing.speedMicroseconds;
+  }
+  if (l.tick == 0 && timing.stepIndex == 0) {
+    for (uint8_t i = 0; i < STEP_AXES; i++) {
+      writePin(axes[i], false, l.direction[i]);
+      TRACE(TRACE_STEP_START, i);
+    }
+    timing.stepIndex = 1; // DIR written, first tick follows after the setup time
+    return STEP_DIR_SETUP_US;
+  }
+  if (l.tick >= l.ticks) {
+    linkedActive = false;
+    for (uint8_t i = 0; i < STEP_AXES; i++) {
+      axes[i].running = false;
+      axes[i].remaining = 0;
+      axes[i].profile = 0;
+      TRACE(TRACE_STEP_END, i);
+    }
+    return 0;
+  }
+  if (timing.profile) timing.speedMicroseconds = timing.profile->intervalAt(l.tick);
+  for (uint8_t i = 0; i < STEP_AXES; i++) {
+    if (l.tick < l.start[i] || l.tick - l.start[i] >= l.window) continue;
+    l.error[i] += l.steps[i];
+    if (l.error[i] >= l.window) {
+      l.error[i] -= l.window;
+      writePin(axes[i], true, HIGH);
+      l.stepped |= 1 << i;
+    }
+  }
+  l.tick++;
+  timing.pulseHigh = true;
+  return timing.speedMicroseconds;
+}
+
+void StepEngine::writePin(Axis &a, bool pul, uint8_t level) {
+#ifdef __AVR__
+  volatile uint8_t *port = pul ? a.pulPort : a.dirPort;
+  uint8_t mask = pul ? a.pulMask : a.dirMask;
+  if (level) *port |= mask;
+  else *port &= ~mask;
+#else
+  digitalWrite(pul ? a.pulPin : a.dirPin, level);
+#endif
+}
+
+void StepEngine::startTimer(uint8_t axis) {
+  Axis &a = axes[axis];
+  STEP_ATOMIC {
+    if (!a.running) {
+      a.running = true;
+#ifdef __AVR__
+      // First compare after 2 us, the ISR then takes over the timing
+      if (axis == 0) {
+        TCNT1 = 0;
+        OCR1A = 4;
+        TIFR1 = _BV(OCF1A);
+        TIMSK1 |= _BV(OCIE1A);
+      } else {
+        TCNT3 = 0;
+        OCR3A = 4;
+        TIFR3 = _BV(OCF3A);
+        TIMSK3 |= _BV(OCIE3A);
+      }
+#else
+      Hal.startTimer(axis == 0 ? 1 : 3, 2, stepTimer, (void *)(uintptr_t)axis);
+#endif
+    }
+  }
+}
+
+#ifdef __AVR__
+
+// Convert an edge interval in microseconds to a compare value (0.5 us ticks, CTC period is OCR + 1)
+static inline uint16_t stepTicks(unsigned int us) {
+  if (us > STEP_MAX_INTERVAL) us = STEP_MAX_INTERVAL;
+  if (us < 2) us = 2;
+  return (us << 1) - 1;
+}
+
+ISR(TIMER1_COMPA_vect) {
+  unsigned int next = Steppers.onTimer(0);
+  if (next) OCR1A = stepTicks(next);
+  else TIMSK1 &= ~_BV(OCIE1A);
+}
+
+ISR(TIMER3_COMPA_vect) {
+  unsigned int next = Steppers.onTimer(1);
+  if (next) OCR3A = stepTicks(next);
+  else TIMSK3 &= ~_BV(OCIE3A);
+}
+
+#else
+
+// Timer1 and Timer3 emulated by the native HAL, with the compare range of the AVR timers
+static unsigned long stepTimer(void *axis) {
+  unsigned int next = Steppers.onTimer((uint8_t)(uintptr_t)axis);
+  if (next > STEP_MAX_INTERVAL) next = STEP_MAX_INTERVAL;
+  if (next == 1) next = 2;
+  return next;
+}
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * StepEngine
+ * Background step pulse generator for the GDP03 stepper drivers.
+ *
+ * Moves are queued per axis (direction, microsteps, pulse rate) and the call
+ * returns at once. Pulses are then produced from a hardware timer compare
+ * interrupt (Timer1 for axis 0, Timer3 for axis 1 on the Mega), so the main
+ * loop is free to sample the load cells and talk over serial while an axis
+ * is moving.
+ *
+ * A move queued with STEP_CONTINUOUS steps runs until stop(), and its rate
+ * can be changed on the fly with setSpeed(), for closed-loop control of an
+ * axis from live load cell data.
+ *
+ * linkedMove() drives both axes from a single timer (Timer1) with a DDA: on
+ * each tick of a common timeline every axis that is due steps, so the axes
+ * stay in proportion, start and finish together, or run with a phase
+ * offset of a given number of ticks (e.g. heel leading forefoot). A planned
+ * profile for a linked move is planned over linkedTicks() steps.
+ *
+ * On the host ([env:native]) Timer1 and Timer3 are emulated by the HAL
+ * (lib/HAL/Hal.h) and the pins are written with digitalWrite(), so pulse
+ * timing and queue behaviour can be checked without hardware by advancing
+ * the virtual clock and watching the pins with Hal.addPinHook().
+ */
+
+#ifndef STEP_ENGINE_H
+#define STEP_ENGINE_H
+
+#include <stdint.h>
+#include "MotionPlanner.h"
+
+#define STEP_AXES 2 // Number of axes driven by the engine (0 = Forefoot, 1 = Heel)
+#define STEP_QUEUE_LENGTH 4 // Moves that can be queued per axis, must be a power of 2
+#define STEP_CONTINUOUS 0xFFFFFFFFUL // Step count for a move that runs until stop() (position still counts)
+#define STEP_MAX_INTERVAL 32767 // Longest edge time the step timers can produce (us)
+
+struct StepMove {
+  uint8_t direction; // Level written to the DIR pin for this move
+  unsigned long steps; // Number of microsteps to take
+  unsigned int speedMicroseconds; // Time the PUL pin is held high and then low, as in stepMotor()
+  MotionProfile *profile; // Per-step intervals from a planned profile (overrides speedMicroseconds), or 0
+};
+
+class StepEngine {
+  public:
+    void attach(uint8_t axis, uint8_t dirPin, uint8_t pulPin); // Assign driver pins to an axis (call before begin)
+    void begin(); // Set pin modes and configure the step timers
+    bool queueMove(uint8_t axis, bool direction, unsigned long steps, unsigned int speedMicroseconds); // Queue a move, returns false if the queue is full or a linked move is running
+    bool queueMove(uint8_t axis, bool direction, MotionProfile &profile); // Queue a planned move, the profile must stay valid until the move is done
+    bool linkedMove(bool direction0, unsigned long steps0, bool direction1, unsigned long steps1, long phase, unsigned int speedMicroseconds); // Move both axes together, both must be idle
+    bool linkedMove(bool direction0, unsigned long steps0, bool direction1, unsigned long steps1, long phase, MotionProfile &profile); // As above with a profile planned over linkedTicks()
+    static unsigned long linkedTicks(unsigned long steps0, unsigned long steps1, long phase); // Timeline length of a linked move
+    static unsigned int velocityInterval(float velocity); // Edge time (us) for a speed (microsteps/s), clamped to MOTION_MIN_INTERVAL..STEP_MAX_INTERVAL so it is never 0 (idle)
+    bool isMoveDone(uint8_t axis); // True when the axis has no queued or running move
+    uint8_t queueSpace(uint8_t axis); // Number of moves that can still be queued
+    long getPosition(uint8_t axis); // Signed microstep position (forward direction counts up)
+    void setPosition(uint8_t axis, long position); // Overwrite the position counter
+    unsigned long getStepsRemaining(uint8_t axis); // Microsteps left in the running move
+    void stop(uint8_t axis); // Abandon the running move and flush the queue (stops both axes of a linked move)
+    void setSpeed(uint8_t axis, unsigned int speedMicroseconds); // Change the rate of the running fixed-rate move from the next microstep
+
+    unsigned int onTimer(uint8_t axis); // ISR body: emit the next pulse edge, returns microseconds to the next edge (0 = idle)
+
+  private:
+    struct Axis {
+      uint8_t dirPin;
+      uint8_t pulPin;
+#ifdef __AVR__
+      volatile uint8_t *dirPort; // Output registers cached at begin() for use in the ISR
+      volatile uint8_t *pulPort;
+      uint8_t dirMask;
+      uint8_t pulMask;
+#endif
+      StepMove queue[STEP_QUEUE_LENGTH];
+      volatile uint8_t head; // Next move to run, advanced by the ISR
+      volatile uint8_t tail; // Next free slot, advanced by queueMove()
+      volatile bool running; // Timer is active for this axis
+      volatile bool pulseHigh; // PUL pin is currently high
+      volatile unsigned long remaining; // Microsteps left in the current move
+      volatile long position;
+      int8_t stepDir; // +1 or -1 for the current move
+      unsigned int speedMicroseconds;
+      MotionProfile *profile; // Profile of the running move, or 0 for a fixed rate
+      unsigned long stepIndex; // Microsteps started in the running move
+    };
+
+    // Linked move state, phase > 0 starts axis 1 that many ticks before axis 0 (phase < 0: after)
+    struct Linked {
+      unsigned long ticks; // Timeline length
+      unsigned long tick; // Ticks started so far
+      unsigned long start[STEP_AXES]; // Tick each axis starts stepping at
+      unsigned long window; // Ticks each axis spreads its steps over
+      unsigned long steps[STEP_AXES];
+      unsigned long error[STEP_AXES]; // DDA accumulators
+      uint8_t direction[STEP_AXES];
+      uint8_t stepped; // Bit per axis raised on the current tick
+    };
+
+    void writePin(Axis &a, bool pul, uint8_t level);
+    bool pushMove(uint8_t axis, bool direction, unsigned long steps, unsigned int speedMicroseconds, MotionProfile *profile);
+    bool startLinked(bool direction0, unsigned long steps0, bool direction1, unsigned long steps1, long phase, unsigned int speedMicroseconds, MotionProfile *profile);
+    unsigned int onLinkedTimer();
+    void startTimer(uint8_t axis);
+    Axis axes[STEP_AXES];
+    Linked linked;
+    volatile bool linkedActive = false; // A linked move owns both axes (timed by axis 0's timer)
+};
+
+extern StepEngine Steppers;
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * StepSearch
+ * Microstep-resolution search for the position that gives a target force.
+ * See StepSearch.h for usage.
+ */
+
+#include "StepSearch.h"
+
+void StepSearch::begin(float targetForce, float forceTolerance, float stiffness) {
+  target = targetForce;
+  tolerance = forceTolerance;
+  slope = stiffness;
+  points = 0;
+  haveLow = false;
+  haveHigh = false;
+  bestPosition = 0;
+  bestForce = 0;
+}
+
+void StepSearch::addPoint(long position, float force) {
+  if (points > 0 && position != lastPosition) {
+    float s = (force - lastForce) / (position - lastPosition);
+    if (s > 0) slope = s; // A flat or falling secant (noise, no contact yet) keeps the previous slope
+  }
+  float error = force - target;
+  float bestError = bestForce - target;
+  if (points == 0 || (error < 0 ? -error : error) < (bestError < 0 ? -bestError : bestError)) {
+    bestPosition = position;
+    bestForce = force;
+  }
+  if (force < target) {
+    if (!haveLow || position > lowPosition) lowPosition = position;
+    haveLow = true;
+  }
+  else {
+    if (!haveHigh || position < highPosition) highPosition = position;
+    haveHigh = true;
+  }
+  lastPosition = position;
+  lastForce = force;
+  if (points < 255) points++;
+}
+
+bool StepSearch::isDone() {
+  if (points == 0) return false;
+  float bestError = bestForce - target;
+  if ((bestError < 0 ? -bestError : bestError) <= tolerance) return true;
+  if (haveLow && haveHigh && highPosition - lowPosition <= 1) return true;
+  return points >= STEP_SEARCH_MAX_POINTS;
+}
+
+long StepSearch::nextPosition() {
+  float next;
+  if (slope > 0) {
+    next = lastPosition + (target - lastForce) / slope; // Secant step
+  }
+  else {
+    next = lastPosition + ((lastForce < target) ? 1 : -1); // No slope yet, creep towards the target
+  }
+  long position = (long)(next + (next < 0 ? -0.5 : 0.5));
+  // Stay strictly inside the bracket, bisecting if the secant leaves it
+  if (haveLow && haveHigh) {
+    if (position <= lowPosition || position >= highPosition) position = lowPosition + (highPosition - lowPosition) / 2;
+  }
+  else if (haveLow && position <= lowPosition) {
+    position = lowPosition + 1;
+  }
+  else if (haveHigh && position >= highPosition) {
+    position = highPosition - 1;
+  }
+  if (position == lastPosition) position += (lastForce < target) ? 1 : -1;
+  return position;
+}
+
+long StepSearch::getBest() {
+  return bestPosition;
+}
+
+float StepSearch::getBestForce() {
+  return bestForce;
+}
+
+uint8_t StepSearch::getPoints() {
+  return points;
+}
+
+float StepSearch::getSlope() {
+  return slope;
+}
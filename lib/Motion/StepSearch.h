@@ -0,0 +1,53 @@
+/*
+ * StepSearch
+ * Microstep-resolution search for the position that gives a target force.
+ *
+ * Feed it the force measured at rest at each position it asks for:
+ *   search.begin(targetForce, tolerance, stiffness);
+ *   search.addPoint(position, force);
+ *   while (!search.isDone()) {
+ *     position = search.nextPosition(); // move there, wait, measure
+ *     search.addPoint(position, force);
+ *   }
+ *   target = search.getBest();
+ *
+ * Each new position is a secant step through the last two points (the
+ * first step uses the stiffness estimate given to begin()), kept inside
+ * the bracket of the closest points below and above the target and
+ * replaced by bisection when the secant would leave it. The search ends
+ * when a point is within tolerance, the bracket is one microstep wide or
+ * STEP_SEARCH_MAX_POINTS have been measured.
+ */
+
+#ifndef STEP_SEARCH_H
+#define STEP_SEARCH_H
+
+#include <stdint.h>
+
+#define STEP_SEARCH_MAX_POINTS 8 // Measurements before the search gives up and returns the best point
+
+class StepSearch {
+  public:
+    void begin(float targetForce, float tolerance, float stiffness); // stiffness in N per microstep (0 if unknown)
+    void addPoint(long position, float force); // Force measured at rest at a position (microsteps)
+    bool isDone(); // True when no further measurement is needed
+    long nextPosition(); // Position to measure next
+    long getBest(); // Measured position closest to the target force
+    float getBestForce(); // Force measured at getBest()
+    uint8_t getPoints(); // Number of measurements so far
+    float getSlope(); // Latest force-vs-position slope (N per microstep)
+
+  private:
+    float target;
+    float tolerance;
+    float slope; // Force per microstep from the last two points (or the initial estimate)
+    uint8_t points;
+    bool haveLow, haveHigh; // Bracket: closest points below and above the target
+    long lowPosition, highPosition;
+    long lastPosition;
+    float lastForce;
+    long bestPosition;
+    float bestForce;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * FootModel
+ * Spring/damper model of the prosthetic foot for the GDP03 rig simulator.
+ * See FootModel.h for usage.
+ */
+
+#include "FootModel.h"
+
+void FootModel::begin(const FootSettings &footSettings) {
+  settings = footSettings;
+  for (uint8_t i = 0; i < FOOT_AXES; i++) {
+    position[i] = 0;
+    lastPosition[i] = 0;
+    velocity[i] = 0;
+    set[i] = 0;
+    peak[i] = 0;
+  }
+  started = false;
+}
+
+void FootModel::step(uint8_t axis, bool forward) {
+  if (axis >= FOOT_AXES) return;
+  position[axis] += forward ? 1 : -1;
+}
+
+// Creep from the force held since the last update, and the velocity once FOOT_VELOCITY_US has passed
+void FootModel::update(unsigned long timeMicroseconds) {
+  if (!started) {
+    started = true;
+    lastUpdate = timeMicroseconds;
+    lastVelocity = timeMicroseconds;
+    return;
+  }
+  float seconds = (timeMicroseconds - lastUpdate) / 1000000.0f;
+  for (uint8_t i = 0; i < FOOT_AXES; i++) {
+    FootAxisSettings &a = settings.axis[i];
+    set[i] += a.creep * spring(i) * seconds;
+    if (set[i] > a.creepLimit) set[i] = a.creepLimit;
+  }
+  lastUpdate = timeMicroseconds;
+  unsigned long window = timeMicroseconds - lastVelocity;
+  if (window < FOOT_VELOCITY_US) return;
+  for (uint8_t i = 0; i < FOOT_AXES; i++) {
+    velocity[i] = (position[i] - lastPosition[i]) * 1000000.0f / window;
+    lastPosition[i] = position[i];
+  }
+  lastVelocity = timeMicroseconds;
+}
+
+float FootModel::spring(uint8_t axis) {
+  FootAxisSettings &a = settings.axis[axis];
+  float compression = position[axis] - a.contact - set[axis];
+  if (compression <= 0) return 0;
+  return a.stiffness * compression + a.hardening * compression * compression / 2;
+}
+
+float FootModel::force(uint8_t axis, unsigned long timeMicroseconds) {
+  if (axis >= FOOT_AXES) return 0;
+  update(timeMicroseconds);
+  float f = spring(axis);
+  if (f > 0) f += settings.axis[axis].damping * velocity[axis];
+  f += settings.coupling * spring(FOOT_AXES - 1 - axis);
+  if (f < 0) f = 0;
+  if (f > peak[axis]) peak[axis] = f;
+  return f;
+}
+
+long FootModel::getPosition(uint8_t axis) {
+  return (axis < FOOT_AXES) ? position[axis] : 0;
+}
+
+float FootModel::getSet(uint8_t axis) {
+  return (axis < FOOT_AXES) ? set[axis] : 0;
+}
+
+float FootModel::getPeakForce(uint8_t axis) {
+  return (axis < FOOT_AXES) ? peak[axis] : 0;
+}
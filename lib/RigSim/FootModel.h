@@ -0,0 +1,66 @@
+/*
+ * FootModel
+ * Spring/damper model of the prosthetic foot for the GDP03 rig simulator.
+ *
+ * Each actuator (0 = Forefoot, 1 = Heel) is a step counter, moved one
+ * microstep at a time by the simulated driver (positive = loading). Once
+ * past its contact point the axis compresses the foot, and its load cell
+ * sees
+ *
+ *   F = k c + h c^2 / 2 + d v + coupling * (spring force of the other axis)
+ *
+ * for a compression c (microsteps) moving at v (microsteps/s), never less
+ * than zero (the actuator can lift off but not pull). k is the stiffness at
+ * contact and h stiffens it with compression, as in a foam heel.
+ *
+ * The foot creeps under load: the integral of force over time adds a
+ * permanent set that moves the contact point away, up to creepLimit, so
+ * the same step count gives a falling peak force over a long test.
+ */
+
+#ifndef FOOT_MODEL_H
+#define FOOT_MODEL_H
+
+#include <stdint.h>
+
+#define FOOT_AXES 2 // 0 = Forefoot, 1 = Heel
+#define FOOT_VELOCITY_US 5000 // Shortest interval the compression speed is measured over
+
+struct FootAxisSettings {
+  long contact; // Microsteps from the start position to first contact
+  float stiffness; // Stiffness at contact (N per microstep)
+  float hardening; // Stiffness added per microstep of compression (N per microstep^2)
+  float damping; // N per microstep/s of compression speed
+  float creep; // Permanent set per N.s of load (microsteps)
+  float creepLimit; // Largest permanent set (microsteps)
+};
+
+struct FootSettings {
+  FootAxisSettings axis[FOOT_AXES];
+  float coupling; // Share of each axis's spring force seen by the other load cell
+};
+
+class FootModel {
+  public:
+    void begin(const FootSettings &settings);
+    void step(uint8_t axis, bool forward); // One microstep of an actuator
+    float force(uint8_t axis, unsigned long timeMicroseconds); // Load on the axis's load cell (N)
+    long getPosition(uint8_t axis); // Actuator position (microsteps)
+    float getSet(uint8_t axis); // Permanent set so far (microsteps)
+    float getPeakForce(uint8_t axis); // Highest force returned by force()
+
+  private:
+    void update(unsigned long timeMicroseconds);
+    float spring(uint8_t axis); // Spring force at the current position (N)
+    FootSettings settings;
+    long position[FOOT_AXES];
+    long lastPosition[FOOT_AXES]; // Position when the velocity was last measured
+    float velocity[FOOT_AXES]; // Microsteps/s
+    float set[FOOT_AXES];
+    float peak[FOOT_AXES];
+    unsigned long lastUpdate = 0;
+    unsigned long lastVelocity = 0; // Time the velocity was last measured
+    bool started = false;
+};
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * Hx711Inputs
+ * Input sequence and pin hook for driving Hx711Models in the HX711 tests.
+ * See Hx711Inputs.h for usage.
+ */
+
+#include "Hx711Inputs.h"
+#include "Hx711Model.h"
+
+const long hx711EdgeInputs[HX711_EDGE_INPUTS] = {0, 1, -1, 0x7FFFFF, -0x800000, 0x400000, -0x400000};
+
+long hx711NextInput(void *context) {
+  Hx711Inputs &inputs = *(Hx711Inputs *)context;
+  if (inputs.next < HX711_EDGE_INPUTS) return hx711EdgeInputs[inputs.next++];
+  inputs.next++;
+  inputs.state ^= inputs.state << 13;
+  inputs.state ^= inputs.state >> 17;
+  inputs.state ^= inputs.state << 5;
+  return (long)(inputs.state & 0xFFFFFF) - 0x800000;
+}
+
+void hx711ModelPin(uint8_t pin, uint8_t level, void *model) {
+  ((Hx711Model *)model)->onPin(pin, level);
+}
@@ -0,0 +1,32 @@
+/*
+ * Hx711Inputs
+ * Input sequence and pin hook for driving Hx711Models in the HX711 tests.
+ *
+ * hx711NextInput() is an Hx711Model::Source over an Hx711Inputs: the range
+ * edges in hx711EdgeInputs first, then xorshift32 values across the 24 bit
+ * range from the seed. Two models given copies of the same Hx711Inputs see
+ * the same sequence, so two readers can be compared conversion for
+ * conversion. hx711ModelPin() is the pin hook for a model:
+ *   Hx711Inputs inputs = {seed, 0};
+ *   model.begin(dout, sck, 80, hx711NextInput, &inputs);
+ *   Hal.addPinHook(hx711ModelPin, &model);
+ */
+
+#ifndef HX711_INPUTS_H
+#define HX711_INPUTS_H
+
+#include <stdint.h>
+
+#define HX711_EDGE_INPUTS 7 // Range edges at the start of every sequence
+
+struct Hx711Inputs {
+  uint32_t state; // xorshift32 state, the seed (not 0)
+  unsigned long next; // Inputs handed out
+};
+
+extern const long hx711EdgeInputs[HX711_EDGE_INPUTS];
+
+long hx711NextInput(void *inputs); // Hx711Model::Source over an Hx711Inputs
+void hx711ModelPin(uint8_t pin, uint8_t level, void *model); // Pin hook passing the levels to an Hx711Model
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Hx711Model
+ * Pin level model of one HX711 for the GDP03 rig simulator ([env:rig]).
+ * See Hx711Model.h for usage.
+ */
+
+#include "Hx711Model.h"
+#include <Arduino.h>
+#include <Hal.h>
+
+void Hx711Model::begin(uint8_t doutPin, uint8_t sckPin, uint8_t rate, Source inputSource, void *inputContext) {
+  dout = doutPin;
+  sck = sckPin;
+  period = (rate >= 80) ? 12500 : 100000;
+  source = inputSource;
+  context = inputContext;
+  timer = Hal.addDeviceTimer();
+  sckHigh = false; // SCK starts low, so the chip powers up with the board
+  powerUp();
+}
+
+void Hx711Model::setNoise(float counts, uint32_t seed) {
+  noise = counts;
+  random = seed ? seed : 1;
+}
+
+void Hx711Model::onPin(uint8_t pin, uint8_t level) {
+  if (pin != sck) return;
+  unsigned long now = Hal.now();
+  if (level == HIGH) {
+    sckHigh = true;
+    sckRise = now;
+    if (poweredDown || (!ready && pulses == 0)) return; // Nothing to read yet
+    pulses++;
+    if (pulses <= 24) Hal.drivePin(dout, (data >> (24 - pulses)) & 1);
+    else if (pulses == 25) {
+      Hal.drivePin(dout, HIGH);
+      ready = false;
+      reads++;
+    }
+    if (pulses == 25) nextGain = 128;
+    else if (pulses == 26) nextGain = 32;
+    else if (pulses == 27) nextGain = 64;
+  }
+  else {
+    sckHigh = false;
+    if (now - sckRise > HX711_POWER_DOWN_US) {
+      if (!poweredDown) powerDowns++;
+      poweredDown = true;
+    }
+    if (poweredDown) powerUp();
+  }
+}
+
+void Hx711Model::powerUp() {
+  poweredDown = false;
+  ready = false;
+  pulses = 0;
+  inputGain = 128;
+  nextGain = 128;
+  Hal.drivePin(dout, HIGH);
+  Hal.startTimer(timer, period * HX711_SETTLING_CONVERSIONS, conversionDone, this);
+}
+
+unsigned long Hx711Model::conversionDone(void *model) {
+  Hx711Model &m = *(Hx711Model *)model;
+  if (m.sckHigh && Hal.now() - m.sckRise > HX711_POWER_DOWN_US) {
+    if (!m.poweredDown) m.powerDowns++;
+    m.poweredDown = true; // Stopped converting, powerUp() restarts the timer
+    return 0;
+  }
+  m.conversions++;
+  if (m.pulses > 0 && m.pulses < 25) return m.period; // Being read out, this result is lost
+  if (m.ready) m.overwritten++;
+  m.inputGain = m.nextGain;
+  m.data = m.convert();
+  m.pulses = 0;
+  m.ready = true;
+  Hal.drivePin(m.dout, LOW);
+  return m.period;
+}
+
+long Hx711Model::convert() {
+  float value = (inputGain == 32) ? 0 : source(context); // Nothing is wired to input B
+  value += noise * gaussian();
+  if (inputGain == 64) value /= 2;
+  else if (inputGain == 32) value /= 4;
+  long counts = (long)(value + (value < 0 ? -0.5f : 0.5f));
+  if (counts > 0x7FFFFFL) counts = 0x7FFFFFL;
+  if (counts < -0x800000L) counts = -0x800000L;
+  return counts & 0xFFFFFFL;
+}
+
+// Standard normal deviate from the xorshift32 generator (Box-Muller)
+float Hx711Model::gaussian() {
+  float u[2];
+  for (uint8_t i = 0; i < 2; i++) {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    u[i] = (random + 0.5f) / 4294967296.0f;
+  }
+  return sqrtf(-2 * logf(u[0])) * cosf(2 * (float)PI * u[1]);
+}
+
+uint8_t Hx711Model::getGain() {
+  return nextGain;
+}
+
+unsigned long Hx711Model::getConversions() {
+  return conversions;
+}
+
+unsigned long Hx711Model::getReads() {
+  return reads;
+}
+
+unsigned long Hx711Model::getOverwritten() {
+  return overwritten;
+}
+
+unsigned long Hx711Model::getPowerDowns() {
+  return powerDowns;
+}
@@ -0,0 +1,72 @@
+/*
+ * Hx711Model
+ * Pin level model of one HX711 for the GDP03 rig simulator ([env:rig]).
+ *
+ * The chip converts continuously at 10 or 80 SPS (its RATE pin is wired,
+ * so the rate is a setting). At the end of each conversion DOUT goes low;
+ * each SCK rising edge then shifts out the next of the 24 data bits, MSB
+ * first, in two's complement. The 25th pulse pulls DOUT high again, and
+ * the number of pulses (25, 26 or 27) picks the input and gain for the
+ * next conversion: A/128, B/32 or A/64. A conversion that finishes while
+ * the previous one is still unread replaces it, one that finishes during a
+ * read is dropped.
+ *
+ * SCK held high for more than 60 us powers the chip down. When SCK goes
+ * low again it resets (input A, gain 128) and the first conversion is only
+ * ready after the settling time, 4 conversion periods. The chip powers up
+ * the same way at the start of the run.
+ *
+ * The input is asked for at the end of each conversion, as raw counts at
+ * gain 128 on input A, from the source given to begin(). Gaussian noise is
+ * added from a seeded generator so runs repeat exactly.
+ */
+
+#ifndef HX711_MODEL_H
+#define HX711_MODEL_H
+
+#include <stdint.h>
+
+#define HX711_POWER_DOWN_US 60 // SCK high time that powers the chip down
+#define HX711_SETTLING_CONVERSIONS 4 // Conversion periods before the first result after power up
+
+class Hx711Model {
+  public:
+    typedef long (*Source)(void *context); // Input A in counts at gain 128
+
+    void begin(uint8_t doutPin, uint8_t sckPin, uint8_t rate, Source source, void *context); // rate: 10 or 80 SPS
+    void setNoise(float counts, uint32_t seed); // Standard deviation of the noise on each conversion (counts at gain 128)
+    void onPin(uint8_t pin, uint8_t level); // Pin hook, passes SCK edges to the model
+    uint8_t getGain(); // Gain of the next conversion (128, 64 or 32)
+    unsigned long getConversions(); // Conversions finished
+    unsigned long getReads(); // Conversions read out
+    unsigned long getOverwritten(); // Conversions replaced unread by the next one
+    unsigned long getPowerDowns();
+
+  private:
+    static unsigned long conversionDone(void *model); // Device timer handler
+    void powerUp();
+    long convert();
+    float gaussian();
+    uint8_t dout;
+    uint8_t sck;
+    unsigned long period; // Conversion period (us)
+    uint8_t timer; // Device timer
+    Source source;
+    void *context;
+    float noise = 0;
+    uint32_t random = 1; // xorshift32 state
+    bool sckHigh = false;
+    unsigned long sckRise = 0; // Time SCK went high
+    bool poweredDown = false;
+    bool ready = false; // Result waiting with DOUT low
+    uint8_t pulses = 0; // SCK pulses in the current read
+    uint8_t inputGain = 128; // Input and gain of the conversion in progress (32 = input B)
+    uint8_t nextGain = 128;
+    long data = 0; // Result being shifted out
+    unsigned long conversions = 0;
+    unsigned long reads = 0;
+    unsigned long overwritten = 0;
+    unsigned long powerDowns = 0;
+};
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * RigMain
+ * Entry point of [env:rig]: the sketch run against the virtual test rig.
+ *
+ * Sets up the simulated board and rig, stores the rig's load cell
+ * calibration in EEPROM (in the earlier layout, which main.cpp migrates to
+ * its configuration store), queues the answers to the
+ * setup questions (by default: skip both calibrations, start the test) and
+ * runs setup() and loop() until the sketch goes quiet after the last cycle.
+ * Serial output, binary telemetry once the test starts, goes to stdout or
+ * to the -o file, and a report of the run is printed on stderr:
+ *
+ *   .pio/build/rig/program -o run.bin
+ *
+ * -i <text> setup answers (default "nny"), -r <sps> HX711 rate (10 or 80),
+ * -n <counts> noise, -S <seed>, -t <s> time limit, -s <s> silence limit
+ * (default 5), -e <file> EEPROM image: read at the start if it exists
+ * (instead of the calibration above) and written at the end, so a run
+ * continues from the configuration an earlier one saved. Editing the image
+ * between runs tests a corrupted or half-written configuration.
+ */
+
+#ifdef RIG_SIM
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Hal.h>
+#include <time.h>
+#include "RigSim.h"
+
+#define RIG_CAL_ADDRESS_F 0 // Earlier layout of the Forefoot calibration value (ConfigStore.h)
+#define RIG_CAL_ADDRESS_H 4 // Earlier layout of the Heel calibration value
+#define RIG_DEFAULT_SILENCE_S 5
+
+static FILE *rigOutput = stdout;
+static const char *rigEeprom = 0; // EEPROM image file
+static clock_t rigStart;
+
+static void rigWrite(const uint8_t *data, size_t length, void *) {
+  fwrite(data, 1, length, rigOutput);
+}
+
+static void rigReport() {
+  fflush(rigOutput);
+  double wall = (double)(clock() - rigStart) / CLOCKS_PER_SEC;
+  double simulated = Hal.now() / 1000000.0;
+  fprintf(stderr, "rig: %.1f s simulated in %.2f s (%.0fx real time)\n", simulated, wall, wall > 0 ? simulated / wall : 0);
+  Rig.report(stderr);
+}
+
+static bool rigLoadEeprom() {
+  FILE *file = fopen(rigEeprom, "rb");
+  if (!file) return false;
+  size_t length = fread(EEPROM.data(), 1, HAL_EEPROM_SIZE, file);
+  fclose(file);
+  return length == HAL_EEPROM_SIZE;
+}
+
+static void rigSaveEeprom() {
+  FILE *file = fopen(rigEeprom, "wb");
+  if (!file) {
+    perror(rigEeprom);
+    return;
+  }
+  fwrite(EEPROM.data(), 1, HAL_EEPROM_SIZE, file);
+  fclose(file);
+}
+
+int main(int argc, char **argv) {
+  RigSettings settings = rigDefaults;
+  const char *input = "nny";
+  unsigned long timeLimit = 0;
+  unsigned long silenceLimit = RIG_DEFAULT_SILENCE_S;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char *value = argv[i + 1];
+    if (!strcmp(argv[i], "-i")) input = value;
+    else if (!strcmp(argv[i], "-o")) rigOutput = fopen(value, "wb");
+    else if (!strcmp(argv[i], "-r")) settings.rate = atoi(value);
+    else if (!strcmp(argv[i], "-n")) settings.noise = atof(value);
+    else if (!strcmp(argv[i], "-S")) settings.seed = strtoul(value, 0, 10);
+    else if (!strcmp(argv[i], "-t")) timeLimit = strtoul(value, 0, 10);
+    else if (!strcmp(argv[i], "-s")) silenceLimit = strtoul(value, 0, 10);
+    else if (!strcmp(argv[i], "-e")) rigEeprom = value;
+    else {
+      fprintf(stderr, "usage: %s [-i answers] [-o file] [-r sps] [-n counts] [-S seed] [-t seconds] [-s seconds] [-e eeprom]\n", argv[0]);
+      return 2;
+    }
+    if (!rigOutput) {
+      perror(value);
+      return 1;
+    }
+  }
+  Hal.reset();
+  Hal.setTimeLimit(timeLimit * 1000000UL);
+  Hal.setSilenceLimit(silenceLimit * 1000000UL);
+  Rig.begin(settings);
+  if (!rigEeprom || !rigLoadEeprom()) {
+    float calFactor = Rig.calFactor(); // Saved by an earlier calibration, so written without taking time
+    memset(EEPROM.data(), 0xFF, HAL_EEPROM_SIZE);
+    memcpy(EEPROM.data() + RIG_CAL_ADDRESS_F, &calFactor, sizeof(calFactor));
+    memcpy(EEPROM.data() + RIG_CAL_ADDRESS_H, &calFactor, sizeof(calFactor));
+  }
+  if (rigEeprom) atexit(rigSaveEeprom);
+  Serial.inject(input);
+  Serial.setSink(rigWrite, 0);
+  rigStart = clock();
+  atexit(rigReport);
+  setup();
+  while (true) loop();
+}
+
+#endif
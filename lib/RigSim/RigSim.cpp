@@ -0,0 +1,85 @@
+/*
+ * RigSim
+ * Virtual GDP03 test rig for the native build ([env:rig]).
+ * See RigSim.h for usage.
+ */
+
+#include "RigSim.h"
+#include <Arduino.h>
+#include <Hal.h>
+
+#define RIG_GRAVITY 9.81 // As g in main.cpp
+
+// Pins as in main.cpp, a 5 kg load cell on each axis (about 420 counts per gram at gain 128)
+const RigSettings rigDefaults = {
+  {
+    {35, 34, 4, 5, 8500}, // Forefoot
+#if HX711_SHARED_SCK
+    {37, 36, 6, 5, -12000} // Heel, clocked with the Forefoot HX711
+#else
+    {37, 36, 6, 7, -12000} // Heel
+#endif
+  },
+  80, 42800, 30, 1,
+  {
+    {
+      {400, 0.002, 2e-6, 2e-5, 0.3, 150}, // Forefoot: 1.5 N about 590 microsteps past contact
+      {300, 0.003, 3e-6, 2e-5, 0.3, 150} // Heel: stiffer, 1.5 N about 410 microsteps past contact
+    },
+    0.05
+  }
+};
+
+RigSimulator Rig;
+
+static const uint8_t rigChannelNumbers[RIG_CHANNELS] = {0, 1}; // Source contexts
+
+void RigSimulator::begin(const RigSettings &rigSettings) {
+  settings = rigSettings;
+  foot.begin(settings.foot);
+  Hal.addPinHook(onPin, this);
+  for (uint8_t i = 0; i < RIG_CHANNELS; i++) {
+    steps[i] = 0;
+    hx711[i].begin(settings.channels[i].doutPin, settings.channels[i].sckPin, settings.rate, loadCellInput, (void *)&rigChannelNumbers[i]);
+    hx711[i].setNoise(settings.noise, settings.seed + i);
+  }
+}
+
+float RigSimulator::calFactor() {
+  return settings.countsPerNewton * RIG_GRAVITY / 1000;
+}
+
+FootModel &RigSimulator::getFoot() {
+  return foot;
+}
+
+Hx711Model &RigSimulator::getHx711(uint8_t channel) {
+  return hx711[channel < RIG_CHANNELS ? channel : 0];
+}
+
+void RigSimulator::onPin(uint8_t pin, uint8_t level, void *rig) {
+  RigSimulator &r = *(RigSimulator *)rig;
+  for (uint8_t i = 0; i < RIG_CHANNELS; i++) {
+    RigChannel &c = r.settings.channels[i];
+    if (pin == c.pulPin && level == HIGH) {
+      r.foot.step(i, Hal.getLevel(c.dirPin) == HIGH); // The driver steps on the rising edge, DIR high loads the foot
+      r.steps[i]++;
+    }
+    if (pin == c.sckPin) r.hx711[i].onPin(pin, level);
+  }
+}
+
+long RigSimulator::loadCellInput(void *channel) {
+  uint8_t i = *(const uint8_t *)channel;
+  float counts = Rig.settings.channels[i].offset + Rig.settings.countsPerNewton * Rig.foot.force(i, Hal.now());
+  return (long)counts;
+}
+
+void RigSimulator::report(FILE *out) {
+  const char *names[RIG_CHANNELS] = {"Forefoot", "Heel"};
+  for (uint8_t i = 0; i < RIG_CHANNELS; i++) {
+    Hx711Model &h = hx711[i];
+    fprintf(out, "%-8s  steps %lu, position %ld, set %.1f microsteps, peak force %.3f N\n", names[i], steps[i], foot.getPosition(i), foot.getSet(i), foot.getPeakForce(i));
+    fprintf(out, "          HX711 conversions %lu, read %lu, overwritten %lu, power downs %lu\n", h.getConversions(), h.getReads(), h.getOverwritten(), h.getPowerDowns());
+  }
+}
@@ -0,0 +1,68 @@
+/*
+ * RigSim
+ * Virtual GDP03 test rig for the native build ([env:rig]).
+ *
+ * Wires the models to the simulated board (lib/HAL): the step and direction
+ * pins of both drivers move the FootModel actuators, and each axis's load
+ * cell is an Hx711Model on the HX711 pins, reading
+ *
+ *   offset + countsPerNewton * (foot force on that axis) + noise
+ *
+ * so the unmodified HX711_ADC code, the sampler and the whole test sequence
+ * in main.cpp run against it. The default settings (rigDefaults) use the
+ * pins of main.cpp and a foot that reaches the test force a few hundred
+ * microsteps past contact, and creeps enough over 1000 cycles to need
+ * drift corrections.
+ *
+ * Everything runs on the HAL's virtual clock with seeded noise, so a run is
+ * repeatable and goes as fast as the host allows.
+ */
+
+#ifndef RIG_SIM_H
+#define RIG_SIM_H
+
+#include <stdio.h>
+#include "FootModel.h"
+#include "Hx711Model.h"
+
+#define RIG_CHANNELS 2 // 0 = Forefoot, 1 = Heel
+
+struct RigChannel {
+  uint8_t dirPin; // Stepper driver
+  uint8_t pulPin;
+  uint8_t doutPin; // HX711
+  uint8_t sckPin;
+  long offset; // Raw reading with no load (counts)
+};
+
+struct RigSettings {
+  RigChannel channels[RIG_CHANNELS];
+  uint8_t rate; // HX711 conversion rate (10 or 80 SPS)
+  float countsPerNewton; // Load cell and HX711 scale at gain 128
+  float noise; // Noise on each conversion (counts)
+  uint32_t seed; // Noise generator seed
+  FootSettings foot;
+};
+
+extern const RigSettings rigDefaults;
+
+class RigSimulator {
+  public:
+    void begin(const RigSettings &settings); // Attach to the HAL, after Hal.reset() and before setup()
+    float calFactor(); // HX711_ADC calibration factor for the simulated load cells (raw counts per gram, as main.cpp uses it)
+    FootModel &getFoot();
+    Hx711Model &getHx711(uint8_t channel);
+    void report(FILE *out); // Step counts, forces and HX711 statistics of the run
+
+  private:
+    static void onPin(uint8_t pin, uint8_t level, void *rig); // HAL pin hook
+    static long loadCellInput(void *channel); // Hx711Model source
+    RigSettings settings;
+    FootModel foot;
+    Hx711Model hx711[RIG_CHANNELS];
+    unsigned long steps[RIG_CHANNELS]; // Pulses received
+};
+
+extern RigSimulator Rig;
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * CycleStats
+ * Per-cycle load cell statistics for the GDP03 test loop.
+ * See CycleStats.h for usage.
+ */
+
+#include "CycleStats.h"
+#include <math.h>
+
+void CycleStats::begin(unsigned long timeMicroseconds) {
+  startTime = timeMicroseconds;
+  for (uint8_t i = 0; i < CYCLE_STATS_CHANNELS; i++) {
+    Channel &c = channels[i];
+    c.count = 0;
+    c.mean = 0;
+    c.m2 = 0;
+    c.peak = 0;
+    c.minimum = 0;
+    c.peakTime = timeMicroseconds;
+    c.peakSteps = 0;
+  }
+}
+
+void CycleStats::add(uint8_t channel, float force, unsigned long timestamp, long steps) {
+  if (channel >= CYCLE_STATS_CHANNELS) return;
+  Channel &c = channels[channel];
+  c.count++;
+  float delta = force - c.mean;
+  c.mean += delta / c.count;
+  c.m2 += delta * (force - c.mean);
+  if (c.count == 1 || force > c.peak) {
+    c.peak = force;
+    c.peakTime = timestamp;
+    c.peakSteps = steps;
+  }
+  if (c.count == 1 || force < c.minimum) c.minimum = force;
+}
+
+CycleSummary CycleStats::summary(uint8_t channel) {
+  CycleSummary s = {0, 0, 0, 0, 0, 0, 0};
+  if (channel >= CYCLE_STATS_CHANNELS) return s;
+  Channel &c = channels[channel];
+  s.samples = c.count;
+  if (c.count == 0) return s;
+  s.peak = c.peak;
+  s.minimum = c.minimum;
+  s.mean = c.mean;
+  s.rms = sqrt(c.mean * c.mean + c.m2 / c.count); // Mean square = mean^2 + population variance
+  s.timeToPeak = (c.peakTime - startTime) / 1000;
+  s.stepsAtPeak = c.peakSteps;
+  return s;
+}
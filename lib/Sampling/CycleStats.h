@@ -0,0 +1,50 @@
+/*
+ * CycleStats
+ * Per-cycle load cell statistics for the GDP03 test loop.
+ *
+ * Every live force sample taken during a test cycle is added as it arrives,
+ * and only running values are kept per channel: peak and minimum, the mean
+ * and variance by Welford's method (numerically stable in float, one pass),
+ * and the time from the start of the cycle and the axis position at the
+ * peak. At the end of the cycle summary() gives the figures that are sent
+ * as one telemetry record, so the raw samples never need to leave the board.
+ */
+
+#ifndef CYCLE_STATS_H
+#define CYCLE_STATS_H
+
+#include <stdint.h>
+
+#define CYCLE_STATS_CHANNELS 2 // Channels tracked (0 = Forefoot, 1 = Heel)
+
+struct CycleSummary {
+  float peak; // Highest force (N)
+  float minimum; // Lowest force (N)
+  float mean; // Mean force (N)
+  float rms; // Root mean square force (N)
+  unsigned long timeToPeak; // Time from the start of the cycle to the peak (ms)
+  long stepsAtPeak; // Axis position at the peak, from the start of the cycle (microsteps)
+  unsigned long samples; // Samples in the cycle
+};
+
+class CycleStats {
+  public:
+    void begin(unsigned long timeMicroseconds); // Start a new cycle
+    void add(uint8_t channel, float force, unsigned long timestamp, long steps); // One sample (timestamp in us, steps from the cycle start)
+    CycleSummary summary(uint8_t channel); // Figures for the cycle so far
+
+  private:
+    struct Channel {
+      unsigned long count;
+      float mean;
+      float m2; // Sum of squared differences from the mean
+      float peak;
+      float minimum;
+      unsigned long peakTime;
+      long peakSteps;
+    };
+    Channel channels[CYCLE_STATS_CHANNELS];
+    unsigned long startTime = 0;
+};
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ * LoadCellSampler
+ * Interrupt-driven acquisition for the GDP03 HX711 load cells.
+ * See LoadCellSampler.h for usage.
+ */
+
+#include "LoadCellSampler.h"
+#include "SampleRing.h"
+#include <util/atomic.h>
+#include <Trace.h>
+#ifndef __AVR__
+#include <Hal.h>
+#endif
+
+#define SAMPLER_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+
+LoadCellSampler Sampler;
+
+// DOUT pin interrupt trampolines, one per channel
+static void samplerPinIsr0() { Sampler.serviceChannel(0); }
+static void samplerPinIsr1() { Sampler.serviceChannel(1); }
+static void (*const samplerPinIsrs[SAMPLER_CHANNELS])() = {samplerPinIsr0, samplerPinIsr1};
+
+int8_t LoadCellSampler::attach(HX711_ADC_Base &cell, uint8_t doutPin) {
+  if (running || channelCount >= SAMPLER_CHANNELS) return -1;
+  Channel &c = channels[channelCount];
+  c.cell = &cell;
+  c.doutPin = doutPin;
+  c.pinInterrupt = false;
+  c.newData = false;
+  c.samples = 0;
+  c.missed = 0;
+  c.lastSample = 0;
+  c.period = 0;
+  return channelCount++;
+}
+
+void LoadCellSampler::begin() {
+  if (running) return;
+  bool poll = false;
+  for (uint8_t i = 0; i < channelCount; i++) {
+    Channel &c = channels[i];
+    c.newData = false;
+    c.samples = 0;
+    c.missed = 0;
+    c.lastSample = 0;
+    c.period = 0;
+    int irq = digitalPinToInterrupt(c.doutPin);
+    c.pinInterrupt = (irq != NOT_AN_INTERRUPT);
+    if (!c.pinInterrupt) poll = true;
+  }
+  running = true;
+  for (uint8_t i = 0; i < channelCount; i++) {
+    Channel &c = channels[i];
+    if (c.pinInterrupt) {
+      SAMPLER_ATOMIC {
+        attachInterrupt(digitalPinToInterrupt(c.doutPin), samplerPinIsrs[i], FALLING);
+        serviceChannel(i); // A conversion may already be waiting, its falling edge has passed
+      }
+    }
+  }
+  if (poll) startPollTimer();
+}
+
+#ifndef __AVR__
+// Timer4 emulated by the native HAL
+static unsigned long samplerPollTimer(void *) {
+  Sampler.service();
+  return SAMPLER_POLL_US;
+}
+#endif
+
+void LoadCellSampler::startPollTimer() {
+#ifdef __AVR__
+  // Timer4: CTC mode, prescaler 64 -> 4 us per tick at 16 MHz
+  SAMPLER_ATOMIC {
+    TCCR4A = 0;
+    TCCR4B = _BV(WGM42) | _BV(CS41) | _BV(CS40);
+    TCNT4 = 0;
+    OCR4A = (SAMPLER_POLL_US / 4) - 1;
+    TIFR4 = _BV(OCF4A);
+    TIMSK4 |= _BV(OCIE4A);
+  }
+#else
+  Hal.startTimer(4, SAMPLER_POLL_US, samplerPollTimer, 0, true); // Nested, as ISR_NOBLOCK
+#endif
+}
+
+void LoadCellSampler::end() {
+  if (!running) return;
+#ifdef __AVR__
+  TIMSK4 &= ~_BV(OCIE4A);
+#else
+  Hal.stopTimer(4);
+#endif
+  for (uint8_t i = 0; i < channelCount; i++) {
+    if (channels[i].pinInterrupt) detachInterrupt(digitalPinToInterrupt(channels[i].doutPin));
+  }
+  running = false;
+}
+
+bool LoadCellSampler::isRunning() {
+  return running;
+}
+
+int8_t LoadCellSampler::channelOf(HX711_ADC_Base &cell) {
+  for (uint8_t i = 0; i < channelCount; i++) {
+    if (channels[i].cell == &cell) return i;
+  }
+  return -1;
+}
+
+bool LoadCellSampler::dataReady(uint8_t channel) {
+  if (channel >= channelCount) return false;
+  if (!running) {
+    if (channels[channel].cell->update()) channels[channel].newData = true; // Fall back to foreground polling
+  }
+  bool ready = channels[channel].newData;
+  channels[channel].newData = false;
+  return ready;
+}
+
+float LoadCellSampler::getData(uint8_t channel) {
+  if (channel >= channelCount) return 0;
+  float value = 0;
+  SAMPLER_ATOMIC { // The dataset must not change while it is being averaged
+    value = channels[channel].cell->getData();
+  }
+  return value;
+}
+
+long LoadCellSampler::getForce_mN(uint8_t channel) {
+  if (channel >= channelCount) return 0;
+  long value = 0;
+  SAMPLER_ATOMIC { // The dataset must not change while it is being averaged
+    value = channels[channel].cell->getForce_mN();
+  }
+  return value;
+}
+
+unsigned long LoadCellSampler::getSampleCount(uint8_t channel) {
+  if (channel >= channelCount) return 0;
+  unsigned long count = 0;
+  SAMPLER_ATOMIC {
+    count = channels[channel].samples;
+  }
+  return count;
+}
+
+unsigned long LoadCellSampler::getMissedCount(uint8_t channel) {
+  if (channel >= channelCount) return 0;
+  unsigned long count = 0;
+  SAMPLER_ATOMIC {
+    count = channels[channel].missed;
+  }
+  return count;
+}
+
+void LoadCellSampler::service() {
+  if (busy) return;
+  busy = true;
+  for (uint8_t i = 0; i < channelCount; i++) {
+    if (!channels[i].pinInterrupt) serviceChannel(i);
+  }
+  busy = false;
+}
+
+void LoadCellSampler::serviceChannel(uint8_t channel) {
+  Channel &c = channels[channel];
+  if (!running) return;
+  uint16_t readStart = TRACE_TICK();
+  if (!c.cell->update()) return;
+  TRACE_SINCE(TRACE_HX711_READ + channel, readStart);
+  unsigned long now = micros();
+  if (c.samples > 0) {
+    unsigned long gap = now - c.lastSample;
+    if (c.period == 0 || gap < c.period) c.period = gap;
+    if (gap > c.period + c.period / 2) c.missed += (gap + c.period / 2) / c.period - 1;
+  }
+  c.lastSample = now;
+  Samples.push(channel, c.cell->getLastConversionRaw(), now);
+  c.samples++;
+  c.newData = true;
+}
+
+#ifdef __AVR__
+// Runs with interrupts enabled so the step engine timers are not held off during the 25 bit read
+ISR(TIMER4_COMPA_vect, ISR_NOBLOCK) {
+  Sampler.service();
+}
+#endif
@@ -0,0 +1,66 @@
+/*
+ * LoadCellSampler
+ * Interrupt-driven acquisition for the GDP03 HX711 load cells.
+ *
+ * Each attached HX711_ADC is read from interrupt context as soon as its
+ * conversion is ready, so no conversion is lost while the main loop is busy
+ * (motion, serial, delays). A DOUT pin that is external interrupt capable is
+ * read from a FALLING edge interrupt. Otherwise (the Mega's pins 4 and 6 have
+ * neither INT nor PCINT) DOUT is polled from a Timer4 compare interrupt every
+ * SAMPLER_POLL_US, which is far shorter than the 12.5 ms conversion period at
+ * 80 SPS. The poll ISR runs with interrupts enabled so the step engine timers
+ * can still preempt it.
+ *
+ * Every conversion read is also pushed, with its channel and timestamp, to
+ * the Samples ring (SampleRing.h) for the main loop to drain.
+ *
+ * Once begin() has been called, update() must no longer be called on the
+ * attached load cells from the foreground; use getData() here instead.
+ */
+
+#ifndef LOAD_CELL_SAMPLER_H
+#define LOAD_CELL_SAMPLER_H
+
+#include <Arduino.h>
+#include <HX711_ADC.h>
+
+#define SAMPLER_CHANNELS 2 // Load cells that can be attached (0 = Forefoot, 1 = Heel)
+#define SAMPLER_POLL_US 500 // DOUT poll period for pins without an interrupt (us)
+
+class LoadCellSampler {
+  public:
+    int8_t attach(HX711_ADC_Base &cell, uint8_t doutPin); // Register a load cell, returns its channel or -1
+    void begin(); // Start interrupt-driven reads of all attached load cells
+    void end(); // Stop reading from interrupts (foreground update() may be used again)
+    bool isRunning(); // True between begin() and end()
+    int8_t channelOf(HX711_ADC_Base &cell); // Channel of an attached load cell, or -1
+    bool dataReady(uint8_t channel); // True once per new conversion on the channel
+    float getData(uint8_t channel); // Smoothed, calibrated value (HX711_ADC_Base::getData() with the ISR held off)
+    long getForce_mN(uint8_t channel); // Smoothed force in mN without float math (HX711_ADC_Base::getForce_mN() with the ISR held off)
+    unsigned long getSampleCount(uint8_t channel); // Conversions read since begin()
+    unsigned long getMissedCount(uint8_t channel); // Conversions lost (gap longer than 1.5 conversion periods)
+
+    void service(); // Poll ISR body: read every channel with a conversion ready
+    void serviceChannel(uint8_t channel); // Read one channel (pin interrupt ISR body)
+
+  private:
+    void startPollTimer();
+    struct Channel {
+      HX711_ADC_Base *cell;
+      uint8_t doutPin;
+      bool pinInterrupt; // Read from a DOUT pin interrupt rather than the poll timer
+      volatile bool newData;
+      volatile unsigned long samples;
+      volatile unsigned long missed;
+      unsigned long lastSample; // micros() of the last conversion read
+      unsigned long period; // Shortest gap seen between conversions (us)
+    };
+    Channel channels[SAMPLER_CHANNELS];
+    uint8_t channelCount = 0;
+    volatile bool running = false;
+    volatile bool busy = false; // Poll ISR re-entry guard
+};
+
+extern LoadCellSampler Sampler;
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * LoadCellSetup
+ * Start-up and calibration dialog of one GDP03 load cell, without blocking.
+ * See LoadCellSetup.h for usage.
+ */
+
+#include "LoadCellSetup.h"
+#include "LoadCellSampler.h"
+#include <ConfigStore.h>
+#include <stdlib.h>
+#include <Trace.h>
+
+static bool isSpace(int c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+void LoadCellSetup::begin(HX711_ADC_Base &cell, Stream &serial, uint8_t channel, unsigned long stabilizingTime) {
+  this->cell = &cell;
+  this->serial = &serial;
+  this->channel = channel;
+  this->stabilizingTime = stabilizingTime;
+  started = false;
+  tare = true;
+  manual = false;
+  state = CALIBRATION_IDLE;
+  calFactor = 1.0;
+  numberLength = 0;
+}
+
+void LoadCellSetup::ask() {
+  if (state != CALIBRATION_IDLE && state != CALIBRATION_DONE) return;
+  manual = false;
+  state = CALIBRATION_CHOOSE;
+}
+
+void LoadCellSetup::useSaved() {
+  calFactor = Config.isCalibrated(channel) ? Config.getCalFactor(channel) : 1.0;
+  if (!started && Config.isTared(channel)) {
+    cell->setTareOffset(Config.getTareOffset(channel));
+    tare = false;
+  }
+  state = CALIBRATION_DONE;
+}
+
+bool LoadCellSetup::update() {
+  if (!cell) return false;
+  if (!started) {
+    started = cell->startMultiple(stabilizingTime, tare); // Stabilising time, then tare unless the offset was saved
+    if (started && tare) TRACE(TRACE_TARE_DONE, Sampler.channelOf(*cell));
+  }
+  else if (!Sampler.isRunning()) {
+    cell->update(); // Keep converting while the operator answers
+  }
+
+  int key;
+  float value;
+  switch (state) {
+    case CALIBRATION_CHOOSE:
+      key = readKey();
+      if (key == 'y') { // Regular calibration with a known mass
+        serial->println("Performing automatic calibration...");
+        serial->println("***");
+        serial->println("Start calibration:");
+        serial->println("Place the load cell an a level stable surface.");
+        serial->println("Remove any load applied to the load cell.");
+        serial->println("Then send 't' from serial monitor to set the tare offset.");
+        state = CALIBRATION_TARE_KEY;
+      }
+      else if (key == 'm') { // Manual calibration
+        serial->println("Performing manual calibration...");
+        serial->println("***");
+        serial->print("Current value is: ");
+        serial->println(Config.getCalFactor(channel)); // The saved calibration value
+        serial->println("Now, send the new value from serial monitor (e.g. 14.4).");
+        manual = true;
+        state = CALIBRATION_MANUAL;
+      }
+      else if (key == 'n') { // Skip calibration
+        serial->println("Skipping calibration. Using saved tare offset value.");
+        float savedValue = Config.getCalFactor(channel);
+        if (savedValue == 0) {
+          serial->println("Warning: Calibration value is invalid or not set. Using default tare offset value.");
+          calFactor = 1.0; // Default value, the operator should calibrate
+        }
+        else {
+          calFactor = savedValue;
+        }
+        serial->print("Saved Value: ");
+        serial->println(calFactor);
+        finish("End of calibration.");
+      }
+      else if (key >= 0) {
+        serial->println("Invalid input. Please enter 'y' for regular calibration, 'm' for manual calibration, or 'n' to skip.");
+      }
+      break;
+
+    case CALIBRATION_TARE_KEY:
+      if (!started) break; // The start-up tare must finish first, 't' stays queued
+      if (readKey() == 't') {
+        cell->tareNoDelay();
+        state = CALIBRATION_TARING;
+      }
+      break;
+
+    case CALIBRATION_TARING:
+      if (cell->getTareStatus()) {
+        TRACE(TRACE_TARE_DONE, Sampler.channelOf(*cell));
+        serial->println("Tare complete");
+        serial->println("Place a mass of know weight on the loadcell, Then send the weight of this mass in grams (i.e. 100.0 [g]) from serial monitor.");
+        state = CALIBRATION_MASS;
+      }
+      break;
+
+    case CALIBRATION_MASS:
+      if (!readNumber(value)) break;
+      if (value != 0) {
+        serial->print("Known mass is: ");
+        serial->println(value);
+        knownMass = value;
+        cell->refreshDataSetNoDelay(); // Refill the dataset to be sure that the known mass is measured correctly
+        state = CALIBRATION_REFRESH;
+      }
+      else {
+        serial->println("Invalid mass input. Please enter a valid number.");
+      }
+      break;
+
+    case CALIBRATION_REFRESH:
+      if (cell->getRefreshStatus()) {
+        calFactor = cell->getNewCalibration(knownMass);
+        serial->print("New calibration value has been set to: ");
+        serial->print(calFactor);
+        serial->println(", use this as calibration value (calFactor) in your project sketch.");
+        askToSave();
+      }
+      break;
+
+    case CALIBRATION_MANUAL:
+      if (!readNumber(value) || value == 0) break;
+      calFactor = value;
+      serial->print("New calibration value is: ");
+      serial->println(calFactor);
+      askToSave();
+      break;
+
+    case CALIBRATION_SAVE:
+      key = readKey();
+      if (key == 'y') {
+        save();
+        finish(manual ? "End of manual calibration value" : "End of auto calibration value");
+      }
+      else if (key == 'n') {
+        serial->println("Value not saved to EEPROM");
+        finish(manual ? "End of manual calibration value" : "End of auto calibration value");
+      }
+      else if (key >= 0) {
+        serial->println("Invalid input. Please enter 'y' or 'n'.");
+      }
+      break;
+  }
+  return isDone();
+}
+
+bool LoadCellSetup::isStarted() {
+  return started;
+}
+
+bool LoadCellSetup::isDone() {
+  return started && state == CALIBRATION_DONE;
+}
+
+uint8_t LoadCellSetup::getState() {
+  return state;
+}
+
+float LoadCellSetup::getCalFactor() {
+  return calFactor;
+}
+
+int LoadCellSetup::readKey() {
+  while (serial->available() > 0) {
+    int c = serial->read();
+    if (!isSpace(c)) return c;
+  }
+  return -1;
+}
+
+// Characters that cannot start a number give 0, as Stream::parseFloat() does when it times out on them.
+// The number ends at any other character, which is left for the next step unless it is white space.
+bool LoadCellSetup::readNumber(float &value) {
+  bool ended = false;
+  while (!ended && serial->available() > 0) {
+    int c = serial->peek();
+    if ((c >= '0' && c <= '9') || c == '.' || (c == '-' && numberLength == 0)) {
+      serial->read();
+      if (numberLength < LOAD_CELL_SETUP_NUMBER_LENGTH) number[numberLength++] = c;
+      lastInput = millis();
+      continue;
+    }
+    if (isSpace(c) || numberLength == 0) serial->read(); // White space, or a character that cannot start a number
+    ended = numberLength > 0 || !isSpace(c);
+  }
+  if (!ended && (numberLength == 0 || millis() - lastInput < LOAD_CELL_SETUP_NUMBER_TIMEOUT)) return false;
+  number[numberLength] = 0;
+  value = numberLength ? atof(number) : 0;
+  numberLength = 0;
+  return true;
+}
+
+void LoadCellSetup::askToSave() {
+  serial->println("Save this value to EEPROM? (y: Yes, n: No)");
+  state = CALIBRATION_SAVE;
+}
+
+void LoadCellSetup::save() {
+  Config.setCalFactor(channel, calFactor);
+  if (!Config.save()) {
+    serial->println("Warning: EEPROM did not read back the value, it is used but not saved.");
+    return;
+  }
+  serial->print("Value ");
+  serial->print(calFactor);
+  serial->println(" saved to EEPROM.");
+}
+
+void LoadCellSetup::finish(const char *message) {
+  serial->println(message);
+  serial->println("***");
+  state = CALIBRATION_DONE;
+}
@@ -0,0 +1,82 @@
+/*
+ * LoadCellSetup
+ * Start-up and calibration dialog of one GDP03 load cell, without blocking.
+ *
+ * update() is called from loop() for each load cell until the test starts.
+ * It runs the HX711 start-up (stabilising time, then tare) and, once ask()
+ * has been called, the operator's calibration dialog over serial:
+ *   y: automatic calibration with a known mass. The cell is tared when 't'
+ *      is sent, then the mass is sent in grams and the calibration factor is
+ *      found once the filter has been refilled with the loaded cell's data.
+ *   m: manual calibration, the calibration factor is sent.
+ *   n: keep the calibration factor saved in EEPROM.
+ * A new calibration factor is then offered for saving to EEPROM (y/n), with
+ * the rest of the configuration (ConfigStore.h). useSaved() skips the dialog
+ * and also the start-up tare if a tare offset was saved, so a rig restarted
+ * with the foot loaded still reads the right force. ask() can run the dialog
+ * again once it has finished.
+ *
+ * Each call does one step and never waits: it only reads the input the
+ * current step can use, and otherwise just updates the load cell. Both cells
+ * keep converting while the operator answers, and the stabilising time runs
+ * while the first question is asked. Input for later steps stays queued, so
+ * a script of answers can be sent at once, as [env:rig] does with -i
+ * (e.g. "nny", or "m420 nny" to set the forefoot calibration factor by hand
+ * without saving it). White space between answers is skipped.
+ */
+
+#ifndef LOAD_CELL_SETUP_H
+#define LOAD_CELL_SETUP_H
+
+#include <Arduino.h>
+#include <HX711_ADC.h>
+
+#define LOAD_CELL_SETUP_NUMBER_LENGTH 15 // Longest number read (characters)
+#define LOAD_CELL_SETUP_NUMBER_TIMEOUT 1000 // A number with nothing after it ends after this long without input (ms), as Stream::parseFloat()
+
+enum LoadCellSetupState {
+  CALIBRATION_IDLE = 0, // Start-up only, the dialog has not been asked for yet
+  CALIBRATION_CHOOSE = 1, // Waiting for y (automatic), m (manual) or n (keep the saved value)
+  CALIBRATION_TARE_KEY = 2, // Automatic: waiting for 't' once the load is removed and the start-up is done
+  CALIBRATION_TARING = 3, // Automatic: tare running
+  CALIBRATION_MASS = 4, // Automatic: waiting for the known mass (g)
+  CALIBRATION_REFRESH = 5, // Automatic: refilling the filter with data of the loaded cell
+  CALIBRATION_MANUAL = 6, // Manual: waiting for the calibration factor
+  CALIBRATION_SAVE = 7, // Waiting for y/n to save the new calibration factor
+  CALIBRATION_DONE = 8
+};
+
+class LoadCellSetup {
+  public:
+    void begin(HX711_ADC_Base &cell, Stream &serial, uint8_t channel, unsigned long stabilizingTime); // Start the start-up (the cell's begin() has been called)
+    void ask(); // Start the dialog, once its question has been printed
+    void useSaved(); // No dialog: the saved calibration factor and tare offset, before the first update()
+    bool update(); // Next step of the start-up and dialog, returns true once both are finished
+    bool isStarted(); // Start-up finished (also after a tare timeout, see getTareTimeoutFlag())
+    bool isDone(); // Start-up and dialog finished
+    uint8_t getState(); // LoadCellSetupState of the dialog
+    float getCalFactor(); // Calibration factor from the dialog
+
+  private:
+    int readKey(); // Next input character other than white space, or -1 if none yet
+    bool readNumber(float &value); // Stream::parseFloat() without waiting: true once a number has been read
+    void askToSave();
+    void save();
+    void finish(const char *message);
+
+    HX711_ADC_Base *cell = 0;
+    Stream *serial = 0;
+    uint8_t channel = 0; // Load cell's channel in the configuration store
+    unsigned long stabilizingTime = 0; // Conversions before the start-up tare (ms)
+    bool started = false;
+    bool tare = true; // Tare at the end of the start-up, false with a saved tare offset
+    bool manual = false; // The dialog is a manual calibration
+    uint8_t state = CALIBRATION_IDLE;
+    float calFactor = 1.0;
+    float knownMass = 0; // g
+    char number[LOAD_CELL_SETUP_NUMBER_LENGTH + 1]; // Number being read
+    uint8_t numberLength = 0;
+    unsigned long lastInput = 0; // millis() of the number's last character
+};
+
+#endif
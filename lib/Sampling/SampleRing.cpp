@@ -0,0 +1,73 @@
+/*
+ * SampleRing
+ * Timestamped load cell sample queue between the sampling ISRs and the main loop.
+ * See SampleRing.h for usage.
+ */
+
+#include "SampleRing.h"
+
+#include <util/atomic.h>
+
+#define SAMPLE_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+
+#define SAMPLE_RING_MASK (SAMPLE_RING_LENGTH - 1)
+
+#if (SAMPLE_RING_LENGTH & SAMPLE_RING_MASK) != 0 || SAMPLE_RING_LENGTH > 128
+#error "SAMPLE_RING_LENGTH must be a power of 2 no larger than 128"
+#endif
+
+SampleRing Samples;
+
+bool SampleRing::push(uint8_t channel, long raw, unsigned long timestamp) {
+  bool stored = false;
+  SAMPLE_ATOMIC {
+    uint8_t count = (head - tail) & SAMPLE_RING_MASK;
+    if (count == SAMPLE_RING_MASK) {
+      overflows++;
+    }
+    else {
+      LoadCellSample &s = records[head];
+      s.timestamp = timestamp;
+      s.raw = raw;
+      s.channel = channel;
+      head = (head + 1) & SAMPLE_RING_MASK; // Publish the record to the consumer
+      if (count + 1 > highWater) highWater = count + 1;
+      stored = true;
+    }
+  }
+  return stored;
+}
+
+bool SampleRing::pop(LoadCellSample &sample) {
+  uint8_t t = tail;
+  if (t == head) return false;
+  sample.timestamp = records[t].timestamp;
+  sample.raw = records[t].raw;
+  sample.channel = records[t].channel;
+  tail = (t + 1) & SAMPLE_RING_MASK; // Release the slot to the producers
+  return true;
+}
+
+uint8_t SampleRing::available() {
+  return (head - tail) & SAMPLE_RING_MASK;
+}
+
+unsigned long SampleRing::getOverflowCount() {
+  unsigned long count;
+  SAMPLE_ATOMIC {
+    count = overflows;
+  }
+  return count;
+}
+
+uint8_t SampleRing::getHighWater() {
+  return highWater;
+}
+
+void SampleRing::clear() {
+  SAMPLE_ATOMIC {
+    tail = head;
+    overflows = 0;
+    highWater = 0;
+  }
+}
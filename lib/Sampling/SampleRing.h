@@ -0,0 +1,45 @@
+/*
+ * SampleRing
+ * Timestamped load cell sample queue between the sampling ISRs and the main loop.
+ *
+ * A fixed-size ring of {channel, raw 24 bit conversion, micros timestamp}
+ * records. The ISRs push and the main loop pops. The indices are single bytes
+ * so the consumer never has to disable interrupts. Producers only hold
+ * interrupts off for the few instructions needed to claim a slot, because the
+ * DOUT pin ISR and the (interruptible) poll ISR can both push. When the ring
+ * is full the new sample is dropped and counted in getOverflowCount().
+ */
+
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdint.h>
+
+#define SAMPLE_RING_LENGTH 32 // Records in the ring, must be a power of 2 (max 128)
+
+struct LoadCellSample {
+  unsigned long timestamp; // micros() when the conversion was read
+  long raw; // Raw 24 bit conversion (before tare and calibration)
+  uint8_t channel; // Sampler channel (0 = Forefoot, 1 = Heel)
+};
+
+class SampleRing {
+  public:
+    bool push(uint8_t channel, long raw, unsigned long timestamp); // Producer (ISR), returns false on overflow
+    bool pop(LoadCellSample &sample); // Consumer (main loop), returns false when empty
+    uint8_t available(); // Records waiting to be popped
+    unsigned long getOverflowCount(); // Samples dropped because the ring was full
+    uint8_t getHighWater(); // Most records ever waiting at once
+    void clear(); // Drop all waiting records and reset the counters (consumer side)
+
+  private:
+    LoadCellSample records[SAMPLE_RING_LENGTH];
+    volatile uint8_t head = 0; // Next slot to write, advanced by producers
+    volatile uint8_t tail = 0; // Next slot to read, advanced by the consumer
+    volatile unsigned long overflows = 0;
+    volatile uint8_t highWater = 0;
+};
+
+extern SampleRing Samples;
+
+#endif
@@ -0,0 +1,288 @@
+/*
+ * Telemetry
+ * Test data output for the GDP03 rig.
+ * See Telemetry.h for usage.
+ */
+
+#include "Telemetry.h"
+
+#if 4 + 14 * CYCLE_STATS_CHANNELS > TELEMETRY_MAX_PAYLOAD
+#error "Cycle summary does not fit in TELEMETRY_MAX_PAYLOAD"
+#endif
+
+TelemetryStream Telemetry;
+
+void TelemetryStream::begin(Print &stream) {
+  out = &stream;
+  sequence = 0;
+  resync();
+}
+
+void TelemetryStream::resync() {
+  if (!out) return;
+#if TELEMETRY_BINARY
+  out->write((uint8_t)0x00); // Ends any text the decoder has collected so the next frame is clean
+#endif
+}
+
+void TelemetryStream::force(uint8_t channel, uint8_t tag, float forceN) {
+  if (!out) return;
+#if TELEMETRY_BINARY
+  uint8_t p[6];
+  p[0] = channel;
+  p[1] = tag;
+  telemetryPut32(p + 2, (uint32_t)(long)(forceN * 1000 + (forceN < 0 ? -0.5 : 0.5)));
+  send(TELEMETRY_FORCE, p, sizeof(p));
+#else
+  printMotor(channel == 0 ? 'F' : 'H');
+  if (tag == FORCE_AFTER_FORWARD) out->print(F(" Force After Forward Move: "));
+  else if (tag == FORCE_AFTER_RETURN) out->print(F(" Force After Backward Move: "));
+  else if (tag == FORCE_DRIFT_PEAK) out->print(F(" Smoothed Peak Force: "));
+  else out->print(F(" Force (N): "));
+  printValue(forceN);
+#endif
+}
+
+void TelemetryStream::sample(uint8_t channel, unsigned long timestamp, long raw) {
+  if (!out) return;
+#if TELEMETRY_BINARY
+  uint8_t p[9];
+  p[0] = channel;
+  telemetryPut32(p + 1, timestamp);
+  telemetryPut32(p + 5, (uint32_t)raw);
+  send(TELEMETRY_SAMPLE, p, sizeof(p));
+#else
+  out->print(channel);
+  out->print(',');
+  out->print(timestamp);
+  out->print(',');
+  out->println(raw);
+#endif
+}
+
+void TelemetryStream::steps(uint8_t axis, long position) {
+  if (!out) return;
+#if TELEMETRY_BINARY
+  uint8_t p[5];
+  p[0] = axis;
+  telemetryPut32(p + 1, (uint32_t)position);
+  send(TELEMETRY_STEPS, p, sizeof(p));
+#else
+  printMotor(axis == 0 ? 'F' : 'H');
+  out->print(F(" Steps: "));
+  out->println(position);
+#endif
+}
+
+void TelemetryStream::cycle(unsigned long count) {
+  if (!out) return;
+#if TELEMETRY_BINARY
+  uint8_t p[4];
+  telemetryPut32(p, count);
+  send(TELEMETRY_CYCLE, p, sizeof(p));
+#else
+  out->print(F("Cycle count: "));
+  out->println(count);
+#endif
+}
+
+void TelemetryStream::event(uint8_t event, char motor) {
+  if (!out) return;
+#if TELEMETRY_BINARY
+  uint8_t p[2] = {event, (uint8_t)motor};
+  send(TELEMETRY_EVENT, p, sizeof(p));
+#else
+  switch (event) {
+    case EVENT_CALIBRATING: out->println(F("Calibrating step counts...")); break;
+    case EVENT_MOVING: out->print(F("Moving ")); printMotor(motor); out->println(F(" Motor...")); break;
+    case EVENT_TARGET_REACHED: out->println(F("Target force reached!")); break;
+    case EVENT_RETURNING: out->print(F("Returning ")); printMotor(motor); out->println(F(" Motor...")); break;
+    case EVENT_BACK_AT_START: printMotor(motor); out->println(F(" Motor Back to Start.")); break;
+    case EVENT_CALIBRATION_COMPLETE: out->println(F("Calibration complete.")); break;
+    case EVENT_MOVING_STORED: out->print(F("Moving ")); printMotor(motor); out->println(F(" Motor using stored step count...")); break;
+    case EVENT_TEST_COMPLETE: out->println(F("Test completed. Max cycles reached.")); break;
+    case EVENT_DRIFT_HIGH: printMotor(motor); out->println(F(" peak force drifted high, correcting step count...")); break;
+    case EVENT_DRIFT_LOW: printMotor(motor); out->println(F(" peak force drifted low, correcting step count...")); break;
+    case EVENT_DRIFT_CLEARED: printMotor(motor); out->println(F(" peak force back in band.")); break;
+    case EVENT_DRIFT_SEARCH: printMotor(motor); out->println(F(" peak force still out of band, recalibrating...")); break;
+    case EVENT_APPROACH_FAILED: printMotor(motor); out->println(F(" target force not reached, test halted. Send 'start' to try again.")); break;
+    case EVENT_NO_SAMPLES: printMotor(motor); out->println(F(" load cell not responding, test halted. Send 'start' to try again.")); break;
+    default: out->print(F("Event ")); out->println(event); break;
+  }
+#endif
+}
+
+void TelemetryStream::text(const char *message) {
+  if (!out) return;
+#if TELEMETRY_BINARY
+  uint8_t length = 0;
+  while (message[length] && length < TELEMETRY_MAX_PAYLOAD) length++;
+  send(TELEMETRY_TEXT, (const uint8_t *)message, length);
+#else
+  out->println(message);
+#endif
+}
+
+void TelemetryStream::tracking(uint8_t axis, float maxError, float rmsError) {
+  if (!out) return;
+#if TELEMETRY_BINARY
+  uint8_t p[9];
+  p[0] = axis;
+  telemetryPut32(p + 1, (uint32_t)(long)(maxError + 0.5));
+  telemetryPut32(p + 5, (uint32_t)(long)(rmsError + 0.5));
+  send(TELEMETRY_TRACKING, p, sizeof(p));
+#else
+  printMotor(axis == 0 ? 'F' : 'H');
+  out->print(F(" Tracking Error (microsteps) Max: "));
+  out->print(maxError, 0);
+  out->print(F(" RMS: "));
+  out->println(rmsError, 1);
+#endif
+}
+
+void TelemetryStream::summary(unsigned long cycle, const CycleSummary channels[CYCLE_STATS_CHANNELS]) {
+  if (!out) return;
+#if TELEMETRY_BINARY
+  uint8_t p[4 + 14 * CYCLE_STATS_CHANNELS];
+  telemetryPut32(p, cycle);
+  uint8_t *q = p + 4;
+  for (uint8_t i = 0; i < CYCLE_STATS_CHANNELS; i++) {
+    const CycleSummary &c = channels[i];
+    telemetryPut16(q, (uint16_t)centinewtons(c.peak));
+    telemetryPut16(q + 2, (uint16_t)centinewtons(c.minimum));
+    telemetryPut16(q + 4, (uint16_t)centinewtons(c.mean));
+    telemetryPut16(q + 6, (uint16_t)centinewtons(c.rms));
+    telemetryPut16(q + 8, (c.timeToPeak > 65535) ? 65535 : c.timeToPeak);
+    telemetryPut32(q + 10, (uint32_t)c.stepsAtPeak);
+    q += 14;
+  }
+  send(TELEMETRY_SUMMARY, p, sizeof(p));
+#else
+  for (uint8_t i = 0; i < CYCLE_STATS_CHANNELS; i++) {
+    const CycleSummary &c = channels[i];
+    out->print(F("Cycle "));
+    out->print(cycle);
+    out->print(' ');
+    printMotor(i == 0 ? 'F' : 'H');
+    out->print(F(" Peak: "));
+    out->print(c.peak, 2);
+    out->print(F(" Min: "));
+    out->print(c.minimum, 2);
+    out->print(F(" Mean: "));
+    out->print(c.mean, 2);
+    out->print(F(" RMS: "));
+    out->print(c.rms, 2);
+    out->print(F(" Time to Peak (ms): "));
+    out->print(c.timeToPeak);
+    out->print(F(" Steps at Peak: "));
+    out->println(c.stepsAtPeak);
+  }
+#endif
+}
+
+void TelemetryStream::trace(uint16_t index, const TraceRecord *records, uint8_t count) {
+  if (!out) return;
+  if (count > TELEMETRY_TRACE_RECORDS) count = TELEMETRY_TRACE_RECORDS;
+#if TELEMETRY_BINARY
+  uint8_t p[2 + 4 * TELEMETRY_TRACE_RECORDS];
+  telemetryPut16(p, index);
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t *q = p + 2 + 4 * i;
+    q[0] = records[i].event;
+    q[1] = records[i].data;
+    telemetryPut16(q + 2, records[i].tick);
+  }
+  send(TELEMETRY_TRACE, p, 2 + 4 * count);
+#else
+  if (count == 0) {
+    out->print(F("Trace end "));
+    out->println(index);
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    out->print(F("Trace "));
+    out->print((uint16_t)(index + i));
+    out->print(' ');
+    out->print(records[i].event);
+    out->print(' ');
+    out->print(records[i].data);
+    out->print(' ');
+    out->println(records[i].tick);
+  }
+#endif
+}
+
+void TelemetryStream::parameter(uint8_t id, uint8_t status, long value) {
+  if (!out) return;
+#if TELEMETRY_BINARY
+  uint8_t p[6];
+  p[0] = id;
+  p[1] = status;
+  telemetryPut32(p + 2, (uint32_t)value);
+  send(TELEMETRY_PARAMETER, p, sizeof(p));
+#else
+  out->print(F("Parameter "));
+  out->print(id);
+  out->print(F(" status "));
+  out->print(status);
+  out->print(F(" value "));
+  out->println(value);
+#endif
+}
+
+void TelemetryStream::parameterInfo(uint8_t id, uint8_t decimals, uint8_t flags, long minimum, long maximum, const char *name) {
+  if (!out) return;
+#if TELEMETRY_BINARY
+  uint8_t p[TELEMETRY_MAX_PAYLOAD];
+  p[0] = id;
+  p[1] = decimals;
+  p[2] = flags;
+  telemetryPut32(p + 3, (uint32_t)minimum);
+  telemetryPut32(p + 7, (uint32_t)maximum);
+  uint8_t length = 11;
+  while (*name && length < sizeof(p)) p[length++] = *name++;
+  send(TELEMETRY_PARAMETER_INFO, p, length);
+#else
+  out->print(F("Parameter "));
+  out->print(id);
+  out->print(' ');
+  out->print(name);
+  out->print(F(" decimals "));
+  out->print(decimals);
+  out->print(F(" flags "));
+  out->print(flags);
+  out->print(F(" range "));
+  out->print(minimum);
+  out->print(F(" to "));
+  out->println(maximum);
+#endif
+}
+
+void TelemetryStream::send(uint8_t type, const uint8_t *payload, uint8_t length) {
+  uint8_t frame[TELEMETRY_MAX_ENCODED];
+  size_t n = telemetryBuildFrame(type, sequence++, payload, length, frame);
+  TRACE(TRACE_SERIAL_BEGIN, type);
+  out->write(frame, n);
+  TRACE(TRACE_SERIAL_END, n);
+}
+
+int16_t TelemetryStream::centinewtons(float forceN) {
+  float v = forceN * 100 + (forceN < 0 ? -0.5 : 0.5);
+  if (v > 32767) return 32767;
+  if (v < -32768) return -32768;
+  return (int16_t)v;
+}
+
+void TelemetryStream::printMotor(char motor) {
+  if (motor == 'F') out->print(F("Forefoot"));
+  else if (motor == 'H') out->print(F("Heel"));
+  else if (motor == 'B') out->print(F("Forefoot and Heel"));
+  else out->print(motor);
+}
+
+void TelemetryStream::printValue(float value) {
+  // Number of digits before the decimal point decides how many decimal places give 3 significant figures
+  int digitsBeforeDecimal = (value != 0) ? log10(fabs(value)) : 0;
+  int decimalPlaces = 3 - digitsBeforeDecimal;
+  if (decimalPlaces < 0) decimalPlaces = 0;
+  out->println(value, decimalPlaces);
+}
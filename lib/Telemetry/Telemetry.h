@@ -0,0 +1,51 @@
+/*
+ * Telemetry
+ * Test data output for the GDP03 rig.
+ *
+ * With TELEMETRY_BINARY set (the default) every message is sent as a small
+ * CRC-protected COBS frame (see TelemetryFrame.h) with fixed-point payloads,
+ * which takes a fraction of the serial time of float text. Build with
+ * -D TELEMETRY_BINARY=0 (build_flags in platformio.ini) to get the
+ * human-readable lines for bench debugging with the serial monitor.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include "TelemetryFrame.h"
+#include "CycleStats.h"
+#include "Trace.h"
+
+#ifndef TELEMETRY_BINARY
+#define TELEMETRY_BINARY 1 // 1 = binary frames, 0 = human-readable text
+#endif
+
+class TelemetryStream {
+  public:
+    void begin(Print &out); // Start sending to 'out' (binary mode first sends a resync delimiter)
+    void resync(); // Binary mode: a delimiter, so a frame sent after plain text on the same port is clean
+    void force(uint8_t channel, uint8_t tag, float forceN); // Force in newtons, sent in millinewtons
+    void sample(uint8_t channel, unsigned long timestamp, long raw); // Raw conversion from the sample ring
+    void steps(uint8_t axis, long position); // Axis position in microsteps
+    void cycle(unsigned long count); // Completed test cycles
+    void event(uint8_t event, char motor = 0); // Test sequence event (TelemetryEvent), motor 'F', 'H' or 'B' (both)
+    void text(const char *message); // Free text, sent as a TEXT frame in binary mode
+    void tracking(uint8_t axis, float maxError, float rmsError); // Gait playback position error over a cycle (microsteps)
+    void summary(unsigned long cycle, const CycleSummary channels[CYCLE_STATS_CHANNELS]); // One record per test cycle
+    void trace(uint16_t index, const TraceRecord *records, uint8_t count); // Part of a trace dump, starting at record 'index' (count = 0 ends the dump)
+    void parameter(uint8_t id, uint8_t status, long value); // Answer to a binary command (fixed point value)
+    void parameterInfo(uint8_t id, uint8_t decimals, uint8_t flags, long minimum, long maximum, const char *name); // Answer to COMMAND_DESCRIBE
+
+  private:
+    void send(uint8_t type, const uint8_t *payload, uint8_t length);
+    void printMotor(char motor);
+    void printValue(float value); // Three significant figures
+    static int16_t centinewtons(float forceN); // Force in 10 mN units, saturated to int16
+    Print *out = 0;
+    uint8_t sequence = 0;
+};
+
+extern TelemetryStream Telemetry;
+
+#endif
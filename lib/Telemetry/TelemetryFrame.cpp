@@ -0,0 +1,144 @@
+/*
+ * TelemetryFrame
+ * Binary framing for the GDP03 telemetry stream.
+ * See TelemetryFrame.h for the frame layout.
+ */
+
+#include "TelemetryFrame.h"
+
+uint16_t telemetryCrc16(const uint8_t *data, size_t length, uint16_t crc) {
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t b = 0; b < 8; b++) {
+      if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+      else crc <<= 1;
+    }
+  }
+  return crc;
+}
+
+// Consistent Overhead Byte Stuffing: removes every 0x00 so it can be used as the frame delimiter
+size_t cobsEncode(const uint8_t *data, size_t length, uint8_t *out) {
+  size_t write = 1;
+  size_t codeIndex = 0;
+  uint8_t code = 1;
+  for (size_t i = 0; i < length; i++) {
+    if (data[i] == 0) {
+      out[codeIndex] = code;
+      codeIndex = write++;
+      code = 1;
+    }
+    else {
+      out[write++] = data[i];
+      code++;
+      if (code == 0xFF) {
+        out[codeIndex] = code;
+        codeIndex = write++;
+        code = 1;
+      }
+    }
+  }
+  out[codeIndex] = code;
+  return write;
+}
+
+size_t cobsDecode(const uint8_t *data, size_t length, uint8_t *out) {
+  size_t read = 0;
+  size_t write = 0;
+  while (read < length) {
+    uint8_t code = data[read];
+    if (code == 0 || read + code > length) return 0;
+    read++;
+    for (uint8_t i = 1; i < code; i++) {
+      if (data[read] == 0) return 0;
+      out[write++] = data[read++];
+    }
+    if (code != 0xFF && read != length) out[write++] = 0;
+  }
+  return write;
+}
+
+void telemetryPut16(uint8_t *p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+void telemetryPut32(uint8_t *p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+uint16_t telemetryGet16(const uint8_t *p) {
+  return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+uint32_t telemetryGet32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t telemetryBuildFrame(uint8_t type, uint8_t sequence, const uint8_t *payload, uint8_t length, uint8_t *out) {
+  uint8_t raw[TELEMETRY_MAX_FRAME];
+  if (length > TELEMETRY_MAX_PAYLOAD) length = TELEMETRY_MAX_PAYLOAD;
+  raw[0] = type;
+  raw[1] = sequence;
+  for (uint8_t i = 0; i < length; i++) raw[2 + i] = payload[i];
+  telemetryPut16(raw + 2 + length, telemetryCrc16(raw, 2 + length));
+  size_t n = cobsEncode(raw, 4 + length, out);
+  out[n++] = 0x00;
+  return n;
+}
+
+bool TelemetryDecoder::feed(uint8_t byte) {
+  if (byte != 0x00) {
+    if (received < sizeof(buffer)) buffer[received++] = byte;
+    else overflow = true;
+    return false;
+  }
+  // End of frame
+  uint8_t n = received;
+  bool wasOverflow = overflow;
+  received = 0;
+  overflow = false;
+  if (n == 0) return false; // Back-to-back delimiters are used to resynchronise
+  size_t length = wasOverflow ? 0 : cobsDecode(buffer, n, frame);
+  if (length < 4 || telemetryCrc16(frame, length - 2) != telemetryGet16(frame + length - 2)) {
+    errors++;
+    return false;
+  }
+  frameLength = length - 4;
+  if (haveSequence) lost += (uint8_t)(frame[1] - lastSequence - 1);
+  lastSequence = frame[1];
+  haveSequence = true;
+  frames++;
+  return true;
+}
+
+uint8_t TelemetryDecoder::type() {
+  return frame[0];
+}
+
+uint8_t TelemetryDecoder::sequence() {
+  return frame[1];
+}
+
+const uint8_t *TelemetryDecoder::payload() {
+  return frame + 2;
+}
+
+uint8_t TelemetryDecoder::length() {
+  return frameLength;
+}
+
+unsigned long TelemetryDecoder::getFrameCount() {
+  return frames;
+}
+
+unsigned long TelemetryDecoder::getErrorCount() {
+  return errors;
+}
+
+unsigned long TelemetryDecoder::getLostCount() {
+  return lost;
+}
@@ -0,0 +1,118 @@
+/*
+ * TelemetryFrame
+ * Binary framing for the GDP03 telemetry stream (no Arduino dependencies,
+ * so the same code is used by the firmware and by host-side decoders).
+ *
+ * Frame on the wire:
+ *   COBS( type | sequence | payload... | CRC16 (little endian) ) 0x00
+ * The CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over type,
+ * sequence and payload. All payload fields are little endian, forces are
+ * fixed point in millinewtons. Commands from the host (CommandType, see
+ * lib/Command/Commands.h) use the same framing.
+ */
+
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TELEMETRY_MAX_PAYLOAD 32 // Largest payload in bytes
+#define TELEMETRY_MAX_FRAME (TELEMETRY_MAX_PAYLOAD + 4) // type + sequence + payload + CRC
+#define TELEMETRY_MAX_ENCODED (TELEMETRY_MAX_FRAME + TELEMETRY_MAX_FRAME / 254 + 2) // COBS overhead + delimiter
+
+// Message types
+enum TelemetryType {
+  TELEMETRY_FORCE = 0x01, // channel u8, tag u8, force i32 (mN)
+  TELEMETRY_SAMPLE = 0x02, // channel u8, timestamp u32 (us), raw i32
+  TELEMETRY_STEPS = 0x03, // axis u8, position i32 (microsteps)
+  TELEMETRY_CYCLE = 0x04, // cycle u32
+  TELEMETRY_EVENT = 0x05, // event u8, argument u8
+  TELEMETRY_TEXT = 0x06, // characters, not terminated
+  TELEMETRY_TRACKING = 0x07, // axis u8, max error i32, RMS error i32 (microsteps, per gait cycle)
+  TELEMETRY_SUMMARY = 0x08, // cycle u32, then per channel: peak, min, mean, RMS i16 (10 mN), time to peak u16 (ms), steps at peak i32
+  TELEMETRY_TRACE = 0x09, // index u16, then up to TELEMETRY_TRACE_RECORDS trace records: event u8, data u8, tick u16 (none = end of dump, index = records written)
+  TELEMETRY_PARAMETER = 0x0A, // id u8, status u8 (ParameterStatus), value i32 (fixed point, value in use)
+  TELEMETRY_PARAMETER_INFO = 0x0B // id u8, decimals u8, flags u8, minimum i32, maximum i32, then the name's characters, not terminated
+};
+
+// Commands from the host, answered with TELEMETRY_PARAMETER frames unless noted
+enum CommandType {
+  COMMAND_GET = 0x20, // id u8
+  COMMAND_SET = 0x21, // id u8, value i32 (fixed point)
+  COMMAND_DESCRIBE = 0x22, // id u8: TELEMETRY_PARAMETER_INFO, or TELEMETRY_PARAMETER with PARAMETER_UNKNOWN past the last parameter
+  COMMAND_SAVE = 0x23, // Save all parameters to EEPROM, answered with id COMMAND_ALL
+  COMMAND_START = 0x24, // Start another test once the last one has completed, answered only if refused (id COMMAND_ALL)
+  COMMAND_RAW = 0x25, // Toggle raw sample streaming (as 'r'), no answer
+  COMMAND_TRACE = 0x26 // Dump the event trace (as 'd'), no answer
+};
+
+#define COMMAND_ALL 0xFF // Parameter id of answers to commands that are not about one parameter
+
+#define TELEMETRY_TRACE_RECORDS 7 // Trace records per TELEMETRY_TRACE frame
+
+// Where in the test cycle a force was measured
+enum TelemetryForceTag {
+  FORCE_LIVE = 0, // While searching for the target force
+  FORCE_AFTER_FORWARD = 1, // After the forward stroke
+  FORCE_AFTER_RETURN = 2, // After the return stroke
+  FORCE_DRIFT_PEAK = 3 // Smoothed cycle peak when the drift state changed
+};
+
+// Test sequence events, the argument is the motor ('F', 'H' or 'B' for both) where relevant
+enum TelemetryEvent {
+  EVENT_CALIBRATING = 0,
+  EVENT_MOVING = 1,
+  EVENT_TARGET_REACHED = 2,
+  EVENT_RETURNING = 3,
+  EVENT_BACK_AT_START = 4,
+  EVENT_CALIBRATION_COMPLETE = 5,
+  EVENT_MOVING_STORED = 6,
+  EVENT_TEST_COMPLETE = 7,
+  EVENT_DRIFT_HIGH = 8, // Cycle peak drifted above the band, correcting the step count
+  EVENT_DRIFT_LOW = 9, // Cycle peak drifted below the band, correcting the step count
+  EVENT_DRIFT_CLEARED = 10, // Cycle peak back in band
+  EVENT_DRIFT_SEARCH = 11, // Corrections did not bring the peak back, full step search
+  EVENT_APPROACH_FAILED = 12, // Target force not reached within the travel or time limit, test halted until 'start'
+  EVENT_NO_SAMPLES = 13 // Load cell stopped delivering samples during the step search, test halted until 'start'
+};
+
+uint16_t telemetryCrc16(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF);
+size_t cobsEncode(const uint8_t *data, size_t length, uint8_t *out); // Returns encoded length (no delimiter)
+size_t cobsDecode(const uint8_t *data, size_t length, uint8_t *out); // Returns decoded length, 0 on a malformed frame
+
+// Little endian field helpers
+void telemetryPut16(uint8_t *p, uint16_t v);
+void telemetryPut32(uint8_t *p, uint32_t v);
+uint16_t telemetryGet16(const uint8_t *p);
+uint32_t telemetryGet32(const uint8_t *p);
+
+// Build a complete encoded frame (including the 0x00 delimiter), returns its length
+size_t telemetryBuildFrame(uint8_t type, uint8_t sequence, const uint8_t *payload, uint8_t length, uint8_t *out);
+
+// Streaming decoder: feed received bytes, read the frame when feed() returns true
+class TelemetryDecoder {
+  public:
+    bool feed(uint8_t byte); // Returns true when a valid frame has been received
+    uint8_t type(); // Type of the last valid frame
+    uint8_t sequence(); // Sequence number of the last valid frame
+    const uint8_t *payload(); // Payload of the last valid frame
+    uint8_t length(); // Payload length of the last valid frame
+    unsigned long getFrameCount(); // Valid frames received
+    unsigned long getErrorCount(); // Frames dropped (CRC, COBS or length errors)
+    unsigned long getLostCount(); // Frames missing according to the sequence numbers
+
+  private:
+    uint8_t buffer[TELEMETRY_MAX_ENCODED];
+    uint8_t frame[TELEMETRY_MAX_ENCODED];
+    uint8_t received = 0; // Bytes collected for the current frame
+    bool overflow = false;
+    uint8_t frameLength = 0; // Decoded length of the last valid frame
+    bool haveSequence = false;
+    uint8_t lastSequence = 0;
+    unsigned long frames = 0;
+    unsigned long errors = 0;
+    unsigned long lost = 0;
+};
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * Trace
+ * Event trace of the GDP03 firmware's hot paths.
+ * See Trace.h for usage.
+ */
+
+#include "Trace.h"
+
+#if TRACE_ENABLED
+
+#include <Arduino.h>
+#include <util/atomic.h>
+#ifndef __AVR__
+#include <Hal.h>
+#endif
+
+#define TRACE_MASK (TRACE_RECORDS - 1)
+
+#if (TRACE_RECORDS & TRACE_MASK) != 0
+#error "TRACE_RECORDS must be a power of 2"
+#endif
+
+TraceBuffer Trace;
+
+#ifndef __AVR__
+// Timer5 overflow emulated by the native HAL
+static unsigned long traceWrapTimer(void *) {
+  Trace.record(TRACE_WRAP, 0);
+  return 65536UL * TRACE_TICK_US;
+}
+#endif
+
+void TraceBuffer::begin() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    head = 0;
+    full = false;
+    paused = false;
+#ifdef __AVR__
+    // Timer5: normal mode, prescaler 64 -> 4 us per tick at 16 MHz, overflow every 262 ms
+    TCCR5A = 0;
+    TCCR5B = _BV(CS51) | _BV(CS50);
+    TCNT5 = 0;
+    TIFR5 = _BV(TOV5);
+    TIMSK5 = _BV(TOIE5);
+#else
+    Hal.startTimer(5, 65536UL * TRACE_TICK_US - Hal.now() % (65536UL * TRACE_TICK_US), traceWrapTimer, 0);
+#endif
+  }
+}
+
+uint16_t TraceBuffer::tick() {
+#ifdef __AVR__
+  uint16_t t;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    t = TCNT5; // 16-bit read through the shared TEMP register
+  }
+  return t;
+#else
+  return Hal.now() / TRACE_TICK_US;
+#endif
+}
+
+void TraceBuffer::record(uint8_t event, uint8_t data) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (!paused || event == TRACE_WRAP) { // Wraps are kept while paused, the host needs every one to unwrap the ticks
+      TraceRecord &r = records[head & TRACE_MASK];
+      r.event = event;
+      r.data = data;
+#ifdef __AVR__
+      r.tick = TCNT5;
+#else
+      r.tick = Hal.now() / TRACE_TICK_US;
+#endif
+      head++;
+      if ((head & TRACE_MASK) == 0) full = true;
+    }
+  }
+}
+
+void TraceBuffer::recordSince(uint8_t event, uint16_t start) {
+  uint16_t ticks = tick() - start;
+  record(event, (ticks > 255) ? 255 : ticks);
+}
+
+void TraceBuffer::pause() {
+  paused = true;
+}
+
+void TraceBuffer::resume() {
+  paused = false;
+}
+
+uint16_t TraceBuffer::first() {
+  uint16_t h;
+  bool f;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    h = head;
+    f = full;
+  }
+  return f ? h - TRACE_RECORDS : 0;
+}
+
+uint16_t TraceBuffer::end() {
+  uint16_t h;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    h = head;
+  }
+  return h;
+}
+
+TraceRecord TraceBuffer::get(uint16_t index) {
+  TraceRecord r;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    r = records[index & TRACE_MASK];
+  }
+  return r;
+}
+
+#ifdef __AVR__
+ISR(TIMER5_OVF_vect) {
+  Trace.record(TRACE_WRAP, 0);
+}
+#endif
+
+#endif
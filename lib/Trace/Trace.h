@@ -0,0 +1,91 @@
+/*
+ * Trace
+ * Event trace of the GDP03 firmware's hot paths, to see whether serial
+ * output, load cell sampling or stepping made a test cycle run long.
+ *
+ * Each event is a 4-byte record (event, data, 16-bit tick) written to a
+ * RAM ring of TRACE_RECORDS, from the step engine ISRs (move start, axis
+ * idle), the sampler (each HX711 read), the setup tare, telemetry frames
+ * written to serial and the test cycle boundaries. When the ring is full
+ * the oldest records are overwritten, so it always holds the latest
+ * history. Sending 'd' between cycles dumps it as TELEMETRY_TRACE frames
+ * (see TelemetryFrame.h) and tools/trace2chrome.py turns a capture into a
+ * timeline or a Chrome trace (chrome://tracing, ui.perfetto.dev).
+ *
+ * Ticks come from Timer5 with prescaler 64 (4 us at 16 MHz), free running.
+ * Its overflow writes a TRACE_WRAP record so the host can unwrap the 16-bit
+ * ticks. On the host ([env:native]) the tick is the HAL's virtual clock
+ * and Timer5 is emulated. The benchmarks also use Timer5, so do not enable
+ * tracing in the bench envs.
+ *
+ * Tracing is off unless built with -D TRACE_ENABLED=1. The TRACE macros
+ * then expand to nothing and the ring is not compiled in.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0 // 1 = record trace events (uses TRACE_RECORDS * 4 bytes of RAM and Timer5)
+#endif
+
+#define TRACE_RECORDS 256 // Ring size, must be a power of 2
+#define TRACE_TICK_US 4 // Tick length
+
+// Record types, the data byte is given for each
+enum TraceEvent {
+  TRACE_WRAP = 0, // Tick counter overflowed (0)
+  TRACE_STEP_START = 1, // Axis loaded a move (axis)
+  TRACE_STEP_END = 2, // Axis went idle (axis)
+  TRACE_HX711_READ = 3, // + channel (up to 4): conversion read, written at the end (read time in ticks, 255 = longer)
+  TRACE_TARE_DONE = 7, // Tare finished (channel)
+  TRACE_SERIAL_BEGIN = 8, // Telemetry frame write started, waits while the serial TX buffer is full (frame type)
+  TRACE_SERIAL_END = 9, // Telemetry frame written (frame length)
+  TRACE_CYCLE_BEGIN = 10, // Test cycle started (0)
+  TRACE_CYCLE_END = 11 // Test cycle finished (cycle number, low byte)
+};
+
+struct TraceRecord {
+  uint8_t event;
+  uint8_t data;
+  uint16_t tick;
+};
+
+#if TRACE_ENABLED
+
+class TraceBuffer {
+  public:
+    void begin(); // Clear the ring and start the tick counter
+    void record(uint8_t event, uint8_t data); // Safe from ISRs
+    void recordSince(uint8_t event, uint16_t start); // Record with the ticks since start as data
+    uint16_t tick(); // Current tick
+    void pause(); // Stop recording (except TRACE_WRAP), e.g. while the ring is dumped
+    void resume();
+    uint16_t first(); // Index of the oldest record held
+    uint16_t end(); // Index after the newest record (records written since begin(), modulo 65536)
+    TraceRecord get(uint16_t index); // Record at an index between first() and end()
+
+  private:
+    TraceRecord records[TRACE_RECORDS];
+    volatile uint16_t head = 0; // Index of the next record
+    volatile bool full = false; // The ring has been filled, older records are overwritten
+    volatile bool paused = true;
+};
+
+extern TraceBuffer Trace;
+
+#define TRACE(event, data) Trace.record(event, data)
+#define TRACE_TICK() Trace.tick()
+#define TRACE_SINCE(event, start) Trace.recordSince(event, start)
+
+#else
+
+#define TRACE(event, data) ((void)0)
+#define TRACE_TICK() ((uint16_t)0)
+#define TRACE_SINCE(event, start) ((void)(start))
+
+#endif
+
+#endif
@@ -23,7 +23,23 @@
 
 #include <Arduino.h> // Include the core Arduino functions (digitalWrite, pinMode, etc.)
 #include <HX711_ADC.h> // Include the HX711_ADC library for interfacing with the HX711 load cell amplifier
-#if defined(ESP8266)|| defined(ESP32) || defined(AVR) // Check if the board is ESP8266, ESP32, or AVR-based (Arduino Mega)
+#include <HX711_ADC_Fast.h> // Compile-time pin variant of HX711_ADC using direct port I/O
+#include <HX711_ADC_Group.h> // Shared clock read-out of both HX711s (HX711_SHARED_SCK=1)
+#include <StepEngine.h> // Include the timer-interrupt step pulse generator
+#include <ForceController.h> // Include the closed-loop force controller used to find the target force
+#include <StepSearch.h> // Include the microstep refinement of the calibrated step count
+#include <DriftDetector.h> // Include the peak force drift detection that triggers recalibration
+#include <GaitPlayer.h> // Include the gait profile playback (profiles are stored in flash)
+#include <LoadCellSampler.h> // Include the interrupt-driven load cell acquisition
+#include <LoadCellSetup.h> // Include the non-blocking load cell start-up and calibration dialog
+#include <SampleRing.h> // Include the timestamped sample queue filled by the sampler
+#include <CycleStats.h> // Include the per-cycle force statistics
+#include <Telemetry.h> // Include the binary (or text, TELEMETRY_BINARY=0) test data output
+#include <Trace.h> // Include the hot path event trace (compiled in with TRACE_ENABLED=1)
+#include <Parameters.h> // Include the test parameters that can be changed at run time
+#include <Commands.h> // Include the text and binary command interface for them
+#include <ConfigStore.h> // Include the versioned configuration record kept in EEPROM (calibration, tare, parameters, limits)
+#if defined(ESP8266)|| defined(ESP32) || defined(AVR) || defined(HAL_NATIVE) // Check if the board is ESP8266, ESP32, AVR-based (Arduino Mega) or the native build
 #include <EEPROM.h> // Include the EEPROM library for storing calibration values and settings in non-volatile memory
 #endif // End of conditional compilation for EEPROM inclusion
 
@@ -41,282 +57,624 @@ const int DIR_H = 37; // Direction pin for Heel stepper driver
 const int PUL_H = 36; // Pulse pin for Heel stepper driver
 const int ENA_H = 29; // Enable pin for Heel stepper driver
 const int HX711_dout_H = 6; // HX711 Heel dout pin
-const int HX711_sck_H = 7; // HX711 Heel sck pin
+const int HX711_sck_H = 7; // HX711 Heel sck pin (unused with HX711_SHARED_SCK)
 
-// Microstepping Configuration
-const int microstepSetting = 4; // 1/4 Microstepping
-const int stepsPerRevolution = 200 * microstepSetting; // 800 steps per revolution
-const int stepDelay_fast = 300; // Speed in microseconds 400
-const int stepDelay_slow = 1000; // Speed in microseconds
-
-// EEPROM adress for load cell calibration tare values
-const int calVal_eepromAdress_F = 0; // EEPROM adress for calibration value load cell Forefoot (4 bytes)
-const int calVal_eepromAdress_H = 4; // EEPROM adress for calibration value load cell Heel (4 bytes)
+// Build with -D HX711_SHARED_SCK=1 when both HX711s are clocked from HX711_sck_F, so they are read out together
+#ifndef HX711_SHARED_SCK
+#define HX711_SHARED_SCK 0
+#endif
 
-// HX711 constructor's (dout pin, sck pin)
-HX711_ADC LoadCell_F(HX711_dout_F, HX711_sck_F); //HX711 1
-HX711_ADC LoadCell_H(HX711_dout_H, HX711_sck_H); //HX711 2
-unsigned long t = 0;
-volatile boolean newDataReady;
+// Microstepping Configuration (microstepSetting and stepDelay_fast can be changed at run time, see parameterTable)
+int microstepSetting = 4; // 1/4 Microstepping, as set on the drivers
+int stepsPerRevolution = 200 * microstepSetting; // 800 steps per revolution
+int stepDelay_fast = 300; // Speed in microseconds 400
+
+// Motion profile limits for fast moves, jerk = 0 gives a trapezoidal profile
+const int limitsMicrostepSetting = 4; // Microstepping the limits below are given for, they are scaled to microstepSetting
+const float maxVelocity = 6000; // Cruise speed in microsteps/s
+const float maxAcceleration = 12000; // Microsteps/s^2
+const float maxJerk = 120000; // Microsteps/s^3
+MotionLimits rigLimits = {maxVelocity, maxAcceleration, maxJerk, 0}; // Limits in use, the ones in the configuration store once saved there
+float startVelocity = 1000000.0 / (2 * stepDelay_fast); // Speed the motors can start at without ramping (microsteps/s)
+MotionLimits fastLimits = {maxVelocity, maxAcceleration, maxJerk, startVelocity}; // Updated by applyParameters()
+const long heelLead = 0; // Microsteps the heel starts before the forefoot in a test stroke (negative: forefoot first)
+
+// Calibration values, tare offsets, saved test parameters and motion limits are kept in EEPROM by the configuration
+// store (ConfigStore.h), which migrates the earlier fixed adresses (calibration values at 0 and 4, parameters at 8)
+const uint8_t config_channel_F = 0; // Configuration store channel of load cell Forefoot
+const uint8_t config_channel_H = 1; // Configuration store channel of load cell Heel
+
+#if HX711_SHARED_SCK
+// HX711 group's <sck pin, dout pins...>, one clock run reads both load cells at the same instant
+HX711_ADC_Group<HX711_sck_F, HX711_dout_F, HX711_dout_H> LoadCells;
+HX711_ADC_Base &LoadCell_F = LoadCells[0]; //HX711 1, both use the filter set in config.h
+HX711_ADC_Base &LoadCell_H = LoadCells[1]; //HX711 2
+#else
+// Load cell filters (HX711_ADC_Filter.h): a longer window on the forefoot for stability, a shorter one on the heel for fast response
+typedef HX711_TrimmedAverage<16> Filter_F;
+typedef HX711_TrimmedAverage<8> Filter_H;
+// HX711 constructor's <dout pin, sck pin, filter>, pins are resolved at compile time for direct port access
+HX711_ADC_Fast<HX711_dout_F, HX711_sck_F, Filter_F> LoadCell_F; //HX711 1
+HX711_ADC_Fast<HX711_dout_H, HX711_sck_H, Filter_H> LoadCell_H; //HX711 2
+#endif
+MotionProfile profile_F; // Planned profile for the Forefoot axis
+MotionProfile profile_H; // Planned profile for the Heel axis
+GaitPlayer gait; // Gait profile playback for both axes
+CycleStats cycleStats; // Force statistics of the running test cycle
+DriftDetector drift_F; // Peak force drift on the Forefoot axis
+DriftDetector drift_H; // Peak force drift on the Heel axis
+bool cycleActive = false; // Samples are added to cycleStats while set
+long cycleStart[SAMPLER_CHANNELS]; // Axis positions at the start of the cycle
 
 // g in m/s^2
 const float g = 9.81;
 
-// Test parameters
-const int maxCycles = 1000;
-const int recalibrationInterval = 1001; // Recalculate steps every X cycles
-const float targetForce = 1.5; 
+// Test parameters (can be changed at run time, see parameterTable)
+long maxCycles = 1000;
+float targetForce = 1.5; 
+bool streamRawSamples = false; // Send every raw sample from the sample ring as telemetry, toggled on demand by sending 'r'
+// Sending 'd' between cycles dumps the event trace as telemetry when built with TRACE_ENABLED=1
+bool startRequested = false; // The host sent 'start' at the start prompt or after the last test completed
+bool promptCommand = false; // A command line is being received at the start prompt
+uint8_t testGait = 0; // Gait replayed each test cycle, index into gaitProfiles
+GaitProfile *const gaitProfiles[] = {0, &gaitWalking}; // 0: the fixed-force stroke, 1: walking gait
+const unsigned long gaitUpdateInterval = 5000; // Time between gait playback speed updates (us)
+
+// Closed-loop force control used to find the target force during calibration
+const float controlBand = 0.05; // Stop when the force is within +/- this of the target (N)
+const float controlGain = 2000; // Proportional gain (microsteps/s per N of force error)
+const float controlIntegralGain = 500; // Integral gain (microsteps/s per N.s)
+const float controlFeedforward = 200; // Speed added towards the target (microsteps/s)
+const float controlMinVelocity = 100; // Slowest approach speed outside the band (microsteps/s)
+const float controlHorizon = 0.5; // Time to close the remaining error once the foot stiffness is known (s)
+const float controlMaxRevolutions = 10; // Travel after which the approach gives up, e.g. no foot or load cell (motor revolutions)
+const unsigned long controlTimeout = 30000; // Time after which the approach gives up (ms)
+ForceControlSettings forceControl = {targetForce, controlBand, controlGain, controlIntegralGain, controlFeedforward, controlMinVelocity, startVelocity, controlHorizon, 3};
+
+// Step count refinement after the closed-loop approach
+const float searchTolerance = 0.01; // Stop refining once a force measured at rest is this close to the target (N)
+const int searchSamples = 4; // Raw samples averaged for each force measured at rest
+const unsigned long searchSampleTimeout = 2000; // Longest wait for the samples of a force measured at rest (ms), 4 times the time at 10 SPS
+const long searchBacklash = 200; // Microsteps to back off past a position so it is always approached forwards
+
+// Drift detection on the per-cycle peak force, replacing a fixed recalibration interval
+float driftTolerance = 0.06; // Correct the step count once the smoothed peak is further than this from the target (N)
+const float driftHysteresis = 0.03; // Back in band only within driftTolerance - driftHysteresis (N)
+const float driftSmoothing = 0.3; // Weight of each new cycle peak in the smoothed peak
+uint8_t driftMaxCorrections = 5; // Step count corrections before a full step search
+DriftSettings driftSettings = {targetForce, driftTolerance, driftHysteresis, driftSmoothing, driftMaxCorrections};
+
+// Test parameters that can be set, read and saved over serial without reflashing (Commands.h), values are fixed point:
+// name, variable, type, decimal places, flags, minimum, maximum
+const Parameter parameterTable[] = {
+  {"targetForce", &targetForce, PARAMETER_FLOAT, 3, PARAMETER_RECALIBRATE, 100, 20000}, // 0.1 to 20 N
+  {"maxCycles", &maxCycles, PARAMETER_LONG, 0, 0, 1, 1000000},
+  {"stepDelay_fast", &stepDelay_fast, PARAMETER_INT, 0, 0, 100, 5000}, // us
+  {"microstepSetting", &microstepSetting, PARAMETER_INT, 0, PARAMETER_IDLE, 1, 16}, // Only between tests, the step counts are searched again
+  {"driftTolerance", &driftTolerance, PARAMETER_FLOAT, 3, PARAMETER_RECALIBRATE, 40, 1000}, // Above driftHysteresis (N)
+  {"driftMaxCorrections", &driftMaxCorrections, PARAMETER_BYTE, 0, PARAMETER_RECALIBRATE, 0, 50},
+  {"testGait", &testGait, PARAMETER_BYTE, 0, 0, 0, sizeof(gaitProfiles) / sizeof(gaitProfiles[0]) - 1} // From the next cycle, see gaitProfiles
+};
+
+// Start-up and calibration, ticked from loop() until the test starts
+enum SetupStep {
+  SETUP_CALIBRATE_F = 0, // Forefoot calibration dialog
+  SETUP_CALIBRATE_H = 1, // Heel calibration dialog
+  SETUP_START_PROMPT = 2, // Waiting for the operator to start the test
+  SETUP_COUNTDOWN = 3, // Counting down to the first motion
+  SETUP_FINISHED = 4 // Test running
+};
+const unsigned long stabilizingTime = 2000; // Conversions before the start-up tare (ms), tare precision can be improved by adding a few seconds
+LoadCellSetup setup_F; // Start-up and calibration dialog of the Forefoot load cell
+LoadCellSetup setup_H; // Start-up and calibration dialog of the Heel load cell
+uint8_t setupStep = SETUP_CALIBRATE_F;
+bool loadCellsStarted = false; // Both start-ups (stabilising time and tare) have finished
+bool savedCalibration = false; // Both calibrations were taken from the configuration store without asking
+int countdown = 0; // Seconds left before the test starts
+unsigned long countdownTime = 0; // millis() of the last countdown line
+
+float liveForce[SAMPLER_CHANNELS] = {0}; // Latest force (N) from each load cell's raw samples, unsmoothed
+bool liveForceNew[SAMPLER_CHANNELS] = {false}; // Set when a new raw sample has updated liveForce
 
 //#### DEFINE FUNCTIONS ####
 
-void printFloat3SF(float value) {
-  // If the value is very small or very large, adjust precision accordingly
-  int digitsBeforeDecimal = log10(abs(value));  // Number of digits before the decimal point
-  // Calculate the number of decimal places to print
-  int decimalPlaces = 3 - digitsBeforeDecimal;
-  // Ensure the number is printed with 3 significant figures
-  if (decimalPlaces < 0) {
-    decimalPlaces = 0;  // If the number is too large, print as an integer (no decimal places)
-  }
-  // Print the value with the calculated decimal places
-  Serial.println(value, decimalPlaces);
+// Update the settings derived from the test parameters after a change
+void applyParameters() {
+  float scale = (float)microstepSetting / limitsMicrostepSetting;
+  stepsPerRevolution = 200 * microstepSetting;
+  startVelocity = 1000000.0 / (2 * stepDelay_fast);
+  fastLimits.maxVelocity = rigLimits.maxVelocity * scale;
+  fastLimits.acceleration = rigLimits.acceleration * scale;
+  fastLimits.jerk = rigLimits.jerk * scale;
+  if (startVelocity > fastLimits.maxVelocity) startVelocity = fastLimits.maxVelocity;
+  fastLimits.startVelocity = startVelocity;
+  forceControl.targetForce = targetForce;
+  forceControl.maxVelocity = startVelocity;
+  driftSettings.targetForce = targetForce;
+  driftSettings.tolerance = driftTolerance;
+  driftSettings.maxCorrections = driftMaxCorrections;
 }
 
-float calibrate(HX711_ADC &LoadCell, int calAddr) {
-  Serial.println("Performing automatic calibration...");
-  Serial.println("***");
-  Serial.println("Start calibration:");
-  Serial.println("Place the load cell an a level stable surface.");
-  Serial.println("Remove any load applied to the load cell.");
-  
-  boolean _resume = false;
-  while (_resume == false) {
-    LoadCell.update();
-    if (Serial.available() > 0) {
-      if (Serial.available() > 0) {
-        char inByte = Serial.read();
-        if (inByte == 't') LoadCell.tareNoDelay();
-      }
-    }
-    if (LoadCell.getTareStatus() == true) {
-      Serial.println("Tare complete");
-      _resume = true;
+// Convert a raw conversion to force (N) using the load cell's tare offset and calibration value
+// (integer mN from the fixed point scale, float only for the result)
+float rawToForce(HX711_ADC_Base &LoadCell, long raw) {
+  return labs(LoadCell.toForce_mN(raw)) * 0.001; // always positive
+}
+
+// Drain the timestamped raw samples queued by the sampler ISRs, streaming them as telemetry if enabled
+void drainSamples() {
+  LoadCellSample sample;
+  while (Samples.pop(sample)) {
+    if (streamRawSamples) Telemetry.sample(sample.channel, sample.timestamp, sample.raw);
+    if (sample.channel < SAMPLER_CHANNELS) {
+      liveForce[sample.channel] = rawToForce(sample.channel == 0 ? (HX711_ADC_Base &)LoadCell_F : (HX711_ADC_Base &)LoadCell_H, sample.raw);
+      liveForceNew[sample.channel] = true;
+      if (cycleActive) cycleStats.add(sample.channel, liveForce[sample.channel], sample.timestamp, Steppers.getPosition(sample.channel) - cycleStart[sample.channel]);
     }
   }
+  yield(); // Nothing left to drain (lets the native build skip to the next event, no-op on the Mega)
+}
 
-  Serial.println("Place a mass of know weight on the loadcell, Then send the weight of this mass in grams (i.e. 100.0 [g]) from serial monitor.");
-
-  float known_mass = 0;
-  _resume = false;
-  while (_resume == false) {
-    LoadCell.update();
-    if (Serial.available() > 0) {
-      known_mass = Serial.parseFloat();
-      if (known_mass != 0) {
-        Serial.print("Known mass is: ");
-        Serial.println(known_mass);
-        _resume = true;
-      }
-      else{
-        Serial.println("Invalid mass input. Please enter a valid number.");
-      }
-    }
+// Start collecting force statistics for a test cycle (sampler channel n belongs to axis n)
+void beginCycle() {
+  drainSamples(); // Samples from before the cycle do not count
+  for (int i = 0; i < SAMPLER_CHANNELS; i++) cycleStart[i] = Steppers.getPosition(i);
+  cycleStats.begin(micros());
+  cycleActive = true;
+  TRACE(TRACE_CYCLE_BEGIN, 0);
+}
+
+// Finish a test cycle and send its summary record (replaces the per-move force lines)
+void endCycle(unsigned long cycle, CycleSummary summaries[CYCLE_STATS_CHANNELS]) {
+  TRACE(TRACE_CYCLE_END, cycle);
+  drainSamples();
+  cycleActive = false;
+  for (int i = 0; i < CYCLE_STATS_CHANNELS; i++) summaries[i] = cycleStats.summary(i);
+  Telemetry.summary(cycle, summaries);
+}
+
+#if TRACE_ENABLED
+// Send the trace ring as telemetry, oldest record first. Recording is paused meanwhile so the dump is one snapshot.
+void dumpTrace() {
+  TraceRecord records[TELEMETRY_TRACE_RECORDS];
+  Trace.pause();
+  uint16_t end = Trace.end();
+  uint16_t index = Trace.first();
+  while (index != end) {
+    uint16_t start = index;
+    uint8_t count = 0;
+    while (count < TELEMETRY_TRACE_RECORDS && index != end) records[count++] = Trace.get(index++);
+    Telemetry.trace(start, records, count);
   }
-  LoadCell.refreshDataSet(); //refresh the dataset to be sure that the known mass is measured correct
-  float newCalibrationValue = LoadCell.getNewCalibration(known_mass); //get the new calibration value
-  Serial.print("New calibration value has been set to: ");
-  Serial.print(newCalibrationValue);
-  Serial.print(", use this as calibration value (calFactor) in your project sketch.");
-  Serial.println("Save this value to EEPROM address ");
-  Serial.print(calAddr);
-  Serial.println("? (y: Yes, n: No)");
-  
-  _resume = false;
-  while (_resume == false) {
-    if (Serial.available() > 0) {
-      char inByte = Serial.read();
-      if (inByte == 'y') {
-#if defined(ESP8266)|| defined(ESP32)
-        EEPROM.begin(512);
+  Telemetry.trace(end, records, 0); // End of the dump
+  Trace.resume();
+}
 #endif
-        EEPROM.put(calAddr, newCalibrationValue);
-#if defined(ESP8266)|| defined(ESP32)
-        EEPROM.commit();
+
+// Pass one received byte to the command interface (Commands.h) and act on the request it completes:
+// 'r' toggles raw sample streaming, 'd' dumps the event trace, 'start' begins another test
+void feedCommand(uint8_t byte) {
+  uint8_t request = Commands.feed(byte);
+  if (request == COMMAND_RAW) streamRawSamples = !streamRawSamples;
+#if TRACE_ENABLED
+  if (request == COMMAND_TRACE) dumpTrace();
 #endif
-        EEPROM.get(calAddr, newCalibrationValue);
-        Serial.print("Value ");
-        Serial.print(newCalibrationValue);
-        Serial.print(" saved to EEPROM address: ");
-        Serial.println(calAddr);
-        _resume = true;
-      }
-      else if (inByte == 'n') {
-        Serial.println("Value not saved to EEPROM");
-        _resume = true;
-      }
-      else{
-        Serial.println("Invalid input. Please enter 'y' or 'n'.");
-      }
+  if (request == COMMAND_START) startRequested = true;
+}
+
+// Handle commands sent while a test is running or after it has completed: parameter changes and the requests above
+void checkSerialRequests() {
+  while (Serial.available() > 0) feedCommand(Serial.read());
+  if (Parameters.changed()) applyParameters();
+}
+
+// Return the latest force (N) from a load cell
+float readLoadCell(HX711_ADC_Base &LoadCell) {
+  static float lastForce[SAMPLER_CHANNELS] = {0}; // Latest force from each load cell, returned if there is no new data
+  int8_t channel = Sampler.channelOf(LoadCell); // Sampler channel of this load cell
+  if (channel < 0) return 0;
+  drainSamples();
+  if (Sampler.dataReady(channel)) { // Conversions are read by the sampler ISR
+    lastForce[channel] = labs(Sampler.getForce_mN(channel)) * 0.001; // always positive
+  }
+  return lastForce[channel];
+}
+
+// Map a motor character to its step engine axis, returns -1 if invalid
+int motorAxis(char motor) {
+  if (motor == 'F') return 0;
+  if (motor == 'H') return 1;
+  Serial.println("Invalid motor selection!");
+  return -1;
+}
+
+// Queue a move on the step engine and return immediately (pulses are generated by the timer interrupt)
+bool startMotor(int speedMicroseconds, bool direction, unsigned long microsteps, char motor) {
+  int axis = motorAxis(motor);
+  if (axis < 0) return false;
+  while (!Steppers.queueMove(axis, direction, microsteps, speedMicroseconds)) yield(); // Wait for space in the move queue
+  return true;
+}
+
+// Wait until the motor has finished all queued moves, keeping the load cells converting if the sampler is not running
+void waitMotor(char motor) {
+  int axis = motorAxis(motor);
+  if (axis < 0) return;
+  while (!Steppers.isMoveDone(axis)) {
+    if (!Sampler.isRunning()) {
+      LoadCell_F.update();
+      LoadCell_H.update();
     }
+    drainSamples();
   }
-  Serial.println("End of auto calibration value");
-  Serial.println("***");
-  return(newCalibrationValue);
 }
 
-float manualCalibrationInput(HX711_ADC &LoadCell, int calAddr) {
-  Serial.println("Performing manual calibration...");
-  float oldCalibrationValue;  // Declare a variable to hold the saved calibration value
-  EEPROM.get(calAddr, oldCalibrationValue);  // Retrieve the saved calibration value from EEPROM
-  boolean _resume = false;
-  Serial.println("***");
-  Serial.print("Current value is: ");
-  Serial.println(oldCalibrationValue);
-  Serial.println("Now, send the new value from serial monitor (e.g. 14.4).");
-  float newCalibrationValue;
-  while (_resume == false) {
-    if (Serial.available() > 0) {
-      newCalibrationValue = Serial.parseFloat();
-      if (newCalibrationValue != 0) {
-        Serial.print("New calibration value is: ");
-        Serial.println(newCalibrationValue);
-        _resume = true;
-      }
+// Function to move a stepper by a number of microsteps and wait for the move to finish
+void stepMotor(int speedMicroseconds, bool direction, unsigned long microsteps, char motor) {
+  if (startMotor(speedMicroseconds, direction, microsteps, motor)) waitMotor(motor);
+}
+
+// Function to move a stepper with an accelerate/cruise/decelerate profile and wait for the move to finish
+void profileMotor(bool direction, unsigned long microsteps, char motor) {
+  int axis = motorAxis(motor);
+  if (axis < 0) return;
+  MotionProfile &profile = (axis == 0) ? profile_F : profile_H;
+  waitMotor(motor); // The profile may still be in use by a running move
+  profile.plan(microsteps, fastLimits);
+  while (!Steppers.queueMove(axis, direction, profile)) yield(); // Wait for space in the move queue
+  waitMotor(motor);
+}
+
+// Move both motors together with one accelerate/cruise/decelerate profile and wait for the move to finish.
+// Pulses for both axes come from the same timer, the heel starting heelLead microsteps of the stroke before the forefoot.
+void profileBoth(bool direction, unsigned long microsteps_F, unsigned long microsteps_H) {
+  waitMotor('F'); // The profile may still be in use by a running move
+  waitMotor('H');
+  profile_F.plan(StepEngine::linkedTicks(microsteps_F, microsteps_H, heelLead), fastLimits);
+  while (!Steppers.linkedMove(direction, microsteps_F, direction, microsteps_H, heelLead, profile_F)) yield(); // Wait for both axes to be idle
+  waitMotor('F');
+  waitMotor('H');
+}
+
+// Run an axis continuously in a direction (+1 forward, -1 back) at a speed (microsteps/s), or stop it (0).
+// 'running' holds the direction the axis is currently running in and is updated.
+void runAxis(int axis, int8_t direction, float velocity, int8_t &running) {
+  unsigned int interval = (direction != 0) ? StepEngine::velocityInterval(velocity) : 0; // Half period in us, a slow speed is clamped rather than 0
+  if (direction != running) { // Stop, then restart in the new direction (if any)
+    Steppers.stop(axis);
+    while (!Steppers.isMoveDone(axis)) yield();
+    if (direction != 0) Steppers.queueMove(axis, direction > 0, STEP_CONTINUOUS, interval);
+    running = direction;
+  }
+  else if (direction != 0) {
+    Steppers.setSpeed(axis, interval);
+  }
+}
+
+// Drive a motor forward until the live force settles within controlBand of the target, the microsteps moved are returned
+// through 'moved'. The axis runs continuously and its speed is updated from every new load cell sample, slowing as the
+// force nears the target. Returns false, with the axis stopped and the failure reported, if the force has not settled
+// within controlMaxRevolutions of travel or controlTimeout (no foot, a load cell not converting).
+// The foot stiffness estimated on the way (N per microstep) is returned through 'stiffness' if given.
+bool driveToForce(HX711_ADC_Base &LoadCell, char motor, long &moved, float *stiffness = 0) {
+  int axis = motorAxis(motor);
+  int8_t channel = Sampler.channelOf(LoadCell);
+  moved = 0;
+  if (axis < 0 || channel < 0) return false;
+  waitMotor(motor);
+  long start = Steppers.getPosition(axis);
+  long maxTravel = (long)(controlMaxRevolutions * stepsPerRevolution);
+  unsigned long startTime = millis();
+  ForceController controller;
+  controller.begin(forceControl);
+  int8_t running = 0; // Direction of the running move, 0 = stopped
+  bool settled = true;
+  liveForceNew[channel] = false;
+  while (!controller.isSettled()) {
+    drainSamples();
+    if (labs(Steppers.getPosition(axis) - start) > maxTravel || millis() - startTime > controlTimeout) {
+      settled = false;
+      break;
     }
+    if (!liveForceNew[channel]) continue;
+    liveForceNew[channel] = false;
+    float force = liveForce[channel];
+    Telemetry.force(channel, FORCE_LIVE, force);
+    int8_t direction = controller.update(force, Steppers.getPosition(axis), micros());
+    runAxis(axis, direction, controller.getVelocity(), running);
   }
-  _resume = false;
-  Serial.print("Save this value to EEPROM address ");
-  Serial.print(calAddr);
-  Serial.println("? (y: Yes, n: No)");
-  while (_resume == false) {
-    if (Serial.available() > 0) {
-      char inByte = Serial.read();
-      if (inByte == 'y') {
-#if defined(ESP8266)|| defined(ESP32)
-        EEPROM.begin(512);
-#endif
-        EEPROM.put(calAddr, newCalibrationValue);
-#if defined(ESP8266)|| defined(ESP32)
-        EEPROM.commit();
-#endif
-        EEPROM.get(calAddr, newCalibrationValue);
-        Serial.print("Value ");
-        Serial.print(newCalibrationValue);
-        Serial.print(" saved to EEPROM address: ");
-        Serial.println(calAddr);
-        _resume = true;
-      }
-      else if (inByte == 'n') {
-        Serial.println("Value not saved to EEPROM");
-        _resume = true;
-      }
+  Steppers.stop(axis);
+  waitMotor(motor);
+  moved = Steppers.getPosition(axis) - start;
+  if (!settled) {
+    Telemetry.event(EVENT_APPROACH_FAILED, motor);
+    return false;
+  }
+  if (stiffness) *stiffness = controller.getStiffness();
+  return true;
+}
+
+// Average the next searchSamples raw samples of a load cell into 'force', skipping one that may have started while the axis
+// was moving. Returns false if the load cell has not delivered them within searchSampleTimeout.
+bool settledForce(HX711_ADC_Base &LoadCell, float &force) {
+  int8_t channel = Sampler.channelOf(LoadCell);
+  force = 0;
+  if (channel < 0) return false;
+  unsigned long startTime = millis();
+  float sum = 0;
+  liveForceNew[channel] = false;
+  for (int i = -1; i < searchSamples; i++) {
+    while (!liveForceNew[channel]) {
+      if (millis() - startTime > searchSampleTimeout) return false;
+      drainSamples();
     }
+    liveForceNew[channel] = false;
+    if (i >= 0) sum += liveForce[channel];
   }
-  Serial.println("End of manual calibration value");
-  Serial.println("***");
-  return(newCalibrationValue);
+  force = sum / searchSamples;
+  return true;
 }
 
-float calibrateLoadCell(HX711_ADC &LoadCell, int calAddr) {
-  float calibrationVal = 0;
-  boolean _resume = false;
-  while (_resume == false){
-    if (Serial.available() > 0) {  // Check if user has typed something in Serial Monitor
-      char response = Serial.read();  // Read the response character
-      if (response == 'y') {  // If the user presses 'y', start the regular calibration process
-        float calibrationVal = calibrate(LoadCell, calAddr);
-        return(calibrationVal);
-        _resume = true;
-        }  // Call the calibrate function to begin the calibration process
-      else if (response == 'm') {  // If the user presses 'm', start the manual calibration process
-        float calibrationVal = manualCalibrationInput(LoadCell, calAddr);  // Call the manual calibration function
-        return(calibrationVal);
-        _resume = true; 
-        } 
-      else if (response == 'n') {  // If the user presses 'n', skip calibration
-        Serial.println("Skipping calibration. Using saved tare offset value.");
-        float savedValue;  // Declare a variable to hold the saved calibration value
-        EEPROM.get(calAddr, savedValue);  // Retrieve the saved calibration value from EEPROM
-        if (savedValue == 0) {
-          Serial.println("Warning: Calibration value is invalid or not set. Using default tare offset value.");
-          float calibrationVal = 1.0; // Set a default value or ask the user to calibrate
-          Serial.print("Saved Value: ");
-          Serial.println(calibrationVal);
-          Serial.println("End of calibration value");
-          Serial.println("***");
-          return(calibrationVal);
-          _resume = true;
-        } 
-        else {
-          float calibrationVal = savedValue;
-          Serial.print("Saved Value: ");
-          Serial.println(calibrationVal);
-          Serial.println("End of calibration.");
+// Move a motor to a position (microsteps), backing off first if needed so the position is always approached forwards
+void moveMotorTo(long position, char motor) {
+  int axis = motorAxis(motor);
+  if (axis < 0) return;
+  waitMotor(motor);
+  long delta = position - Steppers.getPosition(axis);
+  if (delta < 0) {
+    stepMotor(stepDelay_fast, LOW, -delta + searchBacklash, motor);
+    delta = searchBacklash;
+  }
+  if (delta > 0) stepMotor(stepDelay_fast, HIGH, delta, motor);
+}
+
+// Find the microsteps from the current (start) position that give the target force: a fast closed-loop approach,
+// then secant/bisection refinement on forces measured at rest. Leaves the motor at the position returned through
+// 'stepCount'. Returns false, with the motor back at the start, if the approach failed or the load cell stopped responding.
+// The measured stiffness (N per microstep) is returned through 'stiffness' if given.
+bool searchStepCount(HX711_ADC_Base &LoadCell, char motor, long &stepCount, float *stiffness = 0) {
+  int axis = motorAxis(motor);
+  int8_t channel = Sampler.channelOf(LoadCell);
+  stepCount = 0;
+  if (axis < 0 || channel < 0) return false;
+  waitMotor(motor);
+  long start = Steppers.getPosition(axis);
+  float approachStiffness = 0;
+  long position = 0;
+  if (!driveToForce(LoadCell, motor, position, &approachStiffness)) { // Coarse approach
+    if (position != 0) stepMotor(stepDelay_fast, position < 0, labs(position), motor);
+    return false;
+  }
+  StepSearch search;
+  search.begin(targetForce, searchTolerance, approachStiffness);
+  while (true) {
+    float force = 0;
+    if (!settledForce(LoadCell, force)) {
+      Telemetry.event(EVENT_NO_SAMPLES, motor);
+      long back = Steppers.getPosition(axis) - start;
+      if (back != 0) stepMotor(stepDelay_fast, back < 0, labs(back), motor);
+      return false;
+    }
+    Telemetry.force(channel, FORCE_LIVE, force);
+    search.addPoint(position, force);
+    if (search.isDone()) break;
+    position = search.nextPosition();
+    moveMotorTo(start + position, motor);
+  }
+  moveMotorTo(start + search.getBest(), motor);
+  if (stiffness) *stiffness = search.getSlope();
+  stepCount = search.getBest();
+  return true;
+}
+
+// Feed a cycle's peak force to an axis's drift detector. Logs why the drift state changed, corrects the step count
+// while the peak is out of band, and returns true when a full step search is needed instead.
+bool checkDrift(DriftDetector &detector, char motor, const CycleSummary &summary, long &stepCount) {
+  int axis = motorAxis(motor);
+  if (axis < 0 || summary.samples == 0) return false;
+  uint8_t state = detector.update(summary.peak);
+  if (detector.changed()) {
+    Telemetry.force(axis, FORCE_DRIFT_PEAK, detector.getSmoothedPeak());
+    Telemetry.event(state == DRIFT_HIGH ? EVENT_DRIFT_HIGH : (state == DRIFT_LOW ? EVENT_DRIFT_LOW : EVENT_DRIFT_CLEARED), motor);
+  }
+  if (detector.needsSearch()) {
+    Telemetry.event(EVENT_DRIFT_SEARCH, motor);
+    return true;
+  }
+  if (state != DRIFT_IN_BAND) {
+    stepCount = detector.correct(stepCount);
+    Telemetry.steps(axis, stepCount);
+  }
+  return false;
+}
+
+// Replay one cycle of a gait profile on both motors at the profile's cadence, strokes in calibrated microsteps.
+// Sends the tracking error of each axis and finishes exactly back at the start positions.
+void playGaitCycle(GaitProfile &profile, long stroke_F, long stroke_H) {
+  waitMotor('F');
+  waitMotor('H');
+  const long stroke[2] = {stroke_F, stroke_H};
+  long start[2] = {Steppers.getPosition(0), Steppers.getPosition(1)};
+  int8_t running[2] = {0, 0};
+  gait.begin(profile, stroke, fastLimits);
+  unsigned long lastUpdate = micros();
+  gait.start(lastUpdate);
+  bool playing = true;
+  while (playing) {
+    drainSamples();
+    if (micros() - lastUpdate < gaitUpdateInterval) continue;
+    lastUpdate = micros();
+    long position[2] = {Steppers.getPosition(0) - start[0], Steppers.getPosition(1) - start[1]};
+    playing = gait.update(lastUpdate, position);
+    for (int axis = 0; axis < 2; axis++) runAxis(axis, gait.getDirection(axis), gait.getVelocity(axis), running[axis]);
+  }
+  for (int axis = 0; axis < 2; axis++) {
+    runAxis(axis, 0, 0, running[axis]);
+    long residual = start[axis] - Steppers.getPosition(axis); // Overshoot while the axes brake, up to a few tens of microsteps when the stroke is more than the limits can follow
+    if (residual != 0) stepMotor(stepDelay_fast, residual > 0, residual > 0 ? residual : -residual, axis == 0 ? 'F' : 'H');
+    Telemetry.tracking(axis, gait.getMaxError(axis), gait.getRmsError(axis));
+  }
+}
+
+// Print the test parameters and start the countdown to the first motion
+void startCountdown() {
+  Serial.println("Starting test...");
+  Serial.println("! CAUTION: ACUTATOR MOTION !");
+  Serial.println("TEST PARAMETERS");
+  Serial.println("---------------");
+  Serial.println("Test Force (N) = "); 
+  Serial.println(targetForce);
+  Serial.println("Number of Test Cycles = "); 
+  Serial.println(maxCycles);
+  Serial.println("Peak Force Drift Tolerance (N) = "); 
+  Serial.println(driftTolerance);
+  Serial.println("---------------");
+  Serial.println("Test commencing in:");
+  countdown = 10;
+  countdownTime = millis();
+  Serial.print(countdown);  // Print the remaining time
+  Serial.println("...");  // Append ellipsis for effect
+}
+
+// Take the next step of the load cell start-up, the calibration dialogs and the start prompt without waiting.
+// Both load cells keep converting while the operator answers. Returns true once the test has started.
+bool updateSetup() {
+  if (setupStep == SETUP_FINISHED) return true;
+  if (Sampler.isRunning()) {
+    drainSamples();
+  }
+  else {
+    setup_F.update();
+    setup_H.update();
+    yield(); // Lets the native build skip to the next event, no-op on the Mega
+  }
+
+  if (!loadCellsStarted && setup_F.isStarted() && setup_H.isStarted()) {
+    loadCellsStarted = true;
+    if (LoadCell_F.getTareTimeoutFlag()) {
+      Serial.println("Timeout, check MCU>HX711 no.1 wiring and pin designations");
+    }
+    if (LoadCell_H.getTareTimeoutFlag()) {
+      Serial.println("Timeout, check MCU>HX711 no.2 wiring and pin designations");
+    }
+    Serial.println("Load Cells Initialised.");
+  }
+
+  switch (setupStep) {
+    case SETUP_CALIBRATE_F:
+      if (!setup_F.isDone()) break;
+      LoadCell_F.setCalFactor(setup_F.getCalFactor());
+      LoadCell_F.setForceScale(g); // Calibrated in grams: g mN per gram
+      Serial.println("Forefoot Load Cell Calibrated.");
+      if (!savedCalibration) {
+        Serial.println("Do you want to recalibrate the Heel load cell? (y: Yes auto (known weight), m: Manual, n: No)");
+        setup_H.ask();
+      }
+      setupStep = SETUP_CALIBRATE_H;
+      break;
+
+    case SETUP_CALIBRATE_H:
+      if (!setup_H.isDone()) break;
+      LoadCell_H.setCalFactor(setup_H.getCalFactor());
+      LoadCell_H.setForceScale(g);
+      Serial.println("Heel Load Cell Calibrated.");
+
+      // Keep the tare offsets so a restart can skip the start-up tare (only written when they have changed)
+      if (!LoadCell_F.getTareTimeoutFlag()) Config.setTareOffset(config_channel_F, LoadCell_F.getTareOffset());
+      if (!LoadCell_H.getTareTimeoutFlag()) Config.setTareOffset(config_channel_H, LoadCell_H.getTareOffset());
+      if (!Config.save()) Serial.println("Warning: Configuration could not be saved to EEPROM.");
+
+      // Ask user to start the test or not
+      Serial.println("Do you want to start the test? (y: Yes, n: No, c: Recalibrate, or a command such as 'set targetForce 2')");
+      promptCommand = false;
+      startRequested = false;
+      setupStep = SETUP_START_PROMPT;
+      break;
+
+    case SETUP_START_PROMPT:
+      while (Serial.available() > 0) {
+        char response = Serial.read(); // Read the user input
+        if (promptCommand || (response != 'y' && response != 'Y' && response != 'c' && response != 'C' && response != 'n' && response != 'N')) {
+          // Anything else is a command line (Commands.h), so test parameters can be set before the first test
+          if (response == '\r' || response == '\n') {
+            if (!promptCommand) continue; // Blank line
+            promptCommand = false;
+          }
+          else if (!promptCommand) {
+            Telemetry.resync(); // The answer follows the dialog text
+            promptCommand = true;
+          }
+          feedCommand(response);
+          if (Parameters.changed()) applyParameters();
+          if (!startRequested) continue;
+          response = 'y'; // 'start' starts the test as 'y' does
+          startRequested = false;
+        }
+        if (response == 'y' || response == 'Y') {
+          // From here on both load cells are read from interrupts, including during motion
+          Sampler.begin();
+          Serial.println("Load Cell Sampling Started.");
+          startCountdown();
+          setupStep = SETUP_COUNTDOWN;
+          break;
+        } else if (response == 'c' || response == 'C') {
+          savedCalibration = false;
+          Serial.println("Do you want to recalibrate the Forefoot load cell? (y: Yes Auto (Using a Known Mass), m: Manual, n: No)");
+          setup_F.ask();
+          setupStep = SETUP_CALIBRATE_F;
+          break;
+        } else if (response == 'n' || response == 'N') {
+          Serial.println("Test aborted.");
           Serial.println("***");
-          return(calibrationVal);
-          _resume = true;
+        // No motor movement, the prompt stays open
         }
-       }
-      else {
-      // If the user enters an invalid input, ask them again
-      Serial.println("Invalid input. Please enter 'y' for regular calibration, 'm' for manual calibration, or 'n' to skip.");
       }
+      break;
+
+    case SETUP_COUNTDOWN:
+      if (millis() - countdownTime < 1000) break;
+      countdownTime += 1000;
+      if (--countdown > 0) {
+        Serial.print(countdown);
+        Serial.println("...");
+        break;
       }
-    }
-   }
-
-float readLoadCell(HX711_ADC &LoadCell) {
-  static boolean newDataReady = 0; // Flag to check if new data is available
-  if (LoadCell.update()) newDataReady = true; // Update load cell and set flag if new data is ready
-  const int serialPrintInterval = 0; // No delay between serial prints (if serial print is used)
-  if (newDataReady) {
-    if (millis() > t + serialPrintInterval) {
-      float i = LoadCell.getData(); // Issue: This declares a local `i` which shadows the static `i`
-      i = abs(i); // always positive
-      newDataReady = 0; // Reset the flag to indicate no new data
-      // Serial.print("Load_cell output val: ");
-      printFloat3SF(i); // Function to print the value of `i`
-      t = millis(); // Update the timing for serial printing
-      return (i / 1000) * g;
-    }
+      Serial.println("Test commenced!");
+      Serial.println("***");
+      Telemetry.resync(); // Test data from here on is sent as telemetry
+      Parameters.setTestRunning(true);
+      setupStep = SETUP_FINISHED;
+      return true;
   }
+  return false;
 }
 
-// Function to move a stepper by one microstep
-void stepMotor(int speedMicroseconds, bool direction, int microsteps, char motor) {
-  int dirPin, pulPin;
-  // Select correct stepper motor
-  if (motor == 'F') {
-      dirPin = DIR_F;
-      pulPin = PUL_F;
-  } else if (motor == 'H') {
-      dirPin = DIR_H;
-      pulPin = PUL_H;
-  } else {
-      Serial.println("Invalid motor selection!");
-      return;
-  }
-  digitalWrite(dirPin, direction); // Set direction
-  // Loop for the correct number of microsteps
-  for (int i = 0; i < microsteps; i++) {
-      digitalWrite(pulPin, HIGH);
-      delayMicroseconds(speedMicroseconds);
-      digitalWrite(pulPin, LOW);
-      delayMicroseconds(speedMicroseconds);
+// Halt between tests until the host sends 'start', parameters can be changed meanwhile
+void waitForStart() {
+  Parameters.setTestRunning(false);
+  startRequested = false;
+  while (!startRequested) {
+    checkSerialRequests();
+    yield();
   }
+  Parameters.setTestRunning(true);
+  Parameters.needsRecalibration(); // The next test searches both step counts anyway
 }
 
 //#### RUN ONCE SETUP ####
 
 void setup() {
   Serial.begin(57600); // Start Serial Monitor for debugging
+  Telemetry.begin(Serial); // Test data, and the answers to commands sent at the start prompt
+#if TRACE_ENABLED
+  Trace.begin(); // Start recording hot path events
+#endif
   Serial.println("Starting...");
   
-  // Set stepper driver pins as OUTPUT's
-  pinMode(DIR_F, OUTPUT);
-  pinMode(PUL_F, OUTPUT);
-  pinMode(DIR_H, OUTPUT);
-  pinMode(PUL_H, OUTPUT);
+  // Set stepper driver pins as OUTPUT's and start the step engine timers
+  Steppers.attach(0, DIR_F, PUL_F);
+  Steppers.attach(1, DIR_H, PUL_H);
+  Steppers.begin();
   pinMode(ENA_F, OUTPUT);
   pinMode(ENA_H, OUTPUT);
 
@@ -326,237 +684,153 @@ void setup() {
 
   Serial.println("Stepper Motors & Drivers Initialised.");
 
-  // initalise load cells
+  // initalise load cells (the 10/80 SPS rate is detected from the conversion times, setSampleRate() would fix it).
+  // No setSmoothingTime(): the live forces come from the raw samples, the library's filter only averages the tare
+  // and the forces reported after calibration, and its fixed SAMPLES count makes a tare at 80 SPS take an eighth of the time.
   LoadCell_F.begin();
   LoadCell_H.begin();
-  unsigned long stabilizingtime = 2000; // tare preciscion can be improved by adding a few seconds of stabilizing time
-  boolean _tare = true; //set this to false if you don't want tare to be performed in the next step
-  byte loadcell_F_rdy = 0;
-  byte loadcell_H_rdy = 0;
-  while ((loadcell_F_rdy + loadcell_H_rdy) < 2) { //run startup, stabilization and tare, both modules simultaniously
-    if (!loadcell_F_rdy) loadcell_F_rdy = LoadCell_F.startMultiple(stabilizingtime, _tare);
-    if (!loadcell_H_rdy) loadcell_H_rdy = LoadCell_H.startMultiple(stabilizingtime, _tare);
-  }
-  if (LoadCell_F.getTareTimeoutFlag()) {
-    Serial.println("Timeout, check MCU>HX711 no.1 wiring and pin designations");
-  }
-  if (LoadCell_H.getTareTimeoutFlag()) {
-    Serial.println("Timeout, check MCU>HX711 no.2 wiring and pin designations");
-  }
-
-  Serial.println("Load Cells Initialised.");
+  Sampler.attach(LoadCell_F, HX711_dout_F); // Channel 0
+  Sampler.attach(LoadCell_H, HX711_dout_H); // Channel 1
+  // Read the configuration saved in EEPROM once, the values saved there replace the defaults above
+  uint8_t configSource = Config.begin();
+  if (Config.getBadSlots()) Serial.println("Warning: A saved configuration failed its check and was ignored.");
+  if (configSource == CONFIG_LOADED) Serial.println("Configuration loaded from EEPROM.");
+  if (configSource == CONFIG_MIGRATED) Serial.println("Configuration migrated from the earlier EEPROM layout.");
+  if (Config.hasLimits()) rigLimits = Config.getLimits();
+  else Config.setLimits(rigLimits); // Saved with the rest
+  Parameters.begin(parameterTable, sizeof(parameterTable) / sizeof(parameterTable[0]));
+  if (Parameters.load()) Serial.println("Test parameters loaded from EEPROM.");
+  applyParameters();
+
+  setup_F.begin(LoadCell_F, Serial, config_channel_F, stabilizingTime); // Stabilising and tare run while the operator answers
+  setup_H.begin(LoadCell_H, Serial, config_channel_H, stabilizingTime);
 
   // //#### LOAD CELL CALIBRATION & START-UP ####
-
+  // The dialogs and the start prompt are answered from loop(), see updateSetup()
+
+  // A valid saved configuration with both load cells calibrated skips the dialogs (and the start-up tares)
+  savedCalibration = configSource == CONFIG_LOADED && Config.isCalibrated(config_channel_F) && Config.isCalibrated(config_channel_H);
+  if (savedCalibration) {
+    setup_F.useSaved();
+    setup_H.useSaved();
+    Serial.println("Using the saved calibration, send 'c' at the start prompt to recalibrate.");
+    return;
+  }
   Serial.println("Do you want to recalibrate the Forefoot load cell? (y: Yes Auto (Using a Known Mass), m: Manual, n: No)");
-
-  float calibrationVal_F = calibrateLoadCell(LoadCell_F, calVal_eepromAdress_F);
-  LoadCell_F.setCalFactor(calibrationVal_F);
-  Serial.println("Forefoot Load Cell Calibrated.");
-
-  Serial.println("Do you want to recalibrate the Heel load cell? (y: Yes auto (known weight), m: Manual, n: No)");
-
-  float calibrationVal_H = calibrateLoadCell(LoadCell_H, calVal_eepromAdress_H);
-  LoadCell_H.setCalFactor(calibrationVal_H);
-  Serial.println("Heel Load Cell Calibrated.");
-
-  // Ask user to start the test or not
-  Serial.println("Do you want to start the test? (y: Yes, n: No)");
-  
-  // Wait for user input (y: Yes, n: No)
-  while (true) {
-    if (Serial.available() > 0) {
-      char response = Serial.read(); // Read the user input
-      if (response == 'y' || response == 'Y') {
-        Serial.println("Starting test...");
-        Serial.println("! CAUTION: ACUTATOR MOTION !");
-        Serial.println("TEST PARAMETERS");
-        Serial.println("---------------");
-        Serial.println("Test Force (N) = "); 
-        Serial.println(targetForce);
-        Serial.println("Number of Test Cycles = "); 
-        Serial.println(maxCycles);
-        Serial.println("Number of Cycles Between Calibration = "); 
-        Serial.println(recalibrationInterval);
-        Serial.println("---------------");
-        Serial.println("Test commencing in:");
-        for (int i = 10; i > 0; i--) {
-          Serial.print(i);  // Print the remaining time
-          Serial.println("...");  // Append ellipsis for effect
-          delay(1000);  // Wait for 1 second
-        }
-        Serial.println("Test commenced!");
-        Serial.println("***");
-        break; // Break the loop and start motor movement
-      } else if (response == 'n' || response == 'N') {
-        Serial.println("Test aborted.");
-        Serial.println("***");
-      // Exit setup, no motor movement
-      } else {
-        // If the input is invalid, ask the user again
-        Serial.println("Invalid input. Please enter 'y' to start or 'n' to abort.");
-        }
-      }
-    }
-
+  setup_F.ask();
 }
 
 //#### INFINITE LOOP ####
 
 void loop() {
-  int stepCount_F = 0;
-  int stepCount_H = 0;
-  int cycleCount = 0;
+  if (!updateSetup()) return; // Start-up, calibration and start prompt until the test starts
 
-  while (cycleCount < maxCycles) {
+  long stepCount_F = 0; // Microsteps from the start position to the target force
+  long stepCount_H = 0;
+  long cycleCount = 0;
+  bool recalibrate_F = true; // Full step search needed before the next cycle (first cycle, or drift not corrected)
+  bool recalibrate_H = true;
 
-      // Determine if recalibration is needed
-      bool recalibrate = (cycleCount == 0 || cycleCount % recalibrationInterval == 0);
+  while (cycleCount < maxCycles) {
 
-      if (recalibrate) {
-          Serial.println("Calibrating step counts...");
+      if (recalibrate_F || recalibrate_H) {
+          Telemetry.event(EVENT_CALIBRATING);
+      }
 
+      if (recalibrate_F) {
           // Forefoot Motor Calibration
-          stepCount_F = 0;
-          Serial.println("Moving Forefoot Motor...");
-          while (true) {
-              float force_F = readLoadCell(LoadCell_F);
-              Serial.print("Forefoot Force (N): ");
-              printFloat3SF(force_F);
-
-              if (force_F >= targetForce) {
-                  Serial.println("Target force reached!");
-                  break;
-              }
-
-              stepMotor(stepDelay_slow, HIGH, stepsPerRevolution, 'F'); // Slow for calibration
-              stepCount_F++;
+          Telemetry.event(EVENT_MOVING, 'F');
+          float stiffness_F = 0;
+          if (!searchStepCount(LoadCell_F, 'F', stepCount_F, &stiffness_F)) { // Closed-loop approach, then microstep refinement
+              waitForStart();
+              return; // loop() starts the next test from cycle 0
           }
+          drift_F.begin(driftSettings, stiffness_F);
+          Telemetry.event(EVENT_TARGET_REACHED);
 
           // Read force after forward movement
           float force_F = readLoadCell(LoadCell_F);
-          Serial.print("Forefoot Force After Forward Move: ");
-          Serial.println(force_F);
+          Telemetry.force(0, FORCE_AFTER_FORWARD, force_F);
 
           delay(200); // Pause before moving back
 
           // Move Forefoot Motor back after calibration (Fast)
-          Serial.println("Returning Forefoot Motor after calibration...");
-          for (int i = 0; i < stepCount_F; i++) {
-              stepMotor(stepDelay_fast, LOW, stepsPerRevolution, 'F');
-          }
+          Telemetry.event(EVENT_RETURNING, 'F');
+          profileMotor(LOW, stepCount_F, 'F');
 
           // Read force after backward movement
           force_F = readLoadCell(LoadCell_F);
-          Serial.print("Forefoot Force After Backward Move: ");
-          Serial.println(force_F);
-
-          Serial.println("Forefoot Motor Back to Start.");
+          Telemetry.force(0, FORCE_AFTER_RETURN, force_F);
 
-          // // Heel Motor Calibration
-          // stepCount_H = 0;
-          // Serial.println("Moving Heel Motor...");
-          // while (true) {
-          //     float force_H = readLoadCell(LoadCell_H);
-          //     Serial.print("Heel Force (N): ");
-          //     Serial.println(force_H);
-
-          //     if (force_H >= targetForce) {
-          //         Serial.println("Target force reached!");
-          //         break;
-          //     }
+          Telemetry.event(EVENT_BACK_AT_START, 'F');
+      }
 
-          //     stepMotor(stepDelay_slow, HIGH, stepsPerRevolution, 'H'); // Slow for calibration
-          //     stepCount_H++;
-          // }
+      if (recalibrate_H) {
+          // Heel Motor Calibration
+          Telemetry.event(EVENT_MOVING, 'H');
+          float stiffness_H = 0;
+          if (!searchStepCount(LoadCell_H, 'H', stepCount_H, &stiffness_H)) { // Closed-loop approach, then microstep refinement
+              waitForStart();
+              return;
+          }
+          drift_H.begin(driftSettings, stiffness_H);
+          Telemetry.event(EVENT_TARGET_REACHED);
 
           // Read force after forward movement
           float force_H = readLoadCell(LoadCell_H);
-          Serial.print("Heel Force After Forward Move: ");
-          Serial.println(force_H);
+          Telemetry.force(1, FORCE_AFTER_FORWARD, force_H);
 
           delay(200); // Pause before moving back
 
           // Move Heel Motor back after calibration (Fast)
-          Serial.println("Returning Heel Motor after calibration...");
-          for (int i = 0; i < stepCount_H; i++) {
-              stepMotor(stepDelay_fast, LOW, stepsPerRevolution, 'H');
-          }
+          Telemetry.event(EVENT_RETURNING, 'H');
+          profileMotor(LOW, stepCount_H, 'H');
 
           // Read force after backward movement
           force_H = readLoadCell(LoadCell_H);
-          Serial.print("Heel Force After Backward Move: ");
-          Serial.println(force_H);
+          Telemetry.force(1, FORCE_AFTER_RETURN, force_H);
 
-          Serial.println("Heel Motor Back to Start.");
-
-          Serial.println("Calibration complete.");
+          Telemetry.event(EVENT_BACK_AT_START, 'H');
       }
 
-      // Move Forefoot Motor using stored step count (Fast)
-      Serial.println("Moving Forefoot Motor using stored step count...");
-      for (int i = 0; i < stepCount_F; i++) {
-          stepMotor(stepDelay_fast, HIGH, stepsPerRevolution, 'F');
+      if (recalibrate_F || recalibrate_H) {
+          Telemetry.steps(0, stepCount_F);
+          Telemetry.steps(1, stepCount_H);
+          Telemetry.event(EVENT_CALIBRATION_COMPLETE);
       }
 
-      // Read force after forward movement
-      float force_F = readLoadCell(LoadCell_F);
-      Serial.print("Forefoot Force After Forward Move: ");
-      Serial.println(force_F);
-
-      delay(200); // Pause before moving back
-
-      // Move back same number of steps for Forefoot Motor (Fast)
-      Serial.println("Returning Forefoot Motor...");
-      for (int i = 0; i < stepCount_F; i++) {
-          stepMotor(stepDelay_fast, LOW, stepsPerRevolution, 'F');
+      checkSerialRequests();
+      if (Parameters.needsRecalibration()) { // Target force or drift settings changed: search both step counts again first
+          recalibrate_F = true;
+          recalibrate_H = true;
+          continue;
+      }
+      beginCycle();
+      if (gaitProfiles[testGait]) {
+          // Replay the gait profile, scaled to the stored step counts
+          playGaitCycle(*gaitProfiles[testGait], stepCount_F, stepCount_H);
+      }
+      else {
+          // Move both motors together using the stored step counts (Fast)
+          profileBoth(HIGH, stepCount_F, stepCount_H);
+          delay(200); // Pause before moving back
+          // Move both motors back the same number of steps (Fast)
+          profileBoth(LOW, stepCount_F, stepCount_H);
       }
 
-      // Read force after backward movement
-      force_F = readLoadCell(LoadCell_F);
-      Serial.print("Forefoot Force After Backward Move: ");
-      Serial.println(force_F);
-
-      Serial.println("Forefoot Motor Back to Start.");
-
-      // // Move Heel Motor using stored step count (Fast)
-      // Serial.println("Moving Heel Motor using stored step count...");
-      // for (int i = 0; i < stepCount_H; i++) {
-      //     stepMotor(stepDelay_fast, HIGH, stepsPerRevolution, 'H');
-      // }
-
-      // // Read force after forward movement
-      // float force_H = readLoadCell(LoadCell_H);
-      // Serial.print("Heel Force After Forward Move: ");
-      // Serial.println(force_H);
-
-      // delay(200); // Pause before moving back
-
-      // // Move back same number of steps for Heel Motor (Fast)
-      // Serial.println("Returning Heel Motor...");
-      // for (int i = 0; i < stepCount_H; i++) {
-      //     stepMotor(stepDelay_fast, LOW, stepsPerRevolution, 'H');
-      // }
-
-      // // Read force after backward movement
-      // force_H = readLoadCell(LoadCell_H);
-      // Serial.print("Heel Force After Backward Move: ");
-      // Serial.println(force_H);
+      // Increment cycle count and send the cycle summary
+      cycleCount++;
+      CycleSummary summaries[CYCLE_STATS_CHANNELS];
+      endCycle(cycleCount, summaries);
 
-      // Serial.println("Heel Motor Back to Start.");
+      // Watch each axis's peak force for drift: correct the step count, or search again if that does not work
+      recalibrate_F = checkDrift(drift_F, 'F', summaries[0], stepCount_F);
+      recalibrate_H = checkDrift(drift_H, 'H', summaries[1], stepCount_H);
 
-      // Increment cycle count
-      cycleCount++;
-      Serial.print("Cycle count: ");
-      Serial.println(cycleCount);
-
-      // Check if the set number of cycles has been reached
-      if (cycleCount >= maxCycles) {
-          Serial.println("Test completed. Max cycles reached: ");
-          Serial.print(maxCycles);
-          Serial.println(" Cycles");
-          Serial.println("***");
-          while (true) {} // Halt execution
-      }
   }
+
+  // The set number of cycles has been reached (or maxCycles was lowered below the cycles done)
+  Telemetry.event(EVENT_TEST_COMPLETE);
+  waitForStart();
+  // loop() starts the next test from cycle 0
 }
\ No newline at end of file
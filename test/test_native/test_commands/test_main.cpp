@@ -0,0 +1,413 @@
+/*
+ * test_commands
+ * The run-time command interface (lib/Command) over the parameter table of
+ * src/main.cpp: set and get of every parameter in text and binary commands,
+ * rejection of out of range values and malformed lines and frames, a
+ * frame and a line split across several reads of the serial port, save to
+ * and load from the EEPROM configuration (ConfigStore), the exact answers
+ * to "list" and COMMAND_DESCRIBE, and parsing that never touches the heap.
+ */
+
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Hal.h>
+#include <Commands.h>
+#include <ConfigStore.h>
+#include <Telemetry.h>
+
+#define CAPTURE_FRAMES 16
+
+// Heap allocations made while 'countAllocations' is set, operator new ends in malloc() too
+static bool countAllocations = false;
+static unsigned long allocations = 0;
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *malloc(size_t size) {
+  if (countAllocations) allocations++;
+  return __libc_malloc(size);
+}
+#endif
+
+// Variables and table as in src/main.cpp
+static float targetForce;
+static long maxCycles;
+static int stepDelay_fast;
+static int microstepSetting;
+static float driftTolerance;
+static uint8_t driftMaxCorrections;
+static uint8_t testGait;
+
+static const Parameter parameterTable[] = {
+  {"targetForce", &targetForce, PARAMETER_FLOAT, 3, PARAMETER_RECALIBRATE, 100, 20000},
+  {"maxCycles", &maxCycles, PARAMETER_LONG, 0, 0, 1, 1000000},
+  {"stepDelay_fast", &stepDelay_fast, PARAMETER_INT, 0, 0, 100, 5000},
+  {"microstepSetting", &microstepSetting, PARAMETER_INT, 0, PARAMETER_IDLE, 1, 16},
+  {"driftTolerance", &driftTolerance, PARAMETER_FLOAT, 3, PARAMETER_RECALIBRATE, 40, 1000},
+  {"driftMaxCorrections", &driftMaxCorrections, PARAMETER_BYTE, 0, PARAMETER_RECALIBRATE, 0, 50},
+  {"testGait", &testGait, PARAMETER_BYTE, 0, 0, 0, 1}
+};
+#define PARAMETER_COUNT (sizeof(parameterTable) / sizeof(parameterTable[0]))
+
+static void setDefaults() {
+  targetForce = 1.5;
+  maxCycles = 1000;
+  stepDelay_fast = 300;
+  microstepSetting = 4;
+  driftTolerance = 0.06;
+  driftMaxCorrections = 5;
+  testGait = 0;
+}
+
+// Decodes the telemetry the command interface sends and keeps the frames
+class FrameCapture : public Print {
+  public:
+    size_t write(uint8_t c) {
+      if (decoder.feed(c) && frames < CAPTURE_FRAMES) {
+        types[frames] = decoder.type();
+        lengths[frames] = decoder.length();
+        memcpy(payloads[frames], decoder.payload(), decoder.length());
+        payloads[frames][decoder.length()] = 0; // Terminates TEXT frames
+        frames++;
+      }
+      return 1;
+    }
+    TelemetryDecoder decoder;
+    uint8_t types[CAPTURE_FRAMES];
+    uint8_t lengths[CAPTURE_FRAMES];
+    uint8_t payloads[CAPTURE_FRAMES][TELEMETRY_MAX_PAYLOAD + 1];
+    uint8_t frames = 0;
+};
+
+static FrameCapture capture;
+
+// Feed bytes to the parser, returns the last request it made (0 if none)
+static uint8_t feed(const uint8_t *data, size_t length) {
+  uint8_t request = 0;
+  for (size_t i = 0; i < length; i++) {
+    uint8_t r = Commands.feed(data[i]);
+    if (r) request = r;
+  }
+  return request;
+}
+
+static uint8_t sendText(const char *text) {
+  return feed((const uint8_t *)text, strlen(text));
+}
+
+// A command frame with its leading delimiter
+static size_t buildCommand(uint8_t type, const uint8_t *payload, uint8_t length, uint8_t *out) {
+  out[0] = 0x00;
+  return 1 + telemetryBuildFrame(type, 0, payload, length, out + 1);
+}
+
+static uint8_t sendCommand(uint8_t type, const uint8_t *payload, uint8_t length) {
+  uint8_t frame[TELEMETRY_MAX_ENCODED + 1];
+  return feed(frame, buildCommand(type, payload, length, frame));
+}
+
+static uint8_t sendSet(uint8_t id, long value) {
+  uint8_t p[5];
+  p[0] = id;
+  telemetryPut32(p + 1, (uint32_t)value);
+  return sendCommand(COMMAND_SET, p, sizeof(p));
+}
+
+// The single TEXT answer sent since the last check
+static void assertText(const char *expected) {
+  TEST_ASSERT_EQUAL(1, capture.frames);
+  TEST_ASSERT_EQUAL(TELEMETRY_TEXT, capture.types[0]);
+  TEST_ASSERT_EQUAL_STRING(expected, (const char *)capture.payloads[0]);
+  capture.frames = 0;
+}
+
+// The single TELEMETRY_PARAMETER answer sent since the last check
+static void assertParameter(uint8_t id, uint8_t status, long value) {
+  TEST_ASSERT_EQUAL(1, capture.frames);
+  TEST_ASSERT_EQUAL(TELEMETRY_PARAMETER, capture.types[0]);
+  TEST_ASSERT_EQUAL(6, capture.lengths[0]);
+  TEST_ASSERT_EQUAL(id, capture.payloads[0][0]);
+  TEST_ASSERT_EQUAL(status, capture.payloads[0][1]);
+  TEST_ASSERT_EQUAL(value, (long)telemetryGet32(capture.payloads[0] + 2));
+  capture.frames = 0;
+}
+
+void setUp() {
+  Hal.reset();
+  memset(EEPROM.data(), 0xFF, HAL_EEPROM_SIZE);
+  Config = ConfigStore();
+  Config.begin();
+  setDefaults();
+  Parameters.begin(parameterTable, PARAMETER_COUNT);
+  Parameters.setTestRunning(false);
+  Commands = CommandParser();
+  Telemetry.begin(capture);
+  capture.frames = 0;
+}
+
+void tearDown() {
+  countAllocations = false;
+}
+
+void test_text_set_and_get_of_each_parameter() {
+  static const char *const sets[PARAMETER_COUNT] = {"2.25", "5000", "450", "8", "0.1", "12", "1"};
+  static const char *const answers[PARAMETER_COUNT] = {"2.250", "5000", "450", "8", "0.100", "12", "1"};
+  char text[COMMAND_LINE_LENGTH + 1];
+  char answer[COMMAND_LINE_LENGTH + 1];
+  for (uint8_t id = 0; id < PARAMETER_COUNT; id++) {
+    const char *name = parameterTable[id].name;
+    snprintf(text, sizeof(text), "set %s %s\n", name, sets[id]);
+    snprintf(answer, sizeof(answer), "%s %s", name, answers[id]);
+    TEST_ASSERT_EQUAL(0, sendText(text));
+    assertText(answer);
+    snprintf(text, sizeof(text), "get %s\r", name);
+    sendText(text);
+    assertText(answer);
+  }
+  TEST_ASSERT_EQUAL_FLOAT(2.25, targetForce);
+  TEST_ASSERT_EQUAL(5000, maxCycles);
+  TEST_ASSERT_EQUAL(450, stepDelay_fast);
+  TEST_ASSERT_EQUAL(8, microstepSetting);
+  TEST_ASSERT_EQUAL_FLOAT(0.1, driftTolerance);
+  TEST_ASSERT_EQUAL(12, driftMaxCorrections);
+  TEST_ASSERT_EQUAL(1, testGait);
+  TEST_ASSERT_TRUE(Parameters.changed());
+  TEST_ASSERT_TRUE(Parameters.needsRecalibration());
+  sendText("set targetForce 1.23456\n"); // Rounded to the parameter's decimals
+  assertText("targetForce 1.235");
+}
+
+void test_binary_set_and_get_of_each_parameter() {
+  for (uint8_t id = 0; id < PARAMETER_COUNT; id++) {
+    long value = parameterTable[id].maximum;
+    sendSet(id, value);
+    assertParameter(id, PARAMETER_OK, value);
+    sendCommand(COMMAND_GET, &id, 1);
+    assertParameter(id, PARAMETER_OK, value);
+    sendSet(id, parameterTable[id].minimum);
+    assertParameter(id, PARAMETER_OK, parameterTable[id].minimum);
+  }
+  TEST_ASSERT_EQUAL_FLOAT(0.1, targetForce);
+  TEST_ASSERT_EQUAL(1, maxCycles);
+  TEST_ASSERT_EQUAL(100, stepDelay_fast);
+  TEST_ASSERT_EQUAL(1, microstepSetting);
+  TEST_ASSERT_EQUAL_FLOAT(0.04, driftTolerance);
+  TEST_ASSERT_EQUAL(0, driftMaxCorrections);
+  TEST_ASSERT_EQUAL(0, testGait);
+}
+
+void test_text_rejects_bad_commands() {
+  static const char *const rejected[][2] = {
+    {"set targetForce 20.001\n", "error range"},
+    {"set targetForce 0.0999\n", "error range"}, // Rounds to 0.100, in range
+    {"set maxCycles 0\n", "error range"},
+    {"set driftMaxCorrections -1\n", "error range"},
+    {"set targetForce abc\n", "error syntax"},
+    {"set targetForce 1.2.3\n", "error syntax"},
+    {"set targetForce -\n", "error syntax"},
+    {"set maxCycles 1e3\n", "error syntax"},
+    {"set maxCycles 99999999999\n", "error syntax"},
+    {"set nothing 1\n", "error unknown"},
+    {"get\n", "error syntax"},
+    {"get maxCycles 5\n", "error syntax"},
+    {"set maxCycles 1 2\n", "error syntax"},
+    {"start now\n", "error syntax"},
+    {"xyzzy\n", "error syntax"},
+    {"set maxCycles 10000000000000000000000000000000000000000\n", "error syntax"} // Longer than COMMAND_LINE_LENGTH
+  };
+  for (uint8_t i = 0; i < sizeof(rejected) / sizeof(rejected[0]); i++) {
+    sendText(rejected[i][0]);
+    if (i == 1) {
+      assertText("targetForce 0.100");
+      continue;
+    }
+    assertText(rejected[i][1]);
+  }
+  TEST_ASSERT_EQUAL_FLOAT(0.1, targetForce);
+  TEST_ASSERT_EQUAL(1000, maxCycles);
+  Parameters.setTestRunning(true);
+  sendText("set microstepSetting 8\n");
+  assertText("error busy");
+  sendText("set microstepSetting 4\n"); // Unchanged, so not refused
+  assertText("microstepSetting 4");
+  TEST_ASSERT_EQUAL(0, sendText("start\n"));
+  assertText("error busy");
+  Parameters.setTestRunning(false);
+  TEST_ASSERT_EQUAL(COMMAND_START, sendText("start\n"));
+  TEST_ASSERT_EQUAL(0, capture.frames);
+  TEST_ASSERT_EQUAL(COMMAND_RAW, sendText("r"));
+  TEST_ASSERT_EQUAL(COMMAND_TRACE, sendText("d"));
+  TEST_ASSERT_EQUAL(0, sendText("\n\r\n")); // Empty lines are ignored
+  TEST_ASSERT_EQUAL(0, capture.frames);
+}
+
+void test_binary_rejects_bad_frames() {
+  sendSet(0, 20001);
+  assertParameter(0, PARAMETER_RANGE, 1500); // The value still in use
+  sendSet(PARAMETER_COUNT, 1);
+  assertParameter(PARAMETER_COUNT, PARAMETER_UNKNOWN, 0);
+  uint8_t id = PARAMETER_COUNT;
+  sendCommand(COMMAND_GET, &id, 1);
+  assertParameter(PARAMETER_COUNT, PARAMETER_UNKNOWN, 0);
+  uint8_t shortSet[4] = {1, 0, 0, 0};
+  sendCommand(COMMAND_SET, shortSet, sizeof(shortSet));
+  assertParameter(COMMAND_ALL, PARAMETER_SYNTAX, COMMAND_SET);
+  sendCommand(COMMAND_GET, 0, 0);
+  assertParameter(COMMAND_ALL, PARAMETER_SYNTAX, COMMAND_GET);
+  sendCommand(0x30, &id, 1);
+  assertParameter(COMMAND_ALL, PARAMETER_SYNTAX, 0x30);
+  Parameters.setTestRunning(true);
+  sendSet(3, 8);
+  assertParameter(3, PARAMETER_BUSY, 4);
+  sendCommand(COMMAND_START, 0, 0);
+  assertParameter(COMMAND_ALL, PARAMETER_BUSY, 0);
+  Parameters.setTestRunning(false);
+  // A frame with a bad CRC or cut short is dropped without an answer, and the next command still works
+  uint8_t frame[TELEMETRY_MAX_ENCODED + 1];
+  uint8_t p[5] = {1, 0x10, 0x27, 0, 0}; // maxCycles 10000
+  size_t length = buildCommand(COMMAND_SET, p, sizeof(p), frame);
+  frame[3] ^= 0x01;
+  TEST_ASSERT_EQUAL(0, feed(frame, length));
+  frame[3] ^= 0x01;
+  feed(frame, length - 3);
+  feed(frame, 1); // The delimiter ends the frame early
+  TEST_ASSERT_EQUAL(0, capture.frames);
+  TEST_ASSERT_EQUAL(1000, maxCycles);
+  TEST_ASSERT_EQUAL(COMMAND_START, sendCommand(COMMAND_START, 0, 0));
+  TEST_ASSERT_EQUAL(COMMAND_RAW, sendCommand(COMMAND_RAW, 0, 0));
+  TEST_ASSERT_EQUAL(COMMAND_TRACE, sendCommand(COMMAND_TRACE, 0, 0));
+  sendText("get maxCycles\n"); // Text again after the frames
+  assertText("maxCycles 1000");
+}
+
+void test_frame_split_across_reads() {
+  uint8_t frame[TELEMETRY_MAX_ENCODED + 1];
+  uint8_t p[5] = {1, 0x10, 0x27, 0, 0}; // maxCycles 10000
+  size_t length = buildCommand(COMMAND_SET, p, sizeof(p), frame);
+  for (size_t split = 1; split < length; split++) { // Every split point, as two reads of the serial buffer
+    maxCycles = 1000;
+    TEST_ASSERT_EQUAL(0, feed(frame, split));
+    TEST_ASSERT_EQUAL(0, capture.frames);
+    feed(frame + split, length - split);
+    assertParameter(1, PARAMETER_OK, 10000);
+  }
+  for (size_t i = 0; i < length; i++) feed(frame + i, 1); // A byte per read
+  assertParameter(1, PARAMETER_OK, 10000);
+  sendText("set maxC");
+  TEST_ASSERT_EQUAL(0, capture.frames);
+  sendText("ycles 777");
+  sendText("\n");
+  assertText("maxCycles 777");
+}
+
+void test_save_then_load() {
+  sendText("set targetForce 3.5\n");
+  sendText("set maxCycles 250000\n");
+  sendText("set driftMaxCorrections 9\n");
+  capture.frames = 0;
+  sendText("save\n");
+  assertText("saved");
+  setDefaults();
+  Config = ConfigStore(); // As at the next boot
+  TEST_ASSERT_EQUAL(CONFIG_LOADED, Config.begin());
+  Parameters.begin(parameterTable, PARAMETER_COUNT);
+  TEST_ASSERT_TRUE(Parameters.load());
+  TEST_ASSERT_EQUAL_FLOAT(3.5, targetForce);
+  TEST_ASSERT_EQUAL(250000, maxCycles);
+  TEST_ASSERT_EQUAL(9, driftMaxCorrections);
+  TEST_ASSERT_EQUAL(300, stepDelay_fast);
+  sendSet(1, 42);
+  capture.frames = 0;
+  sendCommand(COMMAND_SAVE, 0, 0);
+  assertParameter(COMMAND_ALL, PARAMETER_OK, 0);
+  setDefaults();
+  Config = ConfigStore();
+  Config.begin();
+  TEST_ASSERT_TRUE(Parameters.load());
+  TEST_ASSERT_EQUAL(42, maxCycles);
+  TEST_ASSERT_EQUAL_FLOAT(3.5, targetForce);
+}
+
+void test_describe_output() {
+  static const char *const list[PARAMETER_COUNT + 1] = {
+    "targetForce 1.500 0.100 20.000",
+    "maxCycles 1000 1 1000000",
+    "stepDelay_fast 300 100 5000",
+    "microstepSetting 4 1 16",
+    "driftTolerance 0.060 0.040 1.000",
+    "driftMaxCorrections 5 0 50",
+    "testGait 0 0 1",
+    "end"};
+  TEST_ASSERT_EQUAL(0, sendText("list\n"));
+  TEST_ASSERT_EQUAL(PARAMETER_COUNT + 1, capture.frames);
+  for (uint8_t i = 0; i < PARAMETER_COUNT + 1; i++) {
+    TEST_ASSERT_EQUAL(TELEMETRY_TEXT, capture.types[i]);
+    TEST_ASSERT_EQUAL_STRING(list[i], (const char *)capture.payloads[i]);
+  }
+  capture.frames = 0;
+  for (uint8_t id = 0; id <= PARAMETER_COUNT; id++) {
+    sendCommand(COMMAND_DESCRIBE, &id, 1);
+    if (id == PARAMETER_COUNT) {
+      assertParameter(id, PARAMETER_UNKNOWN, 0); // Past the last parameter
+      break;
+    }
+    const Parameter &p = parameterTable[id];
+    uint8_t expected[TELEMETRY_MAX_PAYLOAD];
+    expected[0] = id;
+    expected[1] = p.decimals;
+    expected[2] = p.flags;
+    telemetryPut32(expected + 3, (uint32_t)p.minimum);
+    telemetryPut32(expected + 7, (uint32_t)p.maximum);
+    memcpy(expected + 11, p.name, strlen(p.name));
+    TEST_ASSERT_EQUAL(1, capture.frames);
+    TEST_ASSERT_EQUAL(TELEMETRY_PARAMETER_INFO, capture.types[0]);
+    TEST_ASSERT_EQUAL(11 + strlen(p.name), capture.lengths[0]);
+    TEST_ASSERT_EQUAL_MEMORY(expected, capture.payloads[0], capture.lengths[0]);
+    capture.frames = 0;
+  }
+  static const uint8_t targetForceInfo[] = {0, 3, PARAMETER_RECALIBRATE, 100, 0, 0, 0, 0x20, 0x4E, 0, 0, 't', 'a', 'r', 'g', 'e', 't', 'F', 'o', 'r', 'c', 'e'};
+  uint8_t id = 0;
+  sendCommand(COMMAND_DESCRIBE, &id, 1);
+  TEST_ASSERT_EQUAL(sizeof(targetForceInfo), capture.lengths[0]);
+  TEST_ASSERT_EQUAL_MEMORY(targetForceInfo, capture.payloads[0], sizeof(targetForceInfo));
+}
+
+void test_parsing_does_not_allocate() {
+#ifndef __GLIBC__
+  TEST_IGNORE_MESSAGE("malloc() is only counted with glibc");
+#endif
+  static const char *const lines[] = {"set targetForce 2.5\n", "get maxCycles\n", "set maxCycles abc\n", "list\n", "save\n", "start\n",
+                                      "set maxCycles 10000000000000000000000000000000000000000\n"};
+  uint8_t frame[TELEMETRY_MAX_ENCODED + 1];
+  uint8_t p[5] = {1, 0x10, 0x27, 0, 0};
+  size_t length = buildCommand(COMMAND_SET, p, sizeof(p), frame);
+  countAllocations = true;
+  for (uint8_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) sendText(lines[i]);
+  feed(frame, length);
+  uint8_t id = 0;
+  sendCommand(COMMAND_DESCRIBE, &id, 1);
+  sendCommand(COMMAND_SAVE, 0, 0);
+  countAllocations = false;
+  TEST_ASSERT_EQUAL_UINT32(0, allocations);
+  countAllocations = true; // The counter does see the heap
+  volatile int *probe = new int(1);
+  delete probe;
+  countAllocations = false;
+  TEST_ASSERT_TRUE(allocations > 0);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_text_set_and_get_of_each_parameter);
+  RUN_TEST(test_binary_set_and_get_of_each_parameter);
+  RUN_TEST(test_text_rejects_bad_commands);
+  RUN_TEST(test_binary_rejects_bad_frames);
+  RUN_TEST(test_frame_split_across_reads);
+  RUN_TEST(test_save_then_load);
+  RUN_TEST(test_describe_output);
+  RUN_TEST(test_parsing_does_not_allocate);
+  return UNITY_END();
+}
@@ -0,0 +1,252 @@
+/*
+ * test_config_store
+ * The two-slot configuration record in EEPROM: a save cut short at every
+ * byte of the slot it writes, where begin() must go back to the previous
+ * record (or take the new one if every byte that changed was written), a
+ * bad CRC in either slot, where the other slot is loaded and the bad one
+ * reported, and migration of the earlier layout (calibration floats at 0
+ * and 4, test parameters at 8), which is kept in RAM until the next save
+ * and left in place after it.
+ */
+
+#include <unity.h>
+#include <string.h>
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Hal.h>
+#include <ConfigStore.h>
+
+#define SLOT_A CONFIG_ADDRESS
+#define SLOT_B (CONFIG_ADDRESS + CONFIG_SLOT_SIZE)
+
+static const MotionLimits limits = {1600, 8000, 0, 200};
+
+// A configuration as the sketch saves it, 'generation' making each one different
+static void fill(ConfigStore &store, int generation) {
+  int32_t parameters[4] = {1500 + generation, 60, 2000 + generation, 10};
+  store.setCalFactor(0, 400.5f + generation);
+  store.setCalFactor(1, 410.25f - generation);
+  store.setTareOffset(0, 8000000L + generation);
+  store.setTareOffset(1, -123456L - generation);
+  store.setLimits(limits);
+  store.setParameters(parameters, 4);
+}
+
+static void assertFilled(ConfigStore &store, int generation) {
+  TEST_ASSERT_EQUAL_FLOAT(400.5f + generation, store.getCalFactor(0));
+  TEST_ASSERT_EQUAL_FLOAT(410.25f - generation, store.getCalFactor(1));
+  TEST_ASSERT_EQUAL(8000000L + generation, store.getTareOffset(0));
+  TEST_ASSERT_EQUAL(-123456L - generation, store.getTareOffset(1));
+  TEST_ASSERT_TRUE(store.hasLimits());
+  TEST_ASSERT_EQUAL_MEMORY(&limits, &store.getLimits(), sizeof(limits));
+  TEST_ASSERT_EQUAL(4, store.getParameterCount());
+  TEST_ASSERT_EQUAL(1500 + generation, store.getParameter(0));
+  TEST_ASSERT_EQUAL(2000 + generation, store.getParameter(2));
+}
+
+// Float in the earlier layout, as EEPROM.put() wrote it
+static void putLegacyFloat(int address, float value) {
+  memcpy(EEPROM.data() + address, &value, sizeof(value));
+}
+
+void setUp(void) {
+  Hal.reset();
+  memset(EEPROM.data(), 0xFF, HAL_EEPROM_SIZE);
+}
+
+void tearDown(void) {}
+
+void test_saves_alternate_slots(void) {
+  ConfigStore store;
+  TEST_ASSERT_EQUAL(CONFIG_EMPTY, store.begin());
+  TEST_ASSERT_EQUAL(CONFIG_NO_SLOT, store.getSlot());
+  for (int generation = 1; generation <= 4; generation++) {
+    fill(store, generation);
+    TEST_ASSERT_TRUE(store.save());
+    TEST_ASSERT_EQUAL((generation - 1) % 2, store.getSlot());
+    ConfigStore loaded;
+    TEST_ASSERT_EQUAL(CONFIG_LOADED, loaded.begin());
+    TEST_ASSERT_EQUAL(store.getSlot(), loaded.getSlot());
+    TEST_ASSERT_EQUAL(generation, loaded.getSequence());
+    TEST_ASSERT_EQUAL(0, loaded.getBadSlots());
+    assertFilled(loaded, generation);
+  }
+  // Nothing changed: no write
+  unsigned long before = Hal.now();
+  TEST_ASSERT_TRUE(store.save());
+  TEST_ASSERT_EQUAL(4, store.getSequence());
+  TEST_ASSERT_EQUAL(before, Hal.now());
+}
+
+void test_torn_write_keeps_previous_record(void) {
+  static uint8_t written[HAL_EEPROM_SIZE];
+  static uint8_t previous[HAL_EEPROM_SIZE];
+  ConfigStore store;
+  store.begin();
+  fill(store, 1);
+  TEST_ASSERT_TRUE(store.save()); // Slot A, sequence 1
+  fill(store, 2);
+  TEST_ASSERT_TRUE(store.save()); // Slot B, sequence 2
+  memcpy(previous, EEPROM.data(), HAL_EEPROM_SIZE);
+  fill(store, 3);
+  TEST_ASSERT_TRUE(store.save()); // Slot A, sequence 3
+  memcpy(written, EEPROM.data(), HAL_EEPROM_SIZE);
+  TEST_ASSERT_TRUE(memcmp(previous + SLOT_A, written + SLOT_A, sizeof(ConfigRecord)) != 0);
+
+  uint16_t newRecords = 0;
+  for (size_t cut = 0; cut < sizeof(ConfigRecord); cut++) {
+    // The reset came after the first 'cut' bytes of the record
+    memcpy(EEPROM.data(), previous, HAL_EEPROM_SIZE);
+    memcpy(EEPROM.data() + SLOT_A, written + SLOT_A, cut);
+    bool complete = memcmp(EEPROM.data() + SLOT_A, written + SLOT_A, sizeof(ConfigRecord)) == 0;
+    bool untouched = memcmp(EEPROM.data() + SLOT_A, previous + SLOT_A, sizeof(ConfigRecord)) == 0;
+    ConfigStore loaded;
+    TEST_ASSERT_EQUAL(CONFIG_LOADED, loaded.begin());
+    TEST_ASSERT_EQUAL_MEMORY(previous + SLOT_B, EEPROM.data() + SLOT_B, sizeof(ConfigRecord));
+    if (complete) {
+      newRecords++;
+      TEST_ASSERT_EQUAL(0, loaded.getSlot());
+      TEST_ASSERT_EQUAL(3, loaded.getSequence());
+      assertFilled(loaded, 3);
+      continue;
+    }
+    TEST_ASSERT_EQUAL(1, loaded.getSlot());
+    TEST_ASSERT_EQUAL(2, loaded.getSequence());
+    TEST_ASSERT_EQUAL(untouched ? 0 : 1, loaded.getBadSlots());
+    assertFilled(loaded, 2);
+
+    // The next save writes over the torn slot again, never over the record just loaded
+    fill(loaded, 4);
+    TEST_ASSERT_TRUE(loaded.save());
+    TEST_ASSERT_EQUAL(0, loaded.getSlot());
+    TEST_ASSERT_EQUAL(0, loaded.getBadSlots());
+    TEST_ASSERT_EQUAL_MEMORY(previous + SLOT_B, EEPROM.data() + SLOT_B, sizeof(ConfigRecord));
+    ConfigStore reloaded;
+    TEST_ASSERT_EQUAL(CONFIG_LOADED, reloaded.begin());
+    TEST_ASSERT_EQUAL(3, reloaded.getSequence());
+    assertFilled(reloaded, 4);
+  }
+  // Only cuts after the last byte that changed leave the new record
+  TEST_ASSERT_LESS_THAN(sizeof(ConfigRecord), newRecords);
+}
+
+void test_bad_crc_in_one_slot(void) {
+  static uint8_t saved[HAL_EEPROM_SIZE];
+  ConfigStore store;
+  store.begin();
+  fill(store, 1);
+  TEST_ASSERT_TRUE(store.save()); // Slot A, sequence 1
+  fill(store, 2);
+  TEST_ASSERT_TRUE(store.save()); // Slot B, sequence 2
+  memcpy(saved, EEPROM.data(), HAL_EEPROM_SIZE);
+
+  // One bit flipped in the newer record, at every byte: the older one is loaded
+  for (size_t i = 0; i < sizeof(ConfigRecord); i++) {
+    memcpy(EEPROM.data(), saved, HAL_EEPROM_SIZE);
+    EEPROM.data()[SLOT_B + i] ^= 0x10;
+    ConfigStore loaded;
+    TEST_ASSERT_EQUAL(CONFIG_LOADED, loaded.begin());
+    TEST_ASSERT_EQUAL(0, loaded.getSlot());
+    TEST_ASSERT_EQUAL(1, loaded.getSequence());
+    TEST_ASSERT_EQUAL(2, loaded.getBadSlots());
+    assertFilled(loaded, 1);
+  }
+
+  // In the older record: the newer one is still loaded, the older reported
+  memcpy(EEPROM.data(), saved, HAL_EEPROM_SIZE);
+  EEPROM.data()[SLOT_A + sizeof(ConfigRecord) - 1] ^= 0x01;
+  ConfigStore loaded;
+  TEST_ASSERT_EQUAL(CONFIG_LOADED, loaded.begin());
+  TEST_ASSERT_EQUAL(1, loaded.getSlot());
+  TEST_ASSERT_EQUAL(1, loaded.getBadSlots());
+  assertFilled(loaded, 2);
+
+  // Both bad, nothing in the earlier layout: defaults
+  EEPROM.data()[SLOT_B + 8] ^= 0x01;
+  ConfigStore empty;
+  TEST_ASSERT_EQUAL(CONFIG_EMPTY, empty.begin());
+  TEST_ASSERT_EQUAL(3, empty.getBadSlots());
+  TEST_ASSERT_FALSE(empty.isCalibrated(0));
+  TEST_ASSERT_FALSE(empty.hasParameters());
+}
+
+void test_migrates_earlier_layout(void) {
+  int32_t parameters[3] = {1500, -42, 70000};
+  putLegacyFloat(0, 419.87f);
+  putLegacyFloat(4, -402.5f);
+  EEPROM.data()[8] = 'P';
+  EEPROM.data()[9] = 3;
+  memcpy(EEPROM.data() + 10, parameters, sizeof(parameters));
+  static uint8_t legacy[CONFIG_ADDRESS];
+  memcpy(legacy, EEPROM.data(), CONFIG_ADDRESS);
+
+  ConfigStore store;
+  TEST_ASSERT_EQUAL(CONFIG_MIGRATED, store.begin());
+  TEST_ASSERT_EQUAL(CONFIG_NO_SLOT, store.getSlot());
+  TEST_ASSERT_EQUAL(0, store.getBadSlots());
+  TEST_ASSERT_EQUAL_FLOAT(419.87f, store.getCalFactor(0));
+  TEST_ASSERT_EQUAL_FLOAT(-402.5f, store.getCalFactor(1));
+  TEST_ASSERT_FALSE(store.isTared(0));
+  TEST_ASSERT_FALSE(store.hasLimits());
+  TEST_ASSERT_EQUAL(3, store.getParameterCount());
+  TEST_ASSERT_EQUAL(1500, store.getParameter(0));
+  TEST_ASSERT_EQUAL(-42, store.getParameter(1));
+  TEST_ASSERT_EQUAL(70000, store.getParameter(2));
+  TEST_ASSERT_EQUAL(0, store.getParameter(3));
+  // Not written until saved
+  TEST_ASSERT_EQUAL(0xFF, EEPROM.data()[SLOT_A]);
+  TEST_ASSERT_EQUAL(0xFF, EEPROM.data()[SLOT_B]);
+
+  store.setTareOffset(0, 8388000L);
+  TEST_ASSERT_TRUE(store.save());
+  TEST_ASSERT_EQUAL(0, store.getSlot());
+  TEST_ASSERT_EQUAL_MEMORY(legacy, EEPROM.data(), CONFIG_ADDRESS);
+  ConfigStore loaded;
+  TEST_ASSERT_EQUAL(CONFIG_LOADED, loaded.begin());
+  TEST_ASSERT_EQUAL_FLOAT(419.87f, loaded.getCalFactor(0));
+  TEST_ASSERT_EQUAL_FLOAT(-402.5f, loaded.getCalFactor(1));
+  TEST_ASSERT_EQUAL(8388000L, loaded.getTareOffset(0));
+  TEST_ASSERT_EQUAL(3, loaded.getParameterCount());
+  TEST_ASSERT_EQUAL(70000, loaded.getParameter(2));
+}
+
+void test_migration_skips_unset_values(void) {
+  // Only the Heel calibrated, Forefoot erased (NaN), parameter block not written
+  putLegacyFloat(4, 415.0f);
+  ConfigStore store;
+  TEST_ASSERT_EQUAL(CONFIG_MIGRATED, store.begin());
+  TEST_ASSERT_FALSE(store.isCalibrated(0));
+  TEST_ASSERT_TRUE(store.isCalibrated(1));
+  TEST_ASSERT_FALSE(store.hasParameters());
+
+  // A zero factor, and a parameter block with more values than the record keeps
+  memset(EEPROM.data(), 0xFF, HAL_EEPROM_SIZE);
+  putLegacyFloat(0, 0.0f);
+  EEPROM.data()[8] = 'P';
+  EEPROM.data()[9] = CONFIG_MAX_PARAMETERS + 1;
+  memset(EEPROM.data() + 10, 0, 4 * CONFIG_MAX_PARAMETERS);
+  ConfigStore rejected;
+  TEST_ASSERT_EQUAL(CONFIG_EMPTY, rejected.begin());
+  TEST_ASSERT_FALSE(rejected.isCalibrated(0));
+  TEST_ASSERT_FALSE(rejected.hasParameters());
+
+  // A valid slot wins over the earlier layout
+  putLegacyFloat(0, 419.87f);
+  ConfigStore saved;
+  saved.begin();
+  fill(saved, 1);
+  TEST_ASSERT_TRUE(saved.save());
+  ConfigStore loaded;
+  TEST_ASSERT_EQUAL(CONFIG_LOADED, loaded.begin());
+  assertFilled(loaded, 1);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_saves_alternate_slots);
+  RUN_TEST(test_torn_write_keeps_previous_record);
+  RUN_TEST(test_bad_crc_in_one_slot);
+  RUN_TEST(test_migrates_earlier_layout);
+  RUN_TEST(test_migration_skips_unset_values);
+  return UNITY_END();
+}
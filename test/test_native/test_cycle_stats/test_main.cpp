@@ -0,0 +1,171 @@
+/*
+ * test_cycle_stats
+ * CycleStats against figures computed directly (two-pass, in double) from
+ * the same force samples: peak and minimum, Welford mean and RMS, time to
+ * peak and steps at peak, for a load cycle on each channel and for a long
+ * cycle with a large offset. Plus the size of the summary record the test
+ * loop sends per cycle against the text the original firmware printed per
+ * cycle, which it replaces.
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+#include <CycleStats.h>
+#include <Telemetry.h>
+
+#define CYCLE_START 1000000UL // Cycle start time (us)
+#define SAMPLE_PERIOD 12500 // 80 SPS (us)
+#define MAX_SAMPLES 4000
+
+struct Direct {
+  double peak, minimum, mean, rms;
+  unsigned long timeToPeak; // ms
+  long stepsAtPeak;
+};
+
+static float forces[MAX_SAMPLES];
+static long positions[MAX_SAMPLES];
+static uint32_t randomState;
+
+static float noise() { // Uniform in -1 to 1
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return (randomState & 0xFFFF) / 32768.0 - 1;
+}
+
+// One stroke of 'count' samples: out to 'travel' microsteps and back, force rising to 'peak' over the middle
+static void fillStroke(int count, float peak, long travel, float noiseForce) {
+  for (int i = 0; i < count; i++) {
+    float phase = (float)i / (count - 1); // 0 to 1
+    positions[i] = lround(travel * sin(M_PI * phase));
+    forces[i] = peak * pow(sin(M_PI * phase), 4) + noiseForce * noise();
+  }
+}
+
+static Direct compute(int count) {
+  Direct d = {forces[0], forces[0], 0, 0, 0, positions[0]};
+  double sum = 0;
+  for (int i = 0; i < count; i++) {
+    sum += forces[i];
+    if (forces[i] > d.peak) { // First sample at the peak
+      d.peak = forces[i];
+      d.timeToPeak = (unsigned long)i * SAMPLE_PERIOD / 1000;
+      d.stepsAtPeak = positions[i];
+    }
+    if (forces[i] < d.minimum) d.minimum = forces[i];
+  }
+  d.mean = sum / count;
+  double squares = 0;
+  for (int i = 0; i < count; i++) squares += (double)forces[i] * forces[i];
+  d.rms = sqrt(squares / count);
+  return d;
+}
+
+static void add(CycleStats &stats, uint8_t channel, int count) {
+  for (int i = 0; i < count; i++) stats.add(channel, forces[i], CYCLE_START + (unsigned long)i * SAMPLE_PERIOD, positions[i]);
+}
+
+static void checkSummary(const CycleSummary &s, const Direct &d, int count) {
+  TEST_ASSERT_EQUAL_UINT32(count, s.samples);
+  TEST_ASSERT_EQUAL_FLOAT(d.peak, s.peak);
+  TEST_ASSERT_EQUAL_FLOAT(d.minimum, s.minimum);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5 * fabs(d.rms), d.mean, s.mean);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5 * d.rms, d.rms, s.rms);
+  TEST_ASSERT_EQUAL_UINT32(d.timeToPeak, s.timeToPeak);
+  TEST_ASSERT_EQUAL_INT32(d.stepsAtPeak, s.stepsAtPeak);
+}
+
+// Bytes written, nothing kept
+class ByteCounter : public Print {
+  public:
+    size_t write(uint8_t) {
+      count++;
+      return 1;
+    }
+    size_t count = 0;
+};
+
+void setUp() {
+  randomState = 2463534242UL;
+}
+
+void tearDown() {}
+
+void test_load_cycle_on_both_channels() {
+  CycleStats stats;
+  stats.begin(CYCLE_START);
+  fillStroke(160, 1.5, 1100, 0.01);
+  Direct forefoot = compute(160);
+  add(stats, 0, 160);
+  fillStroke(120, 2.5, 900, 0.02);
+  Direct heel = compute(120);
+  add(stats, 1, 120);
+  stats.add(2, 100, CYCLE_START, 0); // No such channel, ignored
+  checkSummary(stats.summary(0), forefoot, 160);
+  checkSummary(stats.summary(1), heel, 120);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.summary(2).samples);
+}
+
+void test_long_cycle_with_offset() {
+  CycleStats stats;
+  stats.begin(CYCLE_START);
+  fillStroke(MAX_SAMPLES, 0.5, 20000, 0.05);
+  for (int i = 0; i < MAX_SAMPLES; i++) forces[i] += 100; // Small variation on a large mean, where sum of squares in float fails
+  Direct d = compute(MAX_SAMPLES);
+  add(stats, 0, MAX_SAMPLES);
+  checkSummary(stats.summary(0), d, MAX_SAMPLES);
+}
+
+void test_begin_starts_a_new_cycle() {
+  CycleStats stats;
+  stats.begin(CYCLE_START);
+  fillStroke(160, 3, 1100, 0.01);
+  add(stats, 0, 160);
+  add(stats, 1, 160);
+  stats.begin(CYCLE_START);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.summary(0).samples);
+  TEST_ASSERT_EQUAL_FLOAT(0, stats.summary(1).peak);
+  fillStroke(80, 1, 500, 0.01);
+  for (int i = 0; i < 80; i++) forces[i] -= 0.5; // Negative forces: the peak must not stick at 0
+  Direct d = compute(80);
+  add(stats, 0, 80);
+  checkSummary(stats.summary(0), d, 80);
+}
+
+void test_summary_record_is_a_tenth_of_the_cycle_text() {
+  // What the original firmware printed per cycle and axis (the heel's lines were in place but commented out):
+  // the raw reading and the force after each move, and the progress lines, then the cycle count
+  static const char *const cycleText[] = {
+    "Moving Forefoot Motor using stored step count...\r\n", "152.9\r\n", "Forefoot Force After Forward Move: 1.50\r\n",
+    "Returning Forefoot Motor...\r\n", "2.300\r\n", "Forefoot Force After Backward Move: 0.02\r\n", "Forefoot Motor Back to Start.\r\n",
+    "Moving Heel Motor using stored step count...\r\n", "152.9\r\n", "Heel Force After Forward Move: 1.50\r\n",
+    "Returning Heel Motor...\r\n", "2.300\r\n", "Heel Force After Backward Move: 0.02\r\n", "Heel Motor Back to Start.\r\n",
+    "Cycle count: 500\r\n"};
+  size_t textBytes = 0;
+  for (uint8_t i = 0; i < sizeof(cycleText) / sizeof(cycleText[0]); i++) textBytes += strlen(cycleText[i]);
+  CycleStats stats;
+  stats.begin(CYCLE_START);
+  fillStroke(160, 1.5, 1100, 0.01);
+  add(stats, 0, 160);
+  add(stats, 1, 160);
+  CycleSummary summaries[CYCLE_STATS_CHANNELS];
+  for (uint8_t i = 0; i < CYCLE_STATS_CHANNELS; i++) summaries[i] = stats.summary(i);
+  ByteCounter counter;
+  Telemetry.begin(counter);
+  counter.count = 0;
+  Telemetry.summary(500, summaries);
+  TEST_ASSERT_TRUE(counter.count <= TELEMETRY_MAX_ENCODED);
+  TEST_ASSERT_TRUE(10 * counter.count < textBytes);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_load_cycle_on_both_channels);
+  RUN_TEST(test_long_cycle_with_offset);
+  RUN_TEST(test_begin_starts_a_new_cycle);
+  RUN_TEST(test_summary_record_is_a_tenth_of_the_cycle_text);
+  return UNITY_END();
+}
@@ -0,0 +1,204 @@
+/*
+ * test_drift_detector
+ * Peak force drift detection against a creeping foot (lib/RigSim
+ * FootModel). Each cycle drives the forefoot model to the step count and
+ * back at the rig's stroke timing and takes the peak of the forces sampled
+ * at 80 SPS, then feeds it to DriftDetector as checkDrift() in src/main.cpp
+ * does. With a fixed step count the peak must fall and be flagged low once
+ * it has fallen by the tolerance (and not before); with the corrections
+ * applied it must stay near the target until the creep limit without a full
+ * search. A foot that does not creep must never be flagged through the
+ * sampling noise, and a lost foot must end in a full search.
+ */
+
+#include <unity.h>
+#include <math.h>
+#include <DriftDetector.h>
+#include <FootModel.h>
+
+#define STROKE_US 300000UL // Each way, about a profiled move of the calibrated step count
+#define DWELL_US 200000UL // Pause at the step count, as the fixed-force stroke
+#define SAMPLE_US 12500UL // 80 SPS
+
+// src/main.cpp defaults
+static const DriftSettings settings = {1.5, 0.06, 0.03, 0.3, 5};
+
+// Forefoot of rigDefaults without damping, so the cycle peak is the force at rest the step search calibrates to
+static const FootAxisSettings creeping = {400, 0.002, 2e-6, 0, 0.3, 150};
+static const FootAxisSettings stable = {400, 0.002, 2e-6, 0, 0, 0};
+
+static FootModel foot;
+static unsigned long now;
+static uint32_t noiseState;
+
+static void startFoot(const FootAxisSettings &axis) {
+  FootSettings footSettings = {};
+  footSettings.axis[0] = axis;
+  footSettings.axis[1] = stable;
+  foot = FootModel();
+  foot.begin(footSettings);
+  now = 0;
+  noiseState = 2463534242UL;
+  foot.force(0, now);
+}
+
+// Roughly normal, standard deviation 1 (sum of 12 uniforms)
+static float noise() {
+  float sum = -6;
+  for (int i = 0; i < 12; i++) {
+    noiseState ^= noiseState << 13;
+    noiseState ^= noiseState >> 17;
+    noiseState ^= noiseState << 5;
+    sum += (noiseState & 0xFFFF) / 65536.0f;
+  }
+  return sum;
+}
+
+// Move the actuator linearly to 'target' over 'duration', sampling the force, returns the highest sample
+static float moveTo(long target, unsigned long duration, float noiseSd) {
+  long start = foot.getPosition(0);
+  long distance = target - start;
+  float peak = 0;
+  for (unsigned long t = 0; t < duration; t += SAMPLE_US) {
+    now += SAMPLE_US;
+    long wanted = start + (long)((float)distance * (t + SAMPLE_US) / duration);
+    while (foot.getPosition(0) != wanted) foot.step(0, wanted > foot.getPosition(0));
+    float force = foot.force(0, now) + noiseSd * noise();
+    if (force > peak) peak = force;
+  }
+  return peak;
+}
+
+static float cycle(long steps, float noiseSd = 0) {
+  float peak = moveTo(steps, STROKE_US, noiseSd);
+  float dwell = moveTo(steps, DWELL_US, noiseSd);
+  if (dwell > peak) peak = dwell;
+  moveTo(0, STROKE_US, noiseSd);
+  return peak;
+}
+
+// The step count the calibration search would find, and the stiffness there (N per microstep)
+static long calibrate(const FootAxisSettings &axis, float &stiffness) {
+  float c = (-axis.stiffness + sqrt(axis.stiffness * axis.stiffness + 2 * axis.hardening * settings.targetForce)) / axis.hardening;
+  stiffness = axis.stiffness + axis.hardening * c;
+  return axis.contact + (long)(c + 0.5) + (long)(foot.getSet(0) + 0.5);
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_fixed_steps_are_flagged_low() {
+  startFoot(creeping);
+  float stiffness;
+  long steps = calibrate(creeping, stiffness);
+  DriftDetector detector;
+  detector.begin(settings, stiffness);
+  float first = cycle(steps);
+  TEST_ASSERT_FLOAT_WITHIN(0.06, settings.targetForce, first);
+  int flagged = -1;
+  float smoothedDrop = 0;
+  for (int i = 0; i < 1000 && flagged < 0; i++) {
+    float peak = cycle(steps);
+    uint8_t state = detector.update(peak);
+    if (state != DRIFT_IN_BAND) {
+      TEST_ASSERT_EQUAL(DRIFT_LOW, state);
+      TEST_ASSERT_TRUE(detector.changed());
+      flagged = i;
+      smoothedDrop = settings.targetForce - detector.getSmoothedPeak();
+    }
+  }
+  TEST_ASSERT_TRUE_MESSAGE(flagged >= 0, "creep never flagged");
+  // Flagged on the cycle the smoothed peak crossed the tolerance, the foot has crept a stiffness's worth of it
+  TEST_ASSERT_TRUE(smoothedDrop > settings.tolerance);
+  TEST_ASSERT_TRUE(smoothedDrop < settings.tolerance + 0.02);
+  TEST_ASSERT_FLOAT_WITHIN(10, settings.tolerance / stiffness, foot.getSet(0));
+  TEST_ASSERT_TRUE(flagged > 20);
+}
+
+void test_corrections_follow_creep() {
+  startFoot(creeping);
+  float stiffness;
+  long steps = calibrate(creeping, stiffness);
+  long calibrated = steps;
+  DriftDetector detector;
+  detector.begin(settings, stiffness);
+  int corrections = 0;
+  int changes = 0;
+  float lowest = settings.targetForce;
+  float highest = 0;
+  for (int i = 0; i < 1500; i++) {
+    float peak = cycle(steps, 0.005);
+    if (peak < lowest) lowest = peak;
+    if (peak > highest) highest = peak;
+    uint8_t state = detector.update(peak);
+    if (detector.changed()) changes++;
+    TEST_ASSERT_FALSE_MESSAGE(detector.needsSearch(), "full search asked for while creeping");
+    if (state != DRIFT_IN_BAND) {
+      steps = detector.correct(steps);
+      corrections++;
+    }
+  }
+  // The creep limit has been reached and the step count has followed it
+  TEST_ASSERT_FLOAT_WITHIN(0.01, creeping.creepLimit, foot.getSet(0));
+  TEST_ASSERT_INT_WITHIN(settings.tolerance / stiffness, calibrated + (long)creeping.creepLimit, steps);
+  TEST_ASSERT_EQUAL(DRIFT_IN_BAND, detector.getState());
+  // The peak is held within a tolerance and the margin the smoothing needs to notice, by a few corrections per episode
+  TEST_ASSERT_TRUE(lowest > settings.targetForce - 2 * settings.tolerance);
+  TEST_ASSERT_TRUE(highest < settings.targetForce + settings.tolerance);
+  TEST_ASSERT_TRUE(corrections > 0);
+  TEST_ASSERT_TRUE(corrections < 3 * changes);
+}
+
+void test_stable_foot_is_not_flagged() {
+  startFoot(stable);
+  float stiffness;
+  long steps = calibrate(stable, stiffness);
+  DriftDetector detector;
+  detector.begin(settings, stiffness);
+  for (int i = 0; i < 1000; i++) {
+    uint8_t state = detector.update(cycle(steps, 0.02));
+    TEST_ASSERT_EQUAL(DRIFT_IN_BAND, state);
+  }
+  // The highest of the noisy samples at the top of the stroke sits above the force at rest
+  TEST_ASSERT_TRUE(detector.getSmoothedPeak() > settings.targetForce);
+  TEST_ASSERT_TRUE(detector.getSmoothedPeak() < settings.targetForce + settings.tolerance);
+}
+
+void test_lost_foot_needs_search() {
+  startFoot(creeping);
+  float stiffness;
+  long steps = calibrate(creeping, stiffness);
+  long calibrated = steps;
+  DriftDetector detector;
+  detector.begin(settings, stiffness);
+  FootAxisSettings gone = creeping;
+  gone.contact = 100000;
+  startFoot(gone);
+  int cycles = 0;
+  while (!detector.needsSearch()) {
+    TEST_ASSERT_TRUE_MESSAGE(cycles++ < 100, "no full search asked for");
+    if (detector.update(cycle(steps)) != DRIFT_IN_BAND) {
+      TEST_ASSERT_EQUAL(DRIFT_LOW, detector.getState());
+      steps = detector.correct(steps);
+    }
+  }
+  // Each correction is limited by the calibrated stiffness, so the step count grows but stays bounded
+  TEST_ASSERT_TRUE(steps > calibrated);
+  TEST_ASSERT_TRUE(steps < calibrated + settings.maxCorrections * settings.targetForce / (stiffness / 2));
+  TEST_ASSERT_TRUE(cycles <= 1 + 2 * settings.maxCorrections);
+  detector.recalibrated(stiffness);
+  TEST_ASSERT_FALSE(detector.needsSearch());
+  TEST_ASSERT_EQUAL(DRIFT_IN_BAND, detector.getState());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fixed_steps_are_flagged_low);
+  RUN_TEST(test_corrections_follow_creep);
+  RUN_TEST(test_stable_foot_is_not_flagged);
+  RUN_TEST(test_lost_foot_needs_search);
+  return UNITY_END();
+}
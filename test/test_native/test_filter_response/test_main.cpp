@@ -0,0 +1,131 @@
+/*
+ * test_filter_response
+ * Step response of every filter policy in HX711_ADC_Filter.h, the figures
+ * bench/ prints as comments, held to limits: the conversions until the
+ * output is 90% of the way to a step and until it is within one count of
+ * it, for a rising and a falling step at each samples in use. Every policy
+ * must also be within 0.1% of the step after its 'settling' conversions,
+ * which the tare relies on, and must ignore out of range (0) conversions.
+ */
+
+#include <unity.h>
+#include <HX711_ADC_Filter.h>
+
+#define FROM 0x800000L
+#define TO 0x810000L // A step of 65536 counts, as the benchmark
+
+struct Response {
+  int ninety; // Conversions until 90% of the way
+  int settled; // Conversions until within one count
+  long afterSettling; // Distance from the step after 'settling' conversions (counts)
+};
+
+template <class Filter>
+static Response stepResponse(Filter &filter, long from, long to) {
+  Response response = {-1, -1, -1};
+  for (uint16_t n = 0; n < 2 * Filter::settling + 2; n++) filter.add(from);
+  TEST_ASSERT_EQUAL(from, filter.value());
+  long ninety = from + (to - from) * 9 / 10;
+  for (int n = 1; n <= 1000 && (response.settled < 0 || n <= Filter::settling); n++) {
+    filter.add(to);
+    long value = filter.value();
+    bool pastNinety = (to > from) ? value >= ninety : value <= ninety;
+    if (response.ninety < 0 && pastNinety) response.ninety = n;
+    if (response.settled < 0 && value >= to - 1 && value <= to + 1) response.settled = n;
+    if (n == Filter::settling) response.afterSettling = labs(value - to);
+  }
+  TEST_ASSERT_TRUE_MESSAGE(response.settled > 0, "never settled");
+  return response;
+}
+
+// Rising and falling step at a samples in use, the falling one within a conversion of the rising one
+// (the last counts of the IIR's long tail round differently in each direction)
+template <class Filter>
+static Response checkStep(Filter &filter, int samples) {
+  filter.setSamples(samples, FROM);
+  TEST_ASSERT_EQUAL(samples, filter.samples());
+  Response rising = stepResponse(filter, FROM, TO);
+  Response falling = stepResponse(filter, TO, FROM);
+  TEST_ASSERT_INT_WITHIN(1, rising.ninety, falling.ninety);
+  TEST_ASSERT_INT_WITHIN(1 + rising.settled / 50, rising.settled, falling.settled);
+  TEST_ASSERT_TRUE(rising.ninety <= rising.settled);
+  TEST_ASSERT_TRUE(rising.afterSettling <= (TO - FROM) / 1000);
+  TEST_ASSERT_TRUE(falling.afterSettling <= (TO - FROM) / 1000);
+  return rising;
+}
+
+// An out of range conversion in the middle of a steady input leaves the output where it was
+template <class Filter>
+static void checkOutOfRange(Filter &filter) {
+  for (uint16_t n = 0; n < 2 * Filter::settling + 2; n++) filter.add(TO);
+  filter.add(0);
+  TEST_ASSERT_EQUAL(TO, filter.value());
+  filter.add(TO);
+  TEST_ASSERT_EQUAL(TO, filter.value());
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_trimmed_average() {
+  HX711_TrimmedAverage<128> filter;
+  for (int samples = 1; samples <= 128; samples <<= 1) {
+    Response response = checkStep(filter, samples);
+    // The window plus the ignored highest sample, never quicker than most of the window
+    TEST_ASSERT_TRUE(response.settled <= samples + 1);
+    TEST_ASSERT_TRUE(response.ninety <= samples + 1);
+    TEST_ASSERT_TRUE(response.ninety >= samples * 9 / 10);
+  }
+  checkOutOfRange(filter);
+}
+
+void test_trimmed_average_without_ignored_samples() {
+  HX711_TrimmedAverage<16, 0, 0> filter;
+  for (int samples = 1; samples <= 16; samples <<= 1) {
+    Response response = checkStep(filter, samples);
+    TEST_ASSERT_EQUAL(samples, response.settled);
+    TEST_ASSERT_EQUAL((samples * 9 + 9) / 10, response.ninety);
+  }
+  checkOutOfRange(filter);
+}
+
+void test_median() {
+  HX711_Median<63> filter;
+  for (int samples = 1; samples <= 63; samples += 2) {
+    Response response = checkStep(filter, samples);
+    // A step is followed all at once, when it holds the majority of the window
+    TEST_ASSERT_EQUAL(samples / 2 + 1, response.ninety);
+    TEST_ASSERT_EQUAL(samples / 2 + 1, response.settled);
+  }
+  checkOutOfRange(filter);
+}
+
+void test_iir() {
+  HX711_IIR<5> filter;
+  for (int samples = 1; samples <= 32; samples <<= 1) {
+    Response response = checkStep(filter, samples);
+    // e^-n/tau of the step is left after n conversions, tau = samples: 90% after ln(10) tau
+    TEST_ASSERT_INT_WITHIN(1, (int)(2.3026 * samples), response.ninety);
+    TEST_ASSERT_TRUE(response.settled <= (int)(11.1 * samples) + 1); // ln(65536) tau
+  }
+  checkOutOfRange(filter);
+}
+
+void test_passthrough() {
+  HX711_Passthrough filter;
+  Response response = checkStep(filter, 1);
+  TEST_ASSERT_EQUAL(1, response.ninety);
+  TEST_ASSERT_EQUAL(1, response.settled);
+  checkOutOfRange(filter);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_trimmed_average);
+  RUN_TEST(test_trimmed_average_without_ignored_samples);
+  RUN_TEST(test_median);
+  RUN_TEST(test_iir);
+  RUN_TEST(test_passthrough);
+  return UNITY_END();
+}
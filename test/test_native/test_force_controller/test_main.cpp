@@ -0,0 +1,184 @@
+/*
+ * test_force_controller
+ * Closed-loop approach to the target force against the simulated spring
+ * foot (lib/RigSim FootModel): ForceController runs a StepEngine axis on
+ * the HAL timers, as driveToForce() in src/main.cpp, and is fed the foot's
+ * force at the HX711 sample rate. It must settle in band with a small
+ * overshoot for soft and stiff feet at 10 and 80 SPS, an order of magnitude
+ * below that of the earlier search that read the force after every
+ * revolution (which never ends in band) even with a fresh sample each
+ * time, and in an order of magnitude less time than that search took in
+ * the firmware, where readLoadCell() added one conversion per revolution
+ * to the 16 + 2 sample trimmed average, so the average lagged the foot by
+ * several revolutions.
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <StepEngine.h>
+#include <ForceController.h>
+#include <FootModel.h>
+#include <HX711_ADC_Filter.h>
+
+#define DIR_PIN 22
+#define PUL_PIN 23
+#define REVOLUTION 800 // Microsteps per revolution at 1/4 microstepping
+#define SLOW_INTERVAL 1000 // stepDelay_slow of the earlier search, since removed (us)
+#define APPROACH_TIME_LIMIT 2500000UL // Contact and about 1000 microsteps of travel in all cases below (us)
+
+// Settings of src/main.cpp at its default stepDelay_fast of 300 us
+static const ForceControlSettings control = {1.5, 0.05, 2000, 500, 200, 100, 1000000.0 / (2 * 300), 0.5, 3};
+
+static FootModel foot;
+static bool sampleNew;
+static float sampleForce;
+
+static void footStep(uint8_t pin, uint8_t level, void *) {
+  if (pin == PUL_PIN && level == HIGH) foot.step(0, Hal.getLevel(DIR_PIN) == HIGH);
+}
+
+static unsigned long footSample(void *period) {
+  sampleForce = foot.force(0, Hal.now());
+  sampleNew = true;
+  return (unsigned long)(uintptr_t)period;
+}
+
+// Foot on axis 0, its load cell sampled at 'rate' SPS
+static void startFoot(long contact, float stiffness, float hardening, uint8_t rate) {
+  FootSettings settings = {};
+  settings.axis[0] = {contact, stiffness, hardening, 2e-5, 0, 0};
+  foot = FootModel();
+  foot.begin(settings);
+  Hal.addPinHook(footStep, 0);
+  Hal.startTimer(Hal.addDeviceTimer(), 1000, footSample, (void *)(uintptr_t)(1000000UL / rate));
+}
+
+static float nextSample() {
+  unsigned long deadline = Hal.now() + 1000000UL;
+  sampleNew = false;
+  while (!sampleNew) {
+    TEST_ASSERT_TRUE_MESSAGE((long)(Hal.now() - deadline) < 0, "no sample within 1 s");
+    yield();
+  }
+  return sampleForce;
+}
+
+struct Approach {
+  unsigned long time; // us
+  float peak; // N
+  float final; // N, at rest
+};
+
+// driveToForce(): the axis runs continuously, its speed set from every sample until settled
+static Approach closedLoop() {
+  Approach result;
+  unsigned long start = Hal.now();
+  ForceController controller;
+  controller.begin(control);
+  int8_t running = 0;
+  while (!controller.isSettled()) {
+    TEST_ASSERT_TRUE_MESSAGE(Hal.now() - start < 30000000UL, "not settled within 30 s");
+    float force = nextSample();
+    int8_t direction = controller.update(force, Steppers.getPosition(0), Hal.now());
+    unsigned int interval = (direction != 0) ? StepEngine::velocityInterval(controller.getVelocity()) : 0;
+    if (direction != running) {
+      Steppers.stop(0);
+      while (!Steppers.isMoveDone(0)) yield();
+      if (direction != 0) Steppers.queueMove(0, direction > 0, STEP_CONTINUOUS, interval);
+      running = direction;
+    }
+    else if (direction != 0) {
+      Steppers.setSpeed(0, interval);
+    }
+  }
+  Steppers.stop(0);
+  while (!Steppers.isMoveDone(0)) yield();
+  result.time = Hal.now() - start;
+  result.peak = controller.getPeakForce();
+  nextSample();
+  result.final = nextSample();
+  return result;
+}
+
+// The earlier calibration: a revolution at the slow speed, then a force reading, until the target is passed.
+// 'smoothed': the reading as the firmware took it, one conversion (in mN, tared to mid-scale) added to the
+// default HX711_ADC filter per revolution and its output compared, otherwise the foot's force at that sample.
+static Approach perRevolution(bool smoothed) {
+  Approach result = {0, 0, 0};
+  HX711_TrimmedAverage<16, 1, 1> average;
+  average.setSamples(16, 0x800000L);
+  unsigned long start = Hal.now();
+  float force = 0;
+  while (force < control.targetForce) {
+    TEST_ASSERT_TRUE(Steppers.queueMove(0, true, REVOLUTION, SLOW_INTERVAL));
+    while (!Steppers.isMoveDone(0)) yield();
+    force = nextSample();
+    if (force > result.peak) result.peak = force;
+    if (smoothed) {
+      average.add(0x800000L + lround(force * 1000));
+      force = (average.value() - 0x800000L) / 1000.0;
+    }
+  }
+  result.time = Hal.now() - start;
+  result.final = force;
+  return result;
+}
+
+// The foot back at its start, with the step engine restarted
+static void restartFoot(long contact, float stiffness, float hardening, uint8_t rate) {
+  Hal.reset();
+  Steppers.attach(0, DIR_PIN, PUL_PIN);
+  Steppers.begin();
+  startFoot(contact, stiffness, hardening, rate);
+}
+
+static void checkApproach(long contact, float stiffness, float hardening, uint8_t rate) {
+  startFoot(contact, stiffness, hardening, rate);
+  Approach controlled = closedLoop();
+  TEST_ASSERT_FLOAT_WITHIN(control.band, control.targetForce, controlled.final);
+  restartFoot(contact, stiffness, hardening, rate);
+  Approach earlier = perRevolution(false);
+  restartFoot(contact, stiffness, hardening, rate);
+  Approach firmware = perRevolution(true);
+  float overshoot = controlled.peak - control.targetForce;
+  TEST_ASSERT_TRUE(overshoot < 2 * control.band);
+  TEST_ASSERT_TRUE(10 * overshoot < earlier.peak - control.targetForce);
+  TEST_ASSERT_TRUE(controlled.time < APPROACH_TIME_LIMIT);
+  TEST_ASSERT_TRUE(10 * controlled.time < firmware.time);
+}
+
+void setUp() {
+  Hal.reset();
+  Steppers.attach(0, DIR_PIN, PUL_PIN);
+  Steppers.begin();
+}
+
+void tearDown() {
+  Steppers.stop(0);
+}
+
+void test_rig_forefoot_at_80_sps() {
+  checkApproach(400, 0.002, 2e-6, 80);
+}
+
+void test_rig_forefoot_at_10_sps() {
+  checkApproach(400, 0.002, 2e-6, 10);
+}
+
+void test_stiff_foot() {
+  checkApproach(300, 0.01, 1e-5, 80);
+}
+
+void test_soft_foot() {
+  checkApproach(200, 0.0008, 0, 80);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rig_forefoot_at_80_sps);
+  RUN_TEST(test_rig_forefoot_at_10_sps);
+  RUN_TEST(test_stiff_foot);
+  RUN_TEST(test_soft_foot);
+  return UNITY_END();
+}
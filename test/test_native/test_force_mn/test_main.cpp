@@ -0,0 +1,100 @@
+/*
+ * test_force_mn
+ * The integer force path of HX711_ADC: toForce_mN() over the 24 bit range
+ * of tared conversions, for several calibration factors and force units,
+ * must give the exact product of the conversion and the fixed point scale,
+ * rounded, and agree within 1 mN with the float calculation it replaces,
+ * (raw - tare) / calFactor * g, wherever the force stays below 2^22 mN
+ * (the 23 bit scale is then within half a mN).
+ */
+
+#include <unity.h>
+#include <math.h>
+#include <stdint.h>
+#include <Arduino.h>
+#include <HX711_ADC.h>
+
+#define TARE_OFFSET (0x800000L + 1234)
+#define FORCE_LIMIT 4194304.0 // 2^22 mN
+#define CONVERSIONS 20000 // Random conversions per calibration
+
+// Exposes the fixed point scale for the reference calculation
+class ForceCell : public HX711_ADC {
+  public:
+    ForceCell() : HX711_ADC(4, 5) {}
+    using HX711_ADC_Base::forceScale;
+    using HX711_ADC_Base::forceShift;
+    using HX711_ADC_Base::forceNegative;
+};
+
+static uint32_t randomState;
+
+static uint32_t nextRandom() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+// (tared * forceScale) / 2^forceShift rounded, in 64 bits
+static long reference(ForceCell &cell, long tared) {
+  uint64_t u = (tared < 0) ? -tared : tared;
+  if (u > 0xFFFFFF) u = 0xFFFFFF;
+  long v = (long)((u * cell.forceScale + (1ULL << (cell.forceShift - 1))) >> cell.forceShift);
+  return ((tared < 0) != cell.forceNegative) ? -v : v;
+}
+
+static void checkCalibration(float calFactor, float mNPerUnit) {
+  ForceCell cell;
+  cell.setCalFactor(calFactor);
+  cell.setForceScale(mNPerUnit);
+  cell.setTareOffset(TARE_OFFSET);
+  double mNPerCount = (double)mNPerUnit / calFactor;
+  long range = (FORCE_LIMIT / fabs(mNPerCount) < 0x800000) ? (long)(FORCE_LIMIT / fabs(mNPerCount)) : 0x7FFFFF;
+  static const long edges[] = {0, 1, -1, 0x7FFFFF, -0x7FFFFF, 0x800000, -0x800000, 0xFFFFFF, -0xFFFFFF};
+  for (uint8_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) TEST_ASSERT_EQUAL(reference(cell, edges[i]), cell.toForce_mN(TARE_OFFSET + edges[i]));
+  for (unsigned long i = 0; i < CONVERSIONS; i++) {
+    long tared = (long)(nextRandom() % (2 * (uint32_t)range + 1)) - range;
+    long force = cell.toForce_mN(TARE_OFFSET + tared);
+    TEST_ASSERT_EQUAL(reference(cell, tared), force);
+    long expected = lround(tared * (1.0 / calFactor) * mNPerUnit);
+    TEST_ASSERT_TRUE_MESSAGE(labs(force - expected) <= 1, "more than 1 mN from the float calculation");
+  }
+}
+
+void setUp() {
+  randomState = 2463534242UL;
+}
+
+void tearDown() {}
+
+void test_rig_calibrations_in_grams() {
+  checkCalibration(420, 9.81);
+  checkCalibration(696, 9.81);
+  checkCalibration(2280, 9.81);
+  checkCalibration(14.4, 9.81);
+}
+
+void test_negative_calibration() {
+  checkCalibration(-420, 9.81);
+}
+
+void test_coarse_scales() {
+  checkCalibration(1, 1); // 1 mN per count
+  checkCalibration(0.1, 9.81); // 98 mN per count, forceShift 16: every low bit of the product counts
+  checkCalibration(0.08, 9.81);
+}
+
+void test_fine_scales() {
+  checkCalibration(100000, 9.81);
+  checkCalibration(1000, 1);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rig_calibrations_in_grams);
+  RUN_TEST(test_negative_calibration);
+  RUN_TEST(test_coarse_scales);
+  RUN_TEST(test_fine_scales);
+  return UNITY_END();
+}
@@ -0,0 +1,241 @@
+/*
+ * test_gait
+ * Gait profile interpolation and playback: GaitProfile::valueAt() on a
+ * keyframe table of known slopes, then GaitPlayer replaying a profile on two
+ * StepEngine axes on the HAL timers, updated every 5 ms as playGaitCycle()
+ * in src/main.cpp does. The tracking statistics must match the position
+ * error measured independently and stay small for a stroke the rig's limits
+ * can follow at the walking cadence. At a calibrated stroke of about 1000
+ * microsteps the heel strike needs more than the acceleration limit allows:
+ * the error must then be reported, and the axes must still stop close
+ * enough to the start for the residual move of playGaitCycle().
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <math.h>
+#include <StepEngine.h>
+#include <GaitPlayer.h>
+
+#define UPDATE_INTERVAL 5000 // gaitUpdateInterval of src/main.cpp (us)
+#define TRACKED_STROKE 200 // Microsteps, both axes
+#define RIG_STROKE 1000 // About the calibrated stroke of the rig simulation
+#define MAX_RESIDUAL 20 // Microsteps from the start once the axes have stopped
+
+// Rig limits of src/main.cpp at 1/4 microstepping, start speed at stepDelay_fast = 300 us
+static const MotionLimits limits = {6000, 12000, 120000, 1000000.0 / (2 * 300)};
+
+// Slopes of +10, -2.5 and -5 permille per ms on the forefoot
+static const GaitKeyframe rampFrames[] PROGMEM = {
+  {0, {0, 1000}},
+  {100, {1000, 500}},
+  {300, {500, 0}},
+  {400, {0, 0}}
+};
+
+static const GaitKeyframe unorderedFrames[] PROGMEM = {
+  {0, {0, 0}},
+  {200, {500, 500}},
+  {200, {0, 0}}
+};
+
+static const GaitKeyframe lateFrames[] PROGMEM = {
+  {10, {0, 0}},
+  {200, {0, 0}}
+};
+
+// Full stroke in 10 ms, far beyond the acceleration limit at any useful stroke
+static const GaitKeyframe jumpFrames[] PROGMEM = {
+  {0, {0, 0}},
+  {10, {1000, 1000}},
+  {300, {1000, 1000}},
+  {310, {0, 0}},
+  {500, {0, 0}}
+};
+
+struct Tracking {
+  float maxError[GAIT_AXES]; // Measured at every update against getTarget(), microsteps
+  float fastest[GAIT_AXES]; // Highest commanded speed, microsteps/s
+  unsigned long duration; // us
+  long end[GAIT_AXES]; // Position at the end of the cycle, before any residual move
+};
+
+// playGaitCycle() of src/main.cpp with the load cell draining replaced by yield()
+static void runAxis(int axis, int8_t direction, float velocity, int8_t &running) {
+  unsigned int interval = (direction != 0) ? StepEngine::velocityInterval(velocity) : 0;
+  if (direction != running) {
+    Steppers.stop(axis);
+    while (!Steppers.isMoveDone(axis)) yield();
+    if (direction != 0) Steppers.queueMove(axis, direction > 0, STEP_CONTINUOUS, interval);
+    running = direction;
+  }
+  else if (direction != 0) {
+    Steppers.setSpeed(axis, interval);
+  }
+}
+
+static Tracking play(GaitPlayer &player, GaitProfile &profile, long strokeF, long strokeH) {
+  Tracking result = {};
+  const long stroke[GAIT_AXES] = {strokeF, strokeH};
+  int8_t running[GAIT_AXES] = {0, 0};
+  player.begin(profile, stroke, limits);
+  unsigned long start = Hal.now();
+  unsigned long lastUpdate = micros();
+  player.start(lastUpdate);
+  bool playing = true;
+  while (playing) {
+    TEST_ASSERT_TRUE_MESSAGE(Hal.now() - start < 10000000UL, "cycle not over within 10 s");
+    yield();
+    if (micros() - lastUpdate < UPDATE_INTERVAL) continue;
+    lastUpdate = micros();
+    long position[GAIT_AXES] = {Steppers.getPosition(0), Steppers.getPosition(1)};
+    unsigned long elapsed = (lastUpdate - start) / 1000;
+    uint16_t time = (elapsed < profile.getPeriod()) ? elapsed : profile.getPeriod();
+    playing = player.update(lastUpdate, position);
+    for (int axis = 0; axis < GAIT_AXES; axis++) {
+      float error = fabs((float)(player.getTarget(axis, time) - position[axis]));
+      if (error > result.maxError[axis]) result.maxError[axis] = error;
+      if (player.getVelocity(axis) > result.fastest[axis]) result.fastest[axis] = player.getVelocity(axis);
+      runAxis(axis, player.getDirection(axis), player.getVelocity(axis), running[axis]);
+    }
+  }
+  for (int axis = 0; axis < GAIT_AXES; axis++) {
+    runAxis(axis, 0, 0, running[axis]);
+    result.end[axis] = Steppers.getPosition(axis);
+  }
+  result.duration = Hal.now() - start;
+  return result;
+}
+
+void setUp() {
+  Hal.reset();
+  Steppers.attach(0, 22, 23);
+  Steppers.attach(1, 24, 25);
+  Steppers.begin();
+}
+
+void tearDown() {
+  Steppers.stop(0);
+  Steppers.stop(1);
+}
+
+void test_profile_checks() {
+  GaitProfile ramp(rampFrames, 4);
+  GaitProfile unordered(unorderedFrames, 3);
+  GaitProfile late(lateFrames, 2);
+  GaitProfile single(rampFrames, 1);
+  TEST_ASSERT_TRUE(ramp.isValid());
+  TEST_ASSERT_TRUE(gaitWalking.isValid());
+  TEST_ASSERT_FALSE(unordered.isValid());
+  TEST_ASSERT_FALSE(late.isValid());
+  TEST_ASSERT_FALSE(single.isValid());
+  TEST_ASSERT_EQUAL(4, ramp.getCount());
+  TEST_ASSERT_EQUAL(400, ramp.getPeriod());
+  TEST_ASSERT_EQUAL(1000, gaitWalking.getPeriod());
+  GaitKeyframe frame = ramp.getFrame(2);
+  TEST_ASSERT_EQUAL(300, frame.time);
+  TEST_ASSERT_EQUAL(500, frame.position[0]);
+  TEST_ASSERT_EQUAL(0, frame.position[1]);
+}
+
+void test_interpolation() {
+  GaitProfile ramp(rampFrames, 4);
+  // Every millisecond forwards, as playback looks them up
+  for (uint16_t t = 0; t <= 400; t++) {
+    long forefoot = (t <= 100) ? 10L * t : (t <= 300) ? 1000 - (t - 100) * 5L / 2 : 500 - 5L * (t - 300);
+    long heel = (t <= 100) ? 1000 - 5L * t : (t <= 300) ? 500 - (t - 100) * 5L / 2 : 0;
+    TEST_ASSERT_INT_WITHIN(1, forefoot, ramp.valueAt(0, t));
+    TEST_ASSERT_INT_WITHIN(1, heel, ramp.valueAt(1, t));
+  }
+  // Keyframes exactly, backwards (a new cycle) and past the period
+  TEST_ASSERT_EQUAL(1000, ramp.valueAt(0, 100));
+  TEST_ASSERT_EQUAL(500, ramp.valueAt(0, 300));
+  TEST_ASSERT_EQUAL(500, ramp.valueAt(0, 50));
+  TEST_ASSERT_EQUAL(1000, ramp.valueAt(1, 0));
+  TEST_ASSERT_EQUAL(0, ramp.valueAt(0, 400));
+  TEST_ASSERT_EQUAL(0, ramp.valueAt(0, 60000));
+  TEST_ASSERT_EQUAL(750, ramp.valueAt(1, 50));
+}
+
+// The residual move of playGaitCycle()
+static void returnToStart(const long start[GAIT_AXES]) {
+  for (int axis = 0; axis < GAIT_AXES; axis++) {
+    long residual = start[axis] - Steppers.getPosition(axis);
+    if (residual != 0) Steppers.queueMove(axis, residual > 0, residual > 0 ? residual : -residual, 300);
+    while (!Steppers.isMoveDone(axis)) yield();
+    TEST_ASSERT_EQUAL(start[axis], Steppers.getPosition(axis));
+  }
+}
+
+void test_walking_gait_is_tracked() {
+  GaitPlayer player;
+  for (int cycle = 0; cycle < 3; cycle++) {
+    const long start[GAIT_AXES] = {Steppers.getPosition(0), Steppers.getPosition(1)};
+    Tracking tracking = play(player, gaitWalking, TRACKED_STROKE, TRACKED_STROKE);
+    for (int axis = 0; axis < GAIT_AXES; axis++) {
+      TEST_ASSERT_FLOAT_WITHIN(0.5, tracking.maxError[axis], player.getMaxError(axis));
+      TEST_ASSERT_TRUE(player.getRmsError(axis) <= player.getMaxError(axis));
+      TEST_ASSERT_TRUE(player.getRmsError(axis) > 0);
+      TEST_ASSERT_TRUE(tracking.fastest[axis] <= limits.maxVelocity);
+    }
+    // The heel strike (700 permille in 60 ms) lags the most
+    TEST_ASSERT_TRUE(player.getMaxError(0) < 100);
+    TEST_ASSERT_TRUE(player.getMaxError(1) < 150);
+    TEST_ASSERT_TRUE(player.getRmsError(0) < 25);
+    TEST_ASSERT_TRUE(player.getRmsError(1) < 60);
+    // The cadence is kept, and the axes stop within a microstep or two of the start
+    TEST_ASSERT_TRUE(tracking.duration >= 1000000UL && tracking.duration < 1050000UL);
+    TEST_ASSERT_INT_WITHIN(2, start[0], tracking.end[0]);
+    TEST_ASSERT_INT_WITHIN(2, start[1], tracking.end[1]);
+    returnToStart(start);
+  }
+}
+
+void test_rig_stroke_lag_is_reported() {
+  GaitPlayer player;
+  const long start[GAIT_AXES] = {0, 0};
+  Tracking tracking = play(player, gaitWalking, RIG_STROKE, RIG_STROKE);
+  for (int axis = 0; axis < GAIT_AXES; axis++) {
+    TEST_ASSERT_FLOAT_WITHIN(0.5, tracking.maxError[axis], player.getMaxError(axis));
+    TEST_ASSERT_TRUE(player.getMaxError(axis) > RIG_STROKE / 2);
+    TEST_ASSERT_TRUE(tracking.fastest[axis] <= limits.maxVelocity);
+    TEST_ASSERT_INT_WITHIN(MAX_RESIDUAL, 0, tracking.end[axis]);
+  }
+  TEST_ASSERT_TRUE(tracking.duration < 1300000UL);
+  returnToStart(start);
+}
+
+void test_untrackable_profile_is_reported() {
+  GaitProfile jump(jumpFrames, 5);
+  GaitPlayer player;
+  Tracking tracking = play(player, jump, 2000, 400);
+  // The limits cannot reach 2000 microsteps in 10 ms: most of the stroke shows as error,
+  // the shorter heel stroke less so
+  TEST_ASSERT_TRUE(player.getMaxError(0) > 1000);
+  TEST_ASSERT_TRUE(player.getMaxError(1) < player.getMaxError(0));
+  TEST_ASSERT_FLOAT_WITHIN(0.5, tracking.maxError[0], player.getMaxError(0));
+  TEST_ASSERT_TRUE(tracking.fastest[0] <= limits.maxVelocity);
+  TEST_ASSERT_INT_WITHIN(MAX_RESIDUAL, 0, tracking.end[0]);
+  TEST_ASSERT_INT_WITHIN(MAX_RESIDUAL, 0, tracking.end[1]);
+}
+
+void test_zero_stroke_stays_still() {
+  GaitPlayer player;
+  Tracking tracking = play(player, gaitWalking, 0, 0);
+  TEST_ASSERT_EQUAL(0, tracking.end[0]);
+  TEST_ASSERT_EQUAL(0, tracking.end[1]);
+  TEST_ASSERT_EQUAL_FLOAT(0, player.getMaxError(0));
+  TEST_ASSERT_EQUAL_FLOAT(0, player.getRmsError(1));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_profile_checks);
+  RUN_TEST(test_interpolation);
+  RUN_TEST(test_walking_gait_is_tracked);
+  RUN_TEST(test_rig_stroke_lag_is_reported);
+  RUN_TEST(test_untrackable_profile_is_reported);
+  RUN_TEST(test_zero_stroke_stays_still);
+  return UNITY_END();
+}
@@ -0,0 +1,108 @@
+/*
+ * test_hx711_decode
+ * The unmodified HX711_ADC decode path on the native HAL: an Hx711Model
+ * (lib/RigSim) shifts out known conversions on the simulated pins and
+ * HX711_ADC reads them back through digitalWrite()/digitalRead().
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <HX711_ADC.h>
+#include <Hx711Model.h>
+
+#define DOUT_PIN 4
+#define SCK_PIN 5
+
+// Inputs handed to the model, one per conversion in order
+struct Inputs {
+  const long *values;
+  uint8_t count;
+  uint8_t next;
+};
+
+static long nextInput(void *context) {
+  Inputs &inputs = *(Inputs *)context;
+  long value = inputs.values[inputs.next];
+  if (inputs.next < inputs.count - 1) inputs.next++;
+  return value;
+}
+
+static Hx711Model model;
+
+static void modelPin(uint8_t pin, uint8_t level, void *) {
+  model.onPin(pin, level);
+}
+
+static void startModel(Inputs &inputs, uint8_t rate = 80) {
+  model = Hx711Model();
+  model.begin(DOUT_PIN, SCK_PIN, rate, nextInput, &inputs);
+  Hal.addPinHook(modelPin, 0);
+}
+
+// Poll the load cell until the model has shifted out one more conversion
+static void readOne(HX711_ADC &cell) {
+  unsigned long reads = model.getReads();
+  unsigned long deadline = Hal.now() + 1000000UL;
+  while (model.getReads() == reads) {
+    TEST_ASSERT_TRUE_MESSAGE((long)(Hal.now() - deadline) < 0, "no conversion within 1 s");
+    cell.update();
+    yield();
+  }
+}
+
+void setUp() {
+  Hal.reset();
+}
+
+void tearDown() {}
+
+void test_decodes_twos_complement_to_offset_binary() {
+  static const long values[] = {0, 1, -1, 123456, -123456, 0x7FFFFF, -0x800000, 8500};
+  Inputs inputs = {values, sizeof(values) / sizeof(values[0]), 0};
+  startModel(inputs);
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  cell.begin();
+  for (uint8_t i = 0; i < inputs.count; i++) {
+    readOne(cell);
+    TEST_ASSERT_EQUAL_HEX32((values[i] & 0xFFFFFF) ^ 0x800000, cell.getLastConversionRaw());
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, model.getOverwritten());
+}
+
+void test_gain_pulses_select_the_next_conversion() {
+  static const long values[] = {40000};
+  Inputs inputs = {values, 1, 0};
+  startModel(inputs);
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  cell.begin(64);
+  readOne(cell); // First conversion at the power-up gain, the read asks for gain 64
+  TEST_ASSERT_EQUAL(64, model.getGain());
+  readOne(cell);
+  TEST_ASSERT_EQUAL_HEX32(20000 ^ 0x800000, cell.getLastConversionRaw());
+}
+
+void test_tare_and_calibration_through_the_decode_path() {
+  long load = 5000;
+  Inputs inputs = {&load, 1, 0};
+  startModel(inputs);
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  cell.begin();
+  cell.start(0, true); // Settling, then tare on the unloaded input
+  TEST_ASSERT_FALSE(cell.getTareTimeoutFlag());
+  TEST_ASSERT_EQUAL(5000 + 0x800000, cell.getTareOffset());
+  cell.setCalFactor(420);
+  load = 47000;
+  readOne(cell); // Converted before the load changed
+  for (uint8_t i = 0; i < cell.getSamplesInUse() + 2; i++) readOne(cell); // The window fills with the loaded input
+  TEST_ASSERT_EQUAL(42000, cell.getRawTared());
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 100.0, cell.getData());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_decodes_twos_complement_to_offset_binary);
+  RUN_TEST(test_gain_pulses_select_the_next_conversion);
+  RUN_TEST(test_tare_and_calibration_through_the_decode_path);
+  return UNITY_END();
+}
@@ -0,0 +1,161 @@
+/*
+ * test_hx711_fast
+ * HX711_ADC_Fast against HX711_ADC, each reading its own Hx711Model
+ * (lib/RigSim) fed the same input sequence: raw conversions, tare and the
+ * filtered, calibrated outputs must match bit for bit. HX711_FAST_PORTS is
+ * set here, so the fast class runs its register path against the Mega's
+ * pin map on the HAL's emulated ports (HalPorts.h), where a wrong port or
+ * bit in its pin table clocks or reads the wrong pin. The whole pin table
+ * is also checked against the HAL's port to pin table.
+ */
+
+#define HX711_FAST_PORTS 1 // The register path, on the HAL's emulated ports
+
+#include <unity.h>
+#include <string.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <HX711_ADC.h>
+#include <HX711_ADC_Fast.h>
+#include <HalPorts.h>
+#include <Hx711Model.h>
+#include <Hx711Inputs.h>
+
+#define DOUT_PIN 4
+#define SCK_PIN 5
+#define FAST_DOUT_PIN 6
+#define FAST_SCK_PIN 7
+#define CONVERSIONS 400
+
+static Hx711Model model;
+static Hx711Model fastModel;
+static Hx711Inputs inputs;
+static Hx711Inputs fastInputs;
+
+static void startModels(float noise) {
+  inputs = {2463534242UL, 0};
+  fastInputs = inputs;
+  model = Hx711Model();
+  fastModel = Hx711Model();
+  model.begin(DOUT_PIN, SCK_PIN, 80, hx711NextInput, &inputs);
+  fastModel.begin(FAST_DOUT_PIN, FAST_SCK_PIN, 80, hx711NextInput, &fastInputs);
+  model.setNoise(noise, 7);
+  fastModel.setNoise(noise, 7);
+  Hal.addPinHook(hx711ModelPin, &model);
+  Hal.addPinHook(hx711ModelPin, &fastModel);
+}
+
+// Poll both cells until each has read one more conversion
+static void readBoth(HX711_ADC_Base &cell, HX711_ADC_Base &fastCell) {
+  unsigned long reads = model.getReads();
+  unsigned long fastReads = fastModel.getReads();
+  unsigned long deadline = Hal.now() + 1000000UL;
+  while (model.getReads() == reads || fastModel.getReads() == fastReads) {
+    TEST_ASSERT_TRUE_MESSAGE((long)(Hal.now() - deadline) < 0, "no conversion within 1 s");
+    if (model.getReads() == reads) cell.update();
+    if (fastModel.getReads() == fastReads) fastCell.update();
+    yield();
+  }
+}
+
+static void assertSameFloat(float expected, float actual) {
+  uint32_t a;
+  uint32_t b;
+  memcpy(&a, &expected, sizeof(a));
+  memcpy(&b, &actual, sizeof(b));
+  TEST_ASSERT_EQUAL_HEX32(a, b);
+}
+
+static void compareCells(uint8_t gain) {
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  HX711_ADC_Fast<FAST_DOUT_PIN, FAST_SCK_PIN> fastCell;
+  cell.begin(gain);
+  fastCell.begin(gain);
+  cell.setCalFactor(421.7);
+  fastCell.setCalFactor(421.7);
+  cell.setForceScale(9.81);
+  fastCell.setForceScale(9.81);
+  for (unsigned int i = 0; i < CONVERSIONS; i++) {
+    readBoth(cell, fastCell);
+    TEST_ASSERT_EQUAL_HEX32(cell.getLastConversionRaw(), fastCell.getLastConversionRaw());
+    TEST_ASSERT_EQUAL(cell.getRawTared(), fastCell.getRawTared());
+    TEST_ASSERT_EQUAL(cell.getForce_mN(), fastCell.getForce_mN());
+    assertSameFloat(cell.getData(), fastCell.getData());
+    if (i == CONVERSIONS / 2) {
+      cell.tareNoDelay();
+      fastCell.tareNoDelay();
+    }
+  }
+  TEST_ASSERT_TRUE(cell.getTareStatus());
+  TEST_ASSERT_TRUE(fastCell.getTareStatus());
+  TEST_ASSERT_EQUAL(cell.getTareOffset(), fastCell.getTareOffset());
+  TEST_ASSERT_EQUAL(gain, fastModel.getGain());
+  TEST_ASSERT_EQUAL_UINT32(0, model.getOverwritten());
+  TEST_ASSERT_EQUAL_UINT32(0, fastModel.getOverwritten());
+}
+
+void setUp() {
+  Hal.reset();
+}
+
+void tearDown() {}
+
+void test_fast_matches_at_gain_128() {
+  startModels(0);
+  compareCells(128);
+}
+
+void test_fast_matches_at_gain_64_with_noise() {
+  startModels(150);
+  compareCells(64);
+}
+
+// Every pin of HX711_pinCodes (port number 1 = A, ..., 9 = J, 11 = L) is the Mega's, and the table covers the HAL's pins
+void test_pin_table_matches_the_mega() {
+  TEST_ASSERT_EQUAL(HAL_PINS, sizeof(HX711_pinCodes));
+  for (uint8_t pin = 0; pin < sizeof(HX711_pinCodes); pin++) {
+    uint8_t port = HX711_pinCodes[pin] >> 3;
+    uint8_t bit = HX711_pinCodes[pin] & 7;
+    TEST_ASSERT_TRUE(port >= 1 && port <= HAL_PORTS);
+    TEST_ASSERT_EQUAL_MESSAGE(pin, halPortPins[port - 1][bit], "pin code of a pin number");
+  }
+}
+
+// The register path drives and reads the pins the HAL maps the registers to
+void test_fast_clocks_through_the_port_registers() {
+  HX711_ADC_Fast<FAST_DOUT_PIN, FAST_SCK_PIN> fastCell;
+  fastCell.begin();
+  uint8_t sckBit = HX711_pinCodes[FAST_SCK_PIN] & 7;
+  HX711_Register &sck = HX711_portRegister(HX711_pinCodes[FAST_SCK_PIN] >> 3, true);
+  HX711_Register &dout = HX711_portRegister(HX711_pinCodes[FAST_DOUT_PIN] >> 3, false);
+  sck |= 1 << sckBit;
+  TEST_ASSERT_EQUAL(HIGH, Hal.getLevel(FAST_SCK_PIN));
+  sck &= ~(1 << sckBit);
+  TEST_ASSERT_EQUAL(LOW, Hal.getLevel(FAST_SCK_PIN));
+  Hal.drivePin(FAST_DOUT_PIN, HIGH);
+  TEST_ASSERT_TRUE(dout & (1 << (HX711_pinCodes[FAST_DOUT_PIN] & 7)));
+  Hal.drivePin(FAST_DOUT_PIN, LOW);
+  TEST_ASSERT_FALSE(dout & (1 << (HX711_pinCodes[FAST_DOUT_PIN] & 7)));
+}
+
+void test_fast_decodes_the_range_edges() {
+  startModels(0);
+  HX711_ADC_Fast<FAST_DOUT_PIN, FAST_SCK_PIN> fastCell;
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  cell.begin();
+  fastCell.begin();
+  for (uint8_t i = 0; i < HX711_EDGE_INPUTS; i++) {
+    readBoth(cell, fastCell);
+    TEST_ASSERT_EQUAL_HEX32((hx711EdgeInputs[i] & 0xFFFFFF) ^ 0x800000, fastCell.getLastConversionRaw());
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fast_matches_at_gain_128);
+  RUN_TEST(test_fast_matches_at_gain_64_with_noise);
+  RUN_TEST(test_fast_decodes_the_range_edges);
+  RUN_TEST(test_pin_table_matches_the_mega);
+  RUN_TEST(test_fast_clocks_through_the_port_registers);
+  return UNITY_END();
+}
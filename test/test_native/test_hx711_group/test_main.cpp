@@ -0,0 +1,185 @@
+/*
+ * test_hx711_group
+ * HX711_ADC_Group against separate HX711_ADC instances: two Hx711Models
+ * share one SCK pin and are read by the group, two more are read by their
+ * own HX711_ADC, each pair fed the same input sequence. Every member must
+ * give the raw conversions, tare and filtered outputs of its reference bit
+ * for bit, at both gains, with the members updated in either order and
+ * with the chips' conversions out of phase, and without dropping a
+ * conversion.
+ */
+
+#include <unity.h>
+#include <string.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <HX711_ADC.h>
+#include <HX711_ADC_Group.h>
+#include <Hx711Model.h>
+#include <Hx711Inputs.h>
+
+#define GROUP_SCK_PIN 5
+#define GROUP_DOUT_0 4
+#define GROUP_DOUT_1 6
+#define REF_DOUT_0 8
+#define REF_SCK_0 9
+#define REF_DOUT_1 10
+#define REF_SCK_1 11
+#define CONVERSIONS 400
+#define CHANNELS 2
+
+static Hx711Model groupModels[CHANNELS];
+static Hx711Model refModels[CHANNELS];
+static Hx711Inputs groupInputs[CHANNELS];
+static Hx711Inputs refInputs[CHANNELS];
+
+// Chip 1 of each pair starts 'lagUs' after chip 0
+static void startModels(float noise, unsigned long lagUs) {
+  static const uint8_t groupDout[CHANNELS] = {GROUP_DOUT_0, GROUP_DOUT_1};
+  static const uint8_t refDout[CHANNELS] = {REF_DOUT_0, REF_DOUT_1};
+  static const uint8_t refSck[CHANNELS] = {REF_SCK_0, REF_SCK_1};
+  for (uint8_t c = 0; c < CHANNELS; c++) {
+    if (c > 0 && lagUs) Hal.advance(lagUs);
+    groupInputs[c] = {(uint32_t)(2463534242UL + 77777UL * c), 0};
+    refInputs[c] = groupInputs[c];
+    groupModels[c] = Hx711Model();
+    refModels[c] = Hx711Model();
+    groupModels[c].begin(groupDout[c], GROUP_SCK_PIN, 80, hx711NextInput, &groupInputs[c]);
+    refModels[c].begin(refDout[c], refSck[c], 80, hx711NextInput, &refInputs[c]);
+    groupModels[c].setNoise(noise, 7 + c);
+    refModels[c].setNoise(noise, 7 + c);
+    Hal.addPinHook(hx711ModelPin, &groupModels[c]);
+    Hal.addPinHook(hx711ModelPin, &refModels[c]);
+  }
+}
+
+// Poll every cell until each chip has been read once more, group members in 'order'
+static void readAll(HX711_ADC_Base *group[CHANNELS], HX711_ADC_Base *refs[CHANNELS], const uint8_t order[CHANNELS]) {
+  unsigned long groupReads[CHANNELS];
+  unsigned long refReads[CHANNELS];
+  for (uint8_t c = 0; c < CHANNELS; c++) {
+    groupReads[c] = groupModels[c].getReads();
+    refReads[c] = refModels[c].getReads();
+  }
+  unsigned long deadline = Hal.now() + 1000000UL;
+  for (;;) {
+    bool done = true;
+    for (uint8_t c = 0; c < CHANNELS; c++) {
+      if (groupModels[c].getReads() == groupReads[c] || refModels[c].getReads() == refReads[c]) done = false;
+    }
+    if (done) break;
+    TEST_ASSERT_TRUE_MESSAGE((long)(Hal.now() - deadline) < 0, "no conversion within 1 s");
+    for (uint8_t c = 0; c < CHANNELS; c++) {
+      group[order[c]]->update();
+      if (refModels[c].getReads() == refReads[c]) refs[c]->update();
+    }
+    yield();
+  }
+  // One shared read-out has read both chips, every member has collected its value
+  for (uint8_t c = 0; c < CHANNELS; c++) {
+    TEST_ASSERT_EQUAL_UINT32(groupReads[c] + 1, groupModels[c].getReads());
+  }
+}
+
+static void assertSameFloat(float expected, float actual) {
+  uint32_t a;
+  uint32_t b;
+  memcpy(&a, &expected, sizeof(a));
+  memcpy(&b, &actual, sizeof(b));
+  TEST_ASSERT_EQUAL_HEX32(a, b);
+}
+
+static void compareGroup(uint8_t gain, const uint8_t order[CHANNELS]) {
+  HX711_ADC_Group<GROUP_SCK_PIN, GROUP_DOUT_0, GROUP_DOUT_1> cells;
+  HX711_ADC ref0(REF_DOUT_0, REF_SCK_0);
+  HX711_ADC ref1(REF_DOUT_1, REF_SCK_1);
+  HX711_ADC_Base *group[CHANNELS] = {&cells[0], &cells[1]};
+  HX711_ADC_Base *refs[CHANNELS] = {&ref0, &ref1};
+  for (uint8_t c = 0; c < CHANNELS; c++) {
+    group[c]->begin(gain);
+    refs[c]->begin(gain);
+    group[c]->setCalFactor(421.7 + c);
+    refs[c]->setCalFactor(421.7 + c);
+    group[c]->setForceScale(9.81);
+    refs[c]->setForceScale(9.81);
+  }
+  for (unsigned int i = 0; i < CONVERSIONS; i++) {
+    readAll(group, refs, order);
+    for (uint8_t c = 0; c < CHANNELS; c++) {
+      TEST_ASSERT_EQUAL_HEX32(refs[c]->getLastConversionRaw(), group[c]->getLastConversionRaw());
+      TEST_ASSERT_EQUAL(refs[c]->getRawTared(), group[c]->getRawTared());
+      TEST_ASSERT_EQUAL(refs[c]->getForce_mN(), group[c]->getForce_mN());
+      assertSameFloat(refs[c]->getData(), group[c]->getData());
+      if (i == CONVERSIONS / 2) {
+        group[c]->tareNoDelay();
+        refs[c]->tareNoDelay();
+      }
+    }
+  }
+  for (uint8_t c = 0; c < CHANNELS; c++) {
+    TEST_ASSERT_TRUE(group[c]->getTareStatus());
+    TEST_ASSERT_EQUAL(refs[c]->getTareOffset(), group[c]->getTareOffset());
+    TEST_ASSERT_EQUAL(gain, groupModels[c].getGain());
+    TEST_ASSERT_EQUAL_UINT32(refModels[c].getOverwritten(), groupModels[c].getOverwritten());
+    TEST_ASSERT_EQUAL_UINT32(refModels[c].getReads(), groupModels[c].getReads());
+  }
+}
+
+static const uint8_t inOrder[CHANNELS] = {0, 1};
+static const uint8_t reversed[CHANNELS] = {1, 0};
+
+void setUp() {
+  Hal.reset();
+}
+
+void tearDown() {}
+
+void test_group_matches_at_gain_128() {
+  startModels(0, 0);
+  compareGroup(128, inOrder);
+}
+
+void test_group_matches_at_gain_64_with_noise() {
+  startModels(150, 0);
+  compareGroup(64, inOrder);
+}
+
+void test_members_updated_in_reverse_order() {
+  startModels(150, 0);
+  compareGroup(128, reversed);
+}
+
+void test_chips_out_of_phase() {
+  // Chip 1 finishes its conversions 6 ms after chip 0, the group waits for both
+  startModels(150, 6000);
+  compareGroup(128, inOrder);
+}
+
+void test_group_decodes_the_range_edges() {
+  startModels(0, 0);
+  HX711_ADC_Group<GROUP_SCK_PIN, GROUP_DOUT_0, GROUP_DOUT_1> cells;
+  HX711_ADC ref0(REF_DOUT_0, REF_SCK_0);
+  HX711_ADC ref1(REF_DOUT_1, REF_SCK_1);
+  HX711_ADC_Base *group[CHANNELS] = {&cells[0], &cells[1]};
+  HX711_ADC_Base *refs[CHANNELS] = {&ref0, &ref1};
+  for (uint8_t c = 0; c < CHANNELS; c++) {
+    group[c]->begin();
+    refs[c]->begin();
+  }
+  for (uint8_t i = 0; i < HX711_EDGE_INPUTS; i++) {
+    readAll(group, refs, inOrder);
+    for (uint8_t c = 0; c < CHANNELS; c++) {
+      TEST_ASSERT_EQUAL_HEX32((hx711EdgeInputs[i] & 0xFFFFFF) ^ 0x800000, group[c]->getLastConversionRaw());
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_group_matches_at_gain_128);
+  RUN_TEST(test_group_matches_at_gain_64_with_noise);
+  RUN_TEST(test_members_updated_in_reverse_order);
+  RUN_TEST(test_chips_out_of_phase);
+  RUN_TEST(test_group_decodes_the_range_edges);
+  return UNITY_END();
+}
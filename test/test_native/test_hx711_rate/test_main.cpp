@@ -0,0 +1,158 @@
+/*
+ * test_hx711_rate
+ * Sample rate handling of HX711_ADC against an Hx711Model (lib/RigSim)
+ * converting at 10 or 80 SPS: the rate is detected from the conversion
+ * times after HX711_RATE_DETECT in a row, a single late read does not
+ * switch it, and the tare timeout, start-up settling time and smoothing
+ * window follow the rate in use, so start() with a tare takes about an
+ * eighth of the time at 80 SPS.
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <HX711_ADC.h>
+#include <Hx711Model.h>
+#include <Hx711Inputs.h>
+
+#define DOUT_PIN 4
+#define SCK_PIN 5
+#define DATASET (SAMPLES + IGN_HIGH_SAMPLE + IGN_LOW_SAMPLE) // Conversions to fill the default filter
+
+static Hx711Model model;
+static Hx711Inputs inputs;
+
+static void startModel(uint8_t rate) {
+  inputs = {2463534242UL, 0};
+  model = Hx711Model();
+  model.begin(DOUT_PIN, SCK_PIN, rate, hx711NextInput, &inputs);
+  Hal.addPinHook(hx711ModelPin, &model);
+}
+
+// Poll the load cell until the model has shifted out one more conversion
+static void readOne(HX711_ADC &cell) {
+  unsigned long reads = model.getReads();
+  unsigned long deadline = Hal.now() + 1000000UL;
+  while (model.getReads() == reads) {
+    TEST_ASSERT_TRUE_MESSAGE((long)(Hal.now() - deadline) < 0, "no conversion within 1 s");
+    cell.update();
+    yield();
+  }
+}
+
+static void checkTimes(HX711_ADC &cell, uint8_t rate) {
+  unsigned long period = (rate == 80) ? 12500 : 100000; // us
+  TEST_ASSERT_EQUAL(rate, cell.getSampleRate());
+  TEST_ASSERT_EQUAL(DATASET * period * 3 / 2000, cell.getTareTimeout()); // The dataset + 50%
+  TEST_ASSERT_EQUAL(HX711_SETTLE_CONVERSIONS * period / 1000, cell.getStartSettlingTime());
+}
+
+// Time start() takes to settle and tare at a rate (us)
+static unsigned long startTime(uint8_t rate) {
+  Hal.reset();
+  startModel(rate);
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  cell.begin();
+  unsigned long start = Hal.now();
+  cell.start(0, true);
+  TEST_ASSERT_FALSE(cell.getTareTimeoutFlag());
+  return Hal.now() - start;
+}
+
+void setUp() {
+  Hal.reset();
+}
+
+void tearDown() {}
+
+void test_detects_80_sps() {
+  startModel(80);
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  cell.begin();
+  checkTimes(cell, 10); // Until a rate has been detected
+  readOne(cell); // The first conversion time runs from begin(), through the chip's settling
+  for (uint8_t i = 0; i < HX711_RATE_DETECT - 1; i++) {
+    readOne(cell);
+    TEST_ASSERT_EQUAL(10, cell.getSampleRate());
+  }
+  readOne(cell);
+  checkTimes(cell, 80);
+}
+
+void test_detects_10_sps() {
+  startModel(10);
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  cell.begin();
+  for (uint8_t i = 0; i < HX711_RATE_DETECT + 1; i++) readOne(cell);
+  checkTimes(cell, 10);
+}
+
+void test_one_late_read_keeps_the_rate() {
+  startModel(80);
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  cell.begin();
+  for (uint8_t i = 0; i < HX711_RATE_DETECT + 1; i++) readOne(cell);
+  TEST_ASSERT_EQUAL(80, cell.getSampleRate());
+  delay(100); // One read late by a 10 SPS conversion time
+  readOne(cell);
+  TEST_ASSERT_EQUAL(80, cell.getSampleRate());
+  delay(1000); // A gap longer than any conversion time is ignored
+  readOne(cell);
+  TEST_ASSERT_EQUAL(80, cell.getSampleRate());
+  readOne(cell); // On time again
+  for (uint8_t i = 0; i < HX711_RATE_DETECT - 1; i++) { // Late reads, but not enough in a row
+    delay(100);
+    readOne(cell);
+  }
+  readOne(cell);
+  for (uint8_t i = 0; i < HX711_RATE_DETECT - 1; i++) {
+    delay(100);
+    readOne(cell);
+  }
+  TEST_ASSERT_EQUAL(80, cell.getSampleRate());
+  delay(100);
+  readOne(cell); // HX711_RATE_DETECT late reads in a row: the conversions are now read at 10 SPS
+  checkTimes(cell, 10);
+}
+
+void test_set_rate_overrides_detection() {
+  startModel(10);
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  cell.begin();
+  cell.setSampleRate(80);
+  checkTimes(cell, 80);
+  for (uint8_t i = 0; i < HX711_RATE_DETECT + 1; i++) readOne(cell);
+  checkTimes(cell, 80);
+  cell.setSampleRate(HX711_RATE_AUTO); // Back to the rate detected meanwhile
+  checkTimes(cell, 10);
+}
+
+void test_smoothing_time_follows_the_rate() {
+  startModel(80);
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  cell.begin();
+  cell.setSmoothingTime(100);
+  TEST_ASSERT_EQUAL(1, cell.getSamplesInUse()); // 100 ms at 10 SPS
+  for (uint8_t i = 0; i < HX711_RATE_DETECT + 1; i++) readOne(cell);
+  TEST_ASSERT_EQUAL(8, cell.getSamplesInUse()); // 100 ms at 80 SPS
+  cell.setSmoothingTime(10000);
+  TEST_ASSERT_EQUAL(SAMPLES, cell.getSamplesInUse()); // No more than the filter holds
+}
+
+void test_start_is_eight_times_faster_at_80_sps() {
+  unsigned long slow = startTime(10);
+  unsigned long fast = startTime(80);
+  TEST_ASSERT_TRUE(slow >= (HX711_SETTLE_CONVERSIONS + DATASET) * 100000UL);
+  TEST_ASSERT_TRUE(6 * fast < slow);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_detects_80_sps);
+  RUN_TEST(test_detects_10_sps);
+  RUN_TEST(test_one_late_read_keeps_the_rate);
+  RUN_TEST(test_set_rate_overrides_detection);
+  RUN_TEST(test_smoothing_time_follows_the_rate);
+  RUN_TEST(test_start_is_eight_times_faster_at_80_sps);
+  return UNITY_END();
+}
@@ -0,0 +1,216 @@
+/*
+ * test_linked_move
+ * StepEngine::linkedMove() on the HAL's Timer1: the order of the DIR and
+ * PUL edges of both axes, the DDA spread of each axis's pulses over the
+ * common timeline, phase offsets and the final positions.
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <StepEngine.h>
+
+#define DIR_PIN_0 22
+#define PUL_PIN_0 23
+#define DIR_PIN_1 24
+#define PUL_PIN_1 25
+#define SPEED 200 // Edge time of the fixed-rate moves (us), a tick is 2 * SPEED
+#define MAX_PULSES 2000
+#define DIR_SETUP_US 10 // STEP_DIR_SETUP_US, from the ISR call that writes DIR to the first tick
+
+static const uint8_t dirPins[STEP_AXES] = {DIR_PIN_0, DIR_PIN_1};
+static const uint8_t pulPins[STEP_AXES] = {PUL_PIN_0, PUL_PIN_1};
+
+struct AxisLog {
+  unsigned long dirTime; // Last DIR change
+  uint8_t dirLevel;
+  bool dirWritten;
+  unsigned long pulses; // Rising PUL edges
+  unsigned long pulseTime[MAX_PULSES];
+  unsigned long firstPulse;
+  unsigned long lastFall;
+};
+
+static AxisLog logs[STEP_AXES];
+
+static void recordEdge(uint8_t pin, uint8_t level, void *) {
+  for (uint8_t i = 0; i < STEP_AXES; i++) {
+    AxisLog &log = logs[i];
+    if (pin == dirPins[i]) {
+      log.dirTime = Hal.now();
+      log.dirLevel = level;
+      log.dirWritten = true;
+    }
+    if (pin != pulPins[i]) continue;
+    if (!level) {
+      log.lastFall = Hal.now();
+      continue;
+    }
+    if (log.pulses == 0) log.firstPulse = Hal.now();
+    if (log.pulses < MAX_PULSES) log.pulseTime[log.pulses] = Hal.now();
+    log.pulses++;
+  }
+}
+
+static void waitDone(unsigned long timeout) {
+  unsigned long deadline = Hal.now() + timeout;
+  while (!Steppers.isMoveDone(0) || !Steppers.isMoveDone(1)) {
+    TEST_ASSERT_TRUE_MESSAGE((long)(Hal.now() - deadline) < 0, "linked move not done in time");
+    yield();
+  }
+}
+
+// Tick of the common timeline a pulse was raised on, from its time after the first tick
+static unsigned long tickOf(unsigned long time, unsigned long firstTick) {
+  return (time - firstTick + SPEED) / (2 * SPEED);
+}
+
+// Time of the first tick: both DIR pins are written by the ISR call before it
+static unsigned long firstTickTime() {
+  return logs[0].dirTime + DIR_SETUP_US;
+}
+
+// Each axis must step on exactly the ticks the DDA gives: after j ticks of its window it has
+// taken (window / 2 + j * steps) / window pulses, so the pulses are spread evenly
+static void checkSpread(uint8_t axis, unsigned long steps, unsigned long window, unsigned long start, unsigned long firstTick) {
+  AxisLog &log = logs[axis];
+  TEST_ASSERT_EQUAL_UINT32(steps, log.pulses);
+  unsigned long pulse = 0;
+  for (unsigned long j = 1; j <= window && pulse < steps; j++) {
+    unsigned long due = (window / 2 + j * steps) / window;
+    while (pulse < due) {
+      TEST_ASSERT_EQUAL_UINT32(start + j - 1, tickOf(log.pulseTime[pulse], firstTick));
+      pulse++;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(steps, pulse);
+}
+
+void setUp() {
+  Hal.reset();
+  for (uint8_t i = 0; i < STEP_AXES; i++) logs[i] = AxisLog();
+  Steppers.attach(0, DIR_PIN_0, PUL_PIN_0);
+  Steppers.attach(1, DIR_PIN_1, PUL_PIN_1);
+  Steppers.begin();
+  Hal.addPinHook(recordEdge, 0);
+}
+
+void tearDown() {
+  Steppers.stop(0);
+  waitDone(1000000UL);
+}
+
+void test_axes_start_and_finish_together() {
+  TEST_ASSERT_TRUE(Steppers.linkedMove(true, 600, true, 250, 0, SPEED));
+  waitDone(1000000UL);
+  for (uint8_t i = 0; i < STEP_AXES; i++) {
+    TEST_ASSERT_TRUE(logs[i].dirWritten);
+    TEST_ASSERT_EQUAL(HIGH, logs[i].dirLevel);
+    TEST_ASSERT_TRUE(logs[i].firstPulse - logs[i].dirTime >= 10); // DIR setup time before the first pulse
+  }
+  unsigned long firstTick = firstTickTime();
+  checkSpread(0, 600, 600, 0, firstTick);
+  checkSpread(1, 250, 600, 0, firstTick);
+  TEST_ASSERT_EQUAL_UINT32(599, tickOf(logs[0].pulseTime[599], firstTick)); // Last tick of the window
+  TEST_ASSERT_UINT32_WITHIN(1, 599, tickOf(logs[1].pulseTime[249], firstTick)); // Centred in the window, ends with it
+  TEST_ASSERT_EQUAL(600, Steppers.getPosition(0));
+  TEST_ASSERT_EQUAL(250, Steppers.getPosition(1));
+  TEST_ASSERT_EQUAL(LOW, Hal.getLevel(PUL_PIN_0));
+  TEST_ASSERT_EQUAL(LOW, Hal.getLevel(PUL_PIN_1));
+}
+
+void test_pulses_of_both_axes_share_the_tick_edges() {
+  TEST_ASSERT_TRUE(Steppers.linkedMove(true, 300, false, 300, 0, SPEED));
+  waitDone(1000000UL);
+  // Equal step counts: both axes rise and fall on every tick, within the two pin writes of one ISR call
+  for (unsigned long k = 0; k < 300; k++) {
+    long skew = (long)(logs[1].pulseTime[k] - logs[0].pulseTime[k]);
+    TEST_ASSERT_TRUE(skew >= 0 && skew <= 2 * HAL_CALL_US);
+  }
+  TEST_ASSERT_EQUAL(LOW, logs[1].dirLevel);
+  TEST_ASSERT_EQUAL(300, Steppers.getPosition(0));
+  TEST_ASSERT_EQUAL(-300, Steppers.getPosition(1));
+}
+
+void test_phase_offset_leads_the_heel() {
+  const long phase = 120;
+  TEST_ASSERT_EQUAL_UINT32(520, StepEngine::linkedTicks(400, 300, phase));
+  TEST_ASSERT_TRUE(Steppers.linkedMove(true, 400, true, 300, phase, SPEED));
+  waitDone(1000000UL);
+  // Axis 1 starts on tick 0, axis 0 'phase' ticks later, each over a window of the larger step count
+  unsigned long firstTick = firstTickTime();
+  checkSpread(1, 300, 400, 0, firstTick);
+  checkSpread(0, 400, 400, phase, firstTick);
+  TEST_ASSERT_EQUAL_UINT32(phase + 399, tickOf(logs[0].pulseTime[399], firstTick));
+  TEST_ASSERT_EQUAL(400, Steppers.getPosition(0));
+  TEST_ASSERT_EQUAL(300, Steppers.getPosition(1));
+}
+
+void test_negative_phase_leads_the_forefoot() {
+  TEST_ASSERT_TRUE(Steppers.linkedMove(false, 200, true, 500, -50, SPEED));
+  waitDone(1000000UL);
+  unsigned long firstTick = firstTickTime();
+  checkSpread(0, 200, 500, 0, firstTick);
+  checkSpread(1, 500, 500, 50, firstTick);
+  TEST_ASSERT_EQUAL(-200, Steppers.getPosition(0));
+  TEST_ASSERT_EQUAL(500, Steppers.getPosition(1));
+}
+
+void test_linked_move_owns_both_axes() {
+  TEST_ASSERT_TRUE(Steppers.queueMove(1, true, 50, SPEED));
+  TEST_ASSERT_FALSE(Steppers.linkedMove(true, 10, true, 10, 0, SPEED)); // Axis 1 busy
+  waitDone(1000000UL);
+  TEST_ASSERT_TRUE(Steppers.linkedMove(true, 100, true, 100, 0, SPEED));
+  TEST_ASSERT_FALSE(Steppers.queueMove(0, true, 10, SPEED));
+  TEST_ASSERT_FALSE(Steppers.queueMove(1, true, 10, SPEED));
+  TEST_ASSERT_FALSE(Steppers.linkedMove(true, 10, true, 10, 0, SPEED));
+  TEST_ASSERT_FALSE(Steppers.isMoveDone(1));
+  waitDone(1000000UL);
+  TEST_ASSERT_EQUAL(100, Steppers.getPosition(0));
+  TEST_ASSERT_EQUAL(150, Steppers.getPosition(1));
+  TEST_ASSERT_TRUE(Steppers.queueMove(0, false, 100, SPEED)); // Free again
+  waitDone(1000000UL);
+  TEST_ASSERT_EQUAL(0, Steppers.getPosition(0));
+}
+
+void test_stop_ends_both_axes() {
+  TEST_ASSERT_TRUE(Steppers.linkedMove(true, 1000, true, 500, 0, SPEED));
+  Hal.advance(100UL * 2 * SPEED);
+  Steppers.stop(1);
+  waitDone(10000UL);
+  TEST_ASSERT_UINT32_WITHIN(2, 100, logs[0].pulses);
+  TEST_ASSERT_UINT32_WITHIN(2, 50, logs[1].pulses);
+  TEST_ASSERT_EQUAL((long)logs[0].pulses, Steppers.getPosition(0));
+  TEST_ASSERT_EQUAL((long)logs[1].pulses, Steppers.getPosition(1));
+  TEST_ASSERT_EQUAL(LOW, Hal.getLevel(PUL_PIN_0));
+}
+
+void test_profiled_linked_move() {
+  MotionProfile profile;
+  MotionLimits limits = {6000, 12000, 0, 500};
+  unsigned long ticks = StepEngine::linkedTicks(1500, 900, 40);
+  profile.plan(ticks, limits);
+  unsigned long start = Hal.now();
+  TEST_ASSERT_TRUE(Steppers.linkedMove(true, 1500, true, 900, 40, profile));
+  waitDone(5000000UL);
+  TEST_ASSERT_EQUAL_UINT32(1500, logs[0].pulses);
+  TEST_ASSERT_EQUAL_UINT32(900, logs[1].pulses);
+  TEST_ASSERT_EQUAL(1500, Steppers.getPosition(0));
+  TEST_ASSERT_EQUAL(900, Steppers.getPosition(1));
+  // The timeline follows the profile: one tick of 2 * intervalAt(tick) per step of the plan
+  unsigned long planned = 0;
+  for (unsigned long k = 0; k < ticks; k++) planned += 2UL * profile.intervalAt(k);
+  TEST_ASSERT_UINT32_WITHIN(planned / 100, planned, logs[0].lastFall - start);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_axes_start_and_finish_together);
+  RUN_TEST(test_pulses_of_both_axes_share_the_tick_edges);
+  RUN_TEST(test_phase_offset_leads_the_heel);
+  RUN_TEST(test_negative_phase_leads_the_forefoot);
+  RUN_TEST(test_linked_move_owns_both_axes);
+  RUN_TEST(test_stop_ends_both_axes);
+  RUN_TEST(test_profiled_linked_move);
+  return UNITY_END();
+}
@@ -0,0 +1,139 @@
+/*
+ * test_load_cell_sampler
+ * Interrupt-driven reads of two HX711 models while the foreground is busy:
+ * one channel on a DOUT pin without an interrupt (Timer4 poll, as the rig's
+ * pins 4 and 6), one on INT0, with a step engine axis pulsing alongside.
+ * No conversion may be lost at either HX711 rate.
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <HX711_ADC.h>
+#include <Hx711Model.h>
+#include <Hx711Inputs.h>
+#include <LoadCellSampler.h>
+#include <SampleRing.h>
+#include <StepEngine.h>
+
+#define POLL_DOUT_PIN 4
+#define POLL_SCK_PIN 5
+#define INT_DOUT_PIN 2 // INT0
+#define INT_SCK_PIN 7
+#define DIR_PIN 22
+#define PUL_PIN 23
+#define RUN_SECONDS 20
+
+static long constantInput(void *context) {
+  return *(long *)context;
+}
+
+static long pollInput = 120000;
+static long intInput = -45000;
+static Hx711Model pollModel;
+static Hx711Model intModel;
+static HX711_ADC pollCell(POLL_DOUT_PIN, POLL_SCK_PIN);
+static HX711_ADC intCell(INT_DOUT_PIN, INT_SCK_PIN);
+static int8_t pollChannel = -1;
+static int8_t intChannel = -1;
+static unsigned long pollOverwritten; // Model counts when sampling started
+static unsigned long intOverwritten;
+
+static void discardOutput(const uint8_t *, size_t, void *) {}
+
+// Start both models and cells at 'rate', then interrupt-driven sampling
+static void startSampling(uint8_t rate) {
+  pollModel = Hx711Model();
+  intModel = Hx711Model();
+  pollModel.begin(POLL_DOUT_PIN, POLL_SCK_PIN, rate, constantInput, &pollInput);
+  intModel.begin(INT_DOUT_PIN, INT_SCK_PIN, rate, constantInput, &intInput);
+  Hal.addPinHook(hx711ModelPin, &pollModel);
+  Hal.addPinHook(hx711ModelPin, &intModel);
+  pollCell.begin();
+  intCell.begin();
+  pollCell.setSampleRate(rate);
+  intCell.setSampleRate(rate);
+  pollCell.start(0, false);
+  intCell.start(0, false);
+  if (pollChannel < 0) pollChannel = Sampler.attach(pollCell, POLL_DOUT_PIN);
+  if (intChannel < 0) intChannel = Sampler.attach(intCell, INT_DOUT_PIN);
+  TEST_ASSERT_EQUAL(0, pollChannel);
+  TEST_ASSERT_EQUAL(1, intChannel);
+  Samples.clear();
+  Sampler.begin();
+  pollOverwritten = pollModel.getOverwritten();
+  intOverwritten = intModel.getOverwritten();
+}
+
+// Foreground that is slow to come back: long delays, serial output and the ring drained in bursts
+static void runBusyLoop(unsigned long seconds) {
+  unsigned long end = Hal.now() + seconds * 1000000UL;
+  LoadCellSample sample;
+  while ((long)(Hal.now() - end) < 0) {
+    delay(40);
+    Serial.println(Sampler.getForce_mN(0));
+    Sampler.getData(1);
+    while (Samples.pop(sample)) {}
+  }
+}
+
+static void checkNoneMissed(uint8_t rate) {
+  for (uint8_t c = 0; c < SAMPLER_CHANNELS; c++) {
+    TEST_ASSERT_EQUAL_UINT32(0, Sampler.getMissedCount(c));
+    TEST_ASSERT_UINT32_WITHIN(2, (unsigned long)rate * RUN_SECONDS, Sampler.getSampleCount(c));
+  }
+  TEST_ASSERT_EQUAL_UINT32(pollOverwritten, pollModel.getOverwritten());
+  TEST_ASSERT_EQUAL_UINT32(intOverwritten, intModel.getOverwritten());
+  TEST_ASSERT_EQUAL_UINT32(0, Samples.getOverflowCount());
+}
+
+void setUp() {
+  Hal.reset();
+  Serial.setSink(discardOutput, 0);
+  Steppers.attach(0, DIR_PIN, PUL_PIN);
+  Steppers.begin();
+}
+
+void tearDown() {
+  Sampler.end();
+  Steppers.stop(0);
+}
+
+void test_no_samples_missed_at_10_sps() {
+  startSampling(10);
+  TEST_ASSERT_TRUE(Steppers.queueMove(0, true, STEP_CONTINUOUS, 100));
+  runBusyLoop(RUN_SECONDS);
+  checkNoneMissed(10);
+  TEST_ASSERT_EQUAL_HEX32(120000 ^ 0x800000, pollCell.getLastConversionRaw());
+  TEST_ASSERT_EQUAL_HEX32((-45000 & 0xFFFFFF) ^ 0x800000, intCell.getLastConversionRaw());
+}
+
+void test_no_samples_missed_at_80_sps() {
+  startSampling(80);
+  TEST_ASSERT_TRUE(Steppers.queueMove(0, true, STEP_CONTINUOUS, MOTION_MIN_INTERVAL));
+  runBusyLoop(RUN_SECONDS);
+  checkNoneMissed(80);
+  TEST_ASSERT_TRUE(Steppers.getPosition(0) > 0);
+}
+
+void test_missed_conversions_are_counted() {
+  startSampling(80);
+  runBusyLoop(1);
+  unsigned long samples = Sampler.getSampleCount(0);
+  // Interrupts held off for 100 ms: the model overwrites the unread conversions
+  noInterrupts();
+  Hal.advance(100000UL);
+  interrupts();
+  runBusyLoop(1);
+  TEST_ASSERT_UINT32_WITHIN(1, 7, Sampler.getMissedCount(0));
+  TEST_ASSERT_UINT32_WITHIN(1, 7, Sampler.getMissedCount(1));
+  TEST_ASSERT_TRUE(Sampler.getSampleCount(0) > samples);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_no_samples_missed_at_10_sps);
+  RUN_TEST(test_no_samples_missed_at_80_sps);
+  RUN_TEST(test_missed_conversions_are_counted);
+  return UNITY_END();
+}
@@ -0,0 +1,254 @@
+/*
+ * test_load_cell_setup
+ * LoadCellSetup's start-up and calibration dialog driven by scripted
+ * operator input (Serial.inject()), with an Hx711Model as the load cell and
+ * the serial output captured. Covers each path through the dialog (known
+ * mass, manual value, keeping the saved value, saving or not), invalid
+ * answers, a number ended by the input timeout, answers queued before the
+ * start-up has finished, and useSaved() keeping the saved tare offset.
+ */
+
+#include <unity.h>
+#include <string.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <EEPROM.h>
+#include <HX711_ADC.h>
+#include <LoadCellSetup.h>
+#include <ConfigStore.h>
+#include <Hx711Model.h>
+
+#define DOUT_PIN 4
+#define SCK_PIN 5
+#define CHANNEL 0
+#define STABILIZING_TIME 500 // ms
+#define EMPTY 10000L // Input of the unloaded cell (counts)
+#define CAL_FACTOR 421.7 // Counts per g of the simulated cell
+#define MASS 100 // g
+
+static Hx711Model model;
+static long input;
+static char output[8192];
+static size_t outputLength;
+
+static long cellInput(void *) {
+  return input;
+}
+
+static void modelPin(uint8_t pin, uint8_t level, void *) {
+  model.onPin(pin, level);
+}
+
+static void capture(const uint8_t *data, size_t length, void *) {
+  if (length > sizeof(output) - 1 - outputLength) length = sizeof(output) - 1 - outputLength;
+  memcpy(output + outputLength, data, length);
+  outputLength += length;
+  output[outputLength] = 0;
+}
+
+// The output since the last check contained 'text'
+static bool printed(const char *text) {
+  bool found = strstr(output, text) != 0;
+  outputLength = 0;
+  output[0] = 0;
+  return found;
+}
+
+// update() until the dialog reaches 'state' (and the start-up has finished, if 'started')
+static void runUntil(LoadCellSetup &dialog, uint8_t state, bool started = true) {
+  unsigned long deadline = Hal.now() + 10000000UL;
+  while (dialog.getState() != state || (started && !dialog.isStarted())) {
+    TEST_ASSERT_TRUE_MESSAGE((long)(Hal.now() - deadline) < 0, "dialog stuck");
+    dialog.update();
+    yield();
+  }
+}
+
+// update() for 'ms' of virtual time
+static void runFor(LoadCellSetup &dialog, unsigned long ms) {
+  unsigned long end = Hal.now() + ms * 1000UL;
+  while ((long)(Hal.now() - end) < 0) {
+    dialog.update();
+    yield();
+  }
+}
+
+void setUp() {
+  Hal.reset();
+  while (Serial.available() > 0) Serial.read();
+  Serial.setSink(capture, 0);
+  printed("");
+  memset(EEPROM.data(), 0xFF, HAL_EEPROM_SIZE);
+  Config.begin();
+  input = EMPTY;
+  model = Hx711Model();
+  model.begin(DOUT_PIN, SCK_PIN, 80, cellInput, 0);
+  Hal.addPinHook(modelPin, 0);
+}
+
+void tearDown() {
+  Serial.setSink(0, 0);
+}
+
+// A load cell and its dialog, as setup() in src/main.cpp starts them
+static void start(HX711_ADC &cell, LoadCellSetup &dialog) {
+  cell.begin();
+  dialog.begin(cell, Serial, CHANNEL, STABILIZING_TIME);
+}
+
+void test_startup_runs_while_the_question_is_asked() {
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  LoadCellSetup dialog;
+  start(cell, dialog);
+  dialog.ask();
+  runFor(dialog, STABILIZING_TIME / 2);
+  TEST_ASSERT_FALSE(dialog.isStarted());
+  runUntil(dialog, CALIBRATION_CHOOSE);
+  TEST_ASSERT_TRUE(dialog.isStarted());
+  TEST_ASSERT_FALSE(dialog.isDone());
+  TEST_ASSERT_EQUAL(EMPTY + 0x800000L, cell.getTareOffset());
+  runFor(dialog, 2000);
+  TEST_ASSERT_EQUAL(CALIBRATION_CHOOSE, dialog.getState());
+}
+
+void test_automatic_calibration() {
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  LoadCellSetup dialog;
+  start(cell, dialog);
+  dialog.ask();
+  Serial.inject("y");
+  runUntil(dialog, CALIBRATION_TARE_KEY);
+  TEST_ASSERT_TRUE(printed("Performing automatic calibration..."));
+  Serial.inject("t");
+  runUntil(dialog, CALIBRATION_MASS);
+  TEST_ASSERT_TRUE(printed("Tare complete"));
+  input = EMPTY + (long)(CAL_FACTOR * MASS);
+  Serial.inject("abc\n");
+  runFor(dialog, 100);
+  TEST_ASSERT_TRUE(printed("Invalid mass input."));
+  TEST_ASSERT_EQUAL(CALIBRATION_MASS, dialog.getState());
+  Serial.inject("100\n");
+  runUntil(dialog, CALIBRATION_SAVE);
+  TEST_ASSERT_TRUE(printed("Known mass is: 100.00"));
+  TEST_ASSERT_FLOAT_WITHIN(0.05, CAL_FACTOR, dialog.getCalFactor());
+  Serial.inject("y");
+  runUntil(dialog, CALIBRATION_DONE);
+  TEST_ASSERT_TRUE(printed("saved to EEPROM."));
+  TEST_ASSERT_TRUE(dialog.isDone());
+  TEST_ASSERT_EQUAL_FLOAT(dialog.getCalFactor(), Config.getCalFactor(CHANNEL));
+  // Saved, so a restart takes it from EEPROM
+  Config.begin();
+  TEST_ASSERT_EQUAL(CONFIG_LOADED, Config.getSource());
+  TEST_ASSERT_EQUAL_FLOAT(dialog.getCalFactor(), Config.getCalFactor(CHANNEL));
+}
+
+void test_manual_script_sent_at_once() {
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  LoadCellSetup dialog;
+  start(cell, dialog);
+  // As [env:rig] -i sends it, before the start-up has finished
+  dialog.ask();
+  Serial.inject("m420 n");
+  runUntil(dialog, CALIBRATION_DONE);
+  TEST_ASSERT_TRUE(printed("Value not saved to EEPROM"));
+  TEST_ASSERT_EQUAL_FLOAT(420, dialog.getCalFactor());
+  TEST_ASSERT_FALSE(Config.isCalibrated(CHANNEL));
+  TEST_ASSERT_FALSE(Serial.available() > 0);
+}
+
+void test_number_ended_by_timeout() {
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  LoadCellSetup dialog;
+  start(cell, dialog);
+  dialog.ask();
+  Serial.inject("m14.4");
+  runUntil(dialog, CALIBRATION_MANUAL, false); // The number is read at once, nothing follows it
+  runFor(dialog, LOAD_CELL_SETUP_NUMBER_TIMEOUT - 100);
+  TEST_ASSERT_EQUAL(CALIBRATION_MANUAL, dialog.getState());
+  runFor(dialog, 200);
+  TEST_ASSERT_EQUAL(CALIBRATION_SAVE, dialog.getState());
+  TEST_ASSERT_EQUAL_FLOAT(14.4, dialog.getCalFactor());
+}
+
+void test_invalid_answers_are_asked_again() {
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  LoadCellSetup dialog;
+  start(cell, dialog);
+  dialog.ask();
+  Serial.inject("x");
+  runFor(dialog, 100);
+  TEST_ASSERT_TRUE(printed("Invalid input. Please enter 'y' for regular calibration"));
+  TEST_ASSERT_EQUAL(CALIBRATION_CHOOSE, dialog.getState());
+  Serial.inject("m 0 12.5\n");
+  runUntil(dialog, CALIBRATION_SAVE);
+  TEST_ASSERT_EQUAL_FLOAT(12.5, dialog.getCalFactor()); // 0 is not a calibration factor
+  Serial.inject("q");
+  runFor(dialog, 100);
+  TEST_ASSERT_TRUE(printed("Invalid input. Please enter 'y' or 'n'."));
+  TEST_ASSERT_EQUAL(CALIBRATION_SAVE, dialog.getState());
+  Serial.inject("y");
+  runUntil(dialog, CALIBRATION_DONE);
+  TEST_ASSERT_EQUAL_FLOAT(12.5, Config.getCalFactor(CHANNEL));
+}
+
+void test_keep_saved_value() {
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  LoadCellSetup dialog;
+  start(cell, dialog);
+  dialog.ask();
+  Serial.inject("n");
+  runUntil(dialog, CALIBRATION_DONE);
+  TEST_ASSERT_TRUE(printed("Warning: Calibration value is invalid or not set."));
+  TEST_ASSERT_EQUAL_FLOAT(1.0, dialog.getCalFactor());
+
+  Config.setCalFactor(CHANNEL, 433.3);
+  TEST_ASSERT_TRUE(Config.save());
+  dialog.ask(); // Asked again once finished
+  TEST_ASSERT_EQUAL(CALIBRATION_CHOOSE, dialog.getState());
+  Serial.inject("n");
+  runUntil(dialog, CALIBRATION_DONE);
+  TEST_ASSERT_TRUE(printed("Saved Value: 433.30"));
+  TEST_ASSERT_EQUAL_FLOAT(433.3, dialog.getCalFactor());
+}
+
+void test_tare_key_waits_for_the_startup() {
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  LoadCellSetup dialog;
+  start(cell, dialog);
+  dialog.ask();
+  Serial.inject("yt");
+  runUntil(dialog, CALIBRATION_TARE_KEY, false);
+  TEST_ASSERT_FALSE(dialog.isStarted());
+  TEST_ASSERT_TRUE(Serial.available() > 0); // 't' stays queued
+  runUntil(dialog, CALIBRATION_MASS);
+  TEST_ASSERT_TRUE(printed("Tare complete"));
+}
+
+void test_use_saved_keeps_the_tare_offset() {
+  HX711_ADC cell(DOUT_PIN, SCK_PIN);
+  LoadCellSetup dialog;
+  start(cell, dialog);
+  const long saved = EMPTY + 0x800000L - 5000; // Tared with less load than now
+  Config.setCalFactor(CHANNEL, 421.7);
+  Config.setTareOffset(CHANNEL, saved);
+  TEST_ASSERT_TRUE(Config.save());
+  dialog.useSaved();
+  runUntil(dialog, CALIBRATION_DONE);
+  TEST_ASSERT_TRUE(dialog.isDone());
+  TEST_ASSERT_EQUAL(saved, cell.getTareOffset());
+  TEST_ASSERT_EQUAL_FLOAT(421.7, dialog.getCalFactor());
+  TEST_ASSERT_EQUAL(0, outputLength); // No dialog
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_startup_runs_while_the_question_is_asked);
+  RUN_TEST(test_automatic_calibration);
+  RUN_TEST(test_manual_script_sent_at_once);
+  RUN_TEST(test_number_ended_by_timeout);
+  RUN_TEST(test_invalid_answers_are_asked_again);
+  RUN_TEST(test_keep_saved_value);
+  RUN_TEST(test_tare_key_waits_for_the_startup);
+  RUN_TEST(test_use_saved_keeps_the_tare_offset);
+  return UNITY_END();
+}
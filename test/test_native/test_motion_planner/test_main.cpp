@@ -0,0 +1,103 @@
+/*
+ * test_motion_planner
+ * The integer interval table read by the step ISR (intervalAt()) against the
+ * analytic profile it is built from (velocityAt(), getDuration()), for a
+ * trapezoid, an S-curve and moves too short to reach cruise speed.
+ */
+
+#include <unity.h>
+#include <math.h>
+#include <MotionPlanner.h>
+
+#define INTERVAL_TOLERANCE 0.03 // Largest relative error of one interval (table interpolation and rounding)
+#define DURATION_TOLERANCE 0.005 // Largest relative error of the summed intervals
+
+// Limits of the rig's fast moves (src/main.cpp), with a start speed for a 1 ms edge time
+static const MotionLimits trapezoid = {6000, 12000, 0, 500};
+static const MotionLimits sCurve = {6000, 12000, 120000, 500};
+
+static float analyticInterval(MotionProfile &profile, unsigned long step) {
+  float us = 500000.0 / profile.velocityAt(step + 0.5); // Middle of the microstep
+  return (us < MOTION_MIN_INTERVAL) ? MOTION_MIN_INTERVAL : us;
+}
+
+// Every interval close to the analytic one, the sum close to the analytic duration,
+// the deceleration ramp a mirror of the acceleration ramp and no interval shortening on the way down
+static void checkProfile(MotionProfile &profile) {
+  unsigned long steps = profile.getSteps();
+  float total = 0;
+  for (unsigned long i = 0; i < steps; i++) {
+    unsigned int interval = profile.intervalAt(i);
+    float expected = analyticInterval(profile, i);
+    TEST_ASSERT_FLOAT_WITHIN(expected * INTERVAL_TOLERANCE, expected, interval);
+    TEST_ASSERT_EQUAL(interval, profile.intervalAt(steps - 1 - i));
+    if (i > 0 && i < steps / 2) TEST_ASSERT_TRUE(interval <= profile.intervalAt(i - 1));
+    total += 2.0 * interval; // High and low
+  }
+  float duration = profile.getDuration() * 1e6;
+  TEST_ASSERT_FLOAT_WITHIN(duration * DURATION_TOLERANCE, duration, total);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_trapezoid_matches_the_analytic_profile() {
+  MotionProfile profile;
+  profile.plan(20000, trapezoid);
+  // v^2 = v0^2 + 2 a s
+  float rampLength = (6000.0 * 6000.0 - 500.0 * 500.0) / (2 * 12000.0);
+  TEST_ASSERT_UINT32_WITHIN(1, (unsigned long)rampLength, profile.getRampSteps());
+  TEST_ASSERT_EQUAL(83, profile.intervalAt(10000)); // Cruise, 500000 / 6000 rounded
+  checkProfile(profile);
+}
+
+void test_s_curve_matches_the_analytic_profile() {
+  MotionProfile profile;
+  profile.plan(20000, sCurve);
+  MotionProfile linear;
+  linear.plan(20000, trapezoid);
+  TEST_ASSERT_TRUE(profile.getRampSteps() > linear.getRampSteps()); // Jerk limiting lengthens the ramp
+  TEST_ASSERT_TRUE(profile.getDuration() > linear.getDuration());
+  checkProfile(profile);
+  // Acceleration starts from zero: the first intervals shorten far less than on the trapezoid
+  TEST_ASSERT_TRUE(4 * (profile.intervalAt(0) - profile.intervalAt(10)) < linear.intervalAt(0) - linear.intervalAt(10));
+}
+
+void test_triangle_never_reaches_cruise() {
+  MotionProfile profile;
+  profile.plan(1000, trapezoid);
+  TEST_ASSERT_EQUAL_UINT32(500, profile.getRampSteps());
+  // Peak speed where the two ramps meet: v^2 = v0^2 + 2 a (steps / 2)
+  float vPeak = sqrt(500.0 * 500.0 + 2 * 12000.0 * 500);
+  TEST_ASSERT_FLOAT_WITHIN(1, vPeak, profile.velocityAt(500));
+  TEST_ASSERT_TRUE(profile.intervalAt(499) > 500000 / 6000);
+  checkProfile(profile);
+}
+
+void test_truncated_s_curve_never_reaches_cruise() {
+  MotionProfile profile;
+  profile.plan(1000, sCurve);
+  TEST_ASSERT_EQUAL_UINT32(500, profile.getRampSteps());
+  TEST_ASSERT_TRUE(profile.velocityAt(500) < 6000);
+  checkProfile(profile);
+}
+
+void test_move_at_start_speed_has_no_ramp() {
+  MotionProfile profile;
+  MotionLimits slow = {400, 12000, 0, 500}; // Cruise below the start speed
+  profile.plan(300, slow);
+  TEST_ASSERT_EQUAL_UINT32(0, profile.getRampSteps());
+  for (unsigned long i = 0; i < 300; i++) TEST_ASSERT_EQUAL(1000, profile.intervalAt(i));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 0.6, profile.getDuration());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_trapezoid_matches_the_analytic_profile);
+  RUN_TEST(test_s_curve_matches_the_analytic_profile);
+  RUN_TEST(test_triangle_never_reaches_cruise);
+  RUN_TEST(test_truncated_s_curve_never_reaches_cruise);
+  RUN_TEST(test_move_at_start_speed_has_no_ramp);
+  return UNITY_END();
+}
@@ -0,0 +1,148 @@
+/*
+ * test_sample_ring
+ * SampleRing with two producers on HAL timers, one of them interruptible as
+ * the sampler's poll ISR, and a foreground consumer that is slow to come
+ * back: every record must arrive intact and in order, or be counted as an
+ * overflow. Plus the overflow and high water counters on their own.
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <SampleRing.h>
+
+#define PIN_TIMER 5 // Timer5, stands in for a DOUT pin interrupt
+#define POLL_TIMER 4 // Timer4, as the sampler's poll timer (nested)
+
+static SampleRing ring;
+
+struct Producer {
+  uint8_t channel;
+  unsigned long period; // Microseconds between pushes
+  unsigned long pushed; // Sequence number of the next record
+  unsigned long stored;
+};
+
+static Producer producers[2];
+
+// Raw value carries the channel and the sequence number so the consumer can check each record
+static long encode(uint8_t channel, unsigned long sequence) {
+  return (long)((sequence & 0x3FFFFF) | ((unsigned long)channel << 22));
+}
+
+static unsigned long produce(void *context) {
+  Producer &p = *(Producer *)context;
+  if (p.channel == 1) delayMicroseconds(30); // Poll ISR: a DOUT read, other timers may run meanwhile
+  if (ring.push(p.channel, encode(p.channel, p.pushed), Hal.now())) p.stored++;
+  p.pushed++;
+  return p.period;
+}
+
+static void startProducers(unsigned long pinPeriod, unsigned long pollPeriod) {
+  producers[0] = {0, pinPeriod, 0, 0};
+  producers[1] = {1, pollPeriod, 0, 0};
+  Hal.startTimer(PIN_TIMER, pinPeriod, produce, &producers[0]);
+  Hal.startTimer(POLL_TIMER, pollPeriod, produce, &producers[1], true);
+}
+
+static void stopProducers() {
+  Hal.stopTimer(PIN_TIMER);
+  Hal.stopTimer(POLL_TIMER);
+}
+
+// Pop everything waiting, checking order, content and timestamps
+static unsigned long drain(unsigned long next[2], unsigned long lastTime[2]) {
+  LoadCellSample sample;
+  unsigned long count = 0;
+  while (ring.pop(sample)) {
+    TEST_ASSERT_TRUE(sample.channel < 2);
+    unsigned long sequence = (unsigned long)sample.raw & 0x3FFFFF;
+    TEST_ASSERT_EQUAL(sample.channel, (unsigned long)sample.raw >> 22);
+    TEST_ASSERT_TRUE(sequence >= next[sample.channel]); // In order, gaps only where a push was refused
+    TEST_ASSERT_TRUE((long)(sample.timestamp - lastTime[sample.channel]) > 0);
+    next[sample.channel] = sequence + 1;
+    lastTime[sample.channel] = sample.timestamp;
+    count++;
+  }
+  return count;
+}
+
+void setUp() {
+  Hal.reset();
+  ring.clear();
+  LoadCellSample sample;
+  while (ring.pop(sample)) {}
+}
+
+void tearDown() {
+  stopProducers();
+}
+
+void test_records_survive_interrupt_load() {
+  unsigned long next[2] = {0, 0};
+  unsigned long lastTime[2] = {0, 0};
+  unsigned long popped = 0;
+  startProducers(170, 230);
+  for (unsigned int i = 0; i < 2000; i++) {
+    delayMicroseconds(1000 + (i % 7) * 300); // Uneven foreground work, never long enough to fill the ring
+    popped += drain(next, lastTime);
+  }
+  stopProducers();
+  popped += drain(next, lastTime);
+  TEST_ASSERT_EQUAL_UINT32(0, ring.getOverflowCount());
+  TEST_ASSERT_EQUAL_UINT32(producers[0].pushed + producers[1].pushed, popped);
+  TEST_ASSERT_EQUAL_UINT32(producers[0].pushed, next[0]);
+  TEST_ASSERT_EQUAL_UINT32(producers[1].pushed, next[1]);
+  TEST_ASSERT_TRUE(ring.getHighWater() < SAMPLE_RING_LENGTH - 1);
+}
+
+void test_overflows_are_counted_under_load() {
+  unsigned long next[2] = {0, 0};
+  unsigned long lastTime[2] = {0, 0};
+  unsigned long popped = 0;
+  startProducers(170, 230);
+  for (unsigned int i = 0; i < 200; i++) {
+    delayMicroseconds((i % 10 == 0) ? 20000 : 1000); // Every tenth pass stalls long enough to fill the ring
+    popped += drain(next, lastTime);
+  }
+  stopProducers();
+  popped += drain(next, lastTime);
+  unsigned long pushed = producers[0].pushed + producers[1].pushed;
+  TEST_ASSERT_TRUE(ring.getOverflowCount() > 0);
+  TEST_ASSERT_EQUAL_UINT32(pushed, popped + ring.getOverflowCount());
+  TEST_ASSERT_EQUAL_UINT32(producers[0].stored + producers[1].stored, popped);
+  TEST_ASSERT_EQUAL(SAMPLE_RING_LENGTH - 1, ring.getHighWater());
+}
+
+void test_overflow_counter() {
+  LoadCellSample sample;
+  for (uint8_t i = 0; i < SAMPLE_RING_LENGTH - 1; i++) TEST_ASSERT_TRUE(ring.push(0, i, i));
+  TEST_ASSERT_EQUAL(SAMPLE_RING_LENGTH - 1, ring.available());
+  TEST_ASSERT_FALSE(ring.push(1, 100, 100)); // One slot is kept free
+  TEST_ASSERT_FALSE(ring.push(1, 101, 101));
+  TEST_ASSERT_EQUAL_UINT32(2, ring.getOverflowCount());
+  TEST_ASSERT_EQUAL(SAMPLE_RING_LENGTH - 1, ring.getHighWater());
+  TEST_ASSERT_TRUE(ring.pop(sample));
+  TEST_ASSERT_EQUAL(0, sample.raw);
+  TEST_ASSERT_TRUE(ring.push(1, 102, 102)); // Room again after a pop
+  TEST_ASSERT_EQUAL_UINT32(2, ring.getOverflowCount());
+  for (uint8_t i = 1; i < SAMPLE_RING_LENGTH - 1; i++) {
+    TEST_ASSERT_TRUE(ring.pop(sample));
+    TEST_ASSERT_EQUAL(i, sample.raw);
+  }
+  TEST_ASSERT_TRUE(ring.pop(sample));
+  TEST_ASSERT_EQUAL(102, sample.raw);
+  TEST_ASSERT_EQUAL(1, sample.channel);
+  TEST_ASSERT_FALSE(ring.pop(sample));
+  ring.clear();
+  TEST_ASSERT_EQUAL_UINT32(0, ring.getOverflowCount());
+  TEST_ASSERT_EQUAL(0, ring.getHighWater());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_records_survive_interrupt_load);
+  RUN_TEST(test_overflows_are_counted_under_load);
+  RUN_TEST(test_overflow_counter);
+  return UNITY_END();
+}
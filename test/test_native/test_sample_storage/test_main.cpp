@@ -0,0 +1,213 @@
+/*
+ * test_sample_storage
+ * Packed 3-byte sample storage (HX711_Samples24) against the 4-byte layout
+ * (HX711_Samples32): the storage itself at the edges of the 24 bit range,
+ * where the top bit of a packed sample must not be sign extended, then the
+ * average and median filters on each storage with inputs crowding those
+ * edges, and a load cell on each storage reading HX711 conversions at
+ * +/-2^23 through the Hx711Model. Values, indexes and outputs must be
+ * identical throughout.
+ */
+
+#include <unity.h>
+#include <string.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <HX711_ADC.h>
+#include <Hx711Model.h>
+#include <Hx711Inputs.h>
+
+#define PACKED_DOUT_PIN 4
+#define PACKED_SCK_PIN 5
+#define WIDE_DOUT_PIN 6
+#define WIDE_SCK_PIN 7
+
+// Samples around the ends and the middle of the range of conversion24bit() (0 is out of range)
+static const long edgeSamples[] = {1, 2, 0x7FFFFE, 0x7FFFFF, 0x800000, 0x800001, 0xFFFFFE, 0xFFFFFF};
+#define EDGE_SAMPLES (sizeof(edgeSamples) / sizeof(edgeSamples[0]))
+
+static uint32_t randomState;
+
+static uint32_t nextRandom() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+// Edge samples a few counts apart, out of range conversions, and anything in the range
+static long nextSample() {
+  uint32_t r = nextRandom() % 100;
+  if (r < 5) return 0;
+  if (r < 80) {
+    long value = edgeSamples[nextRandom() % EDGE_SAMPLES] + (long)(nextRandom() % 7) - 3;
+    return (value < 1) ? 1 : (value > 0xFFFFFF ? 0xFFFFFF : value);
+  }
+  return 1 + nextRandom() % 0xFFFFFF;
+}
+
+template <class Packed, class Wide>
+static void compareFilters(uint32_t seed, unsigned long samples, int maxSamples) {
+  Packed packed;
+  Wide wide;
+  randomState = seed;
+  for (unsigned long i = 0; i < samples; i++) {
+    uint32_t action = nextRandom() % 1000;
+    if (action < 5) {
+      int inUse = nextRandom() % (maxSamples + 1); // 0 = back to the compiled size
+      long fill = edgeSamples[nextRandom() % EDGE_SAMPLES];
+      packed.setSamples(inUse, fill);
+      wide.setSamples(inUse, fill);
+    }
+    else if (action < 7) {
+      packed.resetIndex();
+      wide.resetIndex();
+    }
+    long value = nextSample();
+    packed.add(value);
+    wide.add(value);
+    TEST_ASSERT_EQUAL_HEX32(wide.value(), packed.value());
+    TEST_ASSERT_EQUAL(wide.index(), packed.index());
+    TEST_ASSERT_EQUAL(wide.samples(), packed.samples());
+    TEST_ASSERT_EQUAL(wide.slots(), packed.slots());
+  }
+}
+
+// Load cell input: blocks of conversions at the HX711's range ends and around zero, a count or two apart
+struct Inputs {
+  uint32_t state;
+  unsigned long count;
+};
+
+static const long edgeInputs[] = {-0x800000, -0x7FFFFF, 0x7FFFFF, -1, 0, 1, 0x7FFFFE, -0x7FFFFE};
+#define EDGE_INPUTS (sizeof(edgeInputs) / sizeof(edgeInputs[0]))
+#define BLOCK 40 // Conversions at each edge, more than the filters' settling
+
+static long nextInput(void *context) {
+  Inputs &inputs = *(Inputs *)context;
+  long base = edgeInputs[(inputs.count++ / BLOCK) % EDGE_INPUTS];
+  inputs.state ^= inputs.state << 13;
+  inputs.state ^= inputs.state >> 17;
+  inputs.state ^= inputs.state << 5;
+  long value = base + (long)(inputs.state % 5) - 2;
+  return (value < -0x800000) ? -0x800000 : (value > 0x7FFFFF ? 0x7FFFFF : value);
+}
+
+static Hx711Model packedModel;
+static Hx711Model wideModel;
+static Inputs packedInputs;
+static Inputs wideInputs;
+
+static void startModels() {
+  packedInputs = {2463534242UL, 0};
+  wideInputs = packedInputs;
+  packedModel = Hx711Model();
+  wideModel = Hx711Model();
+  packedModel.begin(PACKED_DOUT_PIN, PACKED_SCK_PIN, 80, nextInput, &packedInputs);
+  wideModel.begin(WIDE_DOUT_PIN, WIDE_SCK_PIN, 80, nextInput, &wideInputs);
+  Hal.addPinHook(hx711ModelPin, &packedModel);
+  Hal.addPinHook(hx711ModelPin, &wideModel);
+}
+
+static void readBoth(HX711_ADC_Base &packed, HX711_ADC_Base &wide) {
+  unsigned long reads = packedModel.getReads();
+  unsigned long wideReads = wideModel.getReads();
+  unsigned long deadline = Hal.now() + 1000000UL;
+  while (packedModel.getReads() == reads || wideModel.getReads() == wideReads) {
+    TEST_ASSERT_TRUE_MESSAGE((long)(Hal.now() - deadline) < 0, "no conversion within 1 s");
+    if (packedModel.getReads() == reads) packed.update();
+    if (wideModel.getReads() == wideReads) wide.update();
+    yield();
+  }
+}
+
+static void assertSameFloat(float expected, float actual) {
+  uint32_t a;
+  uint32_t b;
+  memcpy(&a, &expected, sizeof(a));
+  memcpy(&b, &actual, sizeof(b));
+  TEST_ASSERT_EQUAL_HEX32(a, b);
+}
+
+template <class PackedFilter, class WideFilter>
+static void compareLoadCells() {
+  startModels();
+  HX711_ADC_Filtered<PackedFilter> packed(PACKED_DOUT_PIN, PACKED_SCK_PIN);
+  HX711_ADC_Filtered<WideFilter> wide(WIDE_DOUT_PIN, WIDE_SCK_PIN);
+  packed.begin();
+  wide.begin();
+  packed.setCalFactor(-421.7);
+  wide.setCalFactor(-421.7);
+  packed.setForceScale(9.81);
+  wide.setForceScale(9.81);
+  for (unsigned int i = 0; i < 2 * BLOCK * EDGE_INPUTS; i++) {
+    readBoth(packed, wide);
+    TEST_ASSERT_EQUAL_HEX32(wide.getLastConversionRaw(), packed.getLastConversionRaw());
+    TEST_ASSERT_EQUAL(wide.getRawTared(), packed.getRawTared());
+    TEST_ASSERT_EQUAL(wide.getForce_mN(), packed.getForce_mN());
+    assertSameFloat(wide.getData(), packed.getData());
+    TEST_ASSERT_EQUAL(wide.getReadIndex(), packed.getReadIndex());
+    if (i % BLOCK == BLOCK / 2) { // A tare at each edge: negative offsets and the full span after it
+      packed.tareNoDelay();
+      wide.tareNoDelay();
+    }
+  }
+  TEST_ASSERT_EQUAL(wide.getTareOffset(), packed.getTareOffset());
+}
+
+void setUp() {
+  Hal.reset();
+}
+
+void tearDown() {}
+
+void test_storage_round_trip() {
+  HX711_Samples24<EDGE_SAMPLES + 2> packed;
+  HX711_Samples32<EDGE_SAMPLES + 2> wide;
+  for (uint8_t i = 0; i < EDGE_SAMPLES; i++) {
+    // Neighbours at the opposite end of the range, so a byte written to the wrong slot shows
+    long other = 0xFFFFFF - edgeSamples[i];
+    packed.set(i, other);
+    packed.set(i + 2, other);
+    packed.set(i + 1, edgeSamples[i]);
+    wide.set(i + 1, edgeSamples[i]);
+    TEST_ASSERT_EQUAL_HEX32(edgeSamples[i], packed.get(i + 1));
+    TEST_ASSERT_EQUAL_HEX32(wide.get(i + 1), packed.get(i + 1));
+    TEST_ASSERT_EQUAL_HEX32(other, packed.get(i));
+    TEST_ASSERT_EQUAL_HEX32(other, packed.get(i + 2));
+    TEST_ASSERT_TRUE(packed.get(i + 1) > 0); // 0x800000 and up stay positive
+  }
+  packed.set(0, 0);
+  TEST_ASSERT_EQUAL(0, packed.get(0));
+}
+
+void test_trimmed_average_storage() {
+  compareFilters<HX711_TrimmedAverage<16, 1, 1, HX711_Samples24>, HX711_TrimmedAverage<16, 1, 1, HX711_Samples32> >(1, 100000, 16);
+  compareFilters<HX711_TrimmedAverage<128, 1, 1, HX711_Samples24>, HX711_TrimmedAverage<128, 1, 1, HX711_Samples32> >(2, 100000, 128);
+  compareFilters<HX711_TrimmedAverage<8, 1, 0, HX711_Samples24>, HX711_TrimmedAverage<8, 1, 0, HX711_Samples32> >(3, 50000, 8);
+  compareFilters<HX711_TrimmedAverage<8, 0, 1, HX711_Samples24>, HX711_TrimmedAverage<8, 0, 1, HX711_Samples32> >(4, 50000, 8);
+  compareFilters<HX711_TrimmedAverage<16, 0, 0, HX711_Samples24>, HX711_TrimmedAverage<16, 0, 0, HX711_Samples32> >(5, 50000, 16);
+}
+
+void test_median_storage() {
+  compareFilters<HX711_Median<15, HX711_Samples24>, HX711_Median<15, HX711_Samples32> >(6, 100000, 15);
+  compareFilters<HX711_Median<63, HX711_Samples24>, HX711_Median<63, HX711_Samples32> >(7, 50000, 63);
+}
+
+void test_load_cells_at_range_edges() {
+  compareLoadCells<HX711_TrimmedAverage<16, 1, 1, HX711_Samples24>, HX711_TrimmedAverage<16, 1, 1, HX711_Samples32> >();
+}
+
+void test_median_load_cells_at_range_edges() {
+  compareLoadCells<HX711_Median<15, HX711_Samples24>, HX711_Median<15, HX711_Samples32> >();
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_storage_round_trip);
+  RUN_TEST(test_trimmed_average_storage);
+  RUN_TEST(test_median_storage);
+  RUN_TEST(test_load_cells_at_range_edges);
+  RUN_TEST(test_median_load_cells_at_range_edges);
+  return UNITY_END();
+}
@@ -0,0 +1,177 @@
+/*
+ * test_step_engine
+ * Pulse timing and queue behaviour of StepEngine on the Timer1/Timer3
+ * emulation of the native HAL, with the PUL and DIR pins watched through a
+ * pin hook.
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <StepEngine.h>
+
+#define DIR_PIN_0 22
+#define PUL_PIN_0 23
+#define DIR_PIN_1 24
+#define PUL_PIN_1 25
+#define MAX_EDGES 64
+
+struct Edge {
+  unsigned long time;
+  uint8_t pin;
+  uint8_t level;
+};
+
+static Edge edges[MAX_EDGES];
+static uint16_t edgeCount;
+static unsigned long pulses[STEP_AXES]; // Rising PUL edges per axis, past MAX_EDGES as well
+
+static void recordEdge(uint8_t pin, uint8_t level, void *) {
+  if (pin == PUL_PIN_0 && level) pulses[0]++;
+  if (pin == PUL_PIN_1 && level) pulses[1]++;
+  if (edgeCount < MAX_EDGES) {
+    edges[edgeCount].time = Hal.now();
+    edges[edgeCount].pin = pin;
+    edges[edgeCount].level = level;
+    edgeCount++;
+  }
+}
+
+// Let the timers run until the axis is idle, failing after 'timeout' microseconds of virtual time
+static void waitDone(uint8_t axis, unsigned long timeout) {
+  unsigned long deadline = Hal.now() + timeout;
+  while (!Steppers.isMoveDone(axis)) {
+    TEST_ASSERT_TRUE_MESSAGE((long)(Hal.now() - deadline) < 0, "move not done in time");
+    yield();
+  }
+}
+
+void setUp() {
+  Hal.reset();
+  edgeCount = 0;
+  pulses[0] = 0;
+  pulses[1] = 0;
+  Steppers.attach(0, DIR_PIN_0, PUL_PIN_0);
+  Steppers.attach(1, DIR_PIN_1, PUL_PIN_1);
+  Steppers.begin();
+  Hal.addPinHook(recordEdge, 0);
+}
+
+void tearDown() {
+  Steppers.stop(0);
+  Steppers.stop(1);
+}
+
+void test_fixed_rate_edge_times() {
+  const unsigned int speed = 150;
+  const unsigned long start = Hal.now();
+  TEST_ASSERT_TRUE(Steppers.queueMove(0, true, 10, speed));
+  waitDone(0, 100000UL);
+  // DIR first, then 10 pulses high for 'speed' and low for 'speed'
+  TEST_ASSERT_EQUAL(21, edgeCount);
+  TEST_ASSERT_EQUAL(DIR_PIN_0, edges[0].pin);
+  TEST_ASSERT_EQUAL(HIGH, edges[0].level);
+  TEST_ASSERT_EQUAL_UINT32(start + 2 + HAL_CALL_US, edges[0].time); // First compare 2 us after the move is queued, then the write
+  for (uint8_t i = 1; i < edgeCount; i++) {
+    TEST_ASSERT_EQUAL(PUL_PIN_0, edges[i].pin);
+    TEST_ASSERT_EQUAL((i & 1) ? HIGH : LOW, edges[i].level);
+    unsigned long expected = (i == 1) ? 10 : speed; // DIR setup time before the first rising edge
+    TEST_ASSERT_EQUAL_UINT32(expected, edges[i].time - edges[i - 1].time);
+  }
+  TEST_ASSERT_EQUAL(10, Steppers.getPosition(0));
+}
+
+void test_queue_full_rejects_the_next_move() {
+  // The ring keeps one slot free, and the first move is taken from the queue on the first compare
+  uint8_t accepted = 0;
+  while (Steppers.queueMove(1, true, 5, 100)) {
+    accepted++;
+    TEST_ASSERT_TRUE(accepted < 2 * STEP_QUEUE_LENGTH);
+  }
+  TEST_ASSERT_EQUAL(STEP_QUEUE_LENGTH - 1, accepted);
+  TEST_ASSERT_EQUAL(0, Steppers.queueSpace(1));
+  TEST_ASSERT_FALSE(Steppers.queueMove(1, true, 5, 100));
+  TEST_ASSERT_EQUAL(STEP_QUEUE_LENGTH - 1, Steppers.queueSpace(0)); // The other axis is unaffected
+  waitDone(1, 100000UL);
+  TEST_ASSERT_EQUAL(5 * (STEP_QUEUE_LENGTH - 1), Steppers.getPosition(1));
+  TEST_ASSERT_EQUAL(STEP_QUEUE_LENGTH - 1, Steppers.queueSpace(1));
+}
+
+void test_position_counts_both_directions() {
+  TEST_ASSERT_TRUE(Steppers.queueMove(0, true, 300, 20));
+  TEST_ASSERT_TRUE(Steppers.queueMove(0, false, 120, 20));
+  TEST_ASSERT_TRUE(Steppers.queueMove(0, true, 0, 20)); // Skipped
+  TEST_ASSERT_TRUE(Steppers.queueMove(1, false, 75, 30));
+  waitDone(0, 1000000UL);
+  waitDone(1, 1000000UL);
+  TEST_ASSERT_EQUAL(180, Steppers.getPosition(0));
+  TEST_ASSERT_EQUAL(-75, Steppers.getPosition(1));
+  TEST_ASSERT_EQUAL_UINT32(420, pulses[0]);
+  TEST_ASSERT_EQUAL_UINT32(75, pulses[1]);
+  TEST_ASSERT_EQUAL(LOW, Hal.getLevel(PUL_PIN_0));
+  TEST_ASSERT_EQUAL(LOW, Hal.getLevel(DIR_PIN_1));
+  Steppers.setPosition(0, -1000);
+  TEST_ASSERT_TRUE(Steppers.queueMove(0, true, 3, 20));
+  waitDone(0, 1000000UL);
+  TEST_ASSERT_EQUAL(-997, Steppers.getPosition(0));
+}
+
+void test_is_move_done_follows_the_move() {
+  TEST_ASSERT_TRUE(Steppers.isMoveDone(0));
+  TEST_ASSERT_TRUE(Steppers.queueMove(0, true, 4, 500));
+  TEST_ASSERT_FALSE(Steppers.isMoveDone(0)); // Queued, before the first compare
+  Hal.advance(1000);
+  TEST_ASSERT_FALSE(Steppers.isMoveDone(0));
+  TEST_ASSERT_TRUE(Steppers.getStepsRemaining(0) > 0);
+  Hal.advance(3000); // 2 + 10 + 8 edges * 500 us
+  TEST_ASSERT_FALSE(Steppers.isMoveDone(0)); // Last falling edge not yet reached
+  Hal.advance(100);
+  TEST_ASSERT_TRUE(Steppers.isMoveDone(0));
+  TEST_ASSERT_EQUAL(4, Steppers.getPosition(0));
+  TEST_ASSERT_EQUAL_UINT32(0, Steppers.getStepsRemaining(0));
+}
+
+void test_stop_ends_a_continuous_move() {
+  TEST_ASSERT_TRUE(Steppers.queueMove(1, true, STEP_CONTINUOUS, 50));
+  Hal.advance(10012); // 100 microsteps after the DIR setup time
+  TEST_ASSERT_FALSE(Steppers.isMoveDone(1));
+  Steppers.stop(1);
+  waitDone(1, 1000UL);
+  long position = Steppers.getPosition(1);
+  TEST_ASSERT_INT_WITHIN(1, 100, position);
+  Hal.advance(10000);
+  TEST_ASSERT_EQUAL(position, Steppers.getPosition(1));
+  TEST_ASSERT_EQUAL(LOW, Hal.getLevel(PUL_PIN_1));
+}
+
+void test_velocity_interval_is_never_idle() {
+  TEST_ASSERT_EQUAL(500, StepEngine::velocityInterval(1000));
+  TEST_ASSERT_EQUAL(MOTION_MIN_INTERVAL, StepEngine::velocityInterval(1e6));
+  // Slow speeds that would wrap a 16 bit interval to 0 (7.63 microsteps/s is 65536 us) stay at the longest interval
+  TEST_ASSERT_EQUAL(STEP_MAX_INTERVAL, StepEngine::velocityInterval(7.63));
+  TEST_ASSERT_EQUAL(STEP_MAX_INTERVAL, StepEngine::velocityInterval(0.5));
+  TEST_ASSERT_EQUAL(STEP_MAX_INTERVAL, StepEngine::velocityInterval(0));
+  TEST_ASSERT_EQUAL(STEP_MAX_INTERVAL, StepEngine::velocityInterval(-100));
+  // A continuous move slowed that far keeps running and stops when asked
+  TEST_ASSERT_TRUE(Steppers.queueMove(0, true, STEP_CONTINUOUS, 100));
+  Hal.advance(1000);
+  Steppers.setSpeed(0, StepEngine::velocityInterval(1));
+  Hal.advance(1000000UL);
+  TEST_ASSERT_FALSE(Steppers.isMoveDone(0));
+  long position = Steppers.getPosition(0);
+  Hal.advance(2UL * STEP_MAX_INTERVAL);
+  TEST_ASSERT_EQUAL(position + 1, Steppers.getPosition(0));
+  Steppers.stop(0);
+  waitDone(0, 2UL * STEP_MAX_INTERVAL + 1000);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fixed_rate_edge_times);
+  RUN_TEST(test_queue_full_rejects_the_next_move);
+  RUN_TEST(test_position_counts_both_directions);
+  RUN_TEST(test_is_move_done_follows_the_move);
+  RUN_TEST(test_stop_ends_a_continuous_move);
+  RUN_TEST(test_velocity_interval_is_never_idle);
+  return UNITY_END();
+}
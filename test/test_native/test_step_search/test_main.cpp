@@ -0,0 +1,227 @@
+/*
+ * test_step_search
+ * Calibration search for the step count against the simulated spring foot
+ * (lib/RigSim FootModel), as searchStepCount() in src/main.cpp: the
+ * closed-loop ForceController approach, then StepSearch refinement on the
+ * force measured at rest (one sample skipped, the next four averaged) at
+ * each position, approached forwards. For soft, rig and stiff feet, with
+ * and without hardening, the step target it returns must give the target
+ * force to within the force of one microstep there, after fewer
+ * measurements and in a fifth of the time of the earlier search that read the
+ * force after every revolution at the slow speed (as the firmware took
+ * it, through the default 16 + 2 sample trimmed average).
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <StepEngine.h>
+#include <ForceController.h>
+#include <StepSearch.h>
+#include <FootModel.h>
+#include <HX711_ADC_Filter.h>
+
+#define DIR_PIN 22
+#define PUL_PIN 23
+#define RATE 80 // SPS
+#define REVOLUTION 800 // Microsteps per revolution at 1/4 microstepping
+#define SLOW_INTERVAL 1000 // stepDelay_slow of the earlier search, since removed (us)
+#define FAST_INTERVAL 300 // stepDelay_fast (us)
+#define SEARCH_SAMPLES 4 // searchSamples
+#define SEARCH_BACKLASH 200 // searchBacklash (microsteps)
+
+// Settings of src/main.cpp at its default stepDelay_fast of 300 us
+static const ForceControlSettings control = {1.5, 0.05, 2000, 500, 200, 100, 1000000.0 / (2 * FAST_INTERVAL), 0.5, 3};
+
+static FootModel foot;
+static FootAxisSettings footAxis;
+static bool sampleNew;
+static float sampleForce;
+
+static void footStep(uint8_t pin, uint8_t level, void *) {
+  if (pin == PUL_PIN && level == HIGH) foot.step(0, Hal.getLevel(DIR_PIN) == HIGH);
+}
+
+static unsigned long footSample(void *) {
+  sampleForce = foot.force(0, Hal.now());
+  sampleNew = true;
+  return 1000000UL / RATE;
+}
+
+// Foot on axis 0 at its start position, with the step engine restarted
+static void startFoot(long contact, float stiffness, float hardening) {
+  Hal.reset();
+  Steppers.attach(0, DIR_PIN, PUL_PIN);
+  Steppers.begin();
+  FootSettings settings = {};
+  footAxis = {contact, stiffness, hardening, 2e-5, 0, 0};
+  settings.axis[0] = footAxis;
+  foot = FootModel();
+  foot.begin(settings);
+  Hal.addPinHook(footStep, 0);
+  Hal.startTimer(Hal.addDeviceTimer(), 1000, footSample, 0);
+}
+
+static float nextSample() {
+  unsigned long deadline = Hal.now() + 1000000UL;
+  sampleNew = false;
+  while (!sampleNew) {
+    TEST_ASSERT_TRUE_MESSAGE((long)(Hal.now() - deadline) < 0, "no sample within 1 s");
+    yield();
+  }
+  return sampleForce;
+}
+
+static void move(bool forward, unsigned long microsteps, unsigned int interval) {
+  TEST_ASSERT_TRUE(Steppers.queueMove(0, forward, microsteps, interval));
+  while (!Steppers.isMoveDone(0)) yield();
+}
+
+// driveToForce(): returns the stiffness the controller estimated on the way
+static float closedLoop() {
+  unsigned long start = Hal.now();
+  ForceController controller;
+  controller.begin(control);
+  int8_t running = 0;
+  while (!controller.isSettled()) {
+    TEST_ASSERT_TRUE_MESSAGE(Hal.now() - start < 30000000UL, "not settled within 30 s");
+    float force = nextSample();
+    int8_t direction = controller.update(force, Steppers.getPosition(0), Hal.now());
+    unsigned int interval = (direction != 0) ? StepEngine::velocityInterval(controller.getVelocity()) : 0;
+    if (direction != running) {
+      Steppers.stop(0);
+      while (!Steppers.isMoveDone(0)) yield();
+      if (direction != 0) Steppers.queueMove(0, direction > 0, STEP_CONTINUOUS, interval);
+      running = direction;
+    }
+    else if (direction != 0) {
+      Steppers.setSpeed(0, interval);
+    }
+  }
+  Steppers.stop(0);
+  while (!Steppers.isMoveDone(0)) yield();
+  return controller.getStiffness();
+}
+
+// settledForce()
+static float settledForce() {
+  nextSample();
+  float sum = 0;
+  for (int i = 0; i < SEARCH_SAMPLES; i++) sum += nextSample();
+  return sum / SEARCH_SAMPLES;
+}
+
+// moveMotorTo()
+static void moveTo(long position) {
+  long delta = position - Steppers.getPosition(0);
+  if (delta < 0) {
+    move(false, -delta + SEARCH_BACKLASH, FAST_INTERVAL);
+    delta = SEARCH_BACKLASH;
+  }
+  if (delta > 0) move(true, delta, FAST_INTERVAL);
+}
+
+struct Search {
+  unsigned long time; // us
+  long target; // Microsteps
+  uint8_t points; // Forces measured
+};
+
+// searchStepCount(), at a force tolerance of 0 so the search runs to microstep resolution
+static Search stepSearch() {
+  Search result;
+  unsigned long start = Hal.now();
+  StepSearch search;
+  search.begin(control.targetForce, 0, closedLoop());
+  long position = Steppers.getPosition(0);
+  while (true) {
+    search.addPoint(position, settledForce());
+    if (search.isDone()) break;
+    position = search.nextPosition();
+    moveTo(position);
+  }
+  moveTo(search.getBest());
+  result.time = Hal.now() - start;
+  result.target = search.getBest();
+  result.points = search.getPoints();
+  return result;
+}
+
+// The earlier calibration, as the firmware ran it: a revolution at the slow speed, then one conversion added to the
+// default HX711_ADC filter and its output compared, until the target is passed. The step count is whole revolutions.
+static Search perRevolution() {
+  Search result = {0, 0, 0};
+  HX711_TrimmedAverage<16, 1, 1> average;
+  average.setSamples(16, 0x800000L);
+  unsigned long start = Hal.now();
+  float force = 0;
+  while (force < control.targetForce) {
+    move(true, REVOLUTION, SLOW_INTERVAL);
+    average.add(0x800000L + lround(nextSample() * 1000));
+    force = (average.value() - 0x800000L) / 1000.0;
+    result.points++;
+  }
+  result.time = Hal.now() - start;
+  result.target = Steppers.getPosition(0);
+  return result;
+}
+
+static void checkSearch(long contact, float stiffness, float hardening) {
+  startFoot(contact, stiffness, hardening);
+  Search adaptive = stepSearch();
+  TEST_ASSERT_EQUAL(adaptive.target, Steppers.getPosition(0));
+  nextSample();
+  float force = nextSample(); // At rest at the target
+  float microstep = stiffness + hardening * (adaptive.target - contact); // Force of one microstep there
+  TEST_ASSERT_FLOAT_WITHIN(microstep, control.targetForce, force);
+  TEST_ASSERT_TRUE(adaptive.points <= STEP_SEARCH_MAX_POINTS);
+  startFoot(contact, stiffness, hardening);
+  Search earlier = perRevolution();
+  TEST_ASSERT_TRUE(adaptive.points < earlier.points);
+  TEST_ASSERT_TRUE(5 * adaptive.time < earlier.time);
+}
+
+void setUp() {
+  Hal.reset();
+  Steppers.attach(0, DIR_PIN, PUL_PIN);
+  Steppers.begin();
+}
+
+void tearDown() {
+  Steppers.stop(0);
+}
+
+void test_soft_foot() {
+  checkSearch(200, 0.0008, 0);
+}
+
+void test_soft_hardening_foot() {
+  checkSearch(200, 0.0008, 8e-7);
+}
+
+void test_rig_foot() {
+  checkSearch(400, 0.002, 0);
+}
+
+void test_rig_hardening_foot() {
+  checkSearch(400, 0.002, 2e-6);
+}
+
+void test_stiff_foot() {
+  checkSearch(300, 0.01, 0);
+}
+
+void test_stiff_hardening_foot() {
+  checkSearch(300, 0.01, 1e-5);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_soft_foot);
+  RUN_TEST(test_soft_hardening_foot);
+  RUN_TEST(test_rig_foot);
+  RUN_TEST(test_rig_hardening_foot);
+  RUN_TEST(test_stiff_foot);
+  RUN_TEST(test_stiff_hardening_foot);
+  return UNITY_END();
+}
@@ -0,0 +1,153 @@
+/*
+ * test_telemetry_frame
+ * COBS and CRC round trips of the telemetry framing, and rejection of
+ * corrupted, truncated and oversized frames by TelemetryDecoder.
+ */
+
+#include <unity.h>
+#include <string.h>
+#include <TelemetryFrame.h>
+
+static uint32_t randomState = 1;
+
+static uint8_t nextRandom() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return (uint8_t)randomState;
+}
+
+// Payload of 'length' bytes: random, with zero bytes more often than chance so COBS blocks vary
+static void fillPayload(uint8_t *payload, uint8_t length) {
+  for (uint8_t i = 0; i < length; i++) payload[i] = (nextRandom() < 64) ? 0 : nextRandom();
+}
+
+// Feed a whole encoded frame, returns the number of times feed() reported a frame
+static uint8_t feedFrame(TelemetryDecoder &decoder, const uint8_t *encoded, size_t length) {
+  uint8_t frames = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (decoder.feed(encoded[i])) frames++;
+  }
+  return frames;
+}
+
+void setUp() {
+  randomState = 2463534242UL;
+}
+
+void tearDown() {}
+
+void test_crc_check_value() {
+  const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  TEST_ASSERT_EQUAL_HEX16(0x29B1, telemetryCrc16(check, sizeof(check))); // CRC-16/CCITT-FALSE
+  TEST_ASSERT_EQUAL_HEX16(0xFFFF, telemetryCrc16(check, 0));
+  uint16_t partial = telemetryCrc16(check, 4);
+  TEST_ASSERT_EQUAL_HEX16(0x29B1, telemetryCrc16(check + 4, 5, partial)); // Continued over two calls
+}
+
+void test_cobs_round_trip() {
+  static uint8_t data[600];
+  static uint8_t encoded[620];
+  static uint8_t decoded[620];
+  static const size_t lengths[] = {1, 2, 3, 253, 254, 255, 256, 508, 600};
+  for (uint8_t pattern = 0; pattern < 3; pattern++) {
+    for (uint8_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+      size_t length = lengths[l];
+      for (size_t i = 0; i < length; i++) {
+        if (pattern == 0) data[i] = 0; // All zeros
+        else if (pattern == 1) data[i] = (uint8_t)(i % 255 + 1); // No zeros, runs past the 254 byte block limit
+        else data[i] = (nextRandom() < 32) ? 0 : nextRandom();
+      }
+      size_t encodedLength = cobsEncode(data, length, encoded);
+      TEST_ASSERT_TRUE(encodedLength <= length + length / 254 + 1);
+      TEST_ASSERT_NULL(memchr(encoded, 0, encodedLength)); // The delimiter never appears inside a frame
+      TEST_ASSERT_EQUAL_UINT32(length, cobsDecode(encoded, encodedLength, decoded));
+      TEST_ASSERT_EQUAL_MEMORY(data, decoded, length);
+    }
+  }
+}
+
+void test_frames_round_trip_through_the_decoder() {
+  TelemetryDecoder decoder;
+  uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+  uint8_t encoded[TELEMETRY_MAX_ENCODED];
+  for (unsigned int i = 0; i < 2000; i++) {
+    uint8_t length = nextRandom() % (TELEMETRY_MAX_PAYLOAD + 1);
+    uint8_t type = nextRandom();
+    fillPayload(payload, length);
+    size_t encodedLength = telemetryBuildFrame(type, (uint8_t)i, payload, length, encoded);
+    TEST_ASSERT_TRUE(encodedLength <= TELEMETRY_MAX_ENCODED);
+    TEST_ASSERT_EQUAL_HEX8(0, encoded[encodedLength - 1]);
+    TEST_ASSERT_EQUAL(1, feedFrame(decoder, encoded, encodedLength));
+    TEST_ASSERT_EQUAL_HEX8(type, decoder.type());
+    TEST_ASSERT_EQUAL((uint8_t)i, decoder.sequence());
+    TEST_ASSERT_EQUAL(length, decoder.length());
+    if (length) TEST_ASSERT_EQUAL_MEMORY(payload, decoder.payload(), length);
+  }
+  TEST_ASSERT_EQUAL_UINT32(2000, decoder.getFrameCount());
+  TEST_ASSERT_EQUAL_UINT32(0, decoder.getErrorCount());
+  TEST_ASSERT_EQUAL_UINT32(0, decoder.getLostCount());
+}
+
+void test_every_single_bit_error_is_rejected() {
+  TelemetryDecoder decoder;
+  uint8_t payload[12];
+  uint8_t encoded[TELEMETRY_MAX_ENCODED];
+  uint8_t corrupted[TELEMETRY_MAX_ENCODED];
+  fillPayload(payload, sizeof(payload));
+  size_t encodedLength = telemetryBuildFrame(TELEMETRY_SAMPLE, 7, payload, sizeof(payload), encoded);
+  unsigned long errors = 0;
+  for (size_t byte = 0; byte < encodedLength - 1; byte++) {
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      memcpy(corrupted, encoded, encodedLength);
+      corrupted[byte] ^= 1 << bit;
+      // A flipped bit that makes a 0x00 splits the frame in two, neither part may pass
+      TEST_ASSERT_EQUAL(0, feedFrame(decoder, corrupted, encodedLength));
+      TEST_ASSERT_TRUE(decoder.getErrorCount() > errors);
+      errors = decoder.getErrorCount();
+      TEST_ASSERT_EQUAL(1, feedFrame(decoder, encoded, encodedLength)); // The next good frame is still received
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(8 * (encodedLength - 1), decoder.getFrameCount());
+}
+
+void test_truncated_and_oversized_frames_are_rejected() {
+  TelemetryDecoder decoder;
+  uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+  uint8_t encoded[TELEMETRY_MAX_ENCODED];
+  fillPayload(payload, sizeof(payload));
+  size_t encodedLength = telemetryBuildFrame(TELEMETRY_FORCE, 1, payload, 6, encoded);
+  for (size_t cut = 1; cut < encodedLength - 1; cut++) {
+    for (size_t i = 0; i < cut; i++) decoder.feed(encoded[i]);
+    TEST_ASSERT_FALSE(decoder.feed(0)); // Delimiter early
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, decoder.getFrameCount());
+  TEST_ASSERT_EQUAL_UINT32(encodedLength - 2, decoder.getErrorCount());
+  // A run of non-zero bytes longer than any frame, then a good frame
+  for (unsigned int i = 0; i < 3 * TELEMETRY_MAX_ENCODED; i++) TEST_ASSERT_FALSE(decoder.feed(0x55));
+  TEST_ASSERT_FALSE(decoder.feed(0));
+  TEST_ASSERT_EQUAL(1, feedFrame(decoder, encoded, encodedLength));
+  TEST_ASSERT_EQUAL_UINT32(encodedLength - 1, decoder.getErrorCount());
+}
+
+void test_sequence_gaps_are_counted_as_lost() {
+  TelemetryDecoder decoder;
+  uint8_t encoded[TELEMETRY_MAX_ENCODED];
+  static const uint8_t sequences[] = {250, 251, 254, 255, 0, 3};
+  for (uint8_t i = 0; i < sizeof(sequences); i++) {
+    size_t encodedLength = telemetryBuildFrame(TELEMETRY_CYCLE, sequences[i], 0, 0, encoded);
+    TEST_ASSERT_EQUAL(1, feedFrame(decoder, encoded, encodedLength));
+  }
+  TEST_ASSERT_EQUAL_UINT32(4, decoder.getLostCount()); // 252, 253, 1, 2
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc_check_value);
+  RUN_TEST(test_cobs_round_trip);
+  RUN_TEST(test_frames_round_trip_through_the_decoder);
+  RUN_TEST(test_every_single_bit_error_is_rejected);
+  RUN_TEST(test_truncated_and_oversized_frames_are_rejected);
+  RUN_TEST(test_sequence_gaps_are_counted_as_lost);
+  return UNITY_END();
+}
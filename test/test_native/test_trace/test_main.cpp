@@ -0,0 +1,226 @@
+/*
+ * test_trace
+ * The event trace ring (lib/Trace): it keeps the latest TRACE_RECORDS
+ * records, overwriting the oldest, with each record claimed and stamped in
+ * one atomic step, so records from a nested ISR, the ISR it interrupts and
+ * the foreground all arrive intact and in time order. Pausing keeps only
+ * the TRACE_WRAP records, and a dump as dumpTrace() in src/main.cpp sends
+ * it as TELEMETRY_TRACE frames. Needs -D TRACE_ENABLED=1 ([env:native_trace]).
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Hal.h>
+#include <string.h>
+#include <Trace.h>
+#include <Telemetry.h>
+
+#if !TRACE_ENABLED
+#error "test_trace needs -D TRACE_ENABLED=1, run it with pio test -e native_trace"
+#endif
+
+#define READ_TIMER 3 // Stands in for a DOUT pin interrupt
+#define POLL_TIMER 4 // Nested, as the sampler's poll ISR
+#define WRAP_US (65536UL * TRACE_TICK_US) // Tick counter period
+
+struct Producer {
+  uint8_t event;
+  unsigned long period; // us
+  unsigned long recorded;
+};
+
+static Producer producers[2];
+
+static unsigned long produce(void *context) {
+  Producer &p = *(Producer *)context;
+  if (p.event == TRACE_STEP_START) { // Nested: a start and an end record, with other ISRs in between
+    Trace.record(TRACE_STEP_START, (uint8_t)p.recorded);
+    delayMicroseconds(30);
+    Trace.record(TRACE_STEP_END, (uint8_t)p.recorded);
+  }
+  else {
+    Trace.record(p.event, (uint8_t)p.recorded);
+  }
+  p.recorded++;
+  return p.period;
+}
+
+// Feeds each byte written to a decoder and keeps the TELEMETRY_TRACE frames
+class FrameCapture : public Print {
+  public:
+    size_t write(uint8_t c) {
+      if (decoder.feed(c) && decoder.type() == TELEMETRY_TRACE && frames < 64) {
+        lengths[frames] = decoder.length();
+        memcpy(payloads[frames], decoder.payload(), decoder.length());
+        frames++;
+      }
+      return 1;
+    }
+    TelemetryDecoder decoder;
+    uint8_t payloads[64][TELEMETRY_MAX_PAYLOAD];
+    uint8_t lengths[64];
+    uint8_t frames = 0;
+};
+
+static FrameCapture capture;
+
+// dumpTrace() in src/main.cpp
+static void dumpTrace() {
+  TraceRecord records[TELEMETRY_TRACE_RECORDS];
+  Trace.pause();
+  uint16_t end = Trace.end();
+  uint16_t index = Trace.first();
+  while (index != end) {
+    uint16_t start = index;
+    uint8_t count = 0;
+    while (count < TELEMETRY_TRACE_RECORDS && index != end) records[count++] = Trace.get(index++);
+    Telemetry.trace(start, records, count);
+  }
+  Telemetry.trace(end, records, 0);
+  Trace.resume();
+}
+
+void setUp() {
+  Hal.reset();
+  Trace.begin();
+  Trace.resume();
+}
+
+void tearDown() {
+  Hal.stopTimer(READ_TIMER);
+  Hal.stopTimer(POLL_TIMER);
+}
+
+void test_ring_keeps_the_latest_records() {
+  TEST_ASSERT_EQUAL(0, Trace.first());
+  TEST_ASSERT_EQUAL(0, Trace.end());
+  for (unsigned int i = 0; i < TRACE_RECORDS + 37; i++) {
+    Hal.advance(10);
+    Trace.record(TRACE_HX711_READ, (uint8_t)i);
+  }
+  TEST_ASSERT_EQUAL(TRACE_RECORDS + 37, Trace.end());
+  TEST_ASSERT_EQUAL(37, Trace.first()); // The oldest 37 were overwritten
+  for (uint16_t index = Trace.first(); index != Trace.end(); index++) {
+    TraceRecord r = Trace.get(index);
+    TEST_ASSERT_EQUAL(TRACE_HX711_READ, r.event);
+    TEST_ASSERT_EQUAL((uint8_t)index, r.data);
+    TEST_ASSERT_EQUAL((uint16_t)((index + 1) * 10 / TRACE_TICK_US), r.tick);
+  }
+}
+
+void test_record_since_saturates() {
+  uint16_t start = Trace.tick();
+  Hal.advance(100 * TRACE_TICK_US);
+  Trace.recordSince(TRACE_HX711_READ, start);
+  Hal.advance(1000 * TRACE_TICK_US);
+  Trace.recordSince(TRACE_HX711_READ, start);
+  TEST_ASSERT_EQUAL(100, Trace.get(0).data);
+  TEST_ASSERT_EQUAL(255, Trace.get(1).data);
+}
+
+void test_records_survive_interrupt_load() {
+  unsigned long next[3] = {0, 0, 0}; // Foreground, read ISR, poll ISR (its start records)
+  unsigned long ends = 0; // Poll ISR end records
+  unsigned long wraps = 0;
+  unsigned long recorded = 0;
+  uint16_t index = Trace.end();
+  uint16_t lastTick = 0;
+  producers[0] = {TRACE_HX711_READ, 170, 0};
+  producers[1] = {TRACE_STEP_START, 230, 0};
+  Hal.startTimer(READ_TIMER, 170, produce, &producers[0]);
+  Hal.startTimer(POLL_TIMER, 230, produce, &producers[1], true);
+  for (unsigned int i = 0; i < 3000; i++) {
+    Trace.record(TRACE_CYCLE_BEGIN, (uint8_t)i);
+    recorded++;
+    delayMicroseconds(500 + (i % 7) * 100); // Uneven foreground work, never long enough to fill the ring
+    if (i == 2999) {
+      Hal.stopTimer(READ_TIMER);
+      Hal.stopTimer(POLL_TIMER);
+    }
+    uint16_t end = Trace.end();
+    TEST_ASSERT_TRUE((uint16_t)(end - index) < TRACE_RECORDS); // Nothing overwritten before it was read
+    for (; index != end; index++) {
+      TraceRecord r = Trace.get(index);
+      TEST_ASSERT_TRUE((uint16_t)(r.tick - lastTick) < 0x8000); // Claimed in time order
+      lastTick = r.tick;
+      if (r.event == TRACE_WRAP) {
+        TEST_ASSERT_EQUAL(0, r.tick);
+        wraps++;
+        continue;
+      }
+      uint8_t source = (r.event == TRACE_CYCLE_BEGIN) ? 0 : (r.event == TRACE_HX711_READ) ? 1 : 2;
+      if (r.event == TRACE_STEP_END) {
+        TEST_ASSERT_EQUAL((uint8_t)ends, r.data); // After its start, possibly with other records in between
+        TEST_ASSERT_TRUE(ends < next[2]);
+        ends++;
+        continue;
+      }
+      TEST_ASSERT_EQUAL((uint8_t)next[source], r.data);
+      next[source]++;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(recorded, next[0]);
+  TEST_ASSERT_EQUAL_UINT32(producers[0].recorded, next[1]);
+  TEST_ASSERT_EQUAL_UINT32(producers[1].recorded, next[2]);
+  TEST_ASSERT_EQUAL_UINT32(producers[1].recorded, ends);
+  TEST_ASSERT_EQUAL_UINT32(Hal.now() / WRAP_US, wraps);
+  TEST_ASSERT_TRUE(producers[1].recorded > 1000);
+}
+
+void test_pause_keeps_only_wraps() {
+  Trace.record(TRACE_CYCLE_BEGIN, 0);
+  Trace.pause();
+  Trace.record(TRACE_CYCLE_END, 1);
+  Hal.advance(WRAP_US);
+  TEST_ASSERT_EQUAL(2, Trace.end());
+  TEST_ASSERT_EQUAL(TRACE_WRAP, Trace.get(1).event);
+  Trace.resume();
+  Trace.record(TRACE_CYCLE_END, 2);
+  TEST_ASSERT_EQUAL(3, Trace.end());
+  TEST_ASSERT_EQUAL(2, Trace.get(2).data);
+}
+
+void test_dump_format() {
+  for (unsigned int i = 0; i < TRACE_RECORDS + 20; i++) {
+    Hal.advance(50);
+    Trace.record(TRACE_STEP_START + i % 2, (uint8_t)(i * 3));
+  }
+  Telemetry.begin(capture);
+  capture.frames = 0;
+  uint16_t end = Trace.end();
+  dumpTrace();
+  TEST_ASSERT_EQUAL(end, Trace.end()); // Frames sent during the dump are not recorded
+  TEST_ASSERT_EQUAL_UINT32(0, capture.decoder.getErrorCount());
+  uint8_t frames = (TRACE_RECORDS + TELEMETRY_TRACE_RECORDS - 1) / TELEMETRY_TRACE_RECORDS;
+  TEST_ASSERT_EQUAL(frames + 1, capture.frames);
+  uint16_t index = Trace.first();
+  for (uint8_t f = 0; f < frames; f++) {
+    const uint8_t *p = capture.payloads[f];
+    uint8_t count = (capture.lengths[f] - 2) / 4;
+    TEST_ASSERT_EQUAL(2 + 4 * count, capture.lengths[f]);
+    TEST_ASSERT_EQUAL((f < frames - 1) ? TELEMETRY_TRACE_RECORDS : TRACE_RECORDS % TELEMETRY_TRACE_RECORDS, count);
+    TEST_ASSERT_EQUAL(index, p[0] | p[1] << 8); // Index of the first record, little endian
+    for (uint8_t i = 0; i < count; i++, index++) {
+      TraceRecord r = Trace.get(index);
+      const uint8_t *q = p + 2 + 4 * i; // event, data, tick (little endian)
+      TEST_ASSERT_EQUAL(r.event, q[0]);
+      TEST_ASSERT_EQUAL(r.data, q[1]);
+      TEST_ASSERT_EQUAL(r.tick, q[2] | q[3] << 8);
+    }
+  }
+  TEST_ASSERT_EQUAL(end, index);
+  TEST_ASSERT_EQUAL(2, capture.lengths[frames]); // End of the dump: no records, the index of the next record
+  TEST_ASSERT_EQUAL(end, capture.payloads[frames][0] | capture.payloads[frames][1] << 8);
+  Trace.record(TRACE_CYCLE_BEGIN, 0); // Recording again after the dump
+  TEST_ASSERT_EQUAL((uint16_t)(end + 1), Trace.end());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_keeps_the_latest_records);
+  RUN_TEST(test_record_since_saturates);
+  RUN_TEST(test_records_survive_interrupt_load);
+  RUN_TEST(test_pause_keeps_only_wraps);
+  RUN_TEST(test_dump_format);
+  return UNITY_END();
+}
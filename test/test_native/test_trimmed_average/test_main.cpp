@@ -0,0 +1,146 @@
+/*
+ * test_trimmed_average
+ * HX711_TrimmedAverage (running sum and min/max queues) against the filter
+ * it replaced: the dataset summed and scanned for its peaks on every read
+ * (HX711_ADC::smoothedData() before the filter policies). Random
+ * conversions, out of range (0) conversions, runs of equal values and
+ * changes of the samples in use must give bit-identical outputs.
+ */
+
+#include <unity.h>
+#include <HX711_ADC_Filter.h>
+
+// The earlier HX711_ADC dataset handling, with the compile-time settings as template parameters
+template <uint8_t SAMPLES_, uint8_t IGN_HIGH, uint8_t IGN_LOW>
+class ScanFilter {
+  public:
+    void add(long value) {
+      if (readIndex == samplesInUse + IGN_HIGH + IGN_LOW - 1) readIndex = 0;
+      else readIndex++;
+      if (value > 0) dataSampleSet[readIndex] = value;
+    }
+
+    long value() {
+      long data = 0;
+      long L = 0xFFFFFF;
+      long H = 0x00;
+      for (uint8_t r = 0; r < (samplesInUse + IGN_HIGH + IGN_LOW); r++) {
+        if (IGN_LOW && L > dataSampleSet[r]) L = dataSampleSet[r]; // find lowest value
+        if (IGN_HIGH && H < dataSampleSet[r]) H = dataSampleSet[r]; // find highest value
+        data += dataSampleSet[r];
+      }
+      if (IGN_LOW) data -= L; // remove lowest value
+      if (IGN_HIGH) data -= H; // remove highest value
+      return (data >> divBit);
+    }
+
+    void setSamples(int samples, long fill) {
+      int old_value = samplesInUse;
+      if (samples > SAMPLES_) return;
+      if (samples == 0) divBit = HX711_log2(SAMPLES_);
+      else {
+        samples >>= 1;
+        for (divBit = 0; samples != 0; samples >>= 1, divBit++);
+      }
+      samplesInUse = 1 << divBit;
+      if (samplesInUse != old_value) {
+        for (uint8_t r = 0; r < samplesInUse + IGN_HIGH + IGN_LOW; r++) dataSampleSet[r] = fill;
+        readIndex = 0;
+      }
+    }
+
+    void resetIndex() {
+      readIndex = 0;
+    }
+
+  private:
+    long dataSampleSet[SAMPLES_ + IGN_HIGH + IGN_LOW] = {};
+    uint8_t readIndex = 0;
+    uint8_t divBit = HX711_log2(SAMPLES_);
+    int samplesInUse = SAMPLES_;
+};
+
+static uint32_t randomState;
+
+static uint32_t nextRandom() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+// Conversion in the range of conversion24bit(): mostly noise around a wandering level, with
+// full-scale outliers, repeats of the previous value and out of range conversions
+static long nextConversion(long &level, long previous) {
+  uint32_t r = nextRandom() % 100;
+  if (r < 3) return 0;
+  if (r < 6) return (nextRandom() & 1) ? 0xFFFFFF : 1;
+  if (r < 20 && previous) return previous;
+  level += (long)(nextRandom() % 2001) - 1000;
+  if (level < 1) level = 1;
+  if (level > 0xFFFFFF) level = 0xFFFFFF;
+  long value = level + (long)(nextRandom() % 401) - 200;
+  return (value < 1) ? 1 : (value > 0xFFFFFF ? 0xFFFFFF : value);
+}
+
+template <uint8_t SAMPLES_, uint8_t IGN_HIGH, uint8_t IGN_LOW, template <uint8_t> class Storage>
+static void compareFilters(uint32_t seed, unsigned long conversions) {
+  HX711_TrimmedAverage<SAMPLES_, IGN_HIGH, IGN_LOW, Storage> filter;
+  ScanFilter<SAMPLES_, IGN_HIGH, IGN_LOW> reference;
+  randomState = seed;
+  long level = 0x800000;
+  long previous = 0;
+  for (unsigned long i = 0; i < conversions; i++) {
+    uint32_t action = nextRandom() % 1000;
+    if (action < 5) {
+      int samples = nextRandom() % (SAMPLES_ + 1); // 0 = back to the compiled size
+      long fill = reference.value();
+      filter.setSamples(samples, fill);
+      reference.setSamples(samples, fill);
+    }
+    else if (action < 7) {
+      filter.resetIndex();
+      reference.resetIndex();
+    }
+    long value = nextConversion(level, previous);
+    if (value) previous = value;
+    filter.add(value);
+    reference.add(value);
+    TEST_ASSERT_EQUAL(reference.value(), filter.value());
+  }
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_default_configuration() {
+  compareFilters<16, 1, 1, HX711_Samples24>(2463534242UL, 200000);
+}
+
+void test_small_and_large_windows() {
+  compareFilters<2, 1, 1, HX711_Samples24>(1, 50000);
+  compareFilters<4, 1, 1, HX711_Samples24>(2, 50000);
+  compareFilters<128, 1, 1, HX711_Samples24>(3, 50000);
+}
+
+void test_one_side_or_no_trimming() {
+  compareFilters<16, 1, 0, HX711_Samples24>(4, 50000);
+  compareFilters<16, 0, 1, HX711_Samples24>(5, 50000);
+  compareFilters<16, 0, 0, HX711_Samples24>(6, 50000);
+  compareFilters<1, 0, 0, HX711_Samples24>(7, 10000);
+}
+
+void test_four_byte_storage() {
+  compareFilters<16, 1, 1, HX711_Samples32>(8, 50000);
+  compareFilters<64, 1, 1, HX711_Samples32>(9, 50000);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_default_configuration);
+  RUN_TEST(test_small_and_large_windows);
+  RUN_TEST(test_one_side_or_no_trimming);
+  RUN_TEST(test_four_byte_storage);
+  return UNITY_END();
+}
@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+"""Turn a GDP03 event trace dump into a Chrome trace or a text timeline.
+
+    python tools/trace2chrome.py capture.bin > trace.json
+    python tools/trace2chrome.py --text capture.bin
+
+The capture is the raw serial output of a firmware built with
+TRACE_ENABLED=1 after 'd' was sent (or the -o file of [env:rig]). Its
+TELEMETRY_TRACE frames (lib/Telemetry/TelemetryFrame.h) are decoded, the
+16-bit ticks unwrapped and the records (lib/Trace/Trace.h) turned into
+spans: moves per axis, HX711 reads per channel, telemetry frame writes and
+test cycles. Times start at the oldest record held. The last complete
+dump is used unless --dump picks another (0 = first, -1 = last). Open the
+JSON in chrome://tracing or https://ui.perfetto.dev.
+"""
+
+import argparse
+import json
+import sys
+
+TICK_US = 4  # TRACE_TICK_US
+TELEMETRY_TRACE = 0x09
+
+WRAP, STEP_START, STEP_END = 0, 1, 2
+HX711_READ, HX711_CHANNELS = 3, 4
+TARE_DONE, SERIAL_BEGIN, SERIAL_END, CYCLE_BEGIN, CYCLE_END = 7, 8, 9, 10, 11
+
+AXES = ("Forefoot", "Heel")
+TID_STEPS, TID_HX711, TID_SERIAL, TID_CYCLE = 1, 10, 20, 30
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i != len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def frames(capture):
+    """Valid telemetry frames as (type, payload), text and damaged frames are skipped."""
+    for chunk in capture.split(b"\x00"):
+        frame = cobs_decode(chunk) if chunk else None
+        if not frame or len(frame) < 4:
+            continue
+        if crc16(frame[:-2]) != frame[-2] | (frame[-1] << 8):
+            continue
+        yield frame[0], frame[2:-2]
+
+
+def dumps(capture):
+    """Complete trace dumps, each a list of (event, data, tick) oldest first."""
+    result = []
+    records = []
+    expected = None
+    for kind, payload in frames(capture):
+        if kind != TELEMETRY_TRACE or len(payload) < 2:
+            continue
+        index = payload[0] | (payload[1] << 8)
+        if expected is not None and index != expected:
+            records = []  # Missing frames, this dump cannot be unwrapped
+        body = payload[2:]
+        count = len(body) // 4
+        if count == 0:
+            if records:
+                result.append(records)
+            records = []
+            expected = None
+            continue
+        for i in range(count):
+            r = body[4 * i:4 * i + 4]
+            records.append((r[0], r[1], r[2] | (r[3] << 8)))
+        expected = (index + count) & 0xFFFF
+    return result
+
+
+def timeline(records):
+    """(time in us, event, data) with the ticks unwrapped, TRACE_WRAP records keep the gaps below 65536 ticks."""
+    t = 0
+    last = None
+    for event, data, tick in records:
+        if last is not None:
+            t += (tick - last) & 0xFFFF
+        last = tick
+        if event != WRAP:
+            yield t * TICK_US, event, data
+
+
+def chrome(records):
+    events = []
+    names = {TID_SERIAL: "Serial", TID_CYCLE: "Test cycle"}
+    for axis, name in enumerate(AXES):
+        names[TID_STEPS + axis] = name + " steps"
+    for channel in range(HX711_CHANNELS):
+        names[TID_HX711 + channel] = "HX711 %d" % channel
+    for tid, name in names.items():
+        events.append({"ph": "M", "name": "thread_name", "pid": 1, "tid": tid, "args": {"name": name}})
+
+    open_spans = set()
+    end = 0
+
+    def begin(tid, name, ts, args=None):
+        if tid in open_spans:
+            events.append({"ph": "i", "name": name, "pid": 1, "tid": tid, "ts": ts, "s": "t", "args": args or {}})
+            return
+        open_spans.add(tid)
+        events.append({"ph": "B", "name": name, "pid": 1, "tid": tid, "ts": ts, "args": args or {}})
+
+    def finish(tid, ts, args=None):
+        if tid not in open_spans:
+            return  # Began before the oldest record held
+        open_spans.discard(tid)
+        events.append({"ph": "E", "pid": 1, "tid": tid, "ts": ts, "args": args or {}})
+
+    for ts, event, data in timeline(records):
+        end = ts
+        if event == STEP_START:
+            begin(TID_STEPS + data, "move", ts)
+        elif event == STEP_END:
+            finish(TID_STEPS + data, ts)
+        elif HX711_READ <= event < HX711_READ + HX711_CHANNELS:
+            duration = data * TICK_US
+            args = {"read_us": duration if data < 255 else ">= %d" % duration}
+            events.append({"ph": "X", "name": "read", "pid": 1, "tid": TID_HX711 + event - HX711_READ, "ts": ts - duration, "dur": duration, "args": args})
+        elif event == TARE_DONE:
+            events.append({"ph": "i", "name": "tare done", "pid": 1, "tid": TID_HX711 + data, "ts": ts, "s": "t"})
+        elif event == SERIAL_BEGIN:
+            begin(TID_SERIAL, "frame 0x%02x" % data, ts)
+        elif event == SERIAL_END:
+            finish(TID_SERIAL, ts, {"bytes": data})
+        elif event == CYCLE_BEGIN:
+            begin(TID_CYCLE, "cycle", ts)
+        elif event == CYCLE_END:
+            finish(TID_CYCLE, ts, {"cycle (low byte)": data})
+    for tid in sorted(open_spans):
+        events.append({"ph": "E", "pid": 1, "tid": tid, "ts": end})
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def text(records, out):
+    labels = {STEP_START: "step start   axis %d", STEP_END: "step end     axis %d", TARE_DONE: "tare done    channel %d",
+              SERIAL_BEGIN: "serial begin type 0x%02x", SERIAL_END: "serial end   %d bytes",
+              CYCLE_BEGIN: "cycle begin", CYCLE_END: "cycle end    %d (low byte)"}
+    for ts, event, data in timeline(records):
+        if HX711_READ <= event < HX711_READ + HX711_CHANNELS:
+            line = "hx711 read   channel %d, %s%d us" % (event - HX711_READ, ">= " if data == 255 else "", data * TICK_US)
+        elif event in labels:
+            label = labels[event]
+            line = label % data if "%" in label else label
+        else:
+            line = "event %d     data %d" % (event, data)
+        out.write("%12.3f ms  %s\n" % (ts / 1000.0, line))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", help="serial capture file, - for stdin")
+    parser.add_argument("--dump", type=int, default=-1, help="which dump in the capture (default -1, the last)")
+    parser.add_argument("--text", action="store_true", help="print a text timeline instead of Chrome trace JSON")
+    args = parser.parse_args()
+
+    capture = sys.stdin.buffer.read() if args.capture == "-" else open(args.capture, "rb").read()
+    found = dumps(capture)
+    if not found:
+        sys.stderr.write("no complete trace dump in %s\n" % args.capture)
+        return 1
+    try:
+        records = found[args.dump]
+    except IndexError:
+        sys.stderr.write("only %d dump%s in %s\n" % (len(found), "" if len(found) == 1 else "s", args.capture))
+        return 1
+    sys.stderr.write("dump %d of %d: %d records\n" % (args.dump % len(found), len(found), len(records)))
+    if args.text:
+        text(records, sys.stdout)
+    else:
+        json.dump(chrome(records), sys.stdout)
+        sys.stdout.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())